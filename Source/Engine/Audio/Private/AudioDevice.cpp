@@ -168,20 +168,47 @@ AAudioDevice::AAudioDevice( int InSampleRate )
     GLogger.Printf( "Audio buffer size: %d bytes\n", TransferBufferSizeInBytes );
 }
 
+AAudioDevice::AAudioDevice( int InSampleRate, int InSampleBits, int InChannels, int InTransferBufferSizeInFrames )
+{
+    AN_ASSERT( InSampleBits == 8 || InSampleBits == 16 || InSampleBits == 32 );
+    AN_ASSERT( InChannels == 1 || InChannels == 2 );
+
+    AudioDeviceId = 0;
+
+    SampleBits = InSampleBits;
+    bSigned8 = false;
+    SampleRate = InSampleRate;
+    Channels = InChannels;
+    NumFrames = Math::ToGreaterPowerOfTwo( InTransferBufferSizeInFrames );
+    Samples = NumFrames << ( Channels - 1 );
+    TransferBufferSizeInBytes = Samples * (SampleBits / 8);
+    pTransferBuffer = (uint8_t *)GHeapMemory.Alloc( TransferBufferSizeInBytes );
+    Core::MemsetSSE( pTransferBuffer, SampleBits == 8 ? 0x80 : 0, TransferBufferSizeInBytes );
+    TransferOffset = 0;
+    PrevTransferOffset = 0;
+    BufferWraps = 0;
+}
+
 AAudioDevice::~AAudioDevice()
 {
-    SDL_CloseAudioDevice( AudioDeviceId );
+    if ( AudioDeviceId ) {
+        SDL_CloseAudioDevice( AudioDeviceId );
+    }
 
     GHeapMemory.Free( pTransferBuffer );
 }
 
 void AAudioDevice::SetMixerCallback( std::function< void( uint8_t * pTransferBuffer, int TransferBufferSizeInFrames, int FrameNum, int MinFramesToRender ) > _MixerCallback )
 {
-    SDL_LockAudioDevice( AudioDeviceId );
+    if ( AudioDeviceId ) {
+        SDL_LockAudioDevice( AudioDeviceId );
+    }
 
     MixerCallback = _MixerCallback;
 
-    SDL_UnlockAudioDevice( AudioDeviceId );
+    if ( AudioDeviceId ) {
+        SDL_UnlockAudioDevice( AudioDeviceId );
+    }
 }
 
 void AAudioDevice::RenderAudio( uint8_t * pStream, int StreamLength )
@@ -232,7 +259,9 @@ void AAudioDevice::RenderAudio( uint8_t * pStream, int StreamLength )
 
 uint8_t * AAudioDevice::MapTransferBuffer( int64_t * pFrameNum )
 {
-    SDL_LockAudioDevice( AudioDeviceId );
+    if ( AudioDeviceId ) {
+        SDL_LockAudioDevice( AudioDeviceId );
+    }
 
     if ( pFrameNum ) {
         if ( TransferOffset < PrevTransferOffset ) {
@@ -248,17 +277,23 @@ uint8_t * AAudioDevice::MapTransferBuffer( int64_t * pFrameNum )
 
 void AAudioDevice::UnmapTransferBuffer()
 {
-    SDL_UnlockAudioDevice( AudioDeviceId );
+    if ( AudioDeviceId ) {
+        SDL_UnlockAudioDevice( AudioDeviceId );
+    }
 }
 
 void AAudioDevice::BlockSound()
 {
-    SDL_PauseAudioDevice( AudioDeviceId, 1 );
+    if ( AudioDeviceId ) {
+        SDL_PauseAudioDevice( AudioDeviceId, 1 );
+    }
 }
 
 void AAudioDevice::UnblockSound()
 {
-    SDL_PauseAudioDevice( AudioDeviceId, 0 );
+    if ( AudioDeviceId ) {
+        SDL_PauseAudioDevice( AudioDeviceId, 0 );
+    }
 }
 
 void AAudioDevice::ClearBuffer()
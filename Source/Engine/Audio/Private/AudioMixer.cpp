@@ -36,6 +36,10 @@ SOFTWARE.
 #include <Core/Public/Logger.h>
 #include <Core/Public/IntrusiveLinkedListMacro.h>
 
+#include <Runtime/Public/Runtime.h>
+
+#include <emmintrin.h>
+
 ARuntimeVariable Snd_MixAhead( _CTS( "Snd_MixAhead" ), _CTS( "0.1" ) );
 ARuntimeVariable Snd_VolumeRampSize( _CTS( "Snd_VolumeRampSize" ), _CTS( "16" ) );
 ARuntimeVariable Snd_HRTF( _CTS( "Snd_HRTF"), _CTS("1") );
@@ -48,36 +52,21 @@ ARuntimeVariable Rev_Dry( _CTS( "Rev_Dry" ), _CTS( "1" ) );
 ARuntimeVariable Rev_Width( _CTS( "Rev_Width" ), _CTS( "1" ) );
 #endif
 
-// u8 to s32 sample convertion
-struct SSampleLookup8Bit
-{
-    int Data[32][256];
-
-    int16_t ToShort[256];
-
-    SSampleLookup8Bit()
-    {
-        for ( int v = 0; v < 32; v++ ) {
-            int vol = v * 8 * 256;
-            for ( int s = 0; s < 256; s++ ) {
-                Data[ v ][ ( s + 128 ) & 0xff ] = ( ( s < 128 ) ? s : s - 256 ) * vol;
-            }
-        }
-
-        for ( int s = 0; s < 256; s++ ) {
-            ToShort[ ( s + 128 ) & 0xff ] = ( ( s < 128 ) ? s : s - 256 ) * 255;
-        }
-    }
-};
-
-static const SSampleLookup8Bit SampleLookup8Bit;
+// Sample to float convertion. 8-bit samples are unsigned.
+static const float S16ToFloat = 1.0f / 32767;
+static const float U8ToFloat = 255.0f / 32767;
 
 AAudioMixer::AAudioMixer( AAudioDevice * _Device )
+    : AAudioMixer( _Device, GRuntime->GetEmbeddedResources() )
+{
+}
+
+AAudioMixer::AAudioMixer( AAudioDevice * _Device, AArchive const & Resources )
     : pDevice( _Device )
     , bAsync( false )
     , RenderFrame( 0 )
 {
-    Hrtf = MakeUnique< AAudioHRTF >( pDevice->GetSampleRate() );
+    Hrtf = MakeUnique< AAudioHRTF >( pDevice->GetSampleRate(), Resources );
     ReverbFilter = MakeUnique< AFreeverb >( pDevice->GetSampleRate() );
 
     Channels = nullptr;
@@ -214,6 +203,22 @@ void AAudioMixer::Update()
 #endif
 }
 
+void AAudioMixer::RenderOffline( int FrameCount )
+{
+    if ( bAsync ) {
+        GLogger.Printf( "AAudioMixer::RenderOffline: mixer is running in async thread\n" );
+        return;
+    }
+
+    AN_ASSERT( FrameCount <= pDevice->GetTransferBufferSizeInFrames() );
+
+    pTransferBuffer = pDevice->MapTransferBuffer();
+
+    RenderChannels( RenderFrame + FrameCount );
+
+    pDevice->UnmapTransferBuffer();
+}
+
 void AAudioMixer::UpdateAsync( uint8_t * _pTransferBuffer, int TransferBufferSizeInFrames, int FrameNum, int MinFramesToRender )
 {
     pTransferBuffer = _pTransferBuffer;
@@ -333,55 +338,119 @@ void AAudioMixer::RenderChannels( int64_t EndFrame )
             chan->PlaybackPos.Store( PlaybackPos );
         }
 
-        WriteToTransferBuffer( (int const *)RenderBuffer, end );
+        WriteToTransferBuffer( &RenderBuffer[0].Chanf[0], end );
         RenderFrame = end;
     }
 
     NumActiveChannels.Store( numActiveChan );
 }
 
-static void ConvertFramesToMonoF32( const void * pFramesIn, int FrameCount, int SampleBits, int Channels, float * pFramesOut )
+// Convert samples to float format keeping channels interleaved
+static void ConvertSamplesToF32( const void * pSamplesIn, int SampleCount, int SampleBits, float * pSamplesOut )
 {
+    int i = 0;
+
     if ( SampleBits == 8 ) {
-        // Lookup at max volume
-        int const * lookup = SampleLookup8Bit.Data[31];
-        const float intToFloat = 1.0f / 256 / 32767;
+        uint8_t const * samples = (uint8_t const *)pSamplesIn;
 
-        uint8_t const * frames = (uint8_t const *)pFramesIn;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16( 128 );
+        const __m128 scale = _mm_set1_ps( U8ToFloat );
 
-        // Mono
-        if ( Channels == 1 ) {
-            for ( int i = 0 ; i < FrameCount; i++ ) {
-                pFramesOut[i] = lookup[frames[i]] * intToFloat;
-            }
-            return;
+        for ( ; i + 16 <= SampleCount ; i += 16 ) {
+            __m128i s8 = _mm_loadu_si128( (const __m128i *)( samples + i ) );
+            __m128i lo = _mm_sub_epi16( _mm_unpacklo_epi8( s8, zero ), bias );
+            __m128i hi = _mm_sub_epi16( _mm_unpackhi_epi8( s8, zero ), bias );
+
+            _mm_storeu_ps( pSamplesOut + i,      _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( lo, lo ), 16 ) ), scale ) );
+            _mm_storeu_ps( pSamplesOut + i + 4,  _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( lo, lo ), 16 ) ), scale ) );
+            _mm_storeu_ps( pSamplesOut + i + 8,  _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( hi, hi ), 16 ) ), scale ) );
+            _mm_storeu_ps( pSamplesOut + i + 12, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( hi, hi ), 16 ) ), scale ) );
         }
 
-        // Combine stereo channels
-        for ( int i = 0 ; i < FrameCount; i++ ) {
-            pFramesOut[i] = (lookup[frames[0]] + lookup[frames[1]]) * (intToFloat * 0.5f); // average
-            frames += 2;
+        for ( ; i < SampleCount ; i++ ) {
+            pSamplesOut[i] = ( (int)samples[i] - 128 ) * U8ToFloat;
         }
         return;
     }
 
     if ( SampleBits == 16 ) {
-        const float intToFloat = 1.0f / 32767;
+        int16_t const * samples = (int16_t const *)pSamplesIn;
 
+        const __m128 scale = _mm_set1_ps( S16ToFloat );
+
+        for ( ; i + 8 <= SampleCount ; i += 8 ) {
+            __m128i s16 = _mm_loadu_si128( (const __m128i *)( samples + i ) );
+
+            _mm_storeu_ps( pSamplesOut + i,     _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s16, s16 ), 16 ) ), scale ) );
+            _mm_storeu_ps( pSamplesOut + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( s16, s16 ), 16 ) ), scale ) );
+        }
+
+        for ( ; i < SampleCount ; i++ ) {
+            pSamplesOut[i] = samples[i] * S16ToFloat;
+        }
+        return;
+    }
+
+    if ( SampleBits == 32 ) {
+        Core::Memcpy( pSamplesOut, pSamplesIn, SampleCount * sizeof( float ) );
+        return;
+    }
+
+    // Should never happen, but just in case...
+    AN_ASSERT( 0 );
+}
+
+static void ConvertFramesToMonoF32( const void * pFramesIn, int FrameCount, int SampleBits, int Channels, float * pFramesOut )
+{
+    // Mono
+    if ( Channels == 1 ) {
+        ConvertSamplesToF32( pFramesIn, FrameCount, SampleBits, pFramesOut );
+        return;
+    }
+
+    // Combine stereo channels (average)
+    int i = 0;
+
+    if ( SampleBits == 8 ) {
+        uint8_t const * frames = (uint8_t const *)pFramesIn;
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16( 128 );
+        const __m128i one = _mm_set1_epi16( 1 );
+        const __m128 scale = _mm_set1_ps( U8ToFloat * 0.5f );
+
+        for ( ; i + 8 <= FrameCount ; i += 8 ) {
+            __m128i s8 = _mm_loadu_si128( (const __m128i *)( frames + i * 2 ) );
+            __m128i lo = _mm_sub_epi16( _mm_unpacklo_epi8( s8, zero ), bias );
+            __m128i hi = _mm_sub_epi16( _mm_unpackhi_epi8( s8, zero ), bias );
+
+            // Sum of left and right samples
+            _mm_storeu_ps( pFramesOut + i,     _mm_mul_ps( _mm_cvtepi32_ps( _mm_madd_epi16( lo, one ) ), scale ) );
+            _mm_storeu_ps( pFramesOut + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( _mm_madd_epi16( hi, one ) ), scale ) );
+        }
+
+        for ( ; i < FrameCount ; i++ ) {
+            pFramesOut[i] = ( (int)frames[i * 2] + (int)frames[i * 2 + 1] - 256 ) * ( U8ToFloat * 0.5f );
+        }
+        return;
+    }
+
+    if ( SampleBits == 16 ) {
         int16_t const * frames = (int16_t const *)pFramesIn;
 
-        // Mono
-        if ( Channels == 1 ) {
-            for ( int i = 0 ; i < FrameCount; i++ ) {
-                pFramesOut[i] = frames[i] * intToFloat;
-            }
-            return;
+        const __m128i one = _mm_set1_epi16( 1 );
+        const __m128 scale = _mm_set1_ps( S16ToFloat * 0.5f );
+
+        for ( ; i + 4 <= FrameCount ; i += 4 ) {
+            __m128i s16 = _mm_loadu_si128( (const __m128i *)( frames + i * 2 ) );
+
+            // Sum of left and right samples
+            _mm_storeu_ps( pFramesOut + i, _mm_mul_ps( _mm_cvtepi32_ps( _mm_madd_epi16( s16, one ) ), scale ) );
         }
 
-        // Combine stereo channels
-        for ( int i = 0 ; i < FrameCount; i++ ) {
-            pFramesOut[i] = ((int)frames[0] + (int)frames[1]) * (intToFloat * 0.5f); // average
-            frames += 2;
+        for ( ; i < FrameCount ; i++ ) {
+            pFramesOut[i] = ( (int)frames[i * 2] + (int)frames[i * 2 + 1] ) * ( S16ToFloat * 0.5f );
         }
         return;
     }
@@ -389,16 +458,20 @@ static void ConvertFramesToMonoF32( const void * pFramesIn, int FrameCount, int
     if ( SampleBits == 32 ) {
         float const * frames = (float const *)pFramesIn;
 
-        // Mono
-        if ( Channels == 1 ) {
-            Core::Memcpy( pFramesOut, pFramesIn, FrameCount * sizeof( float ) );
-            return;
+        const __m128 half = _mm_set1_ps( 0.5f );
+
+        for ( ; i + 4 <= FrameCount ; i += 4 ) {
+            __m128 a = _mm_loadu_ps( frames + i * 2 );
+            __m128 b = _mm_loadu_ps( frames + i * 2 + 4 );
+
+            __m128 left = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+            __m128 right = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+
+            _mm_storeu_ps( pFramesOut + i, _mm_mul_ps( _mm_add_ps( left, right ), half ) );
         }
 
-        // Combine stereo channels
-        for ( int i = 0 ; i < FrameCount; i++ ) {
-            pFramesOut[i] = (frames[0] + frames[1]) * 0.5f; // average
-            frames += 2;
+        for ( ; i < FrameCount ; i++ ) {
+            pFramesOut[i] = ( frames[i * 2] + frames[i * 2 + 1] ) * 0.5f;
         }
         return;
     }
@@ -592,477 +665,270 @@ void AAudioMixer::RenderStream( SAudioChannel * Chan, int64_t EndFrame )
     }
 }
 
-void AAudioMixer::MakeVolumeRamp( const int CurVol[2], const int _NewVol[2], int FrameCount, int Scale )
+void AAudioMixer::MakeVolumeRamp( const int CurVol[2], const int _NewVol[2], int FrameCount, float Scale )
 {
+    VolumeRamp.Gain[0] = _NewVol[0] * Scale;
+    VolumeRamp.Gain[1] = _NewVol[1] * Scale;
+
+    VolumeRamp.Size = 0;
+
     if ( CurVol[0] == _NewVol[0] && CurVol[1] == _NewVol[1] ) {
-        VolumeRampSize = 0;
         return;
     }
 
-    VolumeRampSize = Math::Min3( (int)AN_ARRAY_SIZE( VolumeRampL ), FrameCount, Snd_VolumeRampSize.GetInteger() );
-    if ( VolumeRampSize < 0 ) {
-        VolumeRampSize = 0;
+    VolumeRamp.Size = Math::Min( FrameCount, Snd_VolumeRampSize.GetInteger() );
+    if ( VolumeRamp.Size <= 0 ) {
+        VolumeRamp.Size = 0;
         return;
     }
 
-    float increment0 = (float)(_NewVol[0] - CurVol[0]) / (VolumeRampSize * Scale);
-    float increment1 = (float)(_NewVol[1] - CurVol[1]) / (VolumeRampSize * Scale);
-
-    float lvolf = (float)CurVol[0] / Scale;
-    float rvolf = (float)CurVol[1] / Scale;
+    VolumeRamp.Start[0] = CurVol[0] * Scale;
+    VolumeRamp.Start[1] = CurVol[1] * Scale;
 
-    for ( int i = 0 ; i < VolumeRampSize ; i++ ) {
-        lvolf += increment0;
-        rvolf += increment1;
-
-        VolumeRampL[i] = lvolf;
-        VolumeRampR[i] = rvolf;
-    }
+    VolumeRamp.Step[0] = ( VolumeRamp.Gain[0] - VolumeRamp.Start[0] ) / VolumeRamp.Size;
+    VolumeRamp.Step[1] = ( VolumeRamp.Gain[1] - VolumeRamp.Start[1] ) / VolumeRamp.Size;
 }
 
-void AAudioMixer::RenderFramesHRTF( SAudioChannel * Chan, int FrameCount, SSamplePair * pBuffer )
+// Mix mono frames to the bus
+static void MixMonoF32( float * pBus, float const * pFrames, int FrameCount, SAudioVolumeRamp const & Ramp )
 {
-    int total = FrameCount;
+    int i = 0;
 
-    // align length to block size
-    int blocksize = HRTF_BLOCK_LENGTH;
-    if ( total % blocksize ) {
-        int numblocks = total / blocksize + 1;
-        total = numblocks * blocksize;
-    }
+    // Volume ramp, two frames per iteration
+    int rampSize = Math::Min( Ramp.Size, FrameCount );
+    if ( rampSize > 0 ) {
+        __m128 gain = _mm_setr_ps( Ramp.Start[0] + Ramp.Step[0], Ramp.Start[1] + Ramp.Step[1], Ramp.Start[0] + Ramp.Step[0] * 2, Ramp.Start[1] + Ramp.Step[1] * 2 );
+        __m128 step = _mm_setr_ps( Ramp.Step[0] * 2, Ramp.Step[1] * 2, Ramp.Step[0] * 2, Ramp.Step[1] * 2 );
 
-    int historyExtraFrames = Hrtf->GetFrameCount() - 1;
+        for ( ; i + 2 <= rampSize ; i += 2 ) {
+            __m128 s = _mm_castpd_ps( _mm_load_sd( (const double *)( pFrames + i ) ) );
+            float * bus = pBus + i * 2;
 
-    // Read frames from current playback position and convert to f32 format
-    FramesF32.ResizeInvalidate( ( total + historyExtraFrames ) * sizeof( float ) );
-    ReadFramesF32( Chan, total, historyExtraFrames, FramesF32.ToPtr() );
+            _mm_storeu_ps( bus, _mm_add_ps( _mm_loadu_ps( bus ), _mm_mul_ps( _mm_unpacklo_ps( s, s ), gain ) ) );
 
-    // Reallocate (if need) container for filtered samples
-    StreamF32.ResizeInvalidate( sizeof( SSamplePair ) * total );
-
-    // Apply HRTF filter
-    Float3 dir;
-    Hrtf->ApplyHRTF( Chan->LocalDir, NewDir, FramesF32.ToPtr(), total, (float *)StreamF32.ToPtr(), dir );
-    Chan->LocalDir = dir;
-
-    // Make volume ramp
-    VolumeRampSize = 0;
-    if ( Chan->Volume[0] != NewVol[0] || Chan->Volume[1] != NewVol[1] ) {
-        VolumeRampSize = Math::Min3( (int)AN_ARRAY_SIZE( VolumeRampL ), FrameCount, Snd_VolumeRampSize.GetInteger() );
-        if ( VolumeRampSize > 0 ) {
-            float scale = 256.0f / Hrtf->GetFilterSize();
-            float increment0 = (float)(NewVol[0] - Chan->Volume[0]) / VolumeRampSize * scale;
-            float lvolf = (float)Chan->Volume[0] * scale;
-            for ( int i = 0 ; i < VolumeRampSize ; i++ ) {
-                lvolf += increment0;
-                VolumeRampL[i] = lvolf;
-            }
+            gain = _mm_add_ps( gain, step );
         }
-    }
-
-    SSamplePair * pStreamF32 = StreamF32.ToPtr();
 
-#if 0
-    // Adjust volume
-    float vol = float( 65536 / 256 ) * NewVol[0] / Hrtf->GetFilterSize();
-    for ( int i = 0; i < VolumeRampSize; i++ ) {
-        pStreamF32[i].Chanf[0] = pStreamF32[i].Chanf[0] * VolumeRampL[i];
-        pStreamF32[i].Chanf[1] = pStreamF32[i].Chanf[1] * VolumeRampL[i];
-    }
-    for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-        pStreamF32[i].Chanf[0] = pStreamF32[i].Chanf[0] * vol;
-        pStreamF32[i].Chanf[1] = pStreamF32[i].Chanf[1] * vol;
+        if ( i < rampSize ) {
+            pBus[i * 2]     += pFrames[i] * ( Ramp.Start[0] + Ramp.Step[0] * ( i + 1 ) );
+            pBus[i * 2 + 1] += pFrames[i] * ( Ramp.Start[1] + Ramp.Step[1] * ( i + 1 ) );
+            i++;
+        }
     }
 
-    float * out = (float *)malloc( FrameCount * 2 * sizeof( float ) );
+    __m128 gain = _mm_setr_ps( Ramp.Gain[0], Ramp.Gain[1], Ramp.Gain[0], Ramp.Gain[1] );
 
-    ReverbFilter->ProcessReplace( &pStreamF32[0].Chanf[0], &pStreamF32[0].Chanf[1], &out[0], &out[1], FrameCount, 2 );
+    for ( ; i + 4 <= FrameCount ; i += 4 ) {
+        __m128 s = _mm_loadu_ps( pFrames + i );
+        float * bus = pBus + i * 2;
 
-    // Mix with output stream
-    for ( int i = 0 ; i < FrameCount; i++ ) {
-        pBuffer[i].Chan[0] += out[i*2] ;
-        pBuffer[i].Chan[1] += out[i*2+1];
+        _mm_storeu_ps( bus,     _mm_add_ps( _mm_loadu_ps( bus ),     _mm_mul_ps( _mm_unpacklo_ps( s, s ), gain ) ) );
+        _mm_storeu_ps( bus + 4, _mm_add_ps( _mm_loadu_ps( bus + 4 ), _mm_mul_ps( _mm_unpackhi_ps( s, s ), gain ) ) );
     }
 
-    free( out );
-#else
-    // Mix with output stream
-    float vol = float(65536 / 256) * NewVol[0] / Hrtf->GetFilterSize();
-    for ( int i = 0; i < VolumeRampSize; i++ ) {
-        pBuffer[i].Chan[0] += pStreamF32[i].Chanf[0] * VolumeRampL[i];
-        pBuffer[i].Chan[1] += pStreamF32[i].Chanf[1] * VolumeRampL[i];
+    for ( ; i < FrameCount ; i++ ) {
+        pBus[i * 2]     += pFrames[i] * Ramp.Gain[0];
+        pBus[i * 2 + 1] += pFrames[i] * Ramp.Gain[1];
     }
-    for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-        pBuffer[i].Chan[0] += pStreamF32[i].Chanf[0] * vol;
-        pBuffer[i].Chan[1] += pStreamF32[i].Chanf[1] * vol;
-    }
-#endif
-    
 }
 
-void AAudioMixer::RenderFrames( SAudioChannel * Chan, const void * pFrames, int FrameCount, SSamplePair * pBuffer )
+// Mix stereo frames to the bus
+static void MixStereoF32( float * pBus, float const * pFrames, int FrameCount, SAudioVolumeRamp const & Ramp )
 {
-    int sampleBits = Chan->SampleBits;
-    int channels = Chan->Channels;
-
-    // Render 8bit audio
-    if ( sampleBits == 8 ) {
-        uint8_t const * frames = (uint8_t const *)pFrames;
-
-#if 0
-        int lvol = Math::Min( NewVol[0] / 256, 255 );
-        int rvol = Math::Min( NewVol[1] / 256, 255 );
+    int i = 0;
 
-        int const * ls = SampleLookup8Bit.Data[lvol >> 3];
-        int const * rs = SampleLookup8Bit.Data[rvol >> 3];
+    // Volume ramp, two frames per iteration
+    int rampSize = Math::Min( Ramp.Size, FrameCount );
+    if ( rampSize > 0 ) {
+        __m128 gain = _mm_setr_ps( Ramp.Start[0] + Ramp.Step[0], Ramp.Start[1] + Ramp.Step[1], Ramp.Start[0] + Ramp.Step[0] * 2, Ramp.Start[1] + Ramp.Step[1] * 2 );
+        __m128 step = _mm_setr_ps( Ramp.Step[0] * 2, Ramp.Step[1] * 2, Ramp.Step[0] * 2, Ramp.Step[1] * 2 );
 
-        // Mono
-        if ( channels == 1 ) {
-            MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 256 );
+        for ( ; i + 2 <= rampSize ; i += 2 ) {
+            float * bus = pBus + i * 2;
 
-            for ( int i = 0; i < VolumeRampSize; i++ ) {
-                pBuffer[i].Chan[0] += ls[frames[i]]*VolumeRampL[i];
-                pBuffer[i].Chan[1] += rs[frames[i]]*VolumeRampR[i];
-            }
+            _mm_storeu_ps( bus, _mm_add_ps( _mm_loadu_ps( bus ), _mm_mul_ps( _mm_loadu_ps( pFrames + i * 2 ), gain ) ) );
 
-            for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-                pBuffer[i].Chan[0] += ls[frames[i]];
-                pBuffer[i].Chan[1] += rs[frames[i]];
-            }
-            return;
+            gain = _mm_add_ps( gain, step );
         }
-#else
-        int lvol = NewVol[0];
-        int rvol = NewVol[1];
 
-        // Mono
-        if ( channels == 1 ) {
-            lvol /= 256;
-            rvol /= 256;
-
-            MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 256 );
-
-            for ( int i = 0; i < VolumeRampSize; i++ ) {
-                pBuffer[i].Chan[0] += SampleLookup8Bit.ToShort[frames[i]]*VolumeRampL[i];
-                pBuffer[i].Chan[1] += SampleLookup8Bit.ToShort[frames[i]]*VolumeRampR[i];
-            }
-
-            for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-                pBuffer[i].Chan[0] += SampleLookup8Bit.ToShort[frames[i]] * lvol;
-                pBuffer[i].Chan[1] += SampleLookup8Bit.ToShort[frames[i]] * rvol;
-            }
-            return;
+        if ( i < rampSize ) {
+            pBus[i * 2]     += pFrames[i * 2]     * ( Ramp.Start[0] + Ramp.Step[0] * ( i + 1 ) );
+            pBus[i * 2 + 1] += pFrames[i * 2 + 1] * ( Ramp.Start[1] + Ramp.Step[1] * ( i + 1 ) );
+            i++;
         }
-#endif
-
-        // Spatialized stereo
-        if ( bSpatializedChannel ) {
-            // Combine stereo channels
-
-#if 0
+    }
 
-            MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 512 );
+    __m128 gain = _mm_setr_ps( Ramp.Gain[0], Ramp.Gain[1], Ramp.Gain[0], Ramp.Gain[1] );
 
-            for ( int i = 0; i < VolumeRampSize; i++ ) {
-                pBuffer[i].Chan[0] += ( ls[frames[0]] + ls[frames[1]] ) * VolumeRampL[i];
-                pBuffer[i].Chan[1] += ( rs[frames[0]] + rs[frames[1]] ) * VolumeRampR[i];
+    for ( ; i + 2 <= FrameCount ; i += 2 ) {
+        float * bus = pBus + i * 2;
 
-                frames += 2;
-            }
+        _mm_storeu_ps( bus, _mm_add_ps( _mm_loadu_ps( bus ), _mm_mul_ps( _mm_loadu_ps( pFrames + i * 2 ), gain ) ) );
+    }
 
-            for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-                pBuffer[i].Chan[0] += ( ls[frames[0]] + ls[frames[1]] ) / 2;
-                pBuffer[i].Chan[1] += ( rs[frames[0]] + rs[frames[1]] ) / 2;
+    if ( i < FrameCount ) {
+        pBus[i * 2]     += pFrames[i * 2]     * Ramp.Gain[0];
+        pBus[i * 2 + 1] += pFrames[i * 2 + 1] * Ramp.Gain[1];
+    }
+}
 
-                frames += 2;
-            }
+void AAudioMixer::RenderFramesHRTF( SAudioChannel * Chan, int FrameCount, SSamplePair * pBuffer )
+{
+    int total = FrameCount;
 
-#else
+    // align length to block size
+    int blocksize = HRTF_BLOCK_LENGTH;
+    if ( total % blocksize ) {
+        int numblocks = total / blocksize + 1;
+        total = numblocks * blocksize;
+    }
 
-            lvol /= 512;
-            rvol /= 512;
+    int historyExtraFrames = Hrtf->GetFrameCount() - 1;
 
-            MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 512 );
+    // Read frames from current playback position and convert to f32 format
+    FramesF32.ResizeInvalidate( ( total + historyExtraFrames ) * sizeof( float ) );
+    ReadFramesF32( Chan, total, historyExtraFrames, FramesF32.ToPtr() );
 
-            for ( int i = 0; i < VolumeRampSize; i++ ) {
-                pBuffer[i].Chan[0] += (SampleLookup8Bit.ToShort[frames[0]] + SampleLookup8Bit.ToShort[frames[1]]) * VolumeRampL[i];
-                pBuffer[i].Chan[1] += (SampleLookup8Bit.ToShort[frames[0]] + SampleLookup8Bit.ToShort[frames[1]]) * VolumeRampR[i];
+    // Reallocate (if need) container for filtered samples
+    StreamF32.ResizeInvalidate( sizeof( SSamplePair ) * total );
 
-                frames += 2;
-            }
+    // Apply HRTF filter
+    Float3 dir;
+    Hrtf->ApplyHRTF( Chan->LocalDir, NewDir, FramesF32.ToPtr(), total, (float *)StreamF32.ToPtr(), dir );
+    Chan->LocalDir = dir;
 
-            for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-                pBuffer[i].Chan[0] += (SampleLookup8Bit.ToShort[frames[0]] + SampleLookup8Bit.ToShort[frames[1]]) * lvol;
-                pBuffer[i].Chan[1] += (SampleLookup8Bit.ToShort[frames[0]] + SampleLookup8Bit.ToShort[frames[1]]) * rvol;
+    // Make volume ramp. Both channels use left volume
+    const int curVol[2] = { Chan->Volume[0], Chan->Volume[0] };
+    const int newVol[2] = { NewVol[0], NewVol[0] };
 
-                frames += 2;
-            }
-#endif
+    MakeVolumeRamp( curVol, newVol, FrameCount, 1.0f / ( Hrtf->GetFilterSize() * 32767.0f ) );
 
-            return;
-        }
-
-        // Background music/etc
-#if 0
-        MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 256 );
-        for ( int i = 0; i < VolumeRampSize; i++ ) {
-            pBuffer[i].Chan[0] += ls[frames[0]] * VolumeRampL[i];
-            pBuffer[i].Chan[1] += rs[frames[1]] * VolumeRampR[i];
+    // Mix with output stream
+    MixStereoF32( &pBuffer[0].Chanf[0], &StreamF32[0].Chanf[0], FrameCount, VolumeRamp );
+}
 
-            frames += 2;
-        }
-        for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-            pBuffer[i].Chan[0] += ls[frames[0]];
-            pBuffer[i].Chan[1] += rs[frames[1]];
+void AAudioMixer::RenderFrames( SAudioChannel * Chan, const void * pFrames, int FrameCount, SSamplePair * pBuffer )
+{
+    int sampleBits = Chan->SampleBits;
+    int channels = Chan->Channels;
 
-            frames += 2;
-        }
-#else
-        lvol /= 256;
-        rvol /= 256;
+    // Volume 65535 is full scale
+    const float volumeScale = 1.0f / 65536;
 
-        MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 256 );
-        for ( int i = 0; i < VolumeRampSize; i++ ) {
-            pBuffer[i].Chan[0] += SampleLookup8Bit.ToShort[frames[0]] * VolumeRampL[i];
-            pBuffer[i].Chan[1] += SampleLookup8Bit.ToShort[frames[1]] * VolumeRampR[i];
+    MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, volumeScale );
 
-            frames += 2;
-        }
-        for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-            pBuffer[i].Chan[0] += SampleLookup8Bit.ToShort[frames[0]] * lvol;
-            pBuffer[i].Chan[1] += SampleLookup8Bit.ToShort[frames[1]] * rvol;
+    // Mono or spatialized stereo
+    if ( channels == 1 || bSpatializedChannel ) {
+        // Stereo channels are combined
+        FramesF32.ResizeInvalidate( FrameCount );
+        ConvertFramesToMonoF32( pFrames, FrameCount, sampleBits, channels, FramesF32.ToPtr() );
 
-            frames += 2;
-        }
-#endif
+        MixMonoF32( &pBuffer[0].Chanf[0], FramesF32.ToPtr(), FrameCount, VolumeRamp );
         return;
     }
 
-    // Render 16bit audio
-    if ( sampleBits == 16 ) {
-        int lvol = NewVol[0];
-        int rvol = NewVol[1];
+    // Background music/etc
+    FramesF32.ResizeInvalidate( FrameCount * 2 );
+    ConvertSamplesToF32( pFrames, FrameCount * 2, sampleBits, FramesF32.ToPtr() );
 
-        int16_t const * frames = (int16_t const *)pFrames;
-
-        // Mono
-        if ( channels == 1 ) {
-            lvol /= 256;
-            rvol /= 256;
-
-            MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 256 );
-
-            for ( int i = 0; i < VolumeRampSize; i++ ) {
-                pBuffer[i].Chan[0] += frames[i] * VolumeRampL[i];
-                pBuffer[i].Chan[1] += frames[i] * VolumeRampR[i];
-            }
-
-            for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-                pBuffer[i].Chan[0] += frames[i] * lvol;
-                pBuffer[i].Chan[1] += frames[i] * rvol;
-            }
-            return;
-        }
-
-        // Spatialized stereo
-        if ( bSpatializedChannel ) {
-            // Combine stereo channels
-
-            // Downscale the volume twice
-            lvol /= 512;
-            rvol /= 512;
-
-            MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 512 );
-
-            for ( int i = 0; i < VolumeRampSize; i++ ) {
-                pBuffer[i].Chan[0] += ( (int)frames[0] + (int)frames[1] ) * VolumeRampL[i];
-                pBuffer[i].Chan[1] += ( (int)frames[0] + (int)frames[1] ) * VolumeRampR[i];
+    MixStereoF32( &pBuffer[0].Chanf[0], FramesF32.ToPtr(), FrameCount, VolumeRamp );
+}
 
-                frames += 2;
-            }
+// Convert bus samples to device format
+static void WriteSamples( float const * pIn, void * pOut, int Count, int SampleBits, bool bSigned8Bit )
+{
+    int i = 0;
 
-            for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-                pBuffer[i].Chan[0] += ( (int)frames[0] + (int)frames[1] ) * lvol;
-                pBuffer[i].Chan[1] += ( (int)frames[0] + (int)frames[1] ) * rvol;
+    switch ( SampleBits ) {
+    case 8:
+    {
+        int8_t * out = (int8_t *)pOut;
+        const __m128 scale = _mm_set1_ps( 32767.0f );
+        const __m128 minVal = _mm_set1_ps( -32768.0f );
+        const __m128 maxVal = _mm_set1_ps( 32767.0f );
+        const __m128i round = _mm_set1_epi16( 255 );
+        const __m128i bias = _mm_set1_epi8( bSigned8Bit ? 0 : (char)0x80 );
 
-                frames += 2;
-            }
+        for ( ; i + 16 <= Count ; i += 16 ) {
+            __m128i a = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pIn + i      ), scale ), minVal ), maxVal ) );
+            __m128i b = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pIn + i + 4  ), scale ), minVal ), maxVal ) );
+            __m128i c = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pIn + i + 8  ), scale ), minVal ), maxVal ) );
+            __m128i d = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pIn + i + 12 ), scale ), minVal ), maxVal ) );
 
-            return;
-        }
+            __m128i lo = _mm_packs_epi32( a, b );
+            __m128i hi = _mm_packs_epi32( c, d );
 
-        // Background music/etc
-        lvol /= 256;
-        rvol /= 256;
-        MakeVolumeRamp( Chan->Volume, NewVol, FrameCount, 256 );
-        for ( int i = 0; i < VolumeRampSize; i++ ) {
-            pBuffer[i].Chan[0] += frames[0] * VolumeRampL[i];
-            pBuffer[i].Chan[1] += frames[1] * VolumeRampR[i];
+            // Divide by 256 with truncation toward zero
+            lo = _mm_srai_epi16( _mm_add_epi16( lo, _mm_and_si128( _mm_srai_epi16( lo, 15 ), round ) ), 8 );
+            hi = _mm_srai_epi16( _mm_add_epi16( hi, _mm_and_si128( _mm_srai_epi16( hi, 15 ), round ) ), 8 );
 
-            frames += 2;
+            _mm_storeu_si128( (__m128i *)( out + i ), _mm_xor_si128( _mm_packs_epi16( lo, hi ), bias ) );
         }
-        for ( int i = VolumeRampSize ; i < FrameCount; i++ ) {
-            pBuffer[i].Chan[0] += frames[0] * lvol;
-            pBuffer[i].Chan[1] += frames[1] * rvol;
 
-            frames += 2;
+        for ( ; i < Count ; i++ ) {
+            int v = (int)Math::Clamp( pIn[i] * 32767.0f, -32768.0f, 32767.0f ) / 256;
+            out[i] = bSigned8Bit ? v : v + 128;
         }
-        return;
-    }
-
-    // TODO: Add code pass for 32F ?
-}
-
-static void WriteSamplesS8( int const * pIn, int8_t * pOut, int Count )
-{
-    int v;
-
-    for ( int i = 0; i < Count; i += 2 ) {
-        v = pIn[i] / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
-
-        pOut[i] = v / 256;
-
-        v = pIn[i+1] / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
-
-        pOut[i+1] = v / 256;
-    }
-}
-
-static void WriteSamplesS8_Mono( int const * pIn, int8_t * pOut, int Count )
-{
-    int v;
-
-    while ( Count-- ) {
-        v = *pIn / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
-        *pOut++ = v / 256;
-        pIn += 2;
+        break;
     }
-}
-
-static void WriteSamplesU8( int const * pIn, uint8_t * pOut, int Count )
-{
-    int v;
-
-    for ( int i = 0; i < Count; i += 2 ) {
-        v = pIn[i] / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
-
-        pOut[i] = (v / 256) + 128;
+    case 16:
+    {
+        short * out = (short *)pOut;
+        const __m128 scale = _mm_set1_ps( 32767.0f );
+        const __m128 minVal = _mm_set1_ps( -32768.0f );
+        const __m128 maxVal = _mm_set1_ps( 32767.0f );
 
-        v = pIn[i+1] / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
+        for ( ; i + 8 <= Count ; i += 8 ) {
+            __m128i a = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pIn + i     ), scale ), minVal ), maxVal ) );
+            __m128i b = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_loadu_ps( pIn + i + 4 ), scale ), minVal ), maxVal ) );
 
-        pOut[i+1] = (v / 256) + 128;
-    }
-}
+            _mm_storeu_si128( (__m128i *)( out + i ), _mm_packs_epi32( a, b ) );
+        }
 
-static void WriteSamplesU8_Mono( int const * pIn, uint8_t * pOut, int Count )
-{
-    int v;
-
-    while ( Count-- ) {
-        v = *pIn / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
-        *pOut++ = (v / 256) + 128;
-        pIn += 2;
+        for ( ; i < Count ; i++ ) {
+            out[i] = (int)Math::Clamp( pIn[i] * 32767.0f, -32768.0f, 32767.0f );
+        }
+        break;
     }
-}
+    case 32:
+    {
+        float * out = (float *)pOut;
+        const __m128 minVal = _mm_set1_ps( -1.0f );
+        const __m128 maxVal = _mm_set1_ps( 1.0f );
 
-static void WriteSamples16( int const * pIn, short * pOut, int Count )
-{
-    int v;
-
-    for ( int i = 0; i < Count; i += 2 ) {
-        v = pIn[i] / 256;
-        if ( v > 32767 )
-            pOut[i] = 32767;
-        else if ( v < -32768 )
-            pOut[i] = -32768;
-        else
-            pOut[i] = v;
-
-        v = pIn[i+1] / 256;
-        if ( v > 32767 )
-            pOut[i+1] = 32767;
-        else if ( v < -32768 )
-            pOut[i+1] = -32768;
-        else
-            pOut[i+1] = v;
-    }
-}
+        for ( ; i + 4 <= Count ; i += 4 ) {
+            _mm_storeu_ps( out + i, _mm_min_ps( _mm_max_ps( _mm_loadu_ps( pIn + i ), minVal ), maxVal ) );
+        }
 
-static void WriteSamples16_Mono( int const * pIn, short * pOut, int Count )
-{
-    int v;
-
-    while ( Count-- ) {
-        v = *pIn / 256;
-        if ( v > 32767 )
-            v = 32767;
-        else if ( v < -32768 )
-            v = -32768;
-        *pOut++ = v;
-        pIn += 2;
+        for ( ; i < Count ; i++ ) {
+            out[i] = Math::Clamp( pIn[i], -1.0f, 1.0f );
+        }
+        break;
     }
-}
-
-static void WriteSamples32( int const * pIn, float * pOut, int Count )
-{
-    const float scale = 1.0f / 256 / 32767;
-
-    __m128 minVal = _mm_set_ss( -1.0f );
-    __m128 maxVal = _mm_set_ss( 1.0f );
-
-    for ( int i = 0; i < Count; i += 2 ) {
-        float val1 = static_cast< float >(pIn[i  ]) * scale;
-        float val2 = static_cast< float >(pIn[i+1]) * scale;
-
-        _mm_store_ss( &pOut[i  ], _mm_min_ss( _mm_max_ss( _mm_set_ss( val1 ), minVal ), maxVal ) );
-        _mm_store_ss( &pOut[i+1], _mm_min_ss( _mm_max_ss( _mm_set_ss( val2 ), minVal ), maxVal ) );
     }
 }
 
-static void WriteSamples32_Mono( int const * pIn, float * pOut, int Count )
+void AAudioMixer::WriteToTransferBuffer( float * pSamples, int64_t EndFrame )
 {
-    const float scale = 1.0f / 256 / 32767;
+    int64_t wrapMask = pDevice->GetTransferBufferSizeInFrames() - 1;
+    int channels = pDevice->GetChannels();
 
-    __m128 minVal = _mm_set_ss( -1.0f );
-    __m128 maxVal = _mm_set_ss( 1.0f );
+    if ( channels == 1 ) {
+        // Keep left channel only. Samples are compacted in place
+        int frameCount = EndFrame - RenderFrame;
+        int i = 0;
 
-    while ( Count-- ) {
-        float val = static_cast< float >(*pIn) * scale;
+        for ( ; i + 4 <= frameCount ; i += 4 ) {
+            __m128 a = _mm_loadu_ps( pSamples + i * 2 );
+            __m128 b = _mm_loadu_ps( pSamples + i * 2 + 4 );
 
-        _mm_store_ss( pOut, _mm_min_ss( _mm_max_ss( _mm_set_ss( val ), minVal ), maxVal ) );
+            _mm_storeu_ps( pSamples + i, _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+        }
 
-        pOut++;
-        pIn += 2;
+        for ( ; i < frameCount ; i++ ) {
+            pSamples[i] = pSamples[i * 2];
+        }
     }
-}
-
-void AAudioMixer::WriteToTransferBuffer( int const * pSamples, int64_t EndFrame )
-{
-    int64_t wrapMask = pDevice->GetTransferBufferSizeInFrames() - 1;
 
     for ( int64_t frameNum = RenderFrame ; frameNum < EndFrame ; ) {
         int frameOffset = frameNum & wrapMask;
@@ -1074,46 +940,12 @@ void AAudioMixer::WriteToTransferBuffer( int const * pSamples, int64_t EndFrame
 
         frameNum += frameCount;
 
-        if ( pDevice->GetChannels() == 1 ) {
-            switch ( pDevice->GetSampleBits() ) {
-            case 8:
-                if ( pDevice->IsSigned8Bit() ) {
-                    WriteSamplesS8_Mono( pSamples, (int8_t *)pTransferBuffer + frameOffset, frameCount );
-                } else {
-                    WriteSamplesU8_Mono( pSamples, (uint8_t *)pTransferBuffer + frameOffset, frameCount );
-                }
-                break;
-            case 16:
-                WriteSamples16_Mono( pSamples, (short *)pTransferBuffer + frameOffset, frameCount );
-                break;
-            case 32:
-                WriteSamples32_Mono( pSamples, (float *)pTransferBuffer + frameOffset, frameCount );
-                break;
-            }
+        int sampleOffset = frameOffset * channels;
+        int sampleCount = frameCount * channels;
+        int sampleBits = pDevice->GetSampleBits();
 
-            pSamples += frameCount << 1;
-        }
-        else {
-            frameOffset <<= 1;
-            frameCount <<= 1;
-
-            switch ( pDevice->GetSampleBits() ) {
-            case 8:
-                if ( pDevice->IsSigned8Bit() ) {
-                    WriteSamplesS8( pSamples, (int8_t *)pTransferBuffer + frameOffset, frameCount );
-                } else {
-                    WriteSamplesU8( pSamples, (uint8_t *)pTransferBuffer + frameOffset, frameCount );
-                }
-                break;
-            case 16:
-                WriteSamples16( pSamples, (short *)pTransferBuffer + frameOffset, frameCount );
-                break;
-            case 32:
-                WriteSamples32( pSamples, (float *)pTransferBuffer + frameOffset, frameCount );
-                break;
-            }
+        WriteSamples( pSamples, (byte *)pTransferBuffer + sampleOffset * ( sampleBits >> 3 ), sampleCount, sampleBits, pDevice->IsSigned8Bit() );
 
-            pSamples += frameCount;
-        }
+        pSamples += sampleCount;
     }
 }
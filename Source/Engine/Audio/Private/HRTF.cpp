@@ -30,9 +30,9 @@ SOFTWARE.
 
 #include <Core/Public/Logger.h>
 #include <Core/Public/Core.h>
+#include <Core/Public/IO.h>
 
 #include <Runtime/Public/RuntimeVariable.h>
-#include <Runtime/Public/Runtime.h>
 
 #include <Audio/Public/HRTF.h>
 
@@ -45,10 +45,10 @@ SOFTWARE.
 
 ARuntimeVariable Snd_LerpHRTF( _CTS("Snd_LerpHRTF"), _CTS("1") );
 
-AAudioHRTF::AAudioHRTF( int SampleRate )
+AAudioHRTF::AAudioHRTF( int SampleRate, AArchive const & Resources )
 {
     AMemoryStream f;
-    if ( !f.OpenRead( "HRTF/IRC_1002_C.bin", GRuntime->GetEmbeddedResources() ) ) {
+    if ( !f.OpenRead( "HRTF/IRC_1002_C.bin", Resources ) ) {
         // An error occurred...
         CriticalError( "Failed to open HRTF data\n" );
     }
@@ -38,6 +38,11 @@ class AAudioDevice
 
 public:
     AAudioDevice( int InSampleRate );
+
+    /** Create device without audio output. Transfer buffer is filled by AAudioMixer::RenderOffline
+    and can be read back with MapTransferBuffer(). Used for offline rendering. */
+    AAudioDevice( int InSampleRate, int InSampleBits, int InChannels, int InTransferBufferSizeInFrames );
+
     virtual ~AAudioDevice();
 
     /** Playback frequency */
@@ -107,7 +112,7 @@ public:
 private:
     void RenderAudio( uint8_t * pStream, int StreamLength );
 
-    // Internal device id
+    // Internal device id. Zero for offline device
     uint32_t AudioDeviceId;
     // Transfer buffer memory
     uint8_t * pTransferBuffer;
@@ -37,12 +37,27 @@ SOFTWARE.
 
 #include <Runtime/Public/RuntimeVariable.h>
 
+class AArchive;
+
+/** Volume of the channel on the mixing bus. Gain is changed by Step on each of first Size frames, then Gain is used */
+struct SAudioVolumeRamp
+{
+    float Start[2];
+    float Step[2];
+    float Gain[2];
+    int Size;
+};
+
 class AAudioMixer
 {
     AN_FORBID_COPY( AAudioMixer )
 
 public:
     AAudioMixer( AAudioDevice * _Device );
+
+    /** HRTF data is loaded from Resources instead of the runtime embedded resources (offline rendering) */
+    AAudioMixer( AAudioDevice * _Device, AArchive const & Resources );
+
     virtual ~AAudioMixer();
 
     /** Make channel visible for mixer thread */
@@ -75,6 +90,16 @@ public:
     /** Perform mixing in main thread */
     void Update();
 
+    /** Render FrameCount frames to the transfer buffer starting from GetRenderFrame(). Device playback
+    position is ignored, so it can be used with the offline device to render the channels without output. */
+    void RenderOffline( int FrameCount );
+
+    /** Next frame to render */
+    int64_t GetRenderFrame() const
+    {
+        return RenderFrame;
+    }
+
 private:
     struct SSamplePair
     {
@@ -95,13 +120,14 @@ private:
     void RenderStream( SAudioChannel * Chan, int64_t EndFrame );
     void RenderFramesHRTF( SAudioChannel * Chan, int FrameCount, SSamplePair * pBuffer );
     void RenderFrames( SAudioChannel * Chan, const void * pFrames, int FrameCount, SSamplePair * pBuffer );
-    void WriteToTransferBuffer( int const * pSamples, int64_t EndFrame );
-    void MakeVolumeRamp( const int CurVol[2], const int NewVol[2], int FrameCount, int Scale );
+    void WriteToTransferBuffer( float * pSamples, int64_t EndFrame );
+    void MakeVolumeRamp( const int CurVol[2], const int NewVol[2], int FrameCount, float Scale );
     void ReadFramesF32( SAudioChannel * Chan, int FramesToRead, int HistoryExtraFrames, float * pFrames );
 
     TUniqueRef< class AAudioHRTF > Hrtf;
     TUniqueRef< class AFreeverb > ReverbFilter;
 
+    // Mixing bus. Samples are in float format, 1.0 is full scale
     alignas(16) SSamplePair RenderBuffer[2048];
     const int RenderBufferSize = AN_ARRAY_SIZE( RenderBuffer );
 
@@ -125,9 +151,7 @@ private:
     bool bSpatializedChannel;
     bool bChannelPaused;
     int PlaybackPos;
-    int VolumeRampL[1024];
-    int VolumeRampR[1024];
-    int VolumeRampSize;
+    SAudioVolumeRamp VolumeRamp;
 
     TPodVectorHeap< uint8_t > TempFrames;
     TPodVectorHeap< float > FramesF32;
@@ -35,12 +35,15 @@ SOFTWARE.
 
 constexpr int HRTF_BLOCK_LENGTH = 128; // Keep it to a power of two
 
+class AArchive;
+
 class AAudioHRTF
 {
     AN_FORBID_COPY( AAudioHRTF )
 
 public:
-    AAudioHRTF( int SampleRate );
+    /** Load HRIR data from the resource archive and resample it to SampleRate */
+    AAudioHRTF( int SampleRate, AArchive const & Resources );
     virtual ~AAudioHRTF();
 
     /** Gets a bilinearly interpolated HRTF */
@@ -30,6 +30,7 @@ SOFTWARE.
 
 #include <Core/Public/Core.h>
 #include <Core/Public/Memory.h>
+#include <Core/Public/MemoryTracker.h>
 #include <Core/Public/Logger.h>
 #include <Core/Public/WindowsDefs.h>
 #include <Core/Public/CoreMath.h>
@@ -517,9 +518,14 @@ static void InitializeMemory( size_t ZoneSizeInMegabytes, size_t HunkSizeInMegab
                     "Hunk memory size: %d Megs\n",
                     ZoneSizeInMegabytes, HunkSizeInMegabytes );
 
+    GMemoryTracker.Initialize();
+
     GHeapMemory.Initialize();
 
-    MemoryHeap = GHeapMemory.Alloc( TotalMemorySizeInBytes, 16 );
+    {
+        AN_MEMORY_TAG( "Zone and Hunk" );
+        MemoryHeap = GHeapMemory.Alloc( TotalMemorySizeInBytes, 16 );
+    }
     Core::ZeroMemSSE( MemoryHeap, TotalMemorySizeInBytes );
 
     //TouchMemoryPages( MemoryHeap, TotalMemorySizeInBytes );
@@ -533,10 +539,15 @@ static void InitializeMemory( size_t ZoneSizeInMegabytes, size_t HunkSizeInMegab
 
 static void DeinitializeMemory()
 {
+    if ( GMemoryTracker.IsEnabled() ) {
+        GMemoryTracker.DumpReport( "memory_report.txt" );
+    }
+
     GZoneMemory.Deinitialize();
     GHunkMemory.Deinitialize();
     GHeapMemory.Free( MemoryHeap );
     GHeapMemory.Deinitialize();
+    GMemoryTracker.Deinitialize();
 }
 
 }
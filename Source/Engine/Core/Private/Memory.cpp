@@ -29,6 +29,7 @@ SOFTWARE.
 */
 
 #include <Core/Public/Memory.h>
+#include <Core/Public/MemoryTracker.h>
 #include <Core/Public/Logger.h>
 #include <Core/Public/Core.h>
 
@@ -59,14 +60,6 @@ AZoneMemory GZoneMemory;
 //#define ZONE_MEMORY_LEAK_ADDRESS <local address>
 //#define ZONE_MEMORY_LEAK_SIZE <size>
 
-#ifdef AN_ZONE_MULTITHREADED_ALLOC
-#define ZONE_SYNC_GUARD ASyncGuard syncGuard( Sync );
-#define ZONE_SYNC_GUARD_STAT ASpinLockGuard lockGuard(StatisticLock);
-#else
-#define ZONE_SYNC_GUARD
-#define ZONE_SYNC_GUARD_STAT
-#endif
-
 using TRASH_MARKER = uint16_t;
 
 static const TRASH_MARKER TrashMarker = 0xfeee;
@@ -225,7 +218,9 @@ void * AHeapMemory::Alloc( size_t _BytesCount, int _Alignment )
 
     if (!HeapDebug())
     {
-        return Core::SysAlloc( Align(_BytesCount,_Alignment), _Alignment );
+        void * bytes = Core::SysAlloc( Align(_BytesCount,_Alignment), _Alignment );
+        GMemoryTracker.TrackAlloc( MEMORY_TRACKER_HEAP, bytes, _BytesCount );
+        return bytes;
     }
 
     size_t chunkSizeInBytes = _BytesCount + sizeof( SHeapChunk );
@@ -273,11 +268,15 @@ void * AHeapMemory::Alloc( size_t _BytesCount, int _Alignment )
 
     IncMemoryStatistics( heap->Size, heap->Size - heap->DataSize );
 
+    GMemoryTracker.TrackAlloc( MEMORY_TRACKER_HEAP, aligned, _BytesCount );
+
     return aligned;
 }
 
 void AHeapMemory::Free( void * _Bytes )
 {
+    GMemoryTracker.TrackFree( MEMORY_TRACKER_HEAP, _Bytes );
+
     if (!HeapDebug())
     {
         return Core::SysFree( _Bytes );
@@ -325,7 +324,14 @@ void * AHeapMemory::Realloc( void * _Data, int _NewBytesCount, int _NewAlignment
 
     if (!HeapDebug())
     {
-        return Core::SysRealloc( _Data, Align(_NewBytesCount,_NewAlignment), _NewAlignment );
+        void * bytes = Core::SysRealloc( _Data, Align(_NewBytesCount,_NewAlignment), _NewAlignment );
+        if ( bytes != _Data ) {
+            GMemoryTracker.TrackFree( MEMORY_TRACKER_HEAP, _Data );
+            GMemoryTracker.TrackAlloc( MEMORY_TRACKER_HEAP, bytes, _NewBytesCount );
+        } else {
+            GMemoryTracker.TrackRealloc( MEMORY_TRACKER_HEAP, bytes, _NewBytesCount );
+        }
+        return bytes;
     }
 
     if ( !_Data ) {
@@ -480,6 +486,8 @@ void AHunkMemory::Clear()
     MemoryBuffer->Hunk->Mark = -1; // marked free
     MemoryBuffer->Hunk->pPrev = MemoryBuffer->Cur = nullptr;
 
+    GMemoryTracker.TrackClear( MEMORY_TRACKER_HUNK );
+
     TotalMemoryUsage = 0;
     MaxMemoryUsage = 0;
     TotalMemoryOverhead = 0;
@@ -487,7 +495,9 @@ void AHunkMemory::Clear()
 
 int AHunkMemory::SetHunkMark()
 {
-    return ++MemoryBuffer->Mark;
+    int mark = ++MemoryBuffer->Mark;
+    GMemoryTracker.TrackHunkMark( mark );
+    return mark;
 }
 
 AN_FORCEINLINE void SetTrashMarker( SHunk * _Hunk )
@@ -574,6 +584,8 @@ void * AHunkMemory::Alloc( size_t _BytesCount )
 
     AN_ASSERT( IsAlignedPtr( aligned, 16 ) );
 
+    GMemoryTracker.TrackAlloc( MEMORY_TRACKER_HUNK, aligned, _BytesCount );
+
     return aligned;
 }
 
@@ -594,6 +606,8 @@ void AHunkMemory::ClearToMark( int _Mark )
         CriticalError( "AHunkMemory::ClearToMark: Memory was trashed\n" );
     }
 
+    GMemoryTracker.TrackHunkClearToMark( _Mark );
+
     int grow = 0;
 
     SHunk * hunk = MemoryBuffer->Hunk;
@@ -605,6 +619,7 @@ void AHunkMemory::ClearToMark( int _Mark )
 
     while ( hunk && hunk->Mark >= _Mark ) {
         DecMemoryStatistics( hunk->Size, sizeof( SHunk ) );
+        GMemoryTracker.TrackFree( MEMORY_TRACKER_HUNK, hunk + 1 );
         if ( HunkTrashTest( hunk ) ) {
             CriticalError( "AHunkMemory::ClearToMark: Warning: memory was trashed\n" );
         }
@@ -631,6 +646,7 @@ void AHunkMemory::ClearLastHunk()
 
     if ( hunk ) {
         DecMemoryStatistics( hunk->Size, sizeof( SHunk ) );
+        GMemoryTracker.TrackFree( MEMORY_TRACKER_HUNK, hunk + 1 );
         if ( HunkTrashTest( hunk ) ) {
             CriticalError( "AHunkMemory::ClearLastHunk: Warning: memory was trashed\n" );
             // error()
@@ -688,7 +704,8 @@ struct SZoneChunk
     SZoneChunk * pPrev;
     int32_t Size;
     int32_t DataSize;
-    byte Pad[8];
+    int32_t Pad;
+    int32_t BlockType;
 };
 
 struct SZoneBuffer
@@ -699,12 +716,160 @@ struct SZoneBuffer
     byte Pad[16];
 };
 
+/** Small block header. DataSize and BlockType are at the same offsets from user pointer as in SZoneChunk. */
+struct SZoneSmallBlock
+{
+    union
+    {
+        /** Next free block (only for free blocks) */
+        SZoneSmallBlock * pNext;
+        struct
+        {
+            int32_t SizeClass;
+            int32_t DataSize;
+        };
+    };
+    /** Offset from span header to the block */
+    int32_t SpanOffset;
+    int32_t BlockType;
+};
+
+/** Span header. Follows the chunk header of the span. */
+struct SZoneSpan
+{
+    /** Next/prev span with free blocks in the bin */
+    SZoneSpan * pNext;
+    SZoneSpan * pPrev;
+    /** Free blocks of the span that are in the bin */
+    SZoneSmallBlock * FreeList;
+    int32_t NumFree;
+    int32_t NumBlocks;
+};
+
 AN_SIZEOF_STATIC_CHECK( SZoneChunk, 32 );
 AN_SIZEOF_STATIC_CHECK( SZoneBuffer, 64 );
+AN_SIZEOF_STATIC_CHECK( SZoneSmallBlock, 16 );
+AN_SIZEOF_STATIC_CHECK( SZoneSpan, 32 );
+
+static_assert( sizeof( SZoneChunk ) - offsetof( SZoneChunk, DataSize ) == sizeof( SZoneSmallBlock ) - offsetof( SZoneSmallBlock, DataSize ), "SZoneSmallBlock::DataSize offset" );
+static_assert( sizeof( SZoneChunk ) - offsetof( SZoneChunk, BlockType ) == sizeof( SZoneSmallBlock ) - offsetof( SZoneSmallBlock, BlockType ), "SZoneSmallBlock::BlockType offset" );
+
+enum EZoneBlockType
+{
+    ZONE_BLOCK_LARGE = 0x4c524741,
+    ZONE_BLOCK_SPAN  = 0x5350414e,
+    ZONE_BLOCK_SMALL = 0x534d4c4c,
+    ZONE_BLOCK_FREE  = 0x46524545
+};
 
 static const int ChunkHeaderLength = sizeof( SZoneChunk );
 static const int MinZoneFragmentLength = 64; // Must be > ChunkHeaderLength
 
+/** Small block sizes (including block header) */
+static const int ZoneSizeClasses[AZoneMemory::NUM_SIZE_CLASSES] = {
+    32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048
+};
+
+static const int MaxSmallBlockSize = 2048;
+
+/** Memory of one span that is carved to small blocks of the same size class */
+static const int ZoneSpanSize = 64 << 10;
+
+/** Blocks transferred between thread cache and bin at once */
+static const int ZoneCacheBatchSize = 32;
+
+/** Max free blocks of one size class in thread cache */
+static const int ZoneCacheMaxBlocks = ZoneCacheBatchSize * 2;
+
+/** Block size to size class lookup (indexed by size / 16) */
+static int8_t ZoneSizeClassLookup[( MaxSmallBlockSize >> 4 ) + 1];
+
+static void InitializeSizeClassLookup()
+{
+    int sizeClass = 0;
+    for ( int i = 0 ; i <= ( MaxSmallBlockSize >> 4 ) ; i++ ) {
+        while ( ZoneSizeClasses[sizeClass] < ( i << 4 ) ) {
+            sizeClass++;
+        }
+        ZoneSizeClassLookup[i] = sizeClass;
+    }
+}
+
+/** Per-thread free lists of small blocks */
+struct SZoneThreadCache
+{
+    SZoneSmallBlock * FreeList[AZoneMemory::NUM_SIZE_CLASSES];
+    int NumFree[AZoneMemory::NUM_SIZE_CLASSES];
+    int Generation;
+
+    /** Next/prev registered thread cache */
+    SZoneThreadCache * pNext;
+    SZoneThreadCache * pPrev;
+    bool bRegistered;
+
+    ~SZoneThreadCache();
+};
+
+static thread_local SZoneThreadCache ZoneThreadCache;
+
+/** List of registered thread caches. Used to account blocks cached by other threads. */
+static SZoneThreadCache * ZoneThreadCacheList;
+static ASpinLock ZoneThreadCacheLock;
+
+SZoneThreadCache::~SZoneThreadCache()
+{
+    // Give cached blocks back to other threads
+    if ( GZoneMemory.MemoryBuffer && Generation == GZoneMemory.Generation.Load() ) {
+        for ( int i = 0 ; i < AZoneMemory::NUM_SIZE_CLASSES ; i++ ) {
+            GZoneMemory.FlushThreadCache( *this, i, NumFree[i] );
+        }
+    }
+
+    if ( bRegistered ) {
+        ASpinLockGuard lockGuard( ZoneThreadCacheLock );
+        if ( pPrev ) {
+            pPrev->pNext = pNext;
+        } else {
+            ZoneThreadCacheList = pNext;
+        }
+        if ( pNext ) {
+            pNext->pPrev = pPrev;
+        }
+        bRegistered = false;
+    }
+}
+
+AN_FORCEINLINE SZoneThreadCache & GetZoneThreadCache( int _Generation )
+{
+    SZoneThreadCache & cache = ZoneThreadCache;
+    if ( cache.Generation != _Generation ) {
+        // Zone memory was cleared, cached blocks are not valid anymore
+        ASpinLockGuard lockGuard( ZoneThreadCacheLock );
+        Core::ZeroMem( cache.FreeList, sizeof( cache.FreeList ) );
+        Core::ZeroMem( cache.NumFree, sizeof( cache.NumFree ) );
+        cache.Generation = _Generation;
+        if ( !cache.bRegistered ) {
+            cache.pPrev = nullptr;
+            cache.pNext = ZoneThreadCacheList;
+            if ( ZoneThreadCacheList ) {
+                ZoneThreadCacheList->pPrev = &cache;
+            }
+            ZoneThreadCacheList = &cache;
+            cache.bRegistered = true;
+        }
+    }
+    return cache;
+}
+
+AN_FORCEINLINE SZoneSpan * GetBlockSpan( SZoneSmallBlock * _Block )
+{
+    return ( SZoneSpan * )( ( byte * )_Block - _Block->SpanOffset );
+}
+
 AN_FORCEINLINE size_t AdjustChunkSize( size_t _BytesCount )
 {
 
@@ -723,6 +888,23 @@ AN_FORCEINLINE size_t AdjustChunkSize( size_t _BytesCount )
     return _BytesCount;
 }
 
+AN_FORCEINLINE size_t AdjustSmallBlockSize( size_t _BytesCount )
+{
+    // Add block header
+    _BytesCount += sizeof( SZoneSmallBlock );
+
+    // Add trash marker
+    if (MemoryTrashTest())
+    {
+        _BytesCount += sizeof( TRASH_MARKER );
+    }
+
+    // Align block to 16-byte boundary
+    _BytesCount = Align( _BytesCount, 16 );
+
+    return _BytesCount;
+}
+
 AN_FORCEINLINE void SetTrashMarker( SZoneChunk * _Chunk )
 {
     if (MemoryTrashTest())
@@ -743,6 +925,31 @@ AN_FORCEINLINE bool ChunkTrashTest( const SZoneChunk * _Chunk )
     }
 }
 
+AN_FORCEINLINE void SetTrashMarker( SZoneSmallBlock * _Block )
+{
+    if (MemoryTrashTest())
+    {
+        *( TRASH_MARKER * )( ( byte * )( _Block ) + ZoneSizeClasses[_Block->SizeClass] - sizeof( TRASH_MARKER ) ) = TrashMarker;
+    }
+}
+
+AN_FORCEINLINE bool BlockTrashTest( const SZoneSmallBlock * _Block )
+{
+    if (MemoryTrashTest())
+    {
+        return *( const TRASH_MARKER * )( ( const byte * )( _Block ) + ZoneSizeClasses[_Block->SizeClass] - sizeof( TRASH_MARKER ) ) != TrashMarker;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+AN_FORCEINLINE int32_t GetZoneBlockType( const void * _Bytes )
+{
+    return *( ( const int32_t * )_Bytes - 1 );
+}
+
 void * AZoneMemory::GetZoneMemoryAddress() const
 {
     return MemoryBuffer;
@@ -755,26 +962,22 @@ int AZoneMemory::GetZoneMemorySizeInMegabytes() const
 
 size_t AZoneMemory::GetTotalMemoryUsage() const
 {
-    ZONE_SYNC_GUARD_STAT
-    return TotalMemoryUsage;
+    return TotalMemoryUsage.Load();
 }
 
 size_t AZoneMemory::GetTotalMemoryOverhead() const
 {
-    ZONE_SYNC_GUARD_STAT
-    return TotalMemoryOverhead;
+    return TotalMemoryOverhead.Load();
 }
 
 size_t AZoneMemory::GetTotalFreeMemory() const
 {
-    ZONE_SYNC_GUARD_STAT
-    return MemoryBuffer ? MemoryBuffer->Size - TotalMemoryUsage : 0;
+    return MemoryBuffer ? MemoryBuffer->Size - TotalMemoryUsage.Load() : 0;
 }
 
 size_t AZoneMemory::GetMaxMemoryUsage() const
 {
-    ZONE_SYNC_GUARD_STAT
-    return MaxMemoryUsage;
+    return MaxMemoryUsage.Load();
 }
 
 void AZoneMemory::Initialize( void * _MemoryAddress, int _SizeInMegabytes )
@@ -793,20 +996,28 @@ void AZoneMemory::Initialize( void * _MemoryAddress, int _SizeInMegabytes )
         CriticalError( "AZoneMemory::Initialize: chunk must be at 16 byte boundary\n" );
     }
 
-    TotalMemoryUsage = 0;
-    TotalMemoryOverhead = 0;
-    MaxMemoryUsage = 0;
+    InitializeSizeClassLookup();
+
+    ResetBins();
+
+    Generation.Increment();
+
+    TotalMemoryUsage.Store( 0 );
+    TotalMemoryOverhead.Store( 0 );
+    MaxMemoryUsage.Store( 0 );
 }
 
 void AZoneMemory::Deinitialize()
 {
     CheckMemoryLeaks();
 
+    Generation.Increment();
+
     MemoryBuffer = nullptr;
 
-    TotalMemoryUsage = 0;
-    TotalMemoryOverhead = 0;
-    MaxMemoryUsage = 0;
+    TotalMemoryUsage.Store( 0 );
+    TotalMemoryOverhead.Store( 0 );
+    MaxMemoryUsage.Store( 0 );
 }
 
 void AZoneMemory::Clear()
@@ -815,37 +1026,53 @@ void AZoneMemory::Clear()
         return;
     }
 
-    ZONE_SYNC_GUARD
-
-    MemoryBuffer->ChunkList.pPrev = MemoryBuffer->ChunkList.pNext = MemoryBuffer->Rover = ( SZoneChunk * )( MemoryBuffer + 1 );
-    MemoryBuffer->ChunkList.Size = 0;
-    MemoryBuffer->Rover->Size = MemoryBuffer->Size - sizeof( SZoneBuffer );
-    MemoryBuffer->Rover->pNext = &MemoryBuffer->ChunkList;
-    MemoryBuffer->Rover->pPrev = &MemoryBuffer->ChunkList;
-
     {
-        ZONE_SYNC_GUARD_STAT
-        TotalMemoryUsage = 0;
-        TotalMemoryOverhead = 0;
-        MaxMemoryUsage = 0;
+        ASpinLockGuard lockGuard( ChunkLock );
+
+        MemoryBuffer->ChunkList.pPrev = MemoryBuffer->ChunkList.pNext = MemoryBuffer->Rover = ( SZoneChunk * )( MemoryBuffer + 1 );
+        MemoryBuffer->ChunkList.Size = 0;
+        MemoryBuffer->Rover->Size = MemoryBuffer->Size - sizeof( SZoneBuffer );
+        MemoryBuffer->Rover->pNext = &MemoryBuffer->ChunkList;
+        MemoryBuffer->Rover->pPrev = &MemoryBuffer->ChunkList;
     }
 
+    ResetBins();
+
+    GMemoryTracker.TrackClear( MEMORY_TRACKER_ZONE );
+
+    // Invalidate thread caches
+    Generation.Increment();
+
+    TotalMemoryUsage.Store( 0 );
+    TotalMemoryOverhead.Store( 0 );
+    MaxMemoryUsage.Store( 0 );
+
     // Allocated "on heap" memory is still present
 }
 
+void AZoneMemory::ResetBins()
+{
+    for ( int i = 0 ; i < NUM_SIZE_CLASSES ; i++ ) {
+        ASpinLockGuard lockGuard( Bins[i].Lock );
+        Bins[i].Spans = nullptr;
+        Bins[i].NumFree = 0;
+        Bins[i].NumTotal = 0;
+    }
+}
+
 void AZoneMemory::IncMemoryStatistics( size_t _MemoryUsage, size_t _Overhead )
 {
-    ZONE_SYNC_GUARD_STAT
-    TotalMemoryUsage += _MemoryUsage;
-    TotalMemoryOverhead += _Overhead;
-    MaxMemoryUsage = StdMax( MaxMemoryUsage, TotalMemoryUsage );
+    int64_t usage = TotalMemoryUsage.Add( _MemoryUsage );
+    TotalMemoryOverhead.Add( _Overhead );
+
+    int64_t maxUsage = MaxMemoryUsage.LoadRelaxed();
+    while ( usage > maxUsage && !MaxMemoryUsage.CompareExchangeWeak( maxUsage, usage ) ) {}
 }
 
 void AZoneMemory::DecMemoryStatistics( size_t _MemoryUsage, size_t _Overhead )
 {
-    ZONE_SYNC_GUARD_STAT
-    TotalMemoryUsage -= _MemoryUsage;
-    TotalMemoryOverhead -= _Overhead;
+    TotalMemoryUsage.Sub( _MemoryUsage );
+    TotalMemoryOverhead.Sub( _Overhead );
 }
 
 SZoneChunk * AZoneMemory::FindFreeChunk( int _RequiredSize )
@@ -865,6 +1092,69 @@ SZoneChunk * AZoneMemory::FindFreeChunk( int _RequiredSize )
     return cur;
 }
 
+SZoneChunk * AZoneMemory::AllocChunk( size_t _RequiredSize )
+{
+    SZoneChunk * cur = FindFreeChunk( _RequiredSize );
+    if ( !cur ) {
+        return nullptr;
+    }
+
+    int recidualChunkSpace = cur->Size - _RequiredSize;
+    if ( recidualChunkSpace >= MinZoneFragmentLength ) { // don't allow to create very small chunks
+        SZoneChunk * newChunk = ( SZoneChunk * )( ( byte * )( cur ) + _RequiredSize );
+        AN_ASSERT( IsAlignedPtr( newChunk, 16 ) );
+        newChunk->Size = recidualChunkSpace;
+        newChunk->pPrev = cur;
+        newChunk->pNext = cur->pNext;
+        newChunk->pNext->pPrev = newChunk;
+        cur->pNext = newChunk;
+        cur->Size = _RequiredSize;
+    }
+
+    AN_ASSERT( IsAlignedPtr( cur, 16 ) );
+    AN_ASSERT( IsAlignedPtr( cur + 1, 16 ) );
+
+    cur->Size = -cur->Size; // Set size to negative to mark chunk used
+    MemoryBuffer->Rover = cur->pNext;
+
+    return cur;
+}
+
+void AZoneMemory::FreeChunk( SZoneChunk * _Chunk )
+{
+    SZoneChunk * chunk = _Chunk;
+
+    chunk->Size = -chunk->Size;
+
+    SZoneChunk * prevChunk = chunk->pPrev;
+    SZoneChunk * nextChunk = chunk->pNext;
+
+    if ( prevChunk->Size > 0 ) {
+        // Merge prev and current chunks to one free chunk
+
+        prevChunk->Size += chunk->Size;
+        prevChunk->pNext = chunk->pNext;
+        prevChunk->pNext->pPrev = prevChunk;
+
+        if ( chunk == MemoryBuffer->Rover ) {
+            MemoryBuffer->Rover = prevChunk;
+        }
+        chunk = prevChunk;
+    }
+
+    if ( nextChunk->Size > 0 ) {
+        // Merge current and next chunks to one free chunk
+
+        chunk->Size += nextChunk->Size;
+        chunk->pNext = nextChunk->pNext;
+        chunk->pNext->pPrev = chunk;
+
+        if ( nextChunk == MemoryBuffer->Rover ) {
+            MemoryBuffer->Rover = chunk;
+        }
+    }
+}
+
 void * AZoneMemory::Alloc( size_t _BytesCount )
 {
 #if 0
@@ -879,326 +1169,386 @@ void * AZoneMemory::Alloc( size_t _BytesCount )
         CriticalError( "AZoneMemory::Alloc: Invalid bytes count\n" );
     }
 
-    ZONE_SYNC_GUARD
-
-    size_t requiredSize = AdjustChunkSize( _BytesCount );
+    void * bytes;
 
-    SZoneChunk * cur = FindFreeChunk( requiredSize );
-    if ( !cur ) {
-        // no free chunks
-        CriticalError( "AZoneMemory::Alloc: Failed on allocation of %u bytes\n", _BytesCount );
+    size_t smallBlockSize = AdjustSmallBlockSize( _BytesCount );
+    if ( smallBlockSize <= MaxSmallBlockSize ) {
+        bytes = AllocSmall( _BytesCount, ZoneSizeClassLookup[smallBlockSize >> 4] );
+    } else {
+        bytes = AllocLarge( _BytesCount );
     }
 
-    int recidualChunkSpace = cur->Size - requiredSize;
-    if ( recidualChunkSpace >= MinZoneFragmentLength ) { // don't allow to create very small chunks
-        SZoneChunk * newChunk = ( SZoneChunk * )( ( byte * )( cur ) + requiredSize );
-        AN_ASSERT( IsAlignedPtr( newChunk, 16 ) );
-        newChunk->Size = recidualChunkSpace;
-        newChunk->pPrev = cur;
-        newChunk->pNext = cur->pNext;
-        newChunk->pNext->pPrev = newChunk;
-        cur->pNext = newChunk;
-        cur->Size = requiredSize;
+    GMemoryTracker.TrackAlloc( MEMORY_TRACKER_ZONE, bytes, _BytesCount );
+
+    return bytes;
+#endif
+}
+
+void * AZoneMemory::AllocSmall( size_t _BytesCount, int _SizeClass )
+{
+    SZoneThreadCache & cache = GetZoneThreadCache( Generation.Load() );
+
+    if ( !cache.FreeList[_SizeClass] ) {
+        RefillThreadCache( cache, _SizeClass );
     }
 
-    byte * pointer = ( byte * )( cur + 1 );
+    SZoneSmallBlock * block = cache.FreeList[_SizeClass];
+    cache.FreeList[_SizeClass] = block->pNext;
+    cache.NumFree[_SizeClass]--;
 
-    AN_ASSERT( IsAlignedPtr( cur, 16 ) );
-    AN_ASSERT( IsAlignedPtr( pointer, 16 ) );
+    AN_ASSERT( block->BlockType == ZONE_BLOCK_FREE );
 
-    IncMemoryStatistics( cur->Size, cur->Size - _BytesCount );
+    block->SizeClass = _SizeClass;
+    block->DataSize = _BytesCount;
+    block->BlockType = ZONE_BLOCK_SMALL;
 
-    cur->Size = -cur->Size; // Set size to negative to mark chunk used
-    cur->DataSize = _BytesCount;
-    MemoryBuffer->Rover = cur->pNext;
+    SetTrashMarker( block );
 
-#if defined ZONE_MEMORY_LEAK_ADDRESS && defined AN_DEBUG
-    size_t localAddr = (size_t)( cur + 1 ) - (size_t)GetZoneMemoryAddress();
-    size_t size =  (-cur->Size);
-    if ( localAddr == ZONE_MEMORY_LEAK_ADDRESS && size == ZONE_MEMORY_LEAK_SIZE ) {
-        GLogger.Printf("Problem alloc\n");
-#ifdef AN_OS_WIN32
-        DebugBreak();
-#else
-        //__asm__( "int $3" );
-        raise( SIGTRAP );
-#endif
-    }
-#endif
+    byte * pointer = ( byte * )( block + 1 );
 
-    SetTrashMarker( cur );
+    AN_ASSERT( IsAlignedPtr( pointer, 16 ) );
 
     return pointer;
-#endif
 }
-//#pragma warning(disable:4702)
-void * AZoneMemory::Realloc( void * _Data, int _NewBytesCount, bool _KeepOld )
+
+SZoneSpan * AZoneMemory::AllocSpan( int _SizeClass )
 {
-#if 1
+    SZoneBin & bin = Bins[_SizeClass];
+    const int blockSize = ZoneSizeClasses[_SizeClass];
 
-#if 0
-    if ( _Data ) {
-        void * d = SysAlloc( _NewBytesCount, 16 );
-        Core::MemcpySSE(d,_Data,_NewBytesCount);
-        SysFree(_Data);
-        return d;
+    SZoneChunk * chunk;
+    {
+        ASpinLockGuard chunkLockGuard( ChunkLock );
+        chunk = AllocChunk( AdjustChunkSize( sizeof( SZoneSpan ) + ZoneSpanSize ) );
     }
-    return nullptr;
-#else
-    if ( !_Data ) {
-        return Alloc( _NewBytesCount );
+    if ( !chunk ) {
+        CriticalError( "AZoneMemory::Alloc: Failed on allocation of %d bytes span\n", ZoneSpanSize );
     }
+    chunk->DataSize = sizeof( SZoneSpan ) + ZoneSpanSize;
+    chunk->BlockType = ZONE_BLOCK_SPAN;
+    SetTrashMarker( chunk );
 
-    SZoneChunk * chunk = ( SZoneChunk * )( _Data ) - 1;
+    SZoneSpan * span = ( SZoneSpan * )( chunk + 1 );
+    span->FreeList = nullptr;
+    span->NumBlocks = ZoneSpanSize / blockSize;
+    span->NumFree = span->NumBlocks;
 
-    if ( chunk->DataSize >= _NewBytesCount ) {
-        // data is big enough
-        //MemLogger.Printf( "_BytesCount >= _NewBytesCount\n" );
-        return _Data;
+    byte * blocks = ( byte * )( span + 1 );
+    for ( int i = span->NumBlocks - 1 ; i >= 0 ; i-- ) {
+        SZoneSmallBlock * block = ( SZoneSmallBlock * )( blocks + i * blockSize );
+        block->pNext = span->FreeList;
+        block->SpanOffset = ( byte * )block - ( byte * )span;
+        block->BlockType = ZONE_BLOCK_FREE;
+        span->FreeList = block;
     }
 
-    // Check freed
-    bool bFreed = chunk->Size > 0;
-
-    if ( bFreed ) {
-        //MemLogger.Printf( "freed pointer\n" );
-        return Alloc( _NewBytesCount );
+    span->pPrev = nullptr;
+    span->pNext = bin.Spans;
+    if ( bin.Spans ) {
+        bin.Spans->pPrev = span;
     }
+    bin.Spans = span;
 
-    if ( !_KeepOld ) {
-        Free( _Data );
-        return Alloc( _NewBytesCount );
-    }
+    bin.NumFree += span->NumBlocks;
+    bin.NumTotal += span->NumBlocks;
 
-    int sz = chunk->DataSize;
-    void * temp = GHunkMemory.Alloc( sz );
-    Core::MemcpySSE( temp, _Data, sz );
-    Free( _Data );
-    void * pNewData = Alloc( _NewBytesCount );
-    if ( pNewData != _Data ) {
-        Core::MemcpySSE( pNewData, temp, sz );
+    return span;
+}
+
+void AZoneMemory::FreeSpan( SZoneSpan * _Span, int _SizeClass )
+{
+    SZoneBin & bin = Bins[_SizeClass];
+
+    AN_ASSERT( _Span->NumFree == _Span->NumBlocks );
+
+    if ( _Span->pPrev ) {
+        _Span->pPrev->pNext = _Span->pNext;
     } else {
-        //MemLogger.Printf( "Caching memcpy\n" );
+        bin.Spans = _Span->pNext;
+    }
+    if ( _Span->pNext ) {
+        _Span->pNext->pPrev = _Span->pPrev;
     }
-    GHunkMemory.ClearLastHunk();
 
-    return pNewData;
-#endif
+    bin.NumFree -= _Span->NumBlocks;
+    bin.NumTotal -= _Span->NumBlocks;
 
-#else
+    SZoneChunk * chunk = ( SZoneChunk * )_Span - 1;
 
-#if 0
-    return SysRealloc( _Data, _NewBytesCount, 16 );
-#else
-    if ( !_Data ) {
-        return Alloc( _NewBytesCount );
+    if ( ChunkTrashTest( chunk ) ) {
+        CriticalError( "AZoneMemory::Free: Warning: memory was trashed\n" );
     }
 
-    SZoneChunk * chunk = ( SZoneChunk * )( _Data ) - 1;
+    ASpinLockGuard chunkLockGuard( ChunkLock );
+    FreeChunk( chunk );
+}
 
-    if ( chunk->DataSize >= _NewBytesCount ) {
-        // data is big enough
-        //MemLogger.Printf( "_BytesCount >= _NewBytesCount\n" );
-        return _Data;
-    }
+void AZoneMemory::RefillThreadCache( SZoneThreadCache & _Cache, int _SizeClass )
+{
+    SZoneBin & bin = Bins[_SizeClass];
+    const int blockSize = ZoneSizeClasses[_SizeClass];
 
-    // Check freed
-    bool bFreed = chunk->Size > 0;
+    ASpinLockGuard lockGuard( bin.Lock );
 
-    if ( bFreed ) {
-        //MemLogger.Printf( "freed pointer\n" );
-        return Alloc( _NewBytesCount );
+    if ( !bin.Spans ) {
+        AllocSpan( _SizeClass );
     }
 
-    ZONE_SYNC_GUARD
+    int count = 0;
+    while ( count < ZoneCacheBatchSize && bin.Spans ) {
+        SZoneSpan * span = bin.Spans;
 
-    size_t oldSize = chunk->DataSize;
+        while ( count < ZoneCacheBatchSize && span->FreeList ) {
+            SZoneSmallBlock * block = span->FreeList;
+            span->FreeList = block->pNext;
+            span->NumFree--;
 
-    if ( ChunkTrashTest( chunk ) ) {
-        CriticalError( "AZoneMemory::Realloc: Warning: memory was trashed\n" );
-        // error()
-    }
+            block->pNext = _Cache.FreeList[_SizeClass];
+            _Cache.FreeList[_SizeClass] = block;
+            count++;
+        }
 
-    int requiredSize = AdjustChunkSize( _NewBytesCount );
-    if ( requiredSize <= -chunk->Size ) {
-        // data is big enough
-        //MemLogger.Printf( "data is big enough\n" );
-        return _Data;
+        if ( !span->FreeList ) {
+            // Span is fully used, remove it from the bin
+            bin.Spans = span->pNext;
+            if ( bin.Spans ) {
+                bin.Spans->pPrev = nullptr;
+            }
+        }
     }
+    bin.NumFree -= count;
 
-    // restore positive chunk size
-    chunk->Size = -chunk->Size;
+    _Cache.NumFree[_SizeClass] += count;
 
-    AN_ASSERT( chunk->Size > 0 );
+    // Blocks in thread caches are not available for other threads, so count them as used
+    IncMemoryStatistics( count * blockSize, count * sizeof( SZoneSmallBlock ) );
+}
 
-    // try to use next chunk
-    SZoneChunk * cur = chunk->pNext;
-    if ( cur->Size > 0 && cur->Size + chunk->Size >= requiredSize ) {
+void AZoneMemory::FlushThreadCache( SZoneThreadCache & _Cache, int _SizeClass, int _NumBlocks )
+{
+    if ( _NumBlocks <= 0 ) {
+        return;
+    }
 
-#if 1
-        requiredSize -= chunk->Size;
-        int recidualChunkSpace = cur->Size - requiredSize;
-        if ( recidualChunkSpace >= MinZoneFragmentLength ) {
-#if 0
-            SZoneChunk * newChunk = ( SZoneChunk * )( ( byte * )( cur ) + requiredSize );
-            AN_ASSERT( IsAlignedPtr( newChunk, 16 ) );
-            newChunk->Size = recidualChunkSpace;
-            newChunk->pPrev = chunk;
-            newChunk->pNext = cur->pNext;
-            newChunk->pNext->pPrev = newChunk;
-            chunk->pNext = newChunk;
-            chunk->Size += requiredSize;
-            IncMemoryStatistics( requiredSize, requiredSize - _NewBytesCount );
-#else
-            chunk->Size = -chunk->Size;
-            void * d = malloc( _NewBytesCount );
-            Core::Memcpy( d, _Data, oldSize );
-            Free( _Data );
-            _Data = Alloc( _NewBytesCount );
-            Core::Memcpy( _Data, d, _NewBytesCount );
-            free( d );
-            return _Data;
-#endif
-        } else {
-#if 1
-            chunk->pNext = cur->pNext;
-            chunk->pNext->pPrev = chunk;
-            chunk->Size += cur->Size;
-            IncMemoryStatistics( cur->Size, cur->Size - _NewBytesCount );
+    SZoneBin & bin = Bins[_SizeClass];
 
-            //Core::Memset( (byte *)_Data + chunk->DataSize, 0, _NewBytesCount - chunk->DataSize );
-#else
-//            chunk->Size = -chunk->Size;
-//            void * d = malloc( oldSize );
-//            Core::Memcpy( d, _Data, oldSize );
-//            Free( _Data );
-//            _Data = Alloc( _NewBytesCount );
-//            Core::Memcpy( _Data, d, oldSize );
-//            free( d );
-//            return _Data;
-            chunk->Size = -chunk->Size;
-            void * d = malloc( _NewBytesCount );
-            Core::Memcpy( d, _Data, oldSize );
-            Free( _Data );
-            _Data = Alloc( _NewBytesCount );
-            Core::Memcpy( _Data, d, oldSize );
-            free( d );
-            return _Data;
-#endif
+    SZoneSmallBlock * block = _Cache.FreeList[_SizeClass];
+    for ( int i = 0 ; i < _NumBlocks ; i++ ) {
+        block = block->pNext;
+    }
+    SZoneSmallBlock * first = _Cache.FreeList[_SizeClass];
+    _Cache.FreeList[_SizeClass] = block;
+    _Cache.NumFree[_SizeClass] -= _NumBlocks;
+
+    {
+        ASpinLockGuard lockGuard( bin.Lock );
+
+        for ( int i = 0 ; i < _NumBlocks ; i++ ) {
+            block = first;
+            first = first->pNext;
+
+            SZoneSpan * span = GetBlockSpan( block );
+
+            block->pNext = span->FreeList;
+            span->FreeList = block;
+            bin.NumFree++;
+
+            if ( span->NumFree++ == 0 ) {
+                // Span has free blocks again, return it to the bin
+                span->pPrev = nullptr;
+                span->pNext = bin.Spans;
+                if ( bin.Spans ) {
+                    bin.Spans->pPrev = span;
+                }
+                bin.Spans = span;
+            }
+
+            // Keep empty span if this is the last free memory of the bin, so the next
+            // allocation will not carve it again
+            if ( span->NumFree == span->NumBlocks && bin.NumFree > span->NumBlocks ) {
+                FreeSpan( span, _SizeClass );
+            }
         }
+    }
+
+    DecMemoryStatistics( _NumBlocks * ZoneSizeClasses[_SizeClass], _NumBlocks * sizeof( SZoneSmallBlock ) );
+}
 
-        // Set size to negative to mark chunk used
-        chunk->Size = -chunk->Size;
-        chunk->DataSize = _NewBytesCount;
-        MemoryBuffer->Rover = chunk->pNext;
+void * AZoneMemory::AllocLarge( size_t _BytesCount )
+{
+    size_t requiredSize = AdjustChunkSize( _BytesCount );
 
-        SetTrashMarker( chunk );
+    SZoneChunk * cur;
+    {
+        ASpinLockGuard lockGuard( ChunkLock );
+        cur = AllocChunk( requiredSize );
+    }
+    if ( !cur ) {
+        // no free chunks
+        CriticalError( "AZoneMemory::Alloc: Failed on allocation of %u bytes\n", _BytesCount );
+    }
 
-        //MemLogger.Printf( "using next chunk\n" );
+    IncMemoryStatistics( -cur->Size, -cur->Size - _BytesCount );
 
-        AN_ASSERT( _Data == chunk+1 );
+    cur->DataSize = _BytesCount;
+    cur->BlockType = ZONE_BLOCK_LARGE;
 
-        return _Data;
+#if defined ZONE_MEMORY_LEAK_ADDRESS && defined AN_DEBUG
+    size_t localAddr = (size_t)( cur + 1 ) - (size_t)GetZoneMemoryAddress();
+    size_t size =  (-cur->Size);
+    if ( localAddr == ZONE_MEMORY_LEAK_ADDRESS && size == ZONE_MEMORY_LEAK_SIZE ) {
+        GLogger.Printf("Problem alloc\n");
+#ifdef AN_OS_WIN32
+        DebugBreak();
 #else
-        chunk->Size = -chunk->Size;
-        void * d = malloc( _NewBytesCount );
-        Core::Memcpy( d, _Data, oldSize );
-        Free( _Data );
-        _Data = Alloc( _NewBytesCount );
-        Core::Memcpy( _Data, d, _NewBytesCount );
-        free( d );
-        return _Data;
+        //__asm__( "int $3" );
+        raise( SIGTRAP );
 #endif
+    }
+#endif
+
+    SetTrashMarker( cur );
+
+    return cur + 1;
+}
+
+void * AZoneMemory::Realloc( void * _Data, int _NewBytesCount, bool _KeepOld )
+{
+    void * pNewData = ReallocBlock( _Data, _NewBytesCount, _KeepOld );
+
+    // New blocks are tracked by Alloc, in-place reallocations only update the size
+    if ( pNewData != _Data ) {
+        GMemoryTracker.TrackFree( MEMORY_TRACKER_ZONE, _Data );
     } else {
+        GMemoryTracker.TrackRealloc( MEMORY_TRACKER_ZONE, pNewData, _NewBytesCount );
+    }
 
-        //chunk->Size = -chunk->Size;
-        //void * d = malloc( _NewBytesCount );
-        //Core::Memcpy(d,_Data, oldSize );
-        //Free(_Data);
-        //_Data=Alloc(_NewBytesCount);
-        //Core::Memcpy(_Data,d,_NewBytesCount);
-        //free(d);
-        //return _Data;
-#if 1
-        //MemLogger.Printf( "reallocating new chunk with copy\n" );
+    return pNewData;
+}
 
-        cur = FindFreeChunk( requiredSize );
-        if ( !cur ) {
+void * AZoneMemory::ReallocBlock( void * _Data, int _NewBytesCount, bool _KeepOld )
+{
+    if ( !_Data ) {
+        return Alloc( _NewBytesCount );
+    }
 
-            chunk->Size = -chunk->Size;
+    const int32_t blockType = GetZoneBlockType( _Data );
 
-            // no free chunks
+    if ( blockType == ZONE_BLOCK_FREE ) {
+        // freed pointer
+        return Alloc( _NewBytesCount );
+    }
 
-            CriticalError( "AZoneMemory::Realloc: Failed on allocation of %u bytes\n", _NewBytesCount );
+    if ( blockType == ZONE_BLOCK_SMALL ) {
+        SZoneSmallBlock * block = ( SZoneSmallBlock * )( _Data ) - 1;
+
+        if ( block->DataSize >= _NewBytesCount ) {
+            // data is big enough
+            return _Data;
         }
 
-        DecMemoryStatistics( chunk->Size, chunk->Size - chunk->DataSize );
-
-        int recidualChunkSpace = cur->Size - requiredSize;
-        if ( recidualChunkSpace >= MinZoneFragmentLength ) {
-            SZoneChunk * newChunk = ( SZoneChunk * )( ( byte * )( cur ) + requiredSize );
-            AN_ASSERT( IsAlignedPtr( newChunk, 16 ) );
-            newChunk->Size = recidualChunkSpace;
-            newChunk->pPrev = cur;
-            newChunk->pNext = cur->pNext;
-            newChunk->pNext->pPrev = newChunk;
-            cur->pNext = newChunk;
-            cur->Size = requiredSize;
+        if ( BlockTrashTest( block ) ) {
+            CriticalError( "AZoneMemory::Realloc: Warning: memory was trashed\n" );
         }
 
-        byte * pointer = ( byte * )( cur + 1 );
+        // Grow in place if the block size class is big enough
+        if ( AdjustSmallBlockSize( _NewBytesCount ) <= (size_t)ZoneSizeClasses[block->SizeClass] ) {
+            block->DataSize = _NewBytesCount;
+            return _Data;
+        }
+
+        void * pNewData = Alloc( _NewBytesCount );
+        if ( _KeepOld ) {
+            Core::Memcpy( pNewData, _Data, block->DataSize );
+        }
+        FreeSmall( _Data );
+        return pNewData;
+    }
+
+    return ReallocLarge( _Data, _NewBytesCount, _KeepOld );
+}
+
+void * AZoneMemory::ReallocLarge( void * _Data, size_t _NewBytesCount, bool _KeepOld )
+{
+    SZoneChunk * chunk = ( SZoneChunk * )( _Data ) - 1;
 
-        AN_ASSERT( IsAlignedPtr( cur, 16 ) );
-        AN_ASSERT( IsAlignedPtr( pointer, 16 ) );
+    if ( chunk->Size > 0 ) {
+        // freed pointer
+        return Alloc( _NewBytesCount );
+    }
 
-        IncMemoryStatistics( cur->Size, cur->Size - _NewBytesCount );
+    const size_t oldDataSize = chunk->DataSize;
 
-        cur->Size = -cur->Size; // Set size to negative to mark chunk used
-        cur->DataSize = _NewBytesCount;
-        MemoryBuffer->Rover = cur->pNext;
+    if ( oldDataSize >= _NewBytesCount ) {
+        // data is big enough
+        return _Data;
+    }
 
-        SetTrashMarker( cur );
+    if ( ChunkTrashTest( chunk ) ) {
+        CriticalError( "AZoneMemory::Realloc: Warning: memory was trashed\n" );
+    }
 
-        if ( _KeepOld ) {
-            Core::MemcpySSE( pointer, _Data, oldSize );
-        }
+    const int requiredSize = AdjustChunkSize( _NewBytesCount );
 
-        // Deallocate old chunk
+    {
+        ASpinLockGuard lockGuard( ChunkLock );
 
-        SZoneChunk * prevChunk = chunk->pPrev;
-        SZoneChunk * nextChunk = chunk->pNext;
+        const int oldSize = -chunk->Size;
 
-        if ( prevChunk->Size > 0 ) {
-            // Merge prev and current chunks to one free chunk
+        if ( requiredSize <= oldSize ) {
+            // chunk is big enough
+            chunk->DataSize = _NewBytesCount;
+            DecMemoryStatistics( 0, _NewBytesCount - oldDataSize );
+            return _Data;
+        }
 
-            prevChunk->Size += chunk->Size;
-            prevChunk->pNext = chunk->pNext;
-            prevChunk->pNext->pPrev = prevChunk;
+        // Try to grow in place using next free chunk
+        SZoneChunk * next = chunk->pNext;
+        if ( next->Size > 0 && next->Size + oldSize >= requiredSize ) {
+            int recidualChunkSpace = next->Size + oldSize - requiredSize;
+            bool bRover = next == MemoryBuffer->Rover;
+
+            if ( recidualChunkSpace >= MinZoneFragmentLength ) {
+                // Take a part of the next chunk
+                SZoneChunk * newChunk = ( SZoneChunk * )( ( byte * )( chunk ) + requiredSize );
+                SZoneChunk * nextNext = next->pNext;
+                AN_ASSERT( IsAlignedPtr( newChunk, 16 ) );
+                newChunk->Size = recidualChunkSpace;
+                newChunk->pPrev = chunk;
+                newChunk->pNext = nextNext;
+                nextNext->pPrev = newChunk;
+                chunk->pNext = newChunk;
+                chunk->Size = -requiredSize;
+            } else {
+                // Take whole next chunk
+                chunk->pNext = next->pNext;
+                chunk->pNext->pPrev = chunk;
+                chunk->Size = -( oldSize + next->Size );
+            }
 
-            if ( chunk == MemoryBuffer->Rover ) {
-                MemoryBuffer->Rover = prevChunk;
+            if ( bRover ) {
+                MemoryBuffer->Rover = chunk->pNext;
             }
-            chunk = prevChunk;
-        }
 
-        if ( nextChunk->Size > 0 ) {
-            // Merge current and next chunks to one free chunk
+            chunk->DataSize = _NewBytesCount;
 
-            chunk->Size += nextChunk->Size;
-            chunk->pNext = nextChunk->pNext;
-            chunk->pNext->pPrev = chunk;
+            DecMemoryStatistics( oldSize, oldSize - oldDataSize );
+            IncMemoryStatistics( -chunk->Size, -chunk->Size - _NewBytesCount );
 
-            if ( nextChunk == MemoryBuffer->Rover ) {
-                MemoryBuffer->Rover = chunk;
-            }
+            SetTrashMarker( chunk );
+
+            return _Data;
         }
+    }
 
-        return pointer;
-#endif
+    // Move to new chunk. Old data is still valid while copying, so no temp buffer is needed.
+    void * pNewData = Alloc( _NewBytesCount );
+    if ( _KeepOld ) {
+        Core::MemcpySSE( pNewData, _Data, oldDataSize );
     }
-#endif
+    FreeLarge( _Data );
 
-#endif
+    return pNewData;
 }
 
 void AZoneMemory::Free( void * _Bytes )
@@ -1214,10 +1564,48 @@ void AZoneMemory::Free( void * _Bytes )
         return;
     }
 
-    ZONE_SYNC_GUARD
+    GMemoryTracker.TrackFree( MEMORY_TRACKER_ZONE, _Bytes );
 
+    const int32_t blockType = GetZoneBlockType( _Bytes );
+
+    if ( blockType == ZONE_BLOCK_SMALL ) {
+        FreeSmall( _Bytes );
+    } else if ( blockType == ZONE_BLOCK_LARGE ) {
+        FreeLarge( _Bytes );
+    }
+    // else: freed pointer
+#endif
+}
+
+void AZoneMemory::FreeSmall( void * _Bytes )
+{
+    SZoneSmallBlock * block = ( SZoneSmallBlock * )( _Bytes ) - 1;
+
+    if ( BlockTrashTest( block ) ) {
+        CriticalError( "AZoneMemory::Free: Warning: memory was trashed\n" );
+    }
+
+    const int sizeClass = block->SizeClass;
+
+    // Block can be allocated by other thread, it just goes to the cache of current thread
+    SZoneThreadCache & cache = GetZoneThreadCache( Generation.Load() );
+
+    block->BlockType = ZONE_BLOCK_FREE;
+    block->pNext = cache.FreeList[sizeClass];
+    cache.FreeList[sizeClass] = block;
+    cache.NumFree[sizeClass]++;
+
+    if ( cache.NumFree[sizeClass] > ZoneCacheMaxBlocks ) {
+        FlushThreadCache( cache, sizeClass, ZoneCacheBatchSize );
+    }
+}
+
+void AZoneMemory::FreeLarge( void * _Bytes )
+{
     SZoneChunk * chunk = ( SZoneChunk * )( _Bytes ) - 1;
 
+    ASpinLockGuard lockGuard( ChunkLock );
+
     if ( chunk->Size > 0 ) {
         // freed pointer
         return;
@@ -1228,58 +1616,63 @@ void AZoneMemory::Free( void * _Bytes )
         // error()
     }
 
-    chunk->Size = -chunk->Size;
-
-    DecMemoryStatistics( chunk->Size, chunk->Size - chunk->DataSize );
+    DecMemoryStatistics( -chunk->Size, -chunk->Size - chunk->DataSize );
 
-    SZoneChunk * prevChunk = chunk->pPrev;
-    SZoneChunk * nextChunk = chunk->pNext;
-
-    if ( prevChunk->Size > 0 ) {
-        // Merge prev and current chunks to one free chunk
-
-        prevChunk->Size += chunk->Size;
-        prevChunk->pNext = chunk->pNext;
-        prevChunk->pNext->pPrev = prevChunk;
+    FreeChunk( chunk );
+}
 
-        if ( chunk == MemoryBuffer->Rover ) {
-            MemoryBuffer->Rover = prevChunk;
-        }
-        chunk = prevChunk;
+void AZoneMemory::TrimThreadCache()
+{
+    if ( !MemoryBuffer ) {
+        return;
     }
 
-    if ( nextChunk->Size > 0 ) {
-        // Merge current and next chunks to one free chunk
-
-        chunk->Size += nextChunk->Size;
-        chunk->pNext = nextChunk->pNext;
-        chunk->pNext->pPrev = chunk;
-
-        if ( nextChunk == MemoryBuffer->Rover ) {
-            MemoryBuffer->Rover = chunk;
-        }
+    SZoneThreadCache & cache = GetZoneThreadCache( Generation.Load() );
+    for ( int i = 0 ; i < NUM_SIZE_CLASSES ; i++ ) {
+        FlushThreadCache( cache, i, cache.NumFree[i] );
     }
-#endif
 }
 
 void AZoneMemory::CheckMemoryLeaks()
 {
-    ZONE_SYNC_GUARD
+    // Return blocks cached by current thread
+    TrimThreadCache();
 
-    size_t totalMemoryUsage;
+    // Blocks cached by other threads are free too. Other threads may still use their caches,
+    // so the blocks are counted, not moved.
+    int numCached[NUM_SIZE_CLASSES] = {};
     {
-        ZONE_SYNC_GUARD_STAT
-        totalMemoryUsage = TotalMemoryUsage;
+        const int generation = Generation.Load();
+
+        ASpinLockGuard lockGuard( ZoneThreadCacheLock );
+        for ( SZoneThreadCache * threadCache = ZoneThreadCacheList ; threadCache ; threadCache = threadCache->pNext ) {
+            if ( threadCache->Generation == generation ) {
+                for ( int i = 0 ; i < NUM_SIZE_CLASSES ; i++ ) {
+                    numCached[i] += threadCache->NumFree[i];
+                }
+            }
+        }
+    }
+
+    for ( int i = 0 ; i < NUM_SIZE_CLASSES ; i++ ) {
+        ASpinLockGuard lockGuard( Bins[i].Lock );
+        int numUsed = Bins[i].NumTotal - Bins[i].NumFree - numCached[i];
+        if ( numUsed > 0 ) {
+            MemLogger.Print( "==== Zone Memory Leak ====\n" );
+            MemLogger.Printf( "%d small blocks of size %d\n", numUsed, ZoneSizeClasses[i] );
+        }
     }
 
-    if ( totalMemoryUsage > 0 ) {
+    ASpinLockGuard lockGuard( ChunkLock );
+
+    if ( TotalMemoryUsage.Load() > 0 ) {
         SZoneChunk * rover = MemoryBuffer->Rover;
         SZoneChunk * start = rover->pPrev;
         SZoneChunk * cur;
 
         do {
             cur = rover;
-            if ( cur->Size < 0 ) {
+            if ( cur->Size < 0 && cur->BlockType == ZONE_BLOCK_LARGE ) {
                 MemLogger.Print( "==== Zone Memory Leak ====\n" );
                 MemLogger.Printf( "Chunk Address: %u (Local: %u) Size: %d\n", (size_t)( cur + 1 ), (size_t)( cur + 1 ) - (size_t)GetZoneMemoryAddress(), (-cur->Size) );
 
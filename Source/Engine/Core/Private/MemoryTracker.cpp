@@ -0,0 +1,496 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <Core/Public/MemoryTracker.h>
+#include <Core/Public/Memory.h>
+#include <Core/Public/Logger.h>
+#include <Core/Public/Core.h>
+#include <Core/Public/BaseMath.h>
+
+#include <stdio.h>
+
+AMemoryTracker GMemoryTracker;
+
+static thread_local const char * ThreadTag = nullptr;
+
+static const char * AllocatorName[MEMORY_TRACKER_ALLOCATOR_COUNT] = { "Heap", "Hunk", "Zone", "Frame" };
+
+static constexpr int INITIAL_TABLE_SIZE = 4096;
+
+static const void * TOMBSTONE = reinterpret_cast< const void * >( ~uintptr_t( 0 ) );
+
+AN_FORCEINLINE uint32_t HashPointer( const void * _Bytes )
+{
+    uint64_t key = reinterpret_cast< uintptr_t >( _Bytes );
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return ( uint32_t )key;
+}
+
+AN_FORCEINLINE int SizeBucket( size_t _SizeInBytes )
+{
+    int bucket = 0;
+    while ( _SizeInBytes > 1 && bucket < AMemoryTracker::NUM_SIZE_BUCKETS - 1 ) {
+        _SizeInBytes >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+AN_FORCEINLINE int LifetimeBucket( int _Frames )
+{
+    // 0 frames, 1 frame, 2-3, 4-7, ...
+    int bucket = 0;
+    while ( _Frames > 0 && bucket < AMemoryTracker::NUM_LIFETIME_BUCKETS - 1 ) {
+        _Frames >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void AMemoryTracker::Initialize()
+{
+    bEnabled = Core::HasArg( "-bMemoryTracking" );
+    if ( !bEnabled ) {
+        return;
+    }
+
+    TableSize = INITIAL_TABLE_SIZE;
+    Records = ( SAllocationRecord * )Core::SysAlloc( sizeof( SAllocationRecord ) * TableSize );
+    Core::ZeroMem( Records, sizeof( SAllocationRecord ) * TableSize );
+    NumRecords = 0;
+    NumTombstones = 0;
+
+    Core::ZeroMem( Tags, sizeof( Tags ) );
+    Core::ZeroMem( TotalUsage, sizeof( TotalUsage ) );
+    Core::ZeroMem( PeakTotalUsage, sizeof( PeakTotalUsage ) );
+    Tags[0].Name = "Untagged";
+    NumTags = 1;
+
+    NumHunkMarks = 0;
+    NumHunkMismatches = 0;
+    Frame = 0;
+}
+
+void AMemoryTracker::Deinitialize()
+{
+    if ( !bEnabled ) {
+        return;
+    }
+
+    bEnabled = false;
+
+    Core::SysFree( Records );
+    Records = nullptr;
+    TableSize = 0;
+    NumRecords = 0;
+    NumTombstones = 0;
+}
+
+const char * AMemoryTracker::SetThreadTag( const char * _Tag )
+{
+    const char * prev = ThreadTag;
+    ThreadTag = _Tag;
+    return prev;
+}
+
+const char * AMemoryTracker::GetThreadTag()
+{
+    return ThreadTag;
+}
+
+int AMemoryTracker::FindTag( const char * _Tag )
+{
+    if ( !_Tag ) {
+        return 0;
+    }
+
+    // Tags are expected to be string literals, so compare pointers first
+    for ( int i = 1 ; i < NumTags ; i++ ) {
+        if ( Tags[i].Name == _Tag ) {
+            return i;
+        }
+    }
+    for ( int i = 1 ; i < NumTags ; i++ ) {
+        if ( !Core::Strcmp( Tags[i].Name, _Tag ) ) {
+            return i;
+        }
+    }
+
+    if ( NumTags == MAX_TAGS ) {
+        return 0;
+    }
+
+    Tags[NumTags].Name = _Tag;
+    return NumTags++;
+}
+
+AMemoryTracker::SAllocationRecord * AMemoryTracker::FindRecord( const void * _Bytes )
+{
+    const int mask = TableSize - 1;
+    for ( int i = HashPointer( _Bytes ) & mask ; ; i = ( i + 1 ) & mask ) {
+        SAllocationRecord * record = &Records[i];
+        if ( record->Address == _Bytes ) {
+            return record;
+        }
+        if ( !record->Address ) {
+            return nullptr;
+        }
+    }
+}
+
+void AMemoryTracker::InsertRecord( SAllocationRecord const & _Record )
+{
+    if ( ( NumRecords + NumTombstones + 1 ) * 4 > TableSize * 3 ) {
+        GrowTable();
+    }
+
+    const int mask = TableSize - 1;
+    for ( int i = HashPointer( _Record.Address ) & mask ; ; i = ( i + 1 ) & mask ) {
+        SAllocationRecord * record = &Records[i];
+        if ( !record->Address || record->Address == TOMBSTONE ) {
+            if ( record->Address == TOMBSTONE ) {
+                NumTombstones--;
+            }
+            *record = _Record;
+            NumRecords++;
+            return;
+        }
+    }
+}
+
+void AMemoryTracker::RemoveRecord( SAllocationRecord * _Record )
+{
+    _Record->Address = TOMBSTONE;
+    NumRecords--;
+    NumTombstones++;
+}
+
+void AMemoryTracker::GrowTable()
+{
+    SAllocationRecord * oldRecords = Records;
+    int oldSize = TableSize;
+
+    // Don't grow if the table is mostly filled with tombstones
+    if ( NumRecords * 2 >= TableSize ) {
+        TableSize <<= 1;
+    }
+
+    Records = ( SAllocationRecord * )Core::SysAlloc( sizeof( SAllocationRecord ) * TableSize );
+    Core::ZeroMem( Records, sizeof( SAllocationRecord ) * TableSize );
+    NumRecords = 0;
+    NumTombstones = 0;
+
+    for ( int i = 0 ; i < oldSize ; i++ ) {
+        if ( oldRecords[i].Address && oldRecords[i].Address != TOMBSTONE ) {
+            InsertRecord( oldRecords[i] );
+        }
+    }
+
+    Core::SysFree( oldRecords );
+}
+
+void AMemoryTracker::AddUsage( int _Tag, int _Allocator, int64_t _Size )
+{
+    STagStatistics & tag = Tags[_Tag];
+
+    tag.CurrentUsage[_Allocator] += _Size;
+    tag.PeakUsage[_Allocator] = Math::Max( tag.PeakUsage[_Allocator], tag.CurrentUsage[_Allocator] );
+
+    TotalUsage[_Allocator] += _Size;
+    PeakTotalUsage[_Allocator] = Math::Max( PeakTotalUsage[_Allocator], TotalUsage[_Allocator] );
+}
+
+void AMemoryTracker::TrackAlloc( EMemoryTrackerAllocator _Allocator, const void * _Bytes, size_t _SizeInBytes )
+{
+    if ( !bEnabled || !_Bytes ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    int tag = FindTag( ThreadTag );
+
+    SAllocationRecord * record = FindRecord( _Bytes );
+    if ( record ) {
+        // Memory was reused without free (e.g. hunk memory after ClearToMark)
+        AddUsage( record->Tag, record->Allocator, -( int64_t )record->Size );
+        Tags[record->Tag].NumLiveAllocations[record->Allocator]--;
+        RemoveRecord( record );
+    }
+
+    SAllocationRecord newRecord;
+    newRecord.Address = _Bytes;
+    newRecord.Size = _SizeInBytes;
+    newRecord.Allocator = _Allocator;
+    newRecord.Tag = tag;
+    newRecord.Frame = Frame;
+    newRecord.Pad = 0;
+    InsertRecord( newRecord );
+
+    STagStatistics & stat = Tags[tag];
+    stat.NumAllocations[_Allocator]++;
+    stat.NumLiveAllocations[_Allocator]++;
+    stat.SizeHistogram[SizeBucket( _SizeInBytes )]++;
+    AddUsage( tag, _Allocator, _SizeInBytes );
+}
+
+void AMemoryTracker::TrackRealloc( EMemoryTrackerAllocator _Allocator, const void * _Bytes, size_t _SizeInBytes )
+{
+    if ( !bEnabled || !_Bytes ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    SAllocationRecord * record = FindRecord( _Bytes );
+    if ( !record ) {
+        return;
+    }
+
+    AN_ASSERT( record->Allocator == _Allocator );
+
+    AddUsage( record->Tag, record->Allocator, ( int64_t )_SizeInBytes - ( int64_t )record->Size );
+    record->Size = _SizeInBytes;
+}
+
+void AMemoryTracker::TrackFree( EMemoryTrackerAllocator _Allocator, const void * _Bytes )
+{
+    if ( !bEnabled || !_Bytes ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    SAllocationRecord * record = FindRecord( _Bytes );
+    if ( !record ) {
+        return;
+    }
+
+    AN_ASSERT( record->Allocator == _Allocator );
+
+    STagStatistics & stat = Tags[record->Tag];
+    stat.NumLiveAllocations[record->Allocator]--;
+    stat.LifetimeHistogram[LifetimeBucket( Frame - record->Frame )]++;
+    AddUsage( record->Tag, record->Allocator, -( int64_t )record->Size );
+
+    RemoveRecord( record );
+}
+
+void AMemoryTracker::TrackClear( EMemoryTrackerAllocator _Allocator )
+{
+    if ( !bEnabled ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    for ( int i = 0 ; i < TableSize ; i++ ) {
+        SAllocationRecord * record = &Records[i];
+        if ( record->Address && record->Address != TOMBSTONE && record->Allocator == _Allocator ) {
+            STagStatistics & stat = Tags[record->Tag];
+            stat.NumLiveAllocations[_Allocator]--;
+            stat.LifetimeHistogram[LifetimeBucket( Frame - record->Frame )]++;
+            AddUsage( record->Tag, _Allocator, -( int64_t )record->Size );
+            RemoveRecord( record );
+        }
+    }
+
+    if ( _Allocator == MEMORY_TRACKER_HUNK ) {
+        NumHunkMarks = 0;
+    }
+}
+
+void AMemoryTracker::TrackFrameAlloc( size_t _SizeInBytes )
+{
+    if ( !bEnabled ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    int tag = FindTag( ThreadTag );
+
+    STagStatistics & stat = Tags[tag];
+    stat.NumAllocations[MEMORY_TRACKER_FRAME]++;
+    stat.NumFrameAllocations++;
+    stat.SizeHistogram[SizeBucket( _SizeInBytes )]++;
+    AddUsage( tag, MEMORY_TRACKER_FRAME, _SizeInBytes );
+}
+
+void AMemoryTracker::TrackHunkMark( int _Mark )
+{
+    if ( !bEnabled ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    if ( NumHunkMarks == MAX_HUNK_MARKS ) {
+        return;
+    }
+
+    SHunkMark & mark = HunkMarks[NumHunkMarks++];
+    mark.Mark = _Mark;
+    mark.Tag = FindTag( ThreadTag );
+}
+
+void AMemoryTracker::TrackHunkClearToMark( int _Mark )
+{
+    if ( !bEnabled ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    int clearTag = FindTag( ThreadTag );
+
+    // Marks must be cleared in reverse order. Newer marks that are cleared implicitly are reported as mismatches.
+    while ( NumHunkMarks > 0 && HunkMarks[NumHunkMarks - 1].Mark >= _Mark ) {
+        SHunkMark const & mark = HunkMarks[--NumHunkMarks];
+        if ( mark.Mark != _Mark && NumHunkMismatches < MAX_HUNK_MISMATCHES ) {
+            SHunkMismatch & mismatch = HunkMismatches[NumHunkMismatches++];
+            mismatch.ClearMark = _Mark;
+            mismatch.LostMark = mark.Mark;
+            mismatch.ClearTag = clearTag;
+            mismatch.LostTag = mark.Tag;
+            mismatch.Frame = Frame;
+        }
+    }
+}
+
+void AMemoryTracker::NextFrame()
+{
+    if ( !bEnabled ) {
+        return;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    // Frame memory is released at once
+    for ( int i = 0 ; i < NumTags ; i++ ) {
+        STagStatistics & stat = Tags[i];
+        stat.LifetimeHistogram[0] += stat.NumFrameAllocations;
+        stat.NumFrameAllocations = 0;
+        stat.CurrentUsage[MEMORY_TRACKER_FRAME] = 0;
+    }
+    TotalUsage[MEMORY_TRACKER_FRAME] = 0;
+
+    Frame++;
+}
+
+bool AMemoryTracker::DumpReport( const char * _FileName )
+{
+    if ( !bEnabled ) {
+        GLogger.Printf( "AMemoryTracker::DumpReport: tracking is disabled (use -bMemoryTracking)\n" );
+        return false;
+    }
+
+    // Use stdio to keep the report itself out of tracked allocators
+    FILE * f = fopen( _FileName, "w" );
+    if ( !f ) {
+        GLogger.Printf( "AMemoryTracker::DumpReport: couldn't open %s\n", _FileName );
+        return false;
+    }
+
+    ASpinLockGuard guard( Lock );
+
+    fprintf( f, "Memory report (frame %d)\n\n", Frame );
+
+    fprintf( f, "Totals:\n" );
+    for ( int a = 0 ; a < MEMORY_TRACKER_ALLOCATOR_COUNT ; a++ ) {
+        fprintf( f, "  %-6s current %12lld peak %12lld\n", AllocatorName[a], ( long long )TotalUsage[a], ( long long )PeakTotalUsage[a] );
+    }
+
+    fprintf( f, "\nTags:\n" );
+    for ( int i = 0 ; i < NumTags ; i++ ) {
+        STagStatistics const & stat = Tags[i];
+
+        fprintf( f, "\n[%s]\n", stat.Name );
+        for ( int a = 0 ; a < MEMORY_TRACKER_ALLOCATOR_COUNT ; a++ ) {
+            if ( !stat.NumAllocations[a] ) {
+                continue;
+            }
+            fprintf( f, "  %-6s current %12lld peak %12lld allocations %10lld live %8lld\n",
+                     AllocatorName[a],
+                     ( long long )stat.CurrentUsage[a],
+                     ( long long )stat.PeakUsage[a],
+                     ( long long )stat.NumAllocations[a],
+                     ( long long )stat.NumLiveAllocations[a] );
+        }
+
+        fprintf( f, "  Size histogram:\n" );
+        for ( int b = 0 ; b < NUM_SIZE_BUCKETS ; b++ ) {
+            if ( stat.SizeHistogram[b] ) {
+                fprintf( f, "    %12llu..%-12llu %lld\n", 1ull << b, ( 2ull << b ) - 1, ( long long )stat.SizeHistogram[b] );
+            }
+        }
+
+        fprintf( f, "  Lifetime histogram (frames):\n" );
+        for ( int b = 0 ; b < NUM_LIFETIME_BUCKETS ; b++ ) {
+            if ( stat.LifetimeHistogram[b] ) {
+                if ( b == 0 ) {
+                    fprintf( f, "    %12d %lld\n", 0, ( long long )stat.LifetimeHistogram[b] );
+                } else {
+                    fprintf( f, "    %12d..%-12d %lld\n", 1 << ( b - 1 ), ( 1 << b ) - 1, ( long long )stat.LifetimeHistogram[b] );
+                }
+            }
+        }
+    }
+
+    fprintf( f, "\nHunk mark mismatches: %d\n", NumHunkMismatches );
+    for ( int i = 0 ; i < NumHunkMismatches ; i++ ) {
+        SHunkMismatch const & mismatch = HunkMismatches[i];
+        fprintf( f, "  frame %d: ClearToMark( %d ) [%s] also cleared mark %d [%s]\n",
+                 mismatch.Frame,
+                 mismatch.ClearMark, Tags[mismatch.ClearTag].Name,
+                 mismatch.LostMark, Tags[mismatch.LostTag].Name );
+    }
+
+    fprintf( f, "\nLive allocations: %d\n", NumRecords );
+    for ( int i = 0 ; i < TableSize ; i++ ) {
+        SAllocationRecord const & record = Records[i];
+        if ( record.Address && record.Address != TOMBSTONE ) {
+            fprintf( f, "  %-6s %p %12llu bytes [%s] allocated at frame %d\n",
+                     AllocatorName[record.Allocator],
+                     record.Address,
+                     ( unsigned long long )record.Size,
+                     Tags[record.Tag].Name,
+                     record.Frame );
+        }
+    }
+
+    fclose( f );
+
+    GLogger.Printf( "Memory report was written to %s\n", _FileName );
+
+    return true;
+}
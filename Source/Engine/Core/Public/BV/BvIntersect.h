@@ -1201,15 +1201,19 @@ AN_INLINE bool BvRayIntersectBox( Float3 const & _RayStart, Float3 const & _InvR
     _Max = Math::MaxValue< float >();
 
     for ( int i = 0; i < 3; i++ ) {
-        // Check is ray axial
-        if ( Math::IsInfinite( _InvRayDir[ i ] ) ) {
-            if ( _RayStart[ i ] < _AABB.Mins[ i ] || _RayStart[ i ] > _AABB.Maxs[ i ] ) {
+        const float invDir = _InvRayDir[ i ];
+
+        // Check is ray axial. Direction component is +0 or -0, so the reciprocal is +-inf (or NaN for
+        // a broken direction). Never multiply it: inf * 0 gives NaN when the ray origin lies on the slab plane,
+        // and NaN fails every comparison below, so the slab would be silently skipped.
+        if ( !( Math::Abs( invDir ) < Math::MaxValue< float >() ) ) {
+            if ( !( _RayStart[ i ] >= _AABB.Mins[ i ] && _RayStart[ i ] <= _AABB.Maxs[ i ] ) ) {
                 // ray origin must be within the bounds
                 return false;
             }
         } else {
-            float lo = _InvRayDir[ i ] * ( _AABB.Mins[ i ] - _RayStart[ i ] );
-            float hi = _InvRayDir[ i ] * ( _AABB.Maxs[ i ] - _RayStart[ i ] );
+            float lo = invDir * ( _AABB.Mins[ i ] - _RayStart[ i ] );
+            float hi = invDir * ( _AABB.Maxs[ i ] - _RayStart[ i ] );
             if ( lo > hi ) {
                 float tmp = lo;
                 lo = hi;
@@ -1239,15 +1243,19 @@ AN_INLINE bool BvRayIntersectBox2D( Float2 const & _RayStart, Float2 const & _In
     _Max = Math::MaxValue< float >();
 
     for ( int i = 0; i < 2; i++ ) {
-        // Check is ray axial
-        if ( Math::IsInfinite( _InvRayDir[ i ] ) ) {
-            if ( _RayStart[ i ] < _Mins[ i ] || _RayStart[ i ] > _Maxs[ i ] ) {
+        const float invDir = _InvRayDir[ i ];
+
+        // Check is ray axial. Direction component is +0 or -0, so the reciprocal is +-inf (or NaN for
+        // a broken direction). Never multiply it: inf * 0 gives NaN when the ray origin lies on the slab plane,
+        // and NaN fails every comparison below, so the slab would be silently skipped.
+        if ( !( Math::Abs( invDir ) < Math::MaxValue< float >() ) ) {
+            if ( !( _RayStart[ i ] >= _Mins[ i ] && _RayStart[ i ] <= _Maxs[ i ] ) ) {
                 // ray origin must be within the bounds
                 return false;
             }
         } else {
-            float lo = _InvRayDir[ i ] * ( _Mins[ i ] - _RayStart[ i ] );
-            float hi = _InvRayDir[ i ] * ( _Maxs[ i ] - _RayStart[ i ] );
+            float lo = invDir * ( _Mins[ i ] - _RayStart[ i ] );
+            float hi = invDir * ( _Maxs[ i ] - _RayStart[ i ] );
             if ( lo > hi ) {
                 float tmp = lo;
                 lo = hi;
@@ -286,7 +286,9 @@ For small blocks, objects or strings.
 Allocated chunks are aligned at 16-byte boundary.
 If you need other alignment, do it on top of the allocator.
 
-Only for main thread.
+Small blocks are taken from segregated size-class bins through thread-local caches,
+large blocks use first-fit over the chunk list. Alloc/Realloc/Free are thread safe,
+memory can be freed from any thread. Initialize/Deinitialize/Clear are for main thread only.
 
 */
 class AZoneMemory final
@@ -320,6 +322,10 @@ public:
     /** Clearing whole zone memory */
     void Clear();
 
+    /** Return small blocks cached by current thread to the bins, so their spans can be reused
+    by other size classes. Call it when the thread goes idle. */
+    void TrimThreadCache();
+
     /** Statistics: current memory usage */
     size_t GetTotalMemoryUsage() const;
 
@@ -332,9 +338,42 @@ public:
     /** Statistics: max memory usage during memory using */
     size_t GetMaxMemoryUsage() const;
 
+    /** Number of small block size classes */
+    static constexpr int NUM_SIZE_CLASSES = 23;
+
 private:
+    friend struct SZoneThreadCache;
+
     struct SZoneChunk * FindFreeChunk( int _RequiredSize );
 
+    /** Allocate chunk from the chunk list. Must be called under ChunkLock. */
+    struct SZoneChunk * AllocChunk( size_t _RequiredSize );
+
+    /** Return chunk to the chunk list. Must be called under ChunkLock. */
+    void FreeChunk( struct SZoneChunk * _Chunk );
+
+    void * AllocLarge( size_t _BytesCount );
+    void * ReallocBlock( void * _Data, int _NewBytesCount, bool _KeepOld );
+    void * ReallocLarge( void * _Data, size_t _NewBytesCount, bool _KeepOld );
+    void FreeLarge( void * _Bytes );
+
+    void * AllocSmall( size_t _BytesCount, int _SizeClass );
+    void FreeSmall( void * _Bytes );
+
+    /** Move a batch of free blocks from the bin to the thread cache */
+    void RefillThreadCache( struct SZoneThreadCache & _Cache, int _SizeClass );
+
+    /** Move blocks from the thread cache back to the bin. Spans that become empty are returned to the chunk list. */
+    void FlushThreadCache( struct SZoneThreadCache & _Cache, int _SizeClass, int _NumBlocks );
+
+    /** Carve a new span to the blocks of the size class. Must be called under bin lock. */
+    struct SZoneSpan * AllocSpan( int _SizeClass );
+
+    /** Return empty span to the chunk list. Must be called under bin lock. */
+    void FreeSpan( struct SZoneSpan * _Span, int _SizeClass );
+
+    void ResetBins();
+
     void CheckMemoryLeaks();
 
     void IncMemoryStatistics( size_t _MemoryUsage, size_t _Overhead );
@@ -342,14 +381,28 @@ private:
 
     struct SZoneBuffer * MemoryBuffer = nullptr;
 
-    mutable ASpinLock StatisticLock;
-    size_t TotalMemoryUsage;
-    size_t TotalMemoryOverhead;
-    size_t MaxMemoryUsage;
+    /** Guards chunk list */
+    ASpinLock ChunkLock;
 
-#ifdef AN_ZONE_MULTITHREADED_ALLOC
-    AThreadSync Sync;
-#endif
+    /** Size class bin: free blocks shared between threads */
+    struct SZoneBin
+    {
+        ASpinLock Lock;
+        /** Spans that have free blocks */
+        struct SZoneSpan * Spans;
+        int NumFree;
+        /** Total blocks carved from spans */
+        int NumTotal;
+    };
+
+    SZoneBin Bins[NUM_SIZE_CLASSES];
+
+    /** Incremented when memory is cleared to invalidate thread caches */
+    AAtomicInt Generation;
+
+    AAtomicLong TotalMemoryUsage;
+    AAtomicLong TotalMemoryOverhead;
+    AAtomicLong MaxMemoryUsage;
 };
 
 AN_FORCEINLINE void * AZoneMemory::ClearedAlloc( size_t _BytesCount )
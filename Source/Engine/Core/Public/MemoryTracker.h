@@ -0,0 +1,209 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include "Thread.h"
+
+enum EMemoryTrackerAllocator
+{
+    MEMORY_TRACKER_HEAP,
+    MEMORY_TRACKER_HUNK,
+    MEMORY_TRACKER_ZONE,
+    MEMORY_TRACKER_FRAME,
+
+    MEMORY_TRACKER_ALLOCATOR_COUNT
+};
+
+/**
+
+AMemoryTracker
+
+Optional allocation tracking for heap, hunk, zone and frame memory.
+Enabled by "-bMemoryTracking" command line argument.
+
+Each allocation is recorded with its tag, size and frame of allocation.
+The report contains per-tag usage, peak usage, size and lifetime histograms,
+hunk mark mismatches and the list of allocations that are still alive (leaks on shutdown).
+
+Use AN_MEMORY_TAG( "Name" ) to set allocation tag for the current scope.
+Tag names must be string literals (or have static lifetime).
+
+*/
+class AMemoryTracker final
+{
+    AN_FORBID_COPY( AMemoryTracker )
+
+public:
+    static constexpr int MAX_TAGS = 256;
+    static constexpr int NUM_SIZE_BUCKETS = 32;
+    static constexpr int NUM_LIFETIME_BUCKETS = 16;
+    static constexpr int MAX_HUNK_MARKS = 64;
+    static constexpr int MAX_HUNK_MISMATCHES = 64;
+
+    AMemoryTracker() {}
+
+    /** Initialize tracker (main thread only). Must be called before memory initialization. */
+    void Initialize();
+
+    /** Deinitialize tracker (main thread only) */
+    void Deinitialize();
+
+    /** Is tracking enabled */
+    bool IsEnabled() const { return bEnabled; }
+
+    /** Record allocation. If the pointer is already tracked, the record is updated. */
+    void TrackAlloc( EMemoryTrackerAllocator _Allocator, const void * _Bytes, size_t _SizeInBytes );
+
+    /** Record in-place reallocation. Only the size of the record is updated. */
+    void TrackRealloc( EMemoryTrackerAllocator _Allocator, const void * _Bytes, size_t _SizeInBytes );
+
+    /** Record deallocation */
+    void TrackFree( EMemoryTrackerAllocator _Allocator, const void * _Bytes );
+
+    /** Forget all allocations of the allocator (allocator was cleared) */
+    void TrackClear( EMemoryTrackerAllocator _Allocator );
+
+    /** Record frame memory allocation. Frame memory is released at frame boundary. */
+    void TrackFrameAlloc( size_t _SizeInBytes );
+
+    /** Record hunk mark */
+    void TrackHunkMark( int _Mark );
+
+    /** Record hunk clear to mark */
+    void TrackHunkClearToMark( int _Mark );
+
+    /** Frame boundary. Frame memory is released here. */
+    void NextFrame();
+
+    /** Write report to the file */
+    bool DumpReport( const char * _FileName );
+
+    /** Set current thread allocation tag. Returns previous tag. */
+    static const char * SetThreadTag( const char * _Tag );
+
+    /** Get current thread allocation tag */
+    static const char * GetThreadTag();
+
+private:
+    struct SAllocationRecord
+    {
+        const void * Address;
+        uint64_t Size : 48;
+        uint64_t Allocator : 8;
+        uint64_t Tag : 8;
+        int Frame;
+        int Pad;
+    };
+
+    struct STagStatistics
+    {
+        const char * Name;
+        int64_t CurrentUsage[MEMORY_TRACKER_ALLOCATOR_COUNT];
+        int64_t PeakUsage[MEMORY_TRACKER_ALLOCATOR_COUNT];
+        int64_t NumAllocations[MEMORY_TRACKER_ALLOCATOR_COUNT];
+        int64_t NumLiveAllocations[MEMORY_TRACKER_ALLOCATOR_COUNT];
+        int64_t SizeHistogram[NUM_SIZE_BUCKETS];
+        int64_t LifetimeHistogram[NUM_LIFETIME_BUCKETS];
+        int64_t NumFrameAllocations;
+    };
+
+    struct SHunkMark
+    {
+        int Mark;
+        int Tag;
+    };
+
+    struct SHunkMismatch
+    {
+        int ClearMark;
+        int LostMark;
+        int ClearTag;
+        int LostTag;
+        int Frame;
+    };
+
+    int FindTag( const char * _Tag );
+    SAllocationRecord * FindRecord( const void * _Bytes );
+    void InsertRecord( SAllocationRecord const & _Record );
+    void RemoveRecord( SAllocationRecord * _Record );
+    void GrowTable();
+    void AddUsage( int _Tag, int _Allocator, int64_t _Size );
+
+    bool bEnabled = false;
+
+    ASpinLock Lock;
+
+    /** Open addressing hash table of live allocations */
+    SAllocationRecord * Records = nullptr;
+    int TableSize = 0;
+    int NumRecords = 0;
+    int NumTombstones = 0;
+
+    STagStatistics Tags[MAX_TAGS];
+    int NumTags = 0;
+
+    int64_t TotalUsage[MEMORY_TRACKER_ALLOCATOR_COUNT] = {};
+    int64_t PeakTotalUsage[MEMORY_TRACKER_ALLOCATOR_COUNT] = {};
+
+    SHunkMark HunkMarks[MAX_HUNK_MARKS];
+    int NumHunkMarks = 0;
+
+    SHunkMismatch HunkMismatches[MAX_HUNK_MISMATCHES];
+    int NumHunkMismatches = 0;
+
+    int Frame = 0;
+};
+
+extern AMemoryTracker GMemoryTracker;
+
+/** Sets allocation tag for the scope */
+class AMemoryTagScope final
+{
+    AN_FORBID_COPY( AMemoryTagScope )
+
+public:
+    explicit AMemoryTagScope( const char * _Tag )
+    {
+        PrevTag = AMemoryTracker::SetThreadTag( _Tag );
+    }
+
+    ~AMemoryTagScope()
+    {
+        AMemoryTracker::SetThreadTag( PrevTag );
+    }
+
+private:
+    const char * PrevTag;
+};
+
+#define AN_MEMORY_TAG_CONCAT_( a, b ) a ## b
+#define AN_MEMORY_TAG_CONCAT( a, b ) AN_MEMORY_TAG_CONCAT_( a, b )
+#define AN_MEMORY_TAG( _Tag ) AMemoryTagScope AN_MEMORY_TAG_CONCAT( memoryTagScope, __LINE__ )( _Tag )
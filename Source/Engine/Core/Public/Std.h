@@ -132,6 +132,7 @@ using AStdThread = std::thread;
 
 // Function wrap
 #define StdSort     std::sort
+#define StdNthElement std::nth_element
 #define StdFind     std::find
 #define StdChrono   std::chrono
 #define StdSqrt     std::sqrt
@@ -125,7 +125,9 @@ layout( binding = 0, std140 ) uniform UniformBuffer0
     uvec2 PrefilteredMapSampler;
     uvec2 IrradianceMapSampler;
     
-    uvec4 NumDirectionalLights;  // W - DebugMode, YZ - unused
+    vec4 ClusterGrid;  // NumClustersX, NumClustersY, SliceScale, SliceBias
+    
+    uvec4 NumDirectionalLights;  // Y - NumClustersZ, W - DebugMode, Z - unused
     
     vec4 LightDirs[MAX_DIRECTIONAL_LIGHTS];            // Direction, W-channel is not used
     
@@ -209,6 +211,10 @@ uint GetNumDirectionalLights() {
     return NumDirectionalLights.x;
 }
 
+uint GetNumClustersZ() {
+    return NumDirectionalLights.y;
+}
+
 // Adjust texture coordinates for dynamic resolution
 vec2 AdjustTexCoord( in vec2 TexCoord ) {
     vec2 tc = min( TexCoord, vec2(1.0) - GetViewportSizeInverted() ) * GetDynamicResolutionRatio();
@@ -83,7 +83,7 @@ struct SClusterProbe
 };
 
 #define MAX_LIGHTS 768
-#define MAX_PROBES 256
+#define MAX_PROBES 1024
 
 layout( binding = 4, std140 ) uniform UniformBuffer4 {
     SClusterLight LightBuffer[MAX_LIGHTS];
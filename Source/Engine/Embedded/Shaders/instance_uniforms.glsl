@@ -30,11 +30,11 @@ SOFTWARE.
 
 layout( binding = 1, std140 ) uniform DrawCall
 {
-    mat4 TransformMatrix; // Instance MVP
-    mat4 TransformMatrixP; // Instance MVP from previous frame
-    vec4 ModelNormalToViewSpace0;
-    vec4 ModelNormalToViewSpace1;
-    vec4 ModelNormalToViewSpace2;
+    mat4 DrawCall_TransformMatrix; // Instance MVP
+    mat4 DrawCall_TransformMatrixP; // Instance MVP from previous frame
+    vec4 DrawCall_ModelNormalToViewSpace0;
+    vec4 DrawCall_ModelNormalToViewSpace1;
+    vec4 DrawCall_ModelNormalToViewSpace2;
     vec4 LightmapOffset;
     vec4 uaddr_0;
     vec4 uaddr_1;
@@ -43,7 +43,39 @@ layout( binding = 1, std140 ) uniform DrawCall
     vec2 VTOffset;
     vec2 VTScale;
     uint VTUnit;
-    uint DrawCall_Pad0;
+    uint InstanceBatch; // Nonzero if transforms are fetched from InstanceTransforms
     uint DrawCall_Pad1;
     uint DrawCall_Pad2;
 };
+
+#if defined INSTANCE_BATCHING && defined VERTEX_SHADER
+
+struct SInstanceTransform
+{
+    mat4 TransformMatrix;
+    mat4 TransformMatrixP;
+    vec4 ModelNormalToViewSpace0;
+    vec4 ModelNormalToViewSpace1;
+    vec4 ModelNormalToViewSpace2;
+};
+
+layout( binding = 8, std140 ) uniform InstanceTransforms
+{
+    SInstanceTransform InstanceTransform[ 64 ];   // MAX_INSTANCE_BATCH = 64
+};
+
+#define TransformMatrix ( InstanceBatch != 0 ? InstanceTransform[ gl_InstanceID ].TransformMatrix : DrawCall_TransformMatrix )
+#define TransformMatrixP ( InstanceBatch != 0 ? InstanceTransform[ gl_InstanceID ].TransformMatrixP : DrawCall_TransformMatrixP )
+#define ModelNormalToViewSpace0 ( InstanceBatch != 0 ? InstanceTransform[ gl_InstanceID ].ModelNormalToViewSpace0 : DrawCall_ModelNormalToViewSpace0 )
+#define ModelNormalToViewSpace1 ( InstanceBatch != 0 ? InstanceTransform[ gl_InstanceID ].ModelNormalToViewSpace1 : DrawCall_ModelNormalToViewSpace1 )
+#define ModelNormalToViewSpace2 ( InstanceBatch != 0 ? InstanceTransform[ gl_InstanceID ].ModelNormalToViewSpace2 : DrawCall_ModelNormalToViewSpace2 )
+
+#else
+
+#define TransformMatrix DrawCall_TransformMatrix
+#define TransformMatrixP DrawCall_TransformMatrixP
+#define ModelNormalToViewSpace0 DrawCall_ModelNormalToViewSpace0
+#define ModelNormalToViewSpace1 DrawCall_ModelNormalToViewSpace1
+#define ModelNormalToViewSpace2 DrawCall_ModelNormalToViewSpace2
+
+#endif
@@ -89,7 +89,7 @@ vec3 CalcPointLightLighting( vec3 Normal, vec3 Specular, float SpecularPower )
     
     for ( int i = 0 ; i < NumLights ; i++ ) {
         const uint indices = texelFetch( ClusterItemTBO, int( FirstIndex + i ) ).x;
-        const uint lightIndex = indices & 0x3ff;
+        const uint lightIndex = indices & 0xfff;
         const uint lightType = GetLightType( lightIndex );
 
         const float OuterRadius = GetLightRadius( lightIndex );
@@ -99,7 +99,7 @@ vec3 CalcAmbient( vec3 Albedo, vec3 R, vec3 N, float NdV, vec3 F0, float Roughne
     
     for ( int i = 0 ; i < NumProbes ; i++ ) {
         const uint Indices = texelFetch( ClusterItemTBO, int( FirstIndex + i ) ).x;
-        const uint ProbeIndex = Indices >> 24;
+        const uint ProbeIndex = Indices >> 22;
         
         const float Radius = Probes[ ProbeIndex ].PositionAndRadius.w;
         const vec3 Vec = Probes[ ProbeIndex ].PositionAndRadius.xyz - VS_Position;
@@ -191,7 +191,7 @@ vec3 CalcPointLightLightingPBR( vec3 Diffuse, vec3 F0, float k, float RoughnessS
     
     for ( int i = 0 ; i < NumLights ; i++ ) {
         const uint indices = texelFetch( ClusterItemTBO, int( FirstIndex + i ) ).x;
-        const uint lightIndex = indices & 0x3ff;
+        const uint lightIndex = indices & 0xfff;
         const uint lightType = GetLightType( lightIndex );
 
         const float OuterRadius = GetLightRadius( lightIndex );
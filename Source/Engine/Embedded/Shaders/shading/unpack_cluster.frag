@@ -33,28 +33,20 @@ SOFTWARE.
 
 void UnpackCluster( out uint numProbes, out uint numDecals, out uint numLights, out uint firstIndex )
 {
-    // TODO: Move scale and bias to uniforms
-    #define NUM_CLUSTERS_Z 24
-    const float znear = 0.0125f;
-    const float zfar = 512;
-    const int nearOffset = 20;
-    const float scale = ( NUM_CLUSTERS_Z + nearOffset ) / log2( zfar / znear );
-    const float bias = -log2( znear ) * scale - nearOffset;
-
     // Calc cluster index
     const float linearDepth = -VS_Position.z;
-    const float slice = max( 0.0, floor( log2( linearDepth ) * scale + bias ) );
-    const ivec3 clusterIndex = ivec3( InNormalizedScreenCoord.x * 16, InNormalizedScreenCoord.y * 8, slice );
+    // Clamp to the slices uploaded this frame, the lookup texture is allocated for MAX_FRUSTUM_CLUSTERS_Z
+    const float slice = clamp( floor( log2( linearDepth ) * ClusterGrid.z + ClusterGrid.w ), 0.0, float( GetNumClustersZ() - 1 ) );
+    const ivec3 clusterIndex = ivec3( InNormalizedScreenCoord.x * ClusterGrid.x, InNormalizedScreenCoord.y * ClusterGrid.y, slice );
 
     // Fetch cluster header
     const uvec2 header = texelFetch( ClusterLookup, clusterIndex, 0 ).xy;
 
     // Unpack header data
     firstIndex = header.x;
-    numProbes = header.y & 0xff;
-    numDecals = ( header.y >> 8 ) & 0xff;
-    numLights = ( header.y >> 16 ) & 0xff;
-    //unused = ( header.y >> 24 ) & 0xff; // can be used in future
+    numProbes = header.y & 0x3ff;
+    numDecals = ( header.y >> 10 ) & 0x7ff;
+    numLights = header.y >> 21;
 }
 
 #endif
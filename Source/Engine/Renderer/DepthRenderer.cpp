@@ -130,9 +130,12 @@ void AddDepthPass( AFrameGraph & FrameGraph, AFrameGraphTexture ** ppDepthTextur
             drawCmd.InstanceCount = 1;
             drawCmd.StartInstanceLocation = 0;
 
-            for ( int i = 0 ; i < GRenderView->InstanceCount ; i++ ) {
+            for ( int i = 0 ; i < GRenderView->InstanceCount ; ) {
                 SRenderInstance const * instance = GFrameData->Instances[GRenderView->FirstInstance + i];
 
+                // Merged instances are drawn with one instanced draw call
+                i += instance->InstanceCount;
+
                 if ( !BindMaterialDepthPass( instance ) ) {
                     continue;
                 }
@@ -140,8 +143,9 @@ void AddDepthPass( AFrameGraph & FrameGraph, AFrameGraphTexture ** ppDepthTextur
                 BindTextures( instance->MaterialInstance, instance->Material->DepthPassTextureCount );
                 BindSkeleton( instance->SkeletonOffset, instance->SkeletonSize );
                 BindSkeletonMotionBlur( instance->SkeletonOffsetMB, instance->SkeletonSize );
-                BindInstanceConstants( instance );
+                BindInstanceConstants( instance, instance->InstanceCount );
 
+                drawCmd.InstanceCount = instance->InstanceCount;
                 drawCmd.IndexCountPerInstance = instance->IndexCount;
                 drawCmd.StartIndexLocation = instance->StartIndexLocation;
                 drawCmd.BaseVertexLocation = instance->BaseVertexLocation;
@@ -182,17 +186,21 @@ void AddDepthPass( AFrameGraph & FrameGraph, AFrameGraphTexture ** ppDepthTextur
             drawCmd.InstanceCount = 1;
             drawCmd.StartInstanceLocation = 0;
 
-            for ( int i = 0 ; i < GRenderView->InstanceCount ; i++ ) {
+            for ( int i = 0 ; i < GRenderView->InstanceCount ; ) {
                 SRenderInstance const * instance = GFrameData->Instances[GRenderView->FirstInstance + i];
 
+                // Merged instances are drawn with one instanced draw call
+                i += instance->InstanceCount;
+
                 if ( !BindMaterialDepthPass( instance ) ) {
                     continue;
                 }
 
                 BindTextures( instance->MaterialInstance, instance->Material->DepthPassTextureCount );
                 BindSkeleton( instance->SkeletonOffset, instance->SkeletonSize );
-                BindInstanceConstants( instance );
+                BindInstanceConstants( instance, instance->InstanceCount );
 
+                drawCmd.InstanceCount = instance->InstanceCount;
                 drawCmd.IndexCountPerInstance = instance->IndexCount;
                 drawCmd.StartIndexLocation = instance->StartIndexLocation;
                 drawCmd.BaseVertexLocation = instance->BaseVertexLocation;
@@ -420,17 +420,21 @@ void ALightRenderer::AddPass( AFrameGraph & FrameGraph,
         drawCmd.InstanceCount = 1;
         drawCmd.StartInstanceLocation = 0;
 
-        for ( int i = 0 ; i < GRenderView->InstanceCount ; i++ ) {
+        for ( int i = 0 ; i < GRenderView->InstanceCount ; ) {
             SRenderInstance const * instance = GFrameData->Instances[GRenderView->FirstInstance + i];
 
+            // Merged instances are drawn with one instanced draw call
+            i += instance->InstanceCount;
+
             if ( !BindMaterialLightPass( instance ) ) {
                 continue;
             }
 
             BindTextures( instance->MaterialInstance, instance->Material->LightPassTextureCount );
             BindSkeleton( instance->SkeletonOffset, instance->SkeletonSize );
-            BindInstanceConstants( instance );
+            BindInstanceConstants( instance, instance->InstanceCount );
 
+            drawCmd.InstanceCount = instance->InstanceCount;
             drawCmd.IndexCountPerInstance = instance->IndexCount;
             drawCmd.StartIndexLocation = instance->StartIndexLocation;
             drawCmd.BaseVertexLocation = instance->BaseVertexLocation;
@@ -511,6 +511,9 @@ void CreateDepthPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Skinned && !_Tessellation;
+
     SRasterizerStateInfo & rsd = pipelineCI.RS;
     rsd.CullMode = _CullMode;
 
@@ -549,6 +552,9 @@ void CreateDepthPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
     if ( _Skinned ) {
         sources.Append( "#define SKINNED_MESH\n" );
     }
+    if ( bInstanceBatching ) {
+        sources.Append( "#define INSTANCE_BATCHING\n" );
+    }
     sources.Append( vertexAttribsShaderString.CStr() );
     sources.Append( _SourceCode );
     CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -593,12 +599,18 @@ void CreateDepthPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
     pipelineCI.ResourceLayout.Samplers = samplers;
 
     // TODO: Specify only used buffers
-    SBufferInfo buffers[3];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
-
-    pipelineCI.ResourceLayout.NumBuffers = _Skinned ? 3 : 2;
+    buffers[3].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[4].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
+
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : ( _Skinned ? 3 : 2 );
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
@@ -609,6 +621,9 @@ void CreateDepthVelocityPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Skinned && !_Tessellation;
+
     SRasterizerStateInfo & rsd = pipelineCI.RS;
     rsd.CullMode = _CullMode;
 
@@ -645,6 +660,9 @@ void CreateDepthVelocityPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     if ( _Skinned ) {
         sources.Append( "#define SKINNED_MESH\n" );
     }
+    if ( bInstanceBatching ) {
+        sources.Append( "#define INSTANCE_BATCHING\n" );
+    }
     sources.Append( vertexAttribsShaderString.CStr() );
     sources.Append( _SourceCode );
     CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -690,7 +708,7 @@ void CreateDepthVelocityPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     pipelineCI.ResourceLayout.Samplers = samplers;
 
     // TODO: Specify only used buffers
-    SBufferInfo buffers[8];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
@@ -699,8 +717,9 @@ void CreateDepthVelocityPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // IBL buffer
     buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // VT buffer
     buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton for motion blur
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
 
-    pipelineCI.ResourceLayout.NumBuffers = AN_ARRAY_SIZE( buffers );
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : 8;
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
@@ -711,6 +730,9 @@ void CreateWireframePassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, co
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Skinned && !_Tessellation;
+
     SRasterizerStateInfo & rsd = pipelineCI.RS;
     rsd.CullMode = _CullMode;
 
@@ -750,6 +772,9 @@ void CreateWireframePassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, co
     if ( _Skinned ) {
         sources.Append( "#define SKINNED_MESH\n" );
     }
+    if ( bInstanceBatching ) {
+        sources.Append( "#define INSTANCE_BATCHING\n" );
+    }
     sources.Append( vertexAttribsShaderString.CStr() );
     sources.Append( _SourceCode );
     CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -799,12 +824,18 @@ void CreateWireframePassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, co
     pipelineCI.ResourceLayout.NumSamplers = NumSamplers;
     pipelineCI.ResourceLayout.Samplers = samplers;
 
-    SBufferInfo buffers[3];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
-
-    pipelineCI.ResourceLayout.NumBuffers = _Skinned ? 3 : 2;
+    buffers[3].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[4].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
+
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : ( _Skinned ? 3 : 2 );
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
@@ -815,6 +846,9 @@ void CreateNormalsPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, cons
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Skinned;
+
     SBlendingStateInfo & bsd = pipelineCI.BS;
     bsd.RenderTargetSlots[0].SetBlendingPreset( BLENDING_ALPHA );
 
@@ -851,6 +885,9 @@ void CreateNormalsPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, cons
     if ( _Skinned ) {
         sources.Append( "#define SKINNED_MESH\n" );
     }
+    if ( bInstanceBatching ) {
+        sources.Append( "#define INSTANCE_BATCHING\n" );
+    }
     sources.Append( vertexAttribsShaderString.CStr() );
     sources.Append( _SourceCode );
     CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -882,12 +919,18 @@ void CreateNormalsPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, cons
     pipelineCI.ResourceLayout.NumSamplers = NumSamplers;
     pipelineCI.ResourceLayout.Samplers = samplers;
 
-    SBufferInfo buffers[3];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
-
-    pipelineCI.ResourceLayout.NumBuffers = _Skinned ? 3 : 2;
+    buffers[3].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[4].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
+
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : ( _Skinned ? 3 : 2 );
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
@@ -984,6 +1027,9 @@ void CreateLightPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Skinned && !_Tessellation;
+
     SRasterizerStateInfo & rsd = pipelineCI.RS;
     rsd.CullMode = _CullMode;
 
@@ -1047,6 +1093,9 @@ void CreateLightPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
 
         sources.Clear();
         sources.Append( "#define MATERIAL_PASS_COLOR\n" );
+        if ( bInstanceBatching ) {
+            sources.Append( "#define INSTANCE_BATCHING\n" );
+        }
         sources.Append( vertexAttribsShaderString.CStr() );
         sources.Append( _SourceCode );
         CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -1108,7 +1157,7 @@ void CreateLightPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
     pipelineCI.ResourceLayout.Samplers = samplers;
 
     // TODO: Specify only used buffers
-    SBufferInfo buffers[7];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
@@ -1116,8 +1165,10 @@ void CreateLightPassPipeline( TRef< RenderCore::IPipeline > * ppPipeline, const
     buffers[4].BufferBinding = BUFFER_BIND_CONSTANT; // light buffer
     buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // IBL buffer
     buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // VT buffer
+    buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
 
-    pipelineCI.ResourceLayout.NumBuffers = AN_ARRAY_SIZE( buffers );
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : 7;
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
@@ -1128,6 +1179,9 @@ void CreateLightPassLightmapPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Tessellation;
+
     SRasterizerStateInfo & rsd = pipelineCI.RS;
     rsd.CullMode = _CullMode;
 
@@ -1157,6 +1211,9 @@ void CreateLightPassLightmapPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     sources.Clear();
     sources.Append( "#define MATERIAL_PASS_COLOR\n" );
     sources.Append( "#define USE_LIGHTMAP\n" );
+    if ( bInstanceBatching ) {
+        sources.Append( "#define INSTANCE_BATCHING\n" );
+    }
     sources.Append( vertexAttribsShaderString.CStr() );
     sources.Append( _SourceCode );
     CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -1227,7 +1284,7 @@ void CreateLightPassLightmapPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     pipelineCI.ResourceLayout.Samplers = samplers;
 
     // TODO: Specify only used buffers
-    SBufferInfo buffers[7];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
@@ -1235,8 +1292,10 @@ void CreateLightPassLightmapPipeline( TRef< RenderCore::IPipeline > * ppPipeline
     buffers[4].BufferBinding = BUFFER_BIND_CONSTANT; // light buffer
     buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // IBL buffer
     buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // VT buffer
+    buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
 
-    pipelineCI.ResourceLayout.NumBuffers = AN_ARRAY_SIZE( buffers );
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : 7;
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
@@ -1247,6 +1306,9 @@ void CreateLightPassVertexLightPipeline( TRef< RenderCore::IPipeline > * ppPipel
     SPipelineCreateInfo pipelineCI;
     TPodVector< const char * > sources;
 
+    // Static geometry can fetch per-instance transforms to draw merged instances
+    bool bInstanceBatching = !_Tessellation;
+
     SRasterizerStateInfo & rsd = pipelineCI.RS;
     rsd.CullMode = _CullMode;
 
@@ -1276,6 +1338,9 @@ void CreateLightPassVertexLightPipeline( TRef< RenderCore::IPipeline > * ppPipel
     sources.Clear();
     sources.Append( "#define MATERIAL_PASS_COLOR\n" );
     sources.Append( "#define USE_VERTEX_LIGHT\n" );
+    if ( bInstanceBatching ) {
+        sources.Append( "#define INSTANCE_BATCHING\n" );
+    }
     sources.Append( vertexAttribsShaderString.CStr() );
     sources.Append( _SourceCode );
     CreateShader( VERTEX_SHADER, sources, pipelineCI.pVS );
@@ -1346,7 +1411,7 @@ void CreateLightPassVertexLightPipeline( TRef< RenderCore::IPipeline > * ppPipel
     pipelineCI.ResourceLayout.Samplers = samplers;
 
     // TODO: Specify only used buffers
-    SBufferInfo buffers[7];
+    SBufferInfo buffers[9];
     buffers[0].BufferBinding = BUFFER_BIND_CONSTANT; // view constants
     buffers[1].BufferBinding = BUFFER_BIND_CONSTANT; // drawcall constants
     buffers[2].BufferBinding = BUFFER_BIND_CONSTANT; // skeleton
@@ -1354,8 +1419,10 @@ void CreateLightPassVertexLightPipeline( TRef< RenderCore::IPipeline > * ppPipel
     buffers[4].BufferBinding = BUFFER_BIND_CONSTANT; // light buffer
     buffers[5].BufferBinding = BUFFER_BIND_CONSTANT; // IBL buffer
     buffers[6].BufferBinding = BUFFER_BIND_CONSTANT; // VT buffer
+    buffers[7].BufferBinding = BUFFER_BIND_CONSTANT; // unused
+    buffers[8].BufferBinding = BUFFER_BIND_CONSTANT; // instance transforms
 
-    pipelineCI.ResourceLayout.NumBuffers = AN_ARRAY_SIZE( buffers );
+    pipelineCI.ResourceLayout.NumBuffers = bInstanceBatching ? AN_ARRAY_SIZE( buffers ) : 7;
     pipelineCI.ResourceLayout.Buffers = buffers;
 
     GDevice->CreatePipeline( pipelineCI, ppPipeline );
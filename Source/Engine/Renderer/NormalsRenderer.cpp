@@ -84,17 +84,21 @@ void AddNormalsPass( AFrameGraph & FrameGraph, AFrameGraphTexture * RenderTarget
         drawCmd.InstanceCount = 1;
         drawCmd.StartInstanceLocation = 0;
 
-        for ( int i = 0 ; i < GRenderView->InstanceCount ; i++ ) {
+        for ( int i = 0 ; i < GRenderView->InstanceCount ; ) {
             SRenderInstance const * instance = GFrameData->Instances[GRenderView->FirstInstance + i];
 
+            // Merged instances are drawn with one instanced draw call
+            i += instance->InstanceCount;
+
             if ( !BindMaterialNormalPass( instance ) ) {
                 continue;
             }
 
             BindTextures( instance->MaterialInstance, instance->Material->NormalsPassTextureCount );
             BindSkeleton( instance->SkeletonOffset, instance->SkeletonSize );
-            BindInstanceConstants( instance );
+            BindInstanceConstants( instance, instance->InstanceCount );
 
+            drawCmd.InstanceCount = instance->InstanceCount;
             drawCmd.IndexCountPerInstance = instance->IndexCount;
             drawCmd.StartIndexLocation = instance->StartIndexLocation;
             drawCmd.BaseVertexLocation = instance->BaseVertexLocation;
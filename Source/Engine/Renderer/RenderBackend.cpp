@@ -606,6 +606,9 @@ void ARenderBackend::InitializeMaterial( AMaterialGPU * Material, SMaterialDef c
     case MATERIAL_TYPE_PBR:
     case MATERIAL_TYPE_BASELIGHT:
     case MATERIAL_TYPE_UNLIT: {
+        // Non-skinned pipelines without tessellation fetch per-instance transforms
+        Material->bInstanceBatching = !bTessellation;
+
         for ( int i = 0 ; i < 2 ; i++ ) {
             bool bSkinned = !!i;
 
@@ -627,6 +630,8 @@ void ARenderBackend::InitializeMaterial( AMaterialGPU * Material, SMaterialDef c
     }
     case MATERIAL_TYPE_HUD:
     case MATERIAL_TYPE_POSTPROCESS: {
+        Material->bInstanceBatching = false;
+
         CreateHUDPipeline( &Material->HUDPipeline, code.CStr(), Def->Samplers, Def->NumSamplers );
         break;
     }
@@ -791,6 +796,12 @@ void ARenderBackend::SetViewConstants()
     pViewCBuf->PrefilteredMapSampler = (uint64_t)GPrefilteredMapBindless->GetHandle();
     pViewCBuf->IrradianceMapSampler = (uint64_t)GIrradianceMapBindless->GetHandle();
 
+    pViewCBuf->ClusterGrid.X = GRenderView->NumClustersX;
+    pViewCBuf->ClusterGrid.Y = GRenderView->NumClustersY;
+    pViewCBuf->ClusterGrid.Z = GRenderView->ClusterSliceScale;
+    pViewCBuf->ClusterGrid.W = GRenderView->ClusterSliceBias;
+    pViewCBuf->NumClustersZ = GRenderView->NumClustersZ;
+
     pViewCBuf->DebugMode = r_DebugRenderMode.GetInteger();
 
     pViewCBuf->NumDirectionalLights = GRenderView->NumDirectionalLights;
@@ -826,14 +837,14 @@ void ARenderBackend::UploadShaderResources()
 #if 1
     // Perform copy from stream buffer on GPU side
     RenderCore::STextureRect rect = {};
-    rect.Dimension.X = MAX_FRUSTUM_CLUSTERS_X;
-    rect.Dimension.Y = MAX_FRUSTUM_CLUSTERS_Y;
-    rect.Dimension.Z = MAX_FRUSTUM_CLUSTERS_Z;
+    rect.Dimension.X = GRenderView->NumClustersX;
+    rect.Dimension.Y = GRenderView->NumClustersY;
+    rect.Dimension.Z = GRenderView->NumClustersZ;
     rcmd->CopyBufferToTexture( GStreamBuffer, GClusterLookup, rect, RenderCore::FORMAT_UINT2, 0, GRenderView->ClusterLookupStreamHandle, 1 );
 #else
     GClusterLookup->Write( 0,
                           RenderCore::FORMAT_UINT2,
-                          sizeof( SClusterHeader )*MAX_FRUSTUM_CLUSTERS_X*MAX_FRUSTUM_CLUSTERS_Y*MAX_FRUSTUM_CLUSTERS_Z,
+                          sizeof( SClusterHeader )*GRenderView->NumClustersX*GRenderView->NumClustersY*GRenderView->NumClustersZ,
                           1,
                           GRenderView->LightData.ClusterLookup );
 #endif
@@ -172,26 +172,35 @@ bool STexturePixelFormat::GetAppropriatePixelFormat( EImagePixelFormat const & _
     return true;
 }
 
-// TODO: this can be computed at compile-time
-float FRUSTUM_SLICE_SCALE = -(MAX_FRUSTUM_CLUSTERS_Z + FRUSTUM_SLICE_OFFSET) / std::log2( (double)FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR );
-float FRUSTUM_SLICE_BIAS = std::log2( (double)FRUSTUM_CLUSTER_ZFAR ) * (MAX_FRUSTUM_CLUSTERS_Z + FRUSTUM_SLICE_OFFSET) / std::log2( (double)FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR ) - FRUSTUM_SLICE_OFFSET;
-float FRUSTUM_SLICE_ZCLIP[MAX_FRUSTUM_CLUSTERS_Z + 1];
-
-struct SFrustumSliceZClipInitializer
+void SClusterGrid::Setup( int InNumClustersX, int InNumClustersY, int InNumClustersZ, int InSliceOffset, int InItemCapacity )
 {
-    SFrustumSliceZClipInitializer() {
-        FRUSTUM_SLICE_ZCLIP[0] = 1; // extended near cluster
+    NumClustersX = Math::Clamp( InNumClustersX, 1, MAX_FRUSTUM_CLUSTERS_X );
+    NumClustersY = Math::Clamp( InNumClustersY, 1, MAX_FRUSTUM_CLUSTERS_Y );
+    NumClustersZ = Math::Clamp( InNumClustersZ, 1, MAX_FRUSTUM_CLUSTERS_Z );
+    SliceOffset = Math::Max( InSliceOffset, 0 );
+    ItemCapacity = Math::Clamp( InItemCapacity, 1, MAX_CLUSTER_ITEMS );
 
-        for ( int SliceIndex = 1 ; SliceIndex < MAX_FRUSTUM_CLUSTERS_Z + 1 ; SliceIndex++ ) {
-            //float sliceZ = FRUSTUM_CLUSTER_ZNEAR * Math::Pow( ( FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR ), ( float )sliceIndex / MAX_FRUSTUM_CLUSTERS_Z ); // linear depth
-            //FRUSTUM_SLICE_ZCLIP[ sliceIndex ] = ( FRUSTUM_CLUSTER_ZFAR * FRUSTUM_CLUSTER_ZNEAR / sliceZ - FRUSTUM_CLUSTER_ZNEAR ) / FRUSTUM_CLUSTER_ZRANGE; // to ndc
+    ClusterWidth = 2.0f / NumClustersX;
+    ClusterHeight = 2.0f / NumClustersY;
 
-            FRUSTUM_SLICE_ZCLIP[SliceIndex] = (FRUSTUM_CLUSTER_ZFAR / Math::Pow( (double)FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR, (double)(SliceIndex + FRUSTUM_SLICE_OFFSET) / (MAX_FRUSTUM_CLUSTERS_Z + FRUSTUM_SLICE_OFFSET) ) - FRUSTUM_CLUSTER_ZNEAR) / FRUSTUM_CLUSTER_ZRANGE; // to ndc
-        }
-    }
-};
+    const double numSlices = NumClustersZ + SliceOffset;
+    const double logRange = std::log2( (double)FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR );
+
+    SliceScale = -numSlices / logRange;
+    SliceBias = std::log2( (double)FRUSTUM_CLUSTER_ZFAR ) * numSlices / logRange - SliceOffset;
+
+    ViewSliceScale = numSlices / logRange;
+    ViewSliceBias = -std::log2( (double)FRUSTUM_CLUSTER_ZNEAR ) * numSlices / logRange - SliceOffset;
 
-static SFrustumSliceZClipInitializer FrustumSliceZClipInitializer;
+    SliceZClip[0] = 1; // extended near cluster
+
+    for ( int sliceIndex = 1 ; sliceIndex < NumClustersZ + 1 ; sliceIndex++ ) {
+        //float sliceZ = FRUSTUM_CLUSTER_ZNEAR * Math::Pow( ( FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR ), ( float )sliceIndex / NumClustersZ ); // linear depth
+        //SliceZClip[ sliceIndex ] = ( FRUSTUM_CLUSTER_ZFAR * FRUSTUM_CLUSTER_ZNEAR / sliceZ - FRUSTUM_CLUSTER_ZNEAR ) / FRUSTUM_CLUSTER_ZRANGE; // to ndc
+
+        SliceZClip[sliceIndex] = (FRUSTUM_CLUSTER_ZFAR / Math::Pow( (double)FRUSTUM_CLUSTER_ZFAR / FRUSTUM_CLUSTER_ZNEAR, (double)(sliceIndex + SliceOffset) / numSlices ) - FRUSTUM_CLUSTER_ZNEAR) / FRUSTUM_CLUSTER_ZRANGE; // to ndc
+    }
+}
 
 void SMaterialDef::AddShader( const char * SourceName, AString const & SourceCode )
 {
@@ -43,6 +43,9 @@ SOFTWARE.
 /** Max skeleton joints */
 constexpr int MAX_SKINNED_MESH_JOINTS               = 256;
 
+/** Max instances merged into one instanced draw call. Limited by the minimal uniform block size (16 kB) */
+constexpr int MAX_INSTANCE_BATCH                    = 64;
+
 /** Max textures per material */
 constexpr int MAX_MATERIAL_TEXTURES                 = 11; // Reserved texture slots for AOLookup, ClusterItemTBO, ClusterLookup, ShadowMapShadow, Lightmap
 
@@ -55,14 +58,14 @@ constexpr int MAX_SHADOW_CASCADES = 4;
 /** Max cascades per view */
 constexpr int MAX_TOTAL_SHADOW_CASCADES_PER_VIEW = MAX_SHADOW_CASCADES * MAX_DIRECTIONAL_LIGHTS;
 
-/** Frustum width */
-constexpr int MAX_FRUSTUM_CLUSTERS_X = 16;
+/** Max frustum width in clusters */
+constexpr int MAX_FRUSTUM_CLUSTERS_X = 32;
 
-/** Frustum height */
-constexpr int MAX_FRUSTUM_CLUSTERS_Y = 8;
+/** Max frustum height in clusters */
+constexpr int MAX_FRUSTUM_CLUSTERS_Y = 32;
 
-/** Frustum depth */
-constexpr int MAX_FRUSTUM_CLUSTERS_Z = 24;
+/** Max frustum depth in clusters */
+constexpr int MAX_FRUSTUM_CLUSTERS_Z = 64;
 
 /** Frustum projection matrix ZNear */
 constexpr float FRUSTUM_CLUSTER_ZNEAR = 0.0125f;
@@ -73,42 +76,56 @@ constexpr float FRUSTUM_CLUSTER_ZFAR = 512;
 /** Frustum projection matrix ZRange */
 constexpr float FRUSTUM_CLUSTER_ZRANGE = FRUSTUM_CLUSTER_ZFAR - FRUSTUM_CLUSTER_ZNEAR;
 
-/** Width of single cluster */
-constexpr float FRUSTUM_CLUSTER_WIDTH = 2.0f / MAX_FRUSTUM_CLUSTERS_X;
+/** Max lights, Max decals, Max probes per cluster. Limited by 10 bit probe counter in cluster header. */
+constexpr int MAX_CLUSTER_ITEMS = 1023;
+
+/**
 
-/** Height of single cluster */
-constexpr float FRUSTUM_CLUSTER_HEIGHT = 2.0f / MAX_FRUSTUM_CLUSTERS_Y;
+Clustered shading grid. Dimensions, Z distribution and per-cluster capacity are configured at runtime.
 
-constexpr int FRUSTUM_SLICE_OFFSET = 20;
+*/
+struct SClusterGrid
+{
+    int NumClustersX;
+    int NumClustersY;
+    int NumClustersZ;
 
-extern float FRUSTUM_SLICE_SCALE;
+    /** Number of logarithmic slices skipped near the camera. Larger offset gives more slices to far distances. */
+    int SliceOffset;
 
-extern float FRUSTUM_SLICE_BIAS;
+    /** Max lights, decals and probes per cluster */
+    int ItemCapacity;
 
-extern float FRUSTUM_SLICE_ZCLIP[MAX_FRUSTUM_CLUSTERS_Z + 1];
+    /** Cluster size in clip space */
+    float ClusterWidth;
+    float ClusterHeight;
 
-/** Max lights, Max decals, Max probes per cluster */
-constexpr int MAX_CLUSTER_ITEMS = 256;
+    /** Slice = log2( ClipZ * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * SliceScale + SliceBias */
+    float SliceScale;
+    float SliceBias;
 
-/** Max lights per cluster */
-constexpr int MAX_CLUSTER_LIGHTS = MAX_CLUSTER_ITEMS;
+    /** Slice = log2( LinearDepth ) * ViewSliceScale + ViewSliceBias. Used by shaders. */
+    float ViewSliceScale;
+    float ViewSliceBias;
 
-/** Max decals per cluster */
-constexpr int MAX_CLUSTER_DECALS = MAX_CLUSTER_ITEMS;
+    /** Clip space Z of slice bounds */
+    float SliceZClip[MAX_FRUSTUM_CLUSTERS_Z + 1];
 
-/** Max probes per cluster */
-constexpr int MAX_CLUSTER_PROBES = MAX_CLUSTER_ITEMS;
+    void Setup( int InNumClustersX, int InNumClustersY, int InNumClustersZ, int InSliceOffset, int InItemCapacity );
+
+    int GetNumClusters() const { return NumClustersX * NumClustersY * NumClustersZ; }
+};
 
 constexpr int MAX_TOTAL_CLUSTER_ITEMS = 512 * 1024; // NOTE: must be power of two // TODO: подобрать оптимальный размер
 
-/** Max lights per view. Indexed by 12 bit integer, limited by shader max constant buffer block size. */
-constexpr int MAX_LIGHTS = 768;//1024
+/** Max lights per view. Indexed by 12 bit integer, limited by shader max constant buffer block size (64 kB). */
+constexpr int MAX_LIGHTS = 768;
 
-/** Max decals per view. Indexed by 12 bit integer. */
+/** Max decals per view. Indexed by 10 bit integer. */
 constexpr int MAX_DECALS = 1024;
 
-/** Max probes per view. Indexed by 8 bit integer */
-constexpr int MAX_PROBES = 256;
+/** Max probes per view. Indexed by 10 bit integer. */
+constexpr int MAX_PROBES = 1024;
 
 /** Total max items per view. */
 constexpr int MAX_ITEMS = MAX_LIGHTS + MAX_DECALS + MAX_PROBES;
@@ -821,6 +838,9 @@ public:
     TRef< RenderCore::IPipeline > FeedbackPass[2];
     TRef< RenderCore::IPipeline > OutlinePass[2];
     TRef< RenderCore::IPipeline > HUDPipeline;
+
+    /** Non-skinned pipelines can fetch per-instance transforms, so render instances can be merged into instanced draws */
+    bool bInstanceBatching;
 };
 
 struct SMaterialFrameData
@@ -984,6 +1004,10 @@ struct SRenderInstance
     unsigned int StartIndexLocation;
     int          BaseVertexLocation;
 
+    /** Number of merged instances. If greater than one, transforms are fetched from InstanceTransformsStreamHandle */
+    int InstanceCount;
+    size_t InstanceTransformsStreamHandle;
+
     uint64_t SortKey;
 
     uint8_t GetRenderingPriority() const {
@@ -1004,6 +1028,15 @@ struct SRenderInstance
 };
 
 
+/** Per-instance transform of merged render instances */
+struct SInstanceTransform
+{
+    Float4x4 TransformMatrix;
+    Float4x4 TransformMatrixP;
+    Float3x4 ModelNormalToViewSpace;
+};
+
+
 /**
 
 Shadowmap render instance
@@ -1076,10 +1109,9 @@ Cluster header
 
 uvec2 header = texelFetch( ClusterLookup, TexCoord ).xy;
 int FirstPackedIndex = header.x;
-int NumProbes = header.y & 0xff;
-int NumDecals = ( header.y >> 8 ) & 0xff;
-int NumLights = ( header.y >> 16 ) & 0xff;
-int Pad0 = ( header.y >> 24 ) & 0xff // can be used in future
+int NumProbes = header.y & 0x3ff;
+int NumDecals = ( header.y >> 10 ) & 0x7ff;
+int NumLights = header.y >> 21;
 
 texture3d RG32UI
 
@@ -1087,10 +1119,9 @@ texture3d RG32UI
 struct SClusterHeader
 {
     uint32_t FirstPackedIndex;
-    uint8_t NumProbes;
-    uint8_t NumDecals;
-    uint8_t NumLights;
-    uint8_t Pad0;
+    uint32_t NumProbes : 10;
+    uint32_t NumDecals : 11;
+    uint32_t NumLights : 11;
 };
 
 
@@ -1102,9 +1133,9 @@ Read indices in shader:
     uint packedIndex = (uint)(texelFetch( ItemList, Offset.X ).x);
 
 Unpack indices:
-    int LightIndex = packedIndex & 0x3ff;
+    int LightIndex = packedIndex & 0xfff;
     int DecalIndex = ( packedIndex >> 12 ) & 0x3ff;
-    int ProbeIndex = packedIndex >> 24;
+    int ProbeIndex = packedIndex >> 22;
 
 texture1d R32UI
 
@@ -1154,6 +1185,8 @@ struct SLightParameters
     int ShadowmapIndex;
 };
 
+static_assert( sizeof( SLightParameters ) * MAX_LIGHTS <= ( 64<<10 ), "Light buffer doesn't fit in 64 kB constant buffer block" );
+
 
 /**
 
@@ -1171,6 +1204,8 @@ struct SProbeParameters
     unsigned int Pad1;
 };
 
+static_assert( sizeof( SProbeParameters ) * MAX_PROBES <= ( 64<<10 ), "Probe buffer doesn't fit in 64 kB constant buffer block" );
+
 
 /**
 
@@ -1351,6 +1386,13 @@ struct SRenderView
     size_t ProbeStreamHandle;
     size_t ProbeStreamSize;
 
+    /** Cluster grid */
+    int NumClustersX;
+    int NumClustersY;
+    int NumClustersZ;
+    float ClusterSliceScale;
+    float ClusterSliceBias;
+
     /** Cluster headers */
     SClusterHeader * ClusterLookup;
     size_t ClusterLookupStreamHandle;
@@ -182,7 +182,7 @@ void BindSkeletonMotionBlur( size_t _Offset, size_t _Size )
     rtbl->BindBuffer( 7, GStreamBuffer, _Offset, _Size );
 }
 
-void BindInstanceConstants( SRenderInstance const * Instance )
+void BindInstanceConstants( SRenderInstance const * Instance, int InstanceCount )
 {
     size_t offset = GCircularBuffer->Allocate( sizeof( SInstanceConstantBuffer ) );
 
@@ -199,7 +199,15 @@ void BindInstanceConstants( SRenderInstance const * Instance )
     pConstantBuf->VTScale = Float2( 1.0f );//Instance->VTScale;
     pConstantBuf->VTUnit = 0;//Instance->VTUnit;
 
+    pConstantBuf->InstanceBatch = InstanceCount > 1;
+
     rtbl->BindBuffer( 1, GCircularBuffer->GetBuffer(), offset, sizeof( SInstanceConstantBuffer ) );
+
+    if ( InstanceCount > 1 ) {
+        AN_ASSERT( InstanceCount <= MAX_INSTANCE_BATCH );
+
+        rtbl->BindBuffer( 8, GStreamBuffer, Instance->InstanceTransformsStreamHandle, InstanceCount * sizeof( SInstanceTransform ) );
+    }
 }
 
 void BindInstanceConstantsFB( SRenderInstance const * Instance )
@@ -113,8 +113,10 @@ struct SViewConstantBuffer
     uint64_t PrefilteredMapSampler;
     uint64_t IrradianceMapSampler;
 
+    Float4 ClusterGrid;                   // NumClustersX, NumClustersY, SliceScale, SliceBias
+
     int32_t NumDirectionalLights;
-    int32_t Pad3;
+    int32_t NumClustersZ;
     int32_t Pad4;
     int32_t DebugMode;
 
@@ -138,11 +140,13 @@ struct SInstanceConstantBuffer
     Float2 VTOffset;
     Float2 VTScale;
     uint32_t VTUnit;
-    uint32_t Pad0;
+    uint32_t InstanceBatch;
     uint32_t Pad1;
     uint32_t Pad2;
 };
 
+static_assert( sizeof( SInstanceTransform ) * MAX_INSTANCE_BATCH <= ( 16<<10 ), "Instance transforms > 16 kB" );
+
 struct SFeedbackConstantBuffer
 {
     Float4x4 TransformMatrix; // Instance MVP
@@ -274,7 +278,9 @@ void BindSkeletonMotionBlur( size_t _Offset, size_t _Size );
 void BindTextures( RenderCore::IResourceTable * Rtbl, SMaterialFrameData * Instance, int MaxTextures );
 void BindTextures( SMaterialFrameData * Instance, int MaxTextures );
 
-void BindInstanceConstants( SRenderInstance const * Instance );
+/** Bind draw call constants. Pass Instance->InstanceCount as InstanceCount to draw merged instances
+with a pipeline that supports instance batching */
+void BindInstanceConstants( SRenderInstance const * Instance, int InstanceCount = 1 );
 
 void BindInstanceConstantsFB( SRenderInstance const * Instance );
 
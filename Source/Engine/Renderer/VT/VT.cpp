@@ -111,14 +111,17 @@ void SVirtualTextureFileHandle::Close() {
 void SVirtualTextureFileHandle::Read( void * Data, unsigned int Size, uint64_t Offset ) {
     DWORD numberOfBytesRead;
 
-    Seek( Offset );
+    // Pass offset with the request instead of seeking, so several stream threads can read the file at once
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = (DWORD)Offset;
+    overlapped.OffsetHigh = (DWORD)( Offset >> 32 );
 
     BOOL r = ReadFile(
         Handle,
         Data,
         Size,
         &numberOfBytesRead,
-        NULL
+        &overlapped
     );
 
     AN_ASSERT( r != FALSE );
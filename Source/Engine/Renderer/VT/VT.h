@@ -33,7 +33,7 @@ SOFTWARE.
 #include <Core/Public/IO.h>
 #include <Core/Public/BitMask.h>
 
-constexpr short     VT_FILE_VERSION                 = 5;
+constexpr short     VT_FILE_VERSION                 = 6;
 constexpr uint32_t  VT_FILE_ID                      = 'V' | ( 'T' << 8 ) | ( VT_FILE_VERSION << 16 );
 constexpr int       VT_PAGE_BORDER_WIDTH            = 4;
 constexpr int       VT_MAX_LODS                     = 13;
@@ -43,6 +43,15 @@ typedef size_t SFileOffset;
 
 using APageBitfield = TBitMask<>;
 
+enum EVirtualTexturePageCompression
+{
+    /** Pages are stored as is */
+    VT_PAGE_COMPRESSION_NONE,
+
+    /** Pages are compressed with FastLZ. Page that doesn't fit into its raw size is stored as is */
+    VT_PAGE_COMPRESSION_FASTLZ
+};
+
 enum EVirtualTexturePageFlags4bit
 {
     /** Page in cache */
@@ -39,6 +39,7 @@ AVirtualTexture::AVirtualTexture( const char * FileName, AVirtualTextureCache *
 {
     PIT = nullptr;
     pIndirectionData = nullptr;
+    PageTableId = 0;
     pCache = nullptr;
     NumLods = 0;
 
@@ -295,7 +296,11 @@ void AVirtualTexture::UpdateLRU( uint32_t AbsIndex )
     // NOTE: Assume that texture is registered in cache.
     // We don't check even validness of AbsIndex
     // Checks are disabled for performance issues
-    PendingUpdateLRU.Append( AbsIndex );
+    AN_ASSERT( PIT[AbsIndex] & PF_CACHED );
+
+    int physPageIndex = GetIndirectionData()[AbsIndex] & 0x0fff;
+
+    pCache->UpdateLRU( physPageIndex );
 }
 
 void AVirtualTexture::MakePageResident( uint32_t AbsIndex, int PhysPageIndex )
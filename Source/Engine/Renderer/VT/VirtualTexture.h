@@ -117,11 +117,8 @@ private:
     */
     byte * PIT;
 
-    // Used only by cache to update page LRU
-    TPodVector< uint32_t > PendingUpdateLRU;
-
-    // Used only from stream thread to mark streamed pages
-    std::unordered_map< uint32_t, int64_t > StreamedPages;
+    // Texture id in the cache page table
+    uint32_t PageTableId;
 
     AVirtualTextureCache * pCache;
 
@@ -34,32 +34,59 @@ SOFTWARE.
 #include <Runtime/Public/ScopedTimeCheck.h>
 #include <Runtime/Public/Runtime.h>
 
+ARuntimeVariable r_StreamThreadsVT( _CTS( "r_StreamThreadsVT" ), _CTS( "2" ), 0, _CTS( "Number of threads that read virtual texture pages" ) );
+ARuntimeVariable r_StreamBatchSizeVT( _CTS( "r_StreamBatchSizeVT" ), _CTS( "16" ), 0, _CTS( "Max pages fetched by stream thread at once" ) );
+ARuntimeVariable r_PrefetchBudgetVT( _CTS( "r_PrefetchBudgetVT" ), _CTS( "512" ), 0, _CTS( "Max kilobytes of prefetched pages requested per frame. 0 - disable prefetching" ) );
+ARuntimeVariable r_PrefetchLookaheadVT( _CTS( "r_PrefetchLookaheadVT" ), _CTS( "8" ), 0, _CTS( "How many frames ahead the prefetcher predicts the feedback motion" ) );
+ARuntimeVariable r_PrefetchHitWindowVT( _CTS( "r_PrefetchHitWindowVT" ), _CTS( "120" ), 0, _CTS( "Prefetched page is counted as a hit if it appears in feedback during this number of frames" ) );
+ARuntimeVariable r_PrefetchStatsVT( _CTS( "r_PrefetchStatsVT" ), _CTS( "0" ), 0, _CTS( "Print prefetch statistics" ) );
+ARuntimeVariable r_RecordFeedbackVT( _CTS( "r_RecordFeedbackVT" ), _CTS( "0" ), 0, _CTS( "Record feedback to vt_feedback.trace" ) );
+
 AVirtualTextureFeedbackAnalyzer::AVirtualTextureFeedbackAnalyzer()
     : SwapIndex( 0 )
     , Bindings( nullptr )
     , NumBindings( 0 )
+    , FrameIndex( 0 )
+    , PrefetchRequested( 0 )
+    , PrefetchHits( 0 )
+    , PrefetchMisses( 0 )
+    , PrefetchBytes( 0 )
     , QueueLoadPos( 0 )
+    , QueueLength( 0 )
     , bStopStreamThread( false )
 
 {
     Core::ZeroMem( Textures, sizeof( Textures ) );
     Core::ZeroMem( QuedPages, sizeof( QuedPages ) );
 
-    StreamThread.Routine = StreamThreadMain;
-    StreamThread.Data = this;
-    StreamThread.Start();
+    for ( SFeedbackMotion & motion : FeedbackMotion ) {
+        motion.Center = Float2( 0.0f );
+        motion.Velocity = Float2( 0.0f );
+        motion.Frame = -1;
+    }
+
+    NumStreamThreads = Math::Clamp( r_StreamThreadsVT.GetInteger(), 1, (int)MAX_STREAM_THREADS );
+
+    for ( int i = 0 ; i < NumStreamThreads ; i++ ) {
+        StreamThreads[i].Routine = StreamThreadMain;
+        StreamThreads[i].Data = this;
+        StreamThreads[i].Start();
+    }
 }
 
 AVirtualTextureFeedbackAnalyzer::~AVirtualTextureFeedbackAnalyzer()
 {
     bStopStreamThread.Store( true );
 
-    // Awake stream thread
+    // Awake stream threads. Each thread awakes the next one on exit.
     PageSubmitEvent.Signal();
 
-    StreamThreadStopped.Wait();
+    for ( int i = 0 ; i < NumStreamThreads ; i++ ) {
+        StreamThreads[i].Join();
+    }
 
     ClearQueue();
+    ReleaseSkippedPages();
 
     for ( int i = 0 ; i < VT_MAX_TEXTURE_UNITS ; i++ ) {
         for ( int j = 0 ; j < 2 ; j++ ) {
@@ -84,94 +111,146 @@ void AVirtualTextureFeedbackAnalyzer::WaitForNewPages()
 
 void AVirtualTextureFeedbackAnalyzer::StreamThreadMain()
 {
-    SPageDesc quedPage;
+    TPodVectorHeap< SPageRequest > requests;
+    TPodVectorHeap< byte > readBuffer;
+    TPodVectorHeap< byte > unpackBuffer;
 
     while ( !bStopStreamThread.Load() ) {
-        // Fetch page
-        {
-            AMutexGurad criticalSection( EnqueLock );
+        if ( !FetchPages( requests, Math::Clamp( r_StreamBatchSizeVT.GetInteger(), 1, (int)MAX_QUEUE_LENGTH ) ) ) {
+            // Reached end of queue
+            WaitForNewPages();
+            continue;
+        }
 
-            GLogger.Printf( "Fetch page\n" );
+        if ( requests.IsEmpty() ) {
+            // All fetched pages are already streaming
+            continue;
+        }
 
-            QueueLoadPos = QueueLoadPos & (MAX_QUEUE_LENGTH - 1);
-            quedPage = QuedPages[QueueLoadPos];
+        StreamPages( requests, readBuffer, unpackBuffer );
+    }
 
-            Core::ZeroMem( &QuedPages[QueueLoadPos], sizeof( SPageDesc ) );
+    // Awake next stream thread
+    PageSubmitEvent.Signal();
+}
 
-            QueueLoadPos++;
-        }
+bool AVirtualTextureFeedbackAnalyzer::FetchPages( TPodVectorHeap< SPageRequest > & Requests, int MaxRequests )
+{
+    Requests.Clear();
 
-        AVirtualTexture * pTexture = quedPage.pTexture;
+    {
+        AMutexGurad criticalSection( EnqueLock );
 
-        if ( !pTexture ) {
-            // Reached end of queue
-            GLogger.Printf( "WaitForNewPages\n" );
-            WaitForNewPages();
-            continue;
+        while ( QueueLoadPos < QueueLength && Requests.Size() < MaxRequests ) {
+            SPageDesc & quedPage = QuedPages[QueueLoadPos++];
+
+            SPageRequest & request = Requests.Append();
+            request.pTexture = quedPage.pTexture;
+            request.PageIndex = quedPage.PageIndex;
+
+            quedPage.pTexture = nullptr;
         }
 
-        //if ( pTexture->IsPendingRemove() ) {
-        //    pTexture->RemoveRef();
-        //    continue;
-        //}
+        if ( QueueLoadPos < QueueLength ) {
+            // Awake next stream thread to fetch remaining pages
+            PageSubmitEvent.Signal();
+        }
+    }
 
-        int64_t time = Core::SysMilliseconds();
+    if ( Requests.IsEmpty() ) {
+        return false;
+    }
 
-        // NOTE: We can't use THash now becouse our allocators are not support multithreading
-        // for better performance.
-        std::unordered_map< uint32_t, int64_t > & streamedPages = pTexture->StreamedPages;
-        auto it = streamedPages.find( quedPage.PageIndex );
-        if ( it != streamedPages.end() ) {
-            if ( it->second + 1000 < time ) {
-                GLogger.Printf( "Re-load page\n" );
-                it->second = time;
-            }
-            else {
-                // Page already loaded. Fetch next page
-                GLogger.Printf( "Page already loaded\n" );
+    // Page table is lock-free, so pages are checked outside of the queue lock
+    int64_t time = Core::SysMilliseconds();
+    int numSkipped = 0;
+
+    for ( int i = 0 ; i < Requests.Size() ; i++ ) {
+        SPageRequest & request = Requests[i];
+
+        AVirtualTexture * pTexture = request.pTexture;
+
+        // Page is re-loaded if it was not streamed in STREAM_TIMEOUT
+        if ( pTexture->pCache->GetPageTable().BeginStreaming( pTexture->PageTableId, request.PageIndex, time, STREAM_TIMEOUT ) ) {
+            request.PhysAddress = pTexture->GetPhysAddress( request.PageIndex, &request.StoredSize );
+            if ( request.PhysAddress ) {
                 continue;
             }
+            // Page is not stored
         }
-        else {
-            streamedPages[quedPage.PageIndex] = time;
+
+        // Page is already streaming or not stored. Move it to the beginning of the array.
+        std::swap( request, Requests[numSkipped] );
+        numSkipped++;
+    }
+
+    if ( numSkipped > 0 ) {
+        AMutexGurad criticalSection( EnqueLock );
+
+        // Texture reference is released by main thread
+        for ( int i = 0 ; i < numSkipped ; i++ ) {
+            SkippedPages.Append( Requests[i].pTexture );
         }
 
-        GLogger.Printf( "Load\n" );
+        Requests.Remove( 0, numSkipped );
+    }
+
+    // Sort by file offset to read adjacent pages at once. Pages in the batch have similar priority.
+    struct {
+        bool operator() ( SPageRequest const & a, SPageRequest const & b ) {
+            return a.pTexture < b.pTexture || ( a.pTexture == b.pTexture && a.PhysAddress < b.PhysAddress );
+        }
+    } SortByAddress;
+
+    std::sort( Requests.Begin(), Requests.End(), SortByAddress );
+
+    return true;
+}
+
+void AVirtualTextureFeedbackAnalyzer::StreamPages( TPodVectorHeap< SPageRequest > & Requests, TPodVectorHeap< byte > & ReadBuffer, TPodVectorHeap< byte > & UnpackBuffer )
+{
+    for ( int first = 0, last ; first < Requests.Size() ; first = last ) {
+        AVirtualTexture * pTexture = Requests[first].pTexture;
+
+        // Find pages that are stored one after another in the file
+        size_t readSize = Requests[first].StoredSize;
+        for ( last = first + 1 ; last < Requests.Size() ; last++ ) {
+            if ( Requests[last].pTexture != pTexture || Requests[last].PhysAddress != Requests[last - 1].PhysAddress + Requests[last - 1].StoredSize ) {
+                break;
+            }
+            readSize += Requests[last].StoredSize;
+        }
 
-        SFileOffset physAddress = pTexture->GetPhysAddress( quedPage.PageIndex );
+        ReadBuffer.ResizeInvalidate( readSize );
+        UnpackBuffer.ResizeInvalidate( pTexture->GetPageSizeInBytes() );
 
-        AN_ASSERT( physAddress != 0 );
+        pTexture->ReadPageData( Requests[first].PhysAddress, readSize, ReadBuffer.ToPtr() );
 
-        AVirtualTextureCache::SPageTransfer * transfer = pTexture->pCache->CreatePageTransfer();
+        byte const * storedData = ReadBuffer.ToPtr();
 
-        transfer->PageIndex = quedPage.PageIndex;
-        transfer->pTexture = quedPage.pTexture;
+        for ( int i = first ; i < last ; i++ ) {
+            SPageRequest const & request = Requests[i];
 
-        pTexture->ReadPage( physAddress, transfer->Layers );
+            AVirtualTextureCache::SPageTransfer * transfer = pTexture->pCache->CreatePageTransfer();
 
-        //int32_t pagePayLoad = GRuntime->SysMilliseconds() - time;
+            transfer->PageIndex = request.PageIndex;
+            transfer->pTexture = pTexture;
 
-        //GLogger.Printf( "pagePayLoad %d msec\n", pagePayLoad );
+            // Failed transfer still has to be passed to the cache: transfer slots are recycled in order on the main
+            // thread, which also clears the page table entry and releases the texture reference
+            transfer->bFailed = !pTexture->UnpackPage( storedData, request.StoredSize, transfer->Layers, UnpackBuffer.ToPtr() );
 
-        //GRuntime->WaitSeconds( 1 );
-        //GRuntime->WaitMilliseconds(500);
+            storedData += request.StoredSize;
 
-        pTexture->pCache->MakePageTransferVisible( transfer );
+            pTexture->pCache->MakePageTransferVisible( transfer );
+        }
     }
-
-    StreamThreadStopped.Signal();
 }
 
 void AVirtualTextureFeedbackAnalyzer::ClearQueue()
 {
-    for ( int i = 0 ; i < MAX_QUEUE_LENGTH ; i++ ) {
-        int p = ( QueueLoadPos + i ) & ( MAX_QUEUE_LENGTH - 1 );
-        SPageDesc * quedPage = &QuedPages[p];
-
-        if ( !quedPage->pTexture ) {
-            // end of queue
-            break;
-        }
+    for ( int i = QueueLoadPos ; i < QueueLength ; i++ ) {
+        SPageDesc * quedPage = &QuedPages[i];
 
         // Remove outdated page from queue
         quedPage->pTexture->RemoveRef();
@@ -179,15 +258,25 @@ void AVirtualTextureFeedbackAnalyzer::ClearQueue()
     }
 
     QueueLoadPos = 0;
+    QueueLength = 0;
+}
+
+void AVirtualTextureFeedbackAnalyzer::ReleaseSkippedPages()
+{
+    for ( AVirtualTexture * pTexture : SkippedPages ) {
+        pTexture->RemoveRef();
+    }
+    SkippedPages.Clear();
 }
 
 void AVirtualTextureFeedbackAnalyzer::SubmitPages( TPodVector< SPageDesc > const & Pages )
 {
-    AN_ASSERT( Pages.Size() < MAX_QUEUE_LENGTH );
+    AN_ASSERT( Pages.Size() <= MAX_QUEUE_LENGTH );
 
     AMutexGurad criticalSection( EnqueLock );
 
     ClearQueue();
+    ReleaseSkippedPages();
 
     // Refresh queue
     Core::Memcpy( QuedPages, Pages.ToPtr(), Pages.Size() * sizeof( QuedPages[0] ) );
@@ -195,6 +284,7 @@ void AVirtualTextureFeedbackAnalyzer::SubmitPages( TPodVector< SPageDesc > const
         SPageDesc * quedPage = &QuedPages[i];
         quedPage->pTexture->AddRef();
     }
+    QueueLength = Pages.Size();
 
     if ( Pages.Size() > 0 ) {
         PageSubmitEvent.Signal();
@@ -246,8 +336,19 @@ void AVirtualTextureFeedbackAnalyzer::End()
 {
     SwapIndex = (SwapIndex + 1) & 1;
 
+    FrameIndex++;
+
+    if ( r_RecordFeedbackVT ) {
+        RecordFeedbackTrace();
+    }
+    else if ( FeedbackTrace.IsOpened() ) {
+        FeedbackTrace.Close();
+    }
+
     DecodePages();
 
+    PrefetchPages();
+
     SubmitPages( PendingPages );
 
     Feedbacks.Clear();
@@ -264,11 +365,15 @@ void AVirtualTextureFeedbackAnalyzer::DecodePages()
     //#define WITH_PENDING_FLAG
 
     PendingPages.Clear();
+    VisiblePages.Clear();
+    VisiblePagesHash.Clear();
 #if 1
     if ( NumBindings == 0 ) {
         return;
     }
 
+    bool bCollectVisiblePages = r_PrefetchBudgetVT.GetInteger() > 0 || r_PrefetchStatsVT;
+
     AVirtualTexture **pTextureBindings = Textures[SwapIndex];
 
     AScopedTimeCheck timecheck("AVirtualTextureFeedbackAnalyzer::DecodePage");
@@ -335,6 +440,29 @@ void AVirtualTextureFeedbackAnalyzer::DecodePages()
                 lod = maxLod;
             }
 
+            if ( bCollectVisiblePages ) {
+                uint32_t visibleHash = QuadTreeGetRelativeFromXY( x, y, lod ) ^ ( lod << 24 ) ^ ( unit << 28 ) ^ ( unit >> 4 );
+                int v = VisiblePagesHash.First( visibleHash );
+                for ( ; v != -1 ; v = VisiblePagesHash.Next( v ) ) {
+                    SVisiblePage const & page = VisiblePages[v];
+                    if ( page.X == x && page.Y == y && page.Lod == lod && page.Unit == unit ) {
+                        VisiblePages[v].Refs += refs;
+                        break;
+                    }
+                }
+                if ( v == -1 ) {
+                    SVisiblePage & page = VisiblePages.Append();
+                    page.Hash = visibleHash;
+                    page.Refs = refs;
+                    page.X = x;
+                    page.Y = y;
+                    page.Lod = lod;
+                    page.Unit = unit;
+
+                    VisiblePagesHash.Insert( visibleHash, VisiblePages.Size() - 1 );
+                }
+            }
+
             byte * pageInfo = &pTexture->PIT[absIndex];
 
             if ( *pageInfo & PF_CACHED ) {
@@ -410,7 +538,7 @@ void AVirtualTextureFeedbackAnalyzer::DecodePages()
                 pageDesc.Hash = hash;
                 pageDesc.Refs = refs;
                 pageDesc.PageIndex = absIndex;
-                //pageDesc.Lod = lod;
+                pageDesc.Lod = lod;
 
                 PendingPagesHash.Insert( hash, PendingPages.Size() - 1 );
             }
@@ -430,13 +558,24 @@ void AVirtualTextureFeedbackAnalyzer::DecodePages()
         }
         #endif
 
+        // Don't waste queue for pages that are already streaming
+        int64_t time = Core::SysMilliseconds();
+        for ( int i = PendingPages.Size() - 1 ; i >= 0 ; i-- ) {
+            AVirtualTexture * pTexture = PendingPages[i].pTexture;
+            if ( pTexture->pCache->GetPageTable().IsStreaming( pTexture->PageTableId, PendingPages[i].PageIndex, time, STREAM_TIMEOUT ) ) {
+                PendingPages.RemoveSwap( i );
+            }
+        }
+
+        // Coarse pages go first: finer pages can't be shown until their parent is in cache.
+        // Pages with the same lod are sorted by screen coverage.
         struct {
             bool operator() ( SPageDesc const & a, SPageDesc const & b ) {
-                return a.Refs > b.Refs;
+                return a.Lod < b.Lod || ( a.Lod == b.Lod && a.Refs > b.Refs );
             }
-        } SortByRefs;
+        } SortByPriority;
 
-        std::sort( PendingPages.Begin(), PendingPages.End(), SortByRefs );
+        std::sort( PendingPages.Begin(), PendingPages.End(), SortByPriority );
 
         const int MAX_PENDING_PAGES = 100; // TODO: Set from console variable
 
@@ -446,6 +585,251 @@ void AVirtualTextureFeedbackAnalyzer::DecodePages()
 #endif
 }
 
+void AVirtualTextureFeedbackAnalyzer::PrefetchPages()
+{
+    UpdatePrefetchStats();
+
+    UpdateFeedbackMotion();
+
+    size_t budget = (size_t)Math::Max( r_PrefetchBudgetVT.GetInteger(), 0 ) << 10;
+    if ( !budget || VisiblePages.IsEmpty() ) {
+        return;
+    }
+
+    PrefetchCandidates.Clear();
+    PrefetchHash.Clear();
+
+    // Pages from feedback are already requested
+    for ( int i = 0 ; i < PendingPages.Size() ; i++ ) {
+        SPrefetchPage & candidate = PrefetchCandidates.Append();
+        candidate.pTexture = PendingPages[i].pTexture;
+        candidate.PageIndex = PendingPages[i].PageIndex;
+        candidate.Lod = PendingPages[i].Lod;
+        candidate.Unit = 0;
+        candidate.Score = -1;
+
+        PrefetchHash.Insert( candidate.PageIndex, i );
+    }
+
+    int firstCandidate = PrefetchCandidates.Size();
+
+    float lookahead = Math::Max( r_PrefetchLookaheadVT.GetFloat(), 0.0f );
+
+    for ( SVisiblePage const & page : VisiblePages ) {
+        AN_ASSERT( Textures[SwapIndex][page.Unit] );
+
+        // Expected feedback motion in pages of the page lod
+        Float2 shift = FeedbackMotion[page.Unit].Velocity * ( lookahead * ( 1 << page.Lod ) );
+        float shiftLength = shift.Length();
+        Float2 shiftDir = shiftLength > 0.001f ? shift / shiftLength : Float2( 0.0f );
+        float motionFactor = Math::Min( shiftLength, 1.0f );
+
+        // Quadtree neighbourhood. Neighbours along the motion direction are more likely to be visible.
+        for ( int dy = -1 ; dy <= 1 ; dy++ ) {
+            for ( int dx = -1 ; dx <= 1 ; dx++ ) {
+                if ( dx == 0 && dy == 0 ) {
+                    continue;
+                }
+                float w = Math::Dot( Float2( dx, dy ).Normalized(), shiftDir ) * motionFactor;
+                float score = page.Refs * Math::Max( 1.0f + 3.0f * w, 0.1f );
+                AddPrefetchCandidate( page.Unit, page.X + dx, page.Y + dy, page.Lod, score );
+            }
+        }
+
+        // Page where the visible page is expected to be after the lookahead
+        if ( shiftLength >= 1.0f ) {
+            AddPrefetchCandidate( page.Unit, page.X + Math::Round( shift.X ), page.Y + Math::Round( shift.Y ), page.Lod, page.Refs * 4.0f );
+        }
+    }
+
+    struct {
+        bool operator() ( SPrefetchPage const & a, SPrefetchPage const & b ) {
+            return a.Score > b.Score;
+        }
+    } SortByScore;
+
+    std::sort( PrefetchCandidates.Begin() + firstCandidate, PrefetchCandidates.End(), SortByScore );
+
+    size_t prefetchSize = 0;
+
+    int64_t time = Core::SysMilliseconds();
+
+    for ( int i = firstCandidate ; i < PrefetchCandidates.Size() && PendingPages.Size() < MAX_QUEUE_LENGTH ; i++ ) {
+        SPrefetchPage const & candidate = PrefetchCandidates[i];
+
+        if ( candidate.pTexture->pCache->GetPageTable().IsStreaming( candidate.pTexture->PageTableId, candidate.PageIndex, time, STREAM_TIMEOUT ) ) {
+            continue;
+        }
+
+        size_t storedSize;
+        if ( !candidate.pTexture->GetPhysAddress( candidate.PageIndex, &storedSize ) ) {
+            continue;
+        }
+
+        if ( prefetchSize + storedSize > budget ) {
+            break;
+        }
+
+        prefetchSize += storedSize;
+
+        SPageDesc & pageDesc = PendingPages.Append();
+        pageDesc.pTexture = candidate.pTexture;
+        pageDesc.Hash = 0;
+        pageDesc.Refs = 0;
+        pageDesc.PageIndex = candidate.PageIndex;
+        pageDesc.Lod = candidate.Lod;
+
+        uint64_t key = ( (uint64_t)candidate.Unit << 32 ) | candidate.PageIndex;
+        if ( PrefetchedPages.find( key ) == PrefetchedPages.end() ) {
+            PrefetchedPages[key] = FrameIndex;
+            PrefetchRequested++;
+        }
+    }
+
+    PrefetchBytes += prefetchSize;
+}
+
+void AVirtualTextureFeedbackAnalyzer::AddPrefetchCandidate( int Unit, int X, int Y, int Lod, float Score )
+{
+    if ( X < 0 || Y < 0 || X >= ( 1 << Lod ) || Y >= ( 1 << Lod ) ) {
+        return;
+    }
+
+    AVirtualTexture * pTexture = Textures[SwapIndex][Unit];
+
+    uint32_t relIndex = QuadTreeGetRelativeFromXY( X, Y, Lod );
+    uint32_t absIndex = QuadTreeRelativeToAbsoluteIndex( relIndex, Lod );
+
+    // Correct mip level
+    int maxLod = pTexture->PIT[absIndex] >> 4;
+    if ( maxLod < Lod ) {
+        int diff = Lod - maxLod;
+        Lod = maxLod;
+        relIndex = QuadTreeGetRelativeFromXY( X >> diff, Y >> diff, Lod );
+        absIndex = QuadTreeRelativeToAbsoluteIndex( relIndex, Lod );
+    }
+
+    if ( pTexture->PIT[absIndex] & PF_CACHED ) {
+        return;
+    }
+
+    // Parent must be loaded first
+    while ( Lod > 0 ) {
+        unsigned int parentAbsolute = QuadTreeGetParentFromRelative( relIndex, Lod );
+        if ( pTexture->PIT[parentAbsolute] & PF_CACHED ) {
+            break;
+        }
+        --Lod;
+        absIndex = parentAbsolute;
+        relIndex = QuadTreeAbsoluteToRelativeIndex( parentAbsolute, Lod );
+    }
+
+    for ( int i = PrefetchHash.First( absIndex ) ; i != -1 ; i = PrefetchHash.Next( i ) ) {
+        SPrefetchPage & candidate = PrefetchCandidates[i];
+        if ( candidate.PageIndex == absIndex && candidate.pTexture == pTexture ) {
+            if ( candidate.Score >= 0 ) {
+                candidate.Score += Score;
+            }
+            return;
+        }
+    }
+
+    SPrefetchPage & candidate = PrefetchCandidates.Append();
+    candidate.pTexture = pTexture;
+    candidate.PageIndex = absIndex;
+    candidate.Lod = Lod;
+    candidate.Unit = Unit;
+    candidate.Score = Score;
+
+    PrefetchHash.Insert( absIndex, PrefetchCandidates.Size() - 1 );
+}
+
+void AVirtualTextureFeedbackAnalyzer::UpdateFeedbackMotion()
+{
+    float sum[VT_MAX_TEXTURE_UNITS][3];
+
+    Core::ZeroMem( sum, sizeof( sum ) );
+
+    for ( SVisiblePage const & page : VisiblePages ) {
+        float scale = 1.0f / ( 1 << page.Lod );
+        sum[page.Unit][0] += ( page.X + 0.5f ) * scale * page.Refs;
+        sum[page.Unit][1] += ( page.Y + 0.5f ) * scale * page.Refs;
+        sum[page.Unit][2] += page.Refs;
+    }
+
+    for ( int unit = 0 ; unit < VT_MAX_TEXTURE_UNITS ; unit++ ) {
+        if ( sum[unit][2] <= 0.0f ) {
+            continue;
+        }
+
+        SFeedbackMotion & motion = FeedbackMotion[unit];
+
+        Float2 center( sum[unit][0] / sum[unit][2], sum[unit][1] / sum[unit][2] );
+
+        if ( motion.Frame == FrameIndex - 1 ) {
+            // Smooth velocity to reduce jumps when surfaces appear or disappear
+            motion.Velocity = Math::Lerp( motion.Velocity, center - motion.Center, 0.5f );
+        }
+        else {
+            motion.Velocity = Float2( 0.0f );
+        }
+
+        motion.Center = center;
+        motion.Frame = FrameIndex;
+    }
+}
+
+void AVirtualTextureFeedbackAnalyzer::UpdatePrefetchStats()
+{
+    if ( !PrefetchedPages.empty() ) {
+        // Prefetched page that appears in feedback is a hit
+        for ( SVisiblePage const & page : VisiblePages ) {
+            uint32_t absIndex = QuadTreeRelativeToAbsoluteIndex( QuadTreeGetRelativeFromXY( page.X, page.Y, page.Lod ), page.Lod );
+            auto it = PrefetchedPages.find( ( (uint64_t)page.Unit << 32 ) | absIndex );
+            if ( it != PrefetchedPages.end() ) {
+                PrefetchedPages.erase( it );
+                PrefetchHits++;
+            }
+        }
+
+        // Prefetched page that doesn't appear in feedback during the hit window is a miss
+        int64_t hitWindow = Math::Max( r_PrefetchHitWindowVT.GetInteger(), 1 );
+        for ( auto it = PrefetchedPages.begin() ; it != PrefetchedPages.end() ; ) {
+            if ( it->second + hitWindow < FrameIndex ) {
+                it = PrefetchedPages.erase( it );
+                PrefetchMisses++;
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    if ( r_PrefetchStatsVT && ( FrameIndex % 60 ) == 0 ) {
+        int total = PrefetchHits + PrefetchMisses;
+        GLogger.Printf( "VT prefetch: requested %d pages (%d KB), hits %d, misses %d, hit rate %.1f%%\n",
+                        PrefetchRequested, (int)( PrefetchBytes >> 10 ), PrefetchHits, PrefetchMisses,
+                        total > 0 ? 100.0f * PrefetchHits / total : 0.0f );
+    }
+}
+
+void AVirtualTextureFeedbackAnalyzer::RecordFeedbackTrace()
+{
+    if ( !FeedbackTrace.IsOpened() && !FeedbackTrace.OpenWrite( "vt_feedback.trace" ) ) {
+        GLogger.Printf( "AVirtualTextureFeedbackAnalyzer::RecordFeedbackTrace: couldn't open vt_feedback.trace\n" );
+        r_RecordFeedbackVT.ForceInteger( 0 );
+        return;
+    }
+
+    // Frame: frame index, number of chains, chains (size in texels, RGBA8 texels)
+    FeedbackTrace.WriteUInt64( FrameIndex );
+    FeedbackTrace.WriteUInt32( Feedbacks.Size() );
+    for ( SFeedbackChain const & feedback : Feedbacks ) {
+        FeedbackTrace.WriteUInt32( feedback.Size );
+        FeedbackTrace.WriteBuffer( feedback.Data, feedback.Size * sizeof( SFeedbackData ) );
+    }
+}
+
 void AVirtualTextureFeedbackAnalyzer::AddFeedbackData( int FeedbackSize, const void * FeedbackData )
 {
     SFeedbackChain & feedback = Feedbacks.Append();
@@ -33,6 +33,7 @@ SOFTWARE.
 #include "VirtualTexture.h"
 
 #include <Core/Public/PodVector.h>
+#include <Core/Public/IO.h>
 
 constexpr int VT_MAX_TEXTURE_UNITS = 256;
 
@@ -56,7 +57,7 @@ struct SPageDesc
     uint32_t Hash;
     uint32_t Refs;
     uint32_t PageIndex;
-    //uint8_t  Lod;
+    uint8_t  Lod;
 };
 
 struct SVirtualTextureUnit
@@ -86,9 +87,34 @@ public:
 
 private:
     void DecodePages();
+
+    /** Request pages that are likely to be visible soon. Prefetched pages are queued after pages from feedback */
+    void PrefetchPages();
+    void UpdatePrefetchStats();
+    void UpdateFeedbackMotion();
+    void AddPrefetchCandidate( int Unit, int X, int Y, int Lod, float Score );
+    void RecordFeedbackTrace();
+
     void ClearQueue();
+    void ReleaseSkippedPages();
     void SubmitPages( TPodVector< SPageDesc > const & Pages );
     void WaitForNewPages();
+
+    struct SPageRequest
+    {
+        AVirtualTexture * pTexture;
+        uint32_t PageIndex;
+        SFileOffset PhysAddress;
+        size_t StoredSize;
+    };
+
+    /** Fetch next pages from the queue and skip pages that are already streaming. Called by stream threads.
+    Returns false if the queue is empty */
+    bool FetchPages( TPodVectorHeap< SPageRequest > & Requests, int MaxRequests );
+
+    /** Read and decompress pages and pass them to the cache. Called by stream threads */
+    void StreamPages( TPodVectorHeap< SPageRequest > & Requests, TPodVectorHeap< byte > & ReadBuffer, TPodVectorHeap< byte > & UnpackBuffer );
+
     void StreamThreadMain();
     static void StreamThreadMain( void * pData );
 
@@ -107,14 +133,66 @@ private:
     TPodVector< SPageDesc > PendingPages;
     THash<> PendingPagesHash;
 
-    // Page queue for async loading
+    // Unique pages seen in feedback, cached or not. Used for prefetching
+    struct SVisiblePage
+    {
+        uint32_t Hash;
+        uint32_t Refs;
+        uint16_t X;
+        uint16_t Y;
+        uint8_t  Lod;
+        uint8_t  Unit;
+    };
+    TPodVector< SVisiblePage > VisiblePages;
+    THash<> VisiblePagesHash;
+
+    struct SPrefetchPage
+    {
+        AVirtualTexture * pTexture;
+        uint32_t PageIndex;
+        uint8_t  Lod;
+        uint8_t  Unit;
+        float    Score;
+    };
+    TPodVector< SPrefetchPage > PrefetchCandidates;
+    THash<> PrefetchHash;
+
+    // Motion of the feedback in texture space. This is the camera motion as the texture sees it.
+    struct SFeedbackMotion
+    {
+        Float2 Center;
+        Float2 Velocity;
+        int64_t Frame;
+    };
+    SFeedbackMotion FeedbackMotion[VT_MAX_TEXTURE_UNITS];
+
+    // Prefetched pages and frame of request. Used to measure prefetch hit rate
+    std::unordered_map< uint64_t, int64_t > PrefetchedPages;
+    int64_t FrameIndex;
+    int PrefetchRequested;
+    int PrefetchHits;
+    int PrefetchMisses;
+    size_t PrefetchBytes;
+
+    AFileStream FeedbackTrace;
+
+    // Page queue for async loading. Sorted by priority
     enum { MAX_QUEUE_LENGTH = 256 };
+
+    // Page that was not streamed in this time (milliseconds) is requested again
+    enum { STREAM_TIMEOUT = 1000 };
     SPageDesc QuedPages[MAX_QUEUE_LENGTH];
     int QueueLoadPos; // pointer to a page that will be loaded first
+    int QueueLength;
+
+    // Pages that were fetched but not streamed. Stream threads can't release the texture
+    // reference (reference counter is not atomic), so it is released from the main thread.
+    TPodVectorHeap< AVirtualTexture * > SkippedPages;
 
-    AThread StreamThread;
+    enum { MAX_STREAM_THREADS = 8 };
+    AThread StreamThreads[MAX_STREAM_THREADS];
+    int NumStreamThreads;
     AMutex EnqueLock;
     ASyncEvent PageSubmitEvent;
-    ASyncEvent StreamThreadStopped;
     AAtomicBool bStopStreamThread;
 };
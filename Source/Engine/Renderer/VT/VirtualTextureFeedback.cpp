@@ -252,6 +252,7 @@ void AVirtualTextureFeedback::AddPass( AFrameGraph & FrameGraph )
         // NOTE:
         // 1. Meshes with one material and same virtual texture can be batched to one mesh/drawcall
         // 2. We can draw geometry only with virtual texturing
+        // 3. Merged instances are drawn one by one here: the feedback pipeline doesn't fetch instance transforms
 
         for ( int i = 0 ; i < GRenderView->InstanceCount ; i++ ) {
             SRenderInstance const * instance = GFrameData->Instances[GRenderView->FirstInstance + i];
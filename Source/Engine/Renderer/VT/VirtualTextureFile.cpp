@@ -33,6 +33,7 @@ SOFTWARE.
 
 #include <Core/Public/CoreMath.h>
 #include <Core/Public/Logger.h>
+#include <Core/Public/Compress.h>
 
 AVirtualTextureFile::AVirtualTextureFile( const char * FileName )
 {
@@ -41,6 +42,7 @@ AVirtualTextureFile::AVirtualTextureFile( const char * FileName )
     byte tmp;
 
     FileHeaderSize = 0;
+    PageCompression = VT_PAGE_COMPRESSION_NONE;
     TextureResolution = 0;
     TextureResolutionLog2 = 0;
 
@@ -94,8 +96,30 @@ AVirtualTextureFile::AVirtualTextureFile( const char * FileName )
     // read page address tables
     fileOffset += AddressTable.Read( &FileHandle, fileOffset );
 
+    // read page compression
+    FileHandle.Read( &tmp, sizeof( byte ), fileOffset );
+    fileOffset += sizeof( byte );
+
+    PageCompression = tmp;
+
+    // read num stored pages
+    uint32_t numStoredPages;
+    FileHandle.Read( &numStoredPages, sizeof( numStoredPages ), fileOffset );
+    fileOffset += sizeof( numStoredPages );
+
+    // read page offsets
+    TPodVectorHeap< uint64_t > pageOffsets;
+    pageOffsets.ResizeInvalidate( numStoredPages + 1 );
+    FileHandle.Read( pageOffsets.ToPtr(), sizeof( uint64_t ) * pageOffsets.Size(), fileOffset );
+    fileOffset += sizeof( uint64_t ) * pageOffsets.Size();
+
     FileHeaderSize = fileOffset;
 
+    PageOffsets.ResizeInvalidate( pageOffsets.Size() );
+    for ( int i = 0 ; i < pageOffsets.Size() ; i++ ) {
+        PageOffsets[i] = pageOffsets[i] + FileHeaderSize;
+    }
+
     TextureResolution = (1u << (AddressTable.NumLods - 1)) * PageResolutionB;
     TextureResolutionLog2 = Math::Log2( TextureResolution );
 }
@@ -104,7 +128,7 @@ AVirtualTextureFile::~AVirtualTextureFile()
 {
 }
 
-SFileOffset AVirtualTextureFile::GetPhysAddress( unsigned int _PageIndex ) const
+SFileOffset AVirtualTextureFile::GetPhysAddress( unsigned int _PageIndex, size_t * pStoredSize ) const
 {
     SFileOffset physAddr;
     int pageLod = QuadTreeCalcLod64( _PageIndex );
@@ -122,33 +146,56 @@ SFileOffset AVirtualTextureFile::GetPhysAddress( unsigned int _PageIndex ) const
         unsigned int addrTableIndex = QuadTreeRelativeToAbsoluteIndex( QuadTreeGetRelativeFromXY( x>>4, y>>4, addrTableLod ), addrTableLod );
         physAddr = AddressTable.Table[addrTableIndex] + AddressTable.ByteOffsets[_PageIndex];
     }
-    return physAddr * PageSizeInBytes + FileHeaderSize;
+    if ( physAddr + 1 >= PageOffsets.Size() ) {
+        return 0;
+    }
+    if ( pStoredSize ) {
+        *pStoredSize = PageOffsets[physAddr + 1] - PageOffsets[physAddr];
+    }
+    return PageOffsets[physAddr];
 }
 
-SFileOffset AVirtualTextureFile::ReadPage( SFileOffset PhysAddress, byte * PageData, int Layer ) const
+void AVirtualTextureFile::ReadPageData( SFileOffset PhysAddress, size_t SizeInBytes, byte * Buffer ) const
 {
     if ( FileHandle.IsInvalid() ) {
-        return PhysAddress;
-    }
-    PhysAddress += Layers[Layer].Offset;
-    if ( PageData ) {
-        FileHandle.Read( PageData, Layers[Layer].SizeInBytes, PhysAddress );
+        return;
     }
-    return PhysAddress;
+    FileHandle.Read( Buffer, SizeInBytes, PhysAddress );
 }
 
-SFileOffset AVirtualTextureFile::ReadPage( SFileOffset PhysAddress, byte * PageData[] ) const
+bool AVirtualTextureFile::UnpackPage( byte const * StoredData, size_t StoredSize, byte * PageData[], byte * Scratch ) const
 {
-    if ( FileHandle.IsInvalid() ) {
-        return PhysAddress;
+    // Page that couldn't be compressed is stored as is
+    if ( PageCompression == VT_PAGE_COMPRESSION_NONE || StoredSize == PageSizeInBytes ) {
+        CopyPageLayers( StoredData, PageData );
+        return true;
+    }
+
+    AN_ASSERT( PageCompression == VT_PAGE_COMPRESSION_FASTLZ );
+
+    // Single layer is decompressed in place
+    byte * pageData = ( Layers.Size() == 1 && PageData[0] ) ? PageData[0] : Scratch;
+    size_t pageSize;
+
+    if ( !Core::FastLZDecompress( StoredData, StoredSize, pageData, &pageSize, PageSizeInBytes ) || pageSize != PageSizeInBytes ) {
+        GLogger.Printf( "AVirtualTextureFile::UnpackPage: couldn't decompress page\n" );
+        return false;
     }
+
+    if ( pageData == Scratch ) {
+        CopyPageLayers( Scratch, PageData );
+    }
+    return true;
+}
+
+void AVirtualTextureFile::CopyPageLayers( byte const * Buffer, byte * PageData[] ) const
+{
     for ( int Layer = 0 ; Layer < Layers.Size() ; Layer++ ) {
         if ( PageData[Layer] ) {
-            FileHandle.Read( PageData[Layer], Layers[Layer].SizeInBytes, PhysAddress );
+            Core::Memcpy( PageData[Layer], Buffer, Layers[Layer].SizeInBytes );
         }
-        PhysAddress += Layers[Layer].SizeInBytes;
+        Buffer += Layers[Layer].SizeInBytes;
     }
-    return PhysAddress;
 }
 
 #if 0
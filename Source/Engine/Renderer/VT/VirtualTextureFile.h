@@ -53,16 +53,23 @@ public:
 
     int GetNumLayers() const { return Layers.Size(); }
 
-    /** Read page from file. Can be used from stream thread */
-    SFileOffset ReadPage( uint64_t PhysAddress, byte * PageData, int LayerIndex ) const;
+    /** Page compression, see EVirtualTexturePageCompression */
+    int GetPageCompression() const { return PageCompression; }
 
-    /** Read page from file. Can be used from stream thread */
-    SFileOffset ReadPage( uint64_t PhysAddress, byte * PageData[] ) const;
+    /** Read page data as it stored in file. Pages stored one after another can be read with a single request.
+    Can be used from stream thread */
+    void ReadPageData( SFileOffset PhysAddress, size_t SizeInBytes, byte * Buffer ) const;
 
-    /** Read page physical address. Can be used from stream thread */
-    SFileOffset GetPhysAddress( uint32_t PageIndex ) const;
+    /** Decompress page data read by ReadPageData and copy its layers. Scratch must have GetPageSizeInBytes() bytes.
+    Can be used from stream thread */
+    bool UnpackPage( byte const * StoredData, size_t StoredSize, byte * PageData[], byte * Scratch ) const;
+
+    /** Read page physical address and size of page data in file. Can be used from stream thread */
+    SFileOffset GetPhysAddress( uint32_t PageIndex, size_t * pStoredSize = nullptr ) const;
 
 protected:
+    void CopyPageLayers( byte const * Buffer, byte * PageData[] ) const;
+
     mutable SVirtualTextureFileHandle FileHandle;
     SFileOffset FileHeaderSize;
     int PageResolutionB;
@@ -79,6 +86,12 @@ protected:
     TPodVector< SLayer > Layers;
     size_t PageSizeInBytes; // PageSizeInBytes = Layer[0].SizeInBytes + Layer[1].SizeInBytes + ... + Layer[Layers.size()-1].SizeInBytes
 
+    /** Page compression, see EVirtualTexturePageCompression */
+    int PageCompression;
+
+    /** File offsets of stored pages. Size of page data is the difference between two neighbouring offsets */
+    TPodVectorHeap< SFileOffset > PageOffsets;
+
     /** Resolution of virtual texture in pixels */
     uint32_t TextureResolution;
 
@@ -0,0 +1,185 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "VirtualTexturePageTable.h"
+#include "VT.h"
+
+#include <Core/Public/BaseMath.h>
+
+static_assert( VT_MAX_LODS <= 13, "Page index must fit to 25 bits" );
+
+AVirtualTexturePageTable::AVirtualTexturePageTable()
+    : Slots( nullptr )
+    , Mask( 0 )
+{
+}
+
+AVirtualTexturePageTable::~AVirtualTexturePageTable()
+{
+    delete [] Slots;
+}
+
+void AVirtualTexturePageTable::Initialize( int Capacity )
+{
+    AN_ASSERT( Capacity >= MAX_PROBES );
+
+    delete [] Slots;
+
+    Capacity = Math::ToGreaterPowerOfTwo( Capacity );
+
+    Slots = new TAtomic< uint64_t >[Capacity];
+    Mask = Capacity - 1;
+
+    Clear();
+}
+
+bool AVirtualTexturePageTable::IsStreaming( uint32_t TextureId, uint32_t PageIndex, int64_t Time, int Timeout ) const
+{
+    const uint64_t key = MakeKey( TextureId, PageIndex );
+    const uint32_t home = Hash( key );
+
+    for ( int probe = 0 ; probe < MAX_PROBES ; probe++ ) {
+        uint64_t value = Slots[( home + probe ) & Mask].Load();
+
+        if ( value && ( value >> TIME_BITS ) == key ) {
+            return GetAge( value, Time ) < (uint32_t)Timeout;
+        }
+    }
+
+    return false;
+}
+
+bool AVirtualTexturePageTable::BeginStreaming( uint32_t TextureId, uint32_t PageIndex, int64_t Time, int Timeout )
+{
+    const uint64_t key = MakeKey( TextureId, PageIndex );
+    const uint64_t newValue = ( key << TIME_BITS ) | ( uint64_t( Time ) & TIME_MASK );
+    const uint32_t home = Hash( key );
+
+    for ( ;; ) {
+        uint32_t emptySlot = ~0u;
+        uint32_t oldestSlot = 0;
+        uint64_t oldestValue = 0;
+        uint32_t oldestAge = 0;
+        bool bFound = false;
+
+        for ( int probe = 0 ; probe < MAX_PROBES ; probe++ ) {
+            uint32_t slot = ( home + probe ) & Mask;
+            uint64_t value = Slots[slot].Load();
+
+            if ( !value ) {
+                if ( emptySlot == ~0u ) {
+                    emptySlot = slot;
+                }
+                continue;
+            }
+
+            uint32_t age = GetAge( value, Time );
+
+            if ( ( value >> TIME_BITS ) == key ) {
+                if ( age < (uint32_t)Timeout ) {
+                    // Page is already streaming
+                    return false;
+                }
+
+                // Page was requested long ago and was not streamed. Request it again.
+                if ( Slots[slot].CompareExchangeStrong( value, newValue ) ) {
+                    return true;
+                }
+
+                bFound = true;
+                break;
+            }
+
+            if ( age >= oldestAge ) {
+                oldestAge = age;
+                oldestSlot = slot;
+                oldestValue = value;
+            }
+        }
+
+        if ( bFound ) {
+            // Slot was changed by other thread, try again
+            continue;
+        }
+
+        if ( emptySlot != ~0u ) {
+            uint64_t expected = 0;
+            if ( Slots[emptySlot].CompareExchangeStrong( expected, newValue ) ) {
+                return true;
+            }
+        } else {
+            // Window is full, replace the oldest page
+            if ( Slots[oldestSlot].CompareExchangeStrong( oldestValue, newValue ) ) {
+                return true;
+            }
+        }
+    }
+}
+
+void AVirtualTexturePageTable::Remove( uint32_t TextureId, uint32_t PageIndex )
+{
+    const uint64_t key = MakeKey( TextureId, PageIndex );
+    const uint32_t home = Hash( key );
+
+    for ( int probe = 0 ; probe < MAX_PROBES ; probe++ ) {
+        TAtomic< uint64_t > & slot = Slots[( home + probe ) & Mask];
+
+        uint64_t value = slot.Load();
+
+        // Retry while the slot holds the key: the time may be updated concurrently
+        while ( value && ( value >> TIME_BITS ) == key ) {
+            if ( slot.CompareExchangeStrong( value, 0 ) ) {
+                return;
+            }
+        }
+    }
+}
+
+void AVirtualTexturePageTable::RemoveTexture( uint32_t TextureId )
+{
+    const uint64_t textureKey = uint64_t( TextureId + 1 );
+
+    for ( uint32_t i = 0 ; i <= Mask ; i++ ) {
+        uint64_t value = Slots[i].Load();
+
+        while ( value && ( value >> ( TIME_BITS + PAGE_BITS ) ) == textureKey ) {
+            if ( Slots[i].CompareExchangeStrong( value, 0 ) ) {
+                break;
+            }
+        }
+    }
+}
+
+void AVirtualTexturePageTable::Clear()
+{
+    for ( uint32_t i = 0 ; i <= Mask ; i++ ) {
+        Slots[i].Store( 0 );
+    }
+}
@@ -0,0 +1,100 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Core/Public/Atomic.h>
+
+/**
+Fixed size open addressed table of streamed pages.
+Table is shared between feedback analyzer, stream threads and the cache. Lookups and updates are lock-free.
+
+Each slot is one 64-bit word: [key:40][time:24], where key is (texture id + 1) and absolute page index,
+time is the streaming request time in milliseconds (modulo 2^24). Zero word is an empty slot.
+
+Key is searched in a window of MAX_PROBES slots. If the window is full, the oldest page in the window is replaced.
+Concurrent requests of the same page may rarely stream it twice, the cache discards the duplicate.
+*/
+class AVirtualTexturePageTable
+{
+    AN_FORBID_COPY( AVirtualTexturePageTable )
+
+public:
+    enum { MAX_PROBES = 16 };
+
+    enum { TIME_BITS = 24, PAGE_BITS = 25, TEXTURE_BITS = 15 };
+
+    /** Texture ids are in range [0, MAX_TEXTURE_ID]. Id + 1 is stored in the key, so the last value of TEXTURE_BITS is not used */
+    enum { MAX_TEXTURE_ID = ( 1 << TEXTURE_BITS ) - 2 };
+
+    AVirtualTexturePageTable();
+    ~AVirtualTexturePageTable();
+
+    /** Allocate the table. Capacity is rounded up to a power of two */
+    void Initialize( int Capacity );
+
+    /** Returns true if the page was requested for streaming less than Timeout milliseconds ago */
+    bool IsStreaming( uint32_t TextureId, uint32_t PageIndex, int64_t Time, int Timeout ) const;
+
+    /** Mark the page as streaming. Returns false if the page was requested less than Timeout milliseconds ago */
+    bool BeginStreaming( uint32_t TextureId, uint32_t PageIndex, int64_t Time, int Timeout );
+
+    /** Remove the page from the table. Called by the cache when the page was uploaded or discarded */
+    void Remove( uint32_t TextureId, uint32_t PageIndex );
+
+    /** Remove all pages of the texture */
+    void RemoveTexture( uint32_t TextureId );
+
+    void Clear();
+
+private:
+    static_assert( TEXTURE_BITS + PAGE_BITS + TIME_BITS <= 64, "Page table key doesn't fit the slot" );
+
+    static constexpr uint64_t TIME_MASK = ( uint64_t( 1 ) << TIME_BITS ) - 1;
+
+    static uint64_t MakeKey( uint32_t TextureId, uint32_t PageIndex )
+    {
+        AN_ASSERT( TextureId <= MAX_TEXTURE_ID && PageIndex < ( 1u << PAGE_BITS ) );
+        return ( uint64_t( TextureId + 1 ) << PAGE_BITS ) | PageIndex;
+    }
+
+    static uint32_t GetAge( uint64_t Value, int64_t Time )
+    {
+        return ( uint64_t( Time ) - Value ) & TIME_MASK;
+    }
+
+    uint32_t Hash( uint64_t Key ) const
+    {
+        return uint32_t( ( Key * 0x9E3779B97F4A7C15ull ) >> 32 ) & Mask;
+    }
+
+    TAtomic< uint64_t > * Slots;
+    uint32_t Mask;
+};
@@ -41,6 +41,8 @@ SOFTWARE.
 
 ARuntimeVariable r_ResetCacheVT( _CTS("r_ResetCacheVT"), _CTS("0") );
 
+static constexpr int PAGE_TABLE_CAPACITY = 4096;
+
 AVirtualTextureCache::AVirtualTextureCache( SVirtualTextureCacheCreateInfo const & CreateInfo )
 {
     using namespace RenderCore;
@@ -61,15 +63,15 @@ AVirtualTextureCache::AVirtualTextureCache( SVirtualTextureCacheCreateInfo const
     }
 
     PhysPageInfo.Resize( PageCacheCapacity );
-    PhysPageInfoSorted.Resize( PageCacheCapacity );
 
     for ( int i = 0 ; i < PageCacheCapacity ; i++ ) {
         PhysPageInfo[i].Time = 0;
         PhysPageInfo[i].PageIndex = 0;
         PhysPageInfo[i].pTexture = 0;
-        PhysPageInfoSorted[i].pInfo = &PhysPageInfo[i];
     }
 
+    ClockHand = 0;
+
     int physCacheWidth = PageCacheCapacityX * PageResolutionB;
     int physCacheHeight = PageCacheCapacityY * PageResolutionB;
 
@@ -89,10 +91,12 @@ AVirtualTextureCache::AVirtualTextureCache( SVirtualTextureCacheCreateInfo const
         AlignedSize += Align( size, 16 );
     }
 
-    TotalCachedPages = 0;
-
     LRUTime = 0;
 
+    // Pages are removed from the table when uploaded, so it holds only pages in flight
+    PageTable.Initialize( PAGE_TABLE_CAPACITY );
+    NextTextureId = 0;
+
     PageTranslationOffsetAndScale.X = (float)VT_PAGE_BORDER_WIDTH / PageResolutionB / PageCacheCapacityX;
     PageTranslationOffsetAndScale.Y = (float)VT_PAGE_BORDER_WIDTH / PageResolutionB / PageCacheCapacityY;
     PageTranslationOffsetAndScale.Z = (float)(PageResolutionB - VT_PAGE_BORDER_WIDTH*2) / PageResolutionB / PageCacheCapacityX;
@@ -178,6 +182,10 @@ bool AVirtualTextureCache::CreateTexture( const char * FileName, TRef< AVirtualT
 
     *ppTexture = pTexture;
 
+    // Texture id is a part of the page table key
+    pTexture->PageTableId = NextTextureId;
+    NextTextureId = NextTextureId < AVirtualTexturePageTable::MAX_TEXTURE_ID ? NextTextureId + 1 : 0;
+
     pTexture->AddRef();
 
     VirtualTextures.Append( pTexture.GetObject() );
@@ -202,6 +210,8 @@ AVirtualTextureCache::SPageTransfer * AVirtualTextureCache::CreatePageTransfer()
 {
     AN_ASSERT( LayerInfo.size() > 0 );
 
+    AMutexGurad criticalSection( TransferAllocMutex );
+
     // TODO: break if thread was stopped
     do {
         int freePoint = TransferFreePoint.Load();
@@ -249,8 +259,8 @@ void AVirtualTextureCache::UnlockTransfers()
 }
 
 void AVirtualTextureCache::ResetCache() {
-    TotalCachedPages = 0;
     LRUTime = 0;
+    ClockHand = 0;
 
     for ( int i = 0 ; i < PageCacheCapacity ; i++ ) {
         if ( PhysPageInfo[i].pTexture ) {
@@ -259,91 +269,66 @@ void AVirtualTextureCache::ResetCache() {
         PhysPageInfo[i].Time = 0;
         PhysPageInfo[i].PageIndex = 0;
         PhysPageInfo[i].pTexture = 0;
-        PhysPageInfoSorted[i].pInfo = &PhysPageInfo[i];
     }
 
     for ( AVirtualTexturePtr texture : VirtualTextures ) {
-        texture->PendingUpdateLRU.Clear();
         texture->CommitPageResidency();
     }
 }
 
-void AVirtualTextureCache::Update() {
-    static int maxPendingLRUs = 0;
+int AVirtualTextureCache::AllocatePhysPage( int64_t Time ) {
+    // Pages that were used in last frames are skipped. Each page is visited once per pass,
+    // so the page is found in amortized O(1) without sorting by time.
+    for ( uint32_t i = 0 ; i < PageCacheCapacity ; i++ ) {
+        uint32_t physPageIndex = ClockHand;
 
-    if ( r_ResetCacheVT ) {
-        ResetCache();
-        r_ResetCacheVT = false;
-    }
+        if ( ++ClockHand == PageCacheCapacity ) {
+            ClockHand = 0;
+        }
 
-    WaitForFences();
+        SPhysPageInfo const & info = PhysPageInfo[physPageIndex];
 
-    if ( !LockTransfers() ) {
-        // no pages to upload
-        for ( AVirtualTexturePtr texture : VirtualTextures ) {
-            maxPendingLRUs = Math::Max( maxPendingLRUs, texture->PendingUpdateLRU.Size() );
-            texture->PendingUpdateLRU.Clear(); // No need to update LRU
+        if ( !info.pTexture || info.Time + 4 < Time ) {
+            return physPageIndex;
         }
-        //GLogger.Printf( "maxPendingLRUs %d\n", maxPendingLRUs );
-        return;
     }
 
-    // Update LRU
-
-    int64_t time = ++LRUTime;
-
-    for ( AVirtualTexturePtr texture : VirtualTextures ) {
-        maxPendingLRUs = Math::Max( maxPendingLRUs, texture->PendingUpdateLRU.Size() );
-        for ( int i = 0 ; i < texture->PendingUpdateLRU.Size() ; i++ ) {
-            uint32_t absIndex = texture->PendingUpdateLRU[i];
-
-            AN_ASSERT( texture->PIT[absIndex] & PF_CACHED );
-
-            const uint16_t * pageIndirection = texture->GetIndirectionData();
+    return -1;
+}
 
-            int offset = pageIndirection[absIndex] & 0x0fff;
-            PhysPageInfo[offset].Time = time;
-        }
-        texture->PendingUpdateLRU.Clear();
+void AVirtualTextureCache::Update() {
+    if ( r_ResetCacheVT ) {
+        ResetCache();
+        r_ResetCacheVT = false;
     }
 
-    //GLogger.Printf( "maxPendingLRUs %d\n", maxPendingLRUs );
-
-    int numFirstReservedPages = 0;//1;  // first lod always must be in cache
-    int currentCacheCapacity = Math::Min< int >( PageCacheCapacity - numFirstReservedPages, Transfers.Size() );
+    WaitForFences();
 
-    SPhysPageInfoSorted * pFirstPhysPage = &PhysPageInfoSorted[numFirstReservedPages];
+    // Pages used on this frame are marked by UpdateLRU
+    int64_t time = ++LRUTime;
 
-    if ( TotalCachedPages < PageCacheCapacity ) {
-        pFirstPhysPage = &PhysPageInfoSorted[TotalCachedPages];
-    }
-    else {
-        // Sort cache info by time to move outdated pages to begin of the array
-        struct
-        {
-            bool operator() ( SPhysPageInfoSorted const & a, SPhysPageInfoSorted const & b ) {
-                return a.pInfo->Time < b.pInfo->Time;
-            }
-        } PhysicalPageTimeCompare;
-        std::sort( pFirstPhysPage, PhysPageInfoSorted.End(), PhysicalPageTimeCompare );
+    if ( !LockTransfers() ) {
+        // no pages to upload
+        return;
     }
 
-    SPhysPageInfoSorted * pLastPhysPage = pFirstPhysPage + currentCacheCapacity;
-
     int d_duplicates = 0; // Count of double streamed pages (for debugging)
     int d_uploaded = 0; // Count of uploaded pages (for debugging)
 
-    int fetchIndex = 0;
-
     int64_t uploadStartTime = Core::SysMicroseconds();
 
-    for ( SPhysPageInfoSorted * physPage = pFirstPhysPage ;
-          physPage < pLastPhysPage && fetchIndex < Transfers.Size() ; ++fetchIndex )
+    for ( int fetchIndex = 0 ; fetchIndex < Transfers.Size() ; ++fetchIndex )
     {
         SPageTransfer * transfer = Transfers[fetchIndex];
 
         AVirtualTexture * pTexture = transfer->pTexture;
 
+        if ( transfer->bFailed ) {
+            // Stream thread couldn't unpack the page
+            DiscardTransfers( &transfer, 1 );
+            continue;
+        }
+
         if ( pTexture->PIT[transfer->PageIndex] & PF_CACHED ) {
             // Page is loaded twice.
             d_duplicates++;
@@ -352,39 +337,34 @@ void AVirtualTextureCache::Update() {
         }
 
         // Clear space for the page
-        if ( physPage->pInfo->pTexture ) {
-            if ( physPage->pInfo->Time + 4 >= time ) {
-                GLogger.Printf( "AVirtualTextureCache::UploadPages: texture cache thrashing\n" );
-                // TODO: move uploaded pages to temporary memory for fast re-upload later
-                DiscardTransfers( &Transfers[fetchIndex], Transfers.Size() - fetchIndex );
-                break;
-            }
+        int physPageIndex = AllocatePhysPage( time );
+        if ( physPageIndex < 0 ) {
+            GLogger.Printf( "AVirtualTextureCache::UploadPages: texture cache thrashing\n" );
+            // TODO: move uploaded pages to temporary memory for fast re-upload later
+            DiscardTransfers( &Transfers[fetchIndex], Transfers.Size() - fetchIndex );
+            break;
+        }
 
-            // debug: invalid case if physical page reserved for lod0
-            //if ( pageIndex == 0 ) {
-            //    si++;
-            //    continue;
-            //}
+        SPhysPageInfo & physPage = PhysPageInfo[physPageIndex];
 
-            physPage->pInfo->pTexture->MakePageNonResident( physPage->pInfo->PageIndex );
+        if ( physPage.pTexture ) {
+            physPage.pTexture->MakePageNonResident( physPage.PageIndex );
         }
 
-        physPage->pInfo->Time = time;
-        physPage->pInfo->PageIndex = transfer->PageIndex;
-        physPage->pInfo->pTexture = pTexture;
-
-        // get new cached page index
-        int physPageIndex = physPage->pInfo - PhysPageInfo.ToPtr();
-        AN_ASSERT( physPageIndex < PageCacheCapacity );
+        physPage.Time = time;
+        physPage.PageIndex = transfer->PageIndex;
+        physPage.pTexture = pTexture;
 
         TransferPageData( transfer, physPageIndex );
-        
+
         pTexture->MakePageResident( transfer->PageIndex, physPageIndex );
+
+        // Page is resident now, it is not requested anymore
+        PageTable.Remove( pTexture->PageTableId, transfer->PageIndex );
+
         pTexture->RemoveRef();
 
-        physPage++;
         d_uploaded++;
-        TotalCachedPages++;
     }
 
     if ( d_duplicates > 0 ) {
@@ -406,12 +386,14 @@ void AVirtualTextureCache::Update() {
             for ( int i = 0 ; i < PageCacheCapacity ; i++ ) {
                 if ( PhysPageInfo[i].pTexture == texture ) {
                     PhysPageInfo[i].pTexture->MakePageNonResident( PhysPageInfo[i].PageIndex );
+                    PhysPageInfo[i].Time = 0;
+                    PhysPageInfo[i].PageIndex = 0;
+                    PhysPageInfo[i].pTexture = 0;
                 }
-                PhysPageInfo[i].Time = 0;
-                PhysPageInfo[i].PageIndex = 0;
-                PhysPageInfo[i].pTexture = 0;
             }
 
+            PageTable.RemoveTexture( texture->PageTableId );
+
             texture->RemoveRef();
 
             VirtualTextures.Remove( texIndex );
@@ -463,6 +445,10 @@ void AVirtualTextureCache::DiscardTransfers( SPageTransfer ** InTransfers, int C
 
         for ( int i = 0 ; i < Count ; i++ ) {
             InTransfers[i]->Fence = Fence;
+
+            // Allow to request the page again
+            PageTable.Remove( InTransfers[i]->pTexture->PageTableId, InTransfers[i]->PageIndex );
+
             InTransfers[i]->pTexture->RemoveRef();
         }
     }
@@ -36,6 +36,7 @@ SOFTWARE.
 #include <RenderCore/FrameGraph/FrameGraph.h>
 
 #include "VT.h"
+#include "VirtualTexturePageTable.h"
 
 class AVirtualTexture;
 
@@ -97,17 +98,25 @@ public:
         AVirtualTexture * pTexture;
         uint32_t PageIndex;
         byte * Layers[VT_MAX_LAYERS];
+        /** Page data couldn't be loaded. The transfer is discarded on the next cache update */
+        bool bFailed;
     };
 
-    /** Called by async thread to create new page transfer */
+    /** Called by stream threads to create new page transfer */
     SPageTransfer * CreatePageTransfer();
 
-    /** Called by async thread when page was streamed */
+    /** Called by stream threads when page was streamed */
     void MakePageTransferVisible( SPageTransfer * Transfer );
 
     /** Draw cache for debugging */
     void Draw( AFrameGraph & FrameGraph, AFrameGraphTexture * RenderTarget, int LayerIndex );
 
+    /** Streamed pages of all textures. Shared by feedback analyzer, stream threads and the cache */
+    AVirtualTexturePageTable & GetPageTable() { return PageTable; }
+
+    /** Mark physical page as used. Time is applied on the next cache update */
+    void UpdateLRU( int PhysPageIndex ) { PhysPageInfo[PhysPageIndex].Time = LRUTime + 1; }
+
 private:
     bool LockTransfers();
 
@@ -140,17 +149,14 @@ private:
         AVirtualTexture * pTexture;
     };
 
-    /** Physical pages sorted by time */
-    struct SPhysPageInfoSorted
-    {
-        SPhysPageInfo * pInfo;
-    };
-
     /** Physical page infos */
     TPodVector< SPhysPageInfo > PhysPageInfo;
 
-    /** Physical page infos sorted by time */
-    TPodVector< SPhysPageInfoSorted > PhysPageInfoSorted;
+    /** Find physical page for the new page with clock algorithm. Returns -1 if all pages were used recently */
+    int AllocatePhysPage( int64_t Time );
+
+    /** Clock hand for page replacement */
+    uint32_t ClockHand;
 
     uint32_t PageCacheCapacityX;
     uint32_t PageCacheCapacityY;
@@ -158,12 +164,16 @@ private:
     uint16_t PageResolutionB;
     size_t PageSizeInBytes;
     size_t AlignedSize;
-    int TotalCachedPages;
 
     Float4 PageTranslationOffsetAndScale;
 
     int64_t LRUTime;
 
+    AVirtualTexturePageTable PageTable;
+
+    /** Texture id in the page table */
+    uint32_t NextTextureId;
+
     TPodVector< SPageTransfer * > Transfers;
     AMutex TransfersMutex;
 
@@ -172,6 +182,7 @@ private:
     byte * pTransferData;
     size_t TransferDataOffset;
     int TransferAllocPoint;
+    AMutex TransferAllocMutex;
     AAtomicInt TransferFreePoint;
     SPageTransfer PageTransfer[MAX_UPLOADS_PER_FRAME];
     ASyncEvent PageTransferEvent;
@@ -32,6 +32,11 @@ SOFTWARE.
 #include "QuadTree.h"
 
 #include <Core/Public/Logger.h>
+#include <Core/Public/Compress.h>
+#include <Runtime/Public/Runtime.h>
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
 #include <Core/Public/WindowsDefs.h>
 
 #define PAGE_EXTENSION ".page"
@@ -87,6 +92,7 @@ SVirtualTextureLayer::SVirtualTextureLayer() {
     MaxCachedPages = 1024;
     NumCachedPages = 0;
     bAllowDump = true;
+    UseCounter = 0;
 }
 
 SVirtualTextureLayer::~SVirtualTextureLayer() {
@@ -208,99 +214,224 @@ bool VT_DumpPageToDisk( const char * _Path, unsigned int _AbsoluteIndex, const S
     return _Image.WriteImage( fn.CStr() );
 }
 
-void VT_FitPageData( SVirtualTextureLayer & Layer, bool _ForceFit ) {
+using SCachedPage = SVirtualTextureLayer::SCachedPage;
+
+struct SEvictedPage {
+    unsigned int AbsoluteIndex;
+    SCachedPage * Page;
+};
+
+/** Releases page reference taken by the thread. Page must be removed from the cache */
+static void VT_ReleaseDetachedPage( SCachedPage * _CachedPage ) {
+    if ( _CachedPage->Used.Decrement() == 0 ) {
+        delete _CachedPage;
+    }
+}
+
+/** Evicts unused pages. Pages that must be saved are returned in _Dump: they stay in the cache in STATE_DUMPING
+until they are written by VT_DumpEvictedPages, so nobody reads the page from a partially written file. */
+static void VT_EvictPagesLocked( SVirtualTextureLayer & Layer, bool _ForceFit, TPodVectorHeap< SEvictedPage > & _Dump ) {
     if ( (!_ForceFit && Layer.NumCachedPages < Layer.MaxCachedPages)
          || Layer.MaxCachedPages < 0 ) {
         return;
     }
 
-    int totalDumped = 0;
-    int totalCachedPages = Layer.NumCachedPages;
-
-    GLogger.Printf( "Fit page data...\n" );
+    // Keep recently used pages in memory: pages of neighbouring jobs are likely to be opened again
+    int64_t minUse = Math::MaxValue< int64_t >();
+    if ( !_ForceFit ) {
+        TPodVectorHeap< int64_t > lastUse;
+        for ( auto & it : Layer.Pages ) {
+            if ( it.second->Used.Load() <= 0 ) {
+                lastUse.Append( it.second->LastUse );
+            }
+        }
+        int numEvicted = Layer.NumCachedPages - Layer.MaxCachedPages * 3 / 4;
+        if ( numEvicted <= 0 || lastUse.IsEmpty() ) {
+            return;
+        }
+        if ( numEvicted < lastUse.Size() ) {
+            std::nth_element( lastUse.Begin(), lastUse.Begin() + numEvicted, lastUse.End() );
+            minUse = lastUse[numEvicted];
+        }
+    }
 
     for ( auto it = Layer.Pages.begin() ; it != Layer.Pages.end() ; ) {
-        SVirtualTextureLayer::SCachedPage * cachedPage = it->second;
+        SCachedPage * cachedPage = it->second;
 
-        if ( cachedPage->Used > 0 ) {
+        // Pages that are loading or dumping are in use too
+        if ( cachedPage->Used.Load() > 0 || cachedPage->LastUse >= minUse ) {
             // now page in use, so keep it in memory
             it++;
             continue;
         }
 
         if ( cachedPage->bNeedToSave && Layer.bAllowDump ) {
-            if ( totalDumped == 0 ) {
-                GLogger.Printf( "Dumping pages to disk...\n" );
-            }
-            if ( VT_DumpPageToDisk( Layer.Path.CStr(), it->first, cachedPage->Image ) ) {
-                totalDumped++;
-            }
+            // Page reference is held by the dumping thread
+            cachedPage->Used.Store( 1 );
+            cachedPage->State.Store( SCachedPage::STATE_DUMPING );
+            _Dump.Append( { it->first, cachedPage } );
+            it++;
+            continue;
         }
 
         delete cachedPage;
         it = Layer.Pages.erase( it );
         Layer.NumCachedPages--;
     }
-
-    GLogger.Printf( "Total dumped pages: %d from %d\n", totalDumped, totalCachedPages );
 }
 
-SVirtualTextureLayer::SCachedPage * VT_OpenCachedPage( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, unsigned int _AbsoluteIndex, SVirtualTextureLayer::OpenMode _OpenMode, bool _NeedToSave ) {
-    int                 lod;
-    unsigned int        relativeIndex;
-    AString             fn;
-    SVirtualTextureLayer::SCachedPage * cachedPage;
-
-    cachedPage = VT_FindInCache( Layer, _AbsoluteIndex );
-    if ( cachedPage ) {
-        if ( _NeedToSave ) {
-            cachedPage->bNeedToSave = true;
+/** Writes evicted pages to disk outside of the layer lock and removes them from the cache. Returns count of written pages. */
+static int VT_DumpEvictedPages( SVirtualTextureLayer & Layer, TPodVectorHeap< SEvictedPage > const & _Dump ) {
+    if ( _Dump.IsEmpty() ) {
+        return 0;
+    }
+
+    int totalDumped = 0;
+
+    for ( SEvictedPage const & evicted : _Dump ) {
+        if ( VT_DumpPageToDisk( Layer.Path.CStr(), evicted.AbsoluteIndex, evicted.Page->Image ) ) {
+            totalDumped++;
         }
-        cachedPage->Used++;
-        return cachedPage;
     }
 
-    VT_FitPageData( Layer );
+    {
+        AMutexGurad criticalSection( Layer.Lock );
+
+        for ( SEvictedPage const & evicted : _Dump ) {
+            Layer.Pages.erase( evicted.AbsoluteIndex );
+            Layer.NumCachedPages--;
+        }
+    }
+
+    // Threads waiting for the page will open it again from the file
+    for ( SEvictedPage const & evicted : _Dump ) {
+        evicted.Page->State.Store( SCachedPage::STATE_DUMPED );
+        VT_ReleaseDetachedPage( evicted.Page );
+    }
+
+    return totalDumped;
+}
+
+void VT_FitPageData( SVirtualTextureLayer & Layer, bool _ForceFit ) {
+    TPodVectorHeap< SEvictedPage > dump;
+    int totalCachedPages;
+
+    {
+        AMutexGurad criticalSection( Layer.Lock );
+
+        totalCachedPages = Layer.NumCachedPages;
+
+        VT_EvictPagesLocked( Layer, _ForceFit, dump );
+    }
+
+    int totalDumped = VT_DumpEvictedPages( Layer, dump );
 
-    cachedPage = new SVirtualTextureLayer::SCachedPage;
+    if ( _ForceFit ) {
+        GLogger.Printf( "Total dumped pages: %d from %d\n", totalDumped, totalCachedPages );
+    }
+}
 
+static bool VT_LoadCachedPage( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, unsigned int _AbsoluteIndex, SVirtualTextureLayer::OpenMode _OpenMode, SCachedPage * _CachedPage ) {
     if ( _OpenMode == SVirtualTextureLayer::OpenEmpty ) {
         // create empty page
-        cachedPage->Image.CreateEmpty( _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels );
+        _CachedPage->Image.CreateEmpty( _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels );
         int ImageByteSize = _Struct.PageResolutionB * _Struct.PageResolutionB * Layer.NumChannels;
-        memset( cachedPage->Image.GetData(), 0, ImageByteSize );
-    } else if ( _OpenMode == SVirtualTextureLayer::OpenActual ){
+        memset( _CachedPage->Image.GetData(), 0, ImageByteSize );
+        return true;
+    }
+
+    if ( _OpenMode == SVirtualTextureLayer::OpenActual ) {
         // open from file
-        lod = QuadTreeCalcLod64( _AbsoluteIndex );
-        relativeIndex = QuadTreeAbsoluteToRelativeIndex( _AbsoluteIndex, lod );
-        fn = VT_FileNameFromRelative( Layer.Path.CStr(), relativeIndex, lod );
+        int lod = QuadTreeCalcLod64( _AbsoluteIndex );
+        unsigned int relativeIndex = QuadTreeAbsoluteToRelativeIndex( _AbsoluteIndex, lod );
+        AString fn = VT_FileNameFromRelative( Layer.Path.CStr(), relativeIndex, lod );
 
-        bool bOpened = cachedPage->Image.OpenImage( fn.CStr(), _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels );
-        if ( !bOpened ) {
+        if ( !_CachedPage->Image.OpenImage( fn.CStr(), _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels ) ) {
             GLogger.Printf( "VT_OpenCachedPage: can't open page\n" );
-            delete cachedPage;
-            return NULL;
+            return false;
         }
-    } else {
-        GLogger.Printf( "VT_OpenCachedPage: unknown open mode\n" );
-        delete cachedPage;
-        return NULL;
+        return true;
+    }
+
+    GLogger.Printf( "VT_OpenCachedPage: unknown open mode\n" );
+    return false;
+}
+
+SVirtualTextureLayer::SCachedPage * VT_OpenCachedPage( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, unsigned int _AbsoluteIndex, SVirtualTextureLayer::OpenMode _OpenMode, bool _NeedToSave ) {
+    SCachedPage * cachedPage;
+    TPodVectorHeap< SEvictedPage > dump;
+
+    // Page is loaded and dumped outside of the layer lock. Threads opening the same page wait for the page entry.
+    for ( ;; ) {
+        bool bFound;
+
+        {
+            AMutexGurad criticalSection( Layer.Lock );
+
+            cachedPage = VT_FindInCache( Layer, _AbsoluteIndex );
+            bFound = cachedPage != nullptr;
+
+            if ( !bFound ) {
+                VT_EvictPagesLocked( Layer, false, dump );
+
+                // Placeholder entry, the page is loaded by this thread
+                cachedPage = new SCachedPage;
+                cachedPage->State.Store( SCachedPage::STATE_LOADING );
+                cachedPage->Used.Store( 0 );
+                cachedPage->bNeedToSave = false;
+                Layer.Pages[ _AbsoluteIndex ] = cachedPage;
+                Layer.NumCachedPages++;
+            }
+
+            if ( _NeedToSave ) {
+                cachedPage->bNeedToSave = true;
+            }
+            cachedPage->Used.Increment();
+            cachedPage->LastUse = ++Layer.UseCounter;
+        }
+
+        if ( !bFound ) {
+            break;
+        }
+
+        int state;
+        while ( ( state = cachedPage->State.Load() ) == SCachedPage::STATE_LOADING || state == SCachedPage::STATE_DUMPING ) {
+            AThread::WaitMicroseconds( 100 );
+        }
+
+        if ( state == SCachedPage::STATE_LOADED ) {
+            return cachedPage;
+        }
+
+        // Page was removed from the cache while waiting, open it again
+        VT_ReleaseDetachedPage( cachedPage );
     }
 
-    cachedPage->Used = 1;
-    cachedPage->bNeedToSave = _NeedToSave;
-    Layer.Pages[ _AbsoluteIndex ] = cachedPage;
-    Layer.NumCachedPages++;
+    VT_DumpEvictedPages( Layer, dump );
 
-    return cachedPage;
+    if ( VT_LoadCachedPage( _Struct, Layer, _AbsoluteIndex, _OpenMode, cachedPage ) ) {
+        cachedPage->State.Store( SCachedPage::STATE_LOADED );
+        return cachedPage;
+    }
+
+    {
+        AMutexGurad criticalSection( Layer.Lock );
+
+        Layer.Pages.erase( _AbsoluteIndex );
+        Layer.NumCachedPages--;
+    }
+
+    cachedPage->State.Store( SCachedPage::STATE_FAILED );
+    VT_ReleaseDetachedPage( cachedPage );
+
+    return NULL;
 }
 
 void VT_CloseCachedPage( SVirtualTextureLayer::SCachedPage * _CachedPage ) {
     if ( !_CachedPage ) {
         return;
     }
-    _CachedPage->Used--;
-    if ( _CachedPage->Used < 0 ) {
+    if ( _CachedPage->Used.Decrement() < 0 ) {
         GLogger.Printf( "Warning: VT_CloseCachedPage: trying to close closed page\n" );
     }
 }
@@ -451,165 +582,165 @@ bool VT_LoadQuad( const SVirtualTextureStructure & _Struct,
     return true;
 }
 
-void VT_Downsample( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, SVirtualTextureLayer::SCachedPage * _Pages[4], byte * _Downsample ) {
-    const int borderOffset = ( (VT_PAGE_BORDER_WIDTH) * _Struct.PageResolutionB + (VT_PAGE_BORDER_WIDTH) ) * Layer.NumChannels;
-    const byte * src00 = _Pages[0] ? _Pages[0]->Image.GetData() + borderOffset : NULL;
-    const byte * src01 = _Pages[1] ? _Pages[1]->Image.GetData() + borderOffset : NULL;
-    const byte * src10 = _Pages[2] ? _Pages[2]->Image.GetData() + borderOffset : NULL;
-    const byte * src11 = _Pages[3] ? _Pages[3]->Image.GetData() + borderOffset : NULL;
-    const byte * s;
-    byte * d;
-    int color;
-
-    _Downsample += borderOffset;
-
-    for ( int ch = 0 ; ch < Layer.NumChannels ; ch++ ) {
-        for ( int y = 0 ; y < (_Struct.PageResolution>>1) ; y++ ) {
-            for ( int x = 0 ; x < (_Struct.PageResolution>>1) ; x++ ) {
-                color = 0;
-                if ( src00 ) {
-                    s = &src00[ (y * _Struct.PageResolutionB + x) * Layer.NumChannels * 2 ];
+// Downsample page interior to a quarter of destination page. Source rows are summed with SSE2, then neighbouring texels are summed.
+static void VT_DownsampleQuarter( const SVirtualTextureStructure & _Struct, int _NumChannels, const byte * _Source, byte * _Dest ) {
+    const int stride = _Struct.PageResolutionB * _NumChannels;
+    const int rowSize = _Struct.PageResolution * _NumChannels;
+    const int halfResolution = _Struct.PageResolution >> 1;
 
-                    color += *(s + ch);
-
-                    s += Layer.NumChannels;
-
-                    color += *(s + ch);
-
-                    s += ( _Struct.PageResolutionB - 1 ) * Layer.NumChannels;
+    if ( !_Source ) {
+        for ( int y = 0 ; y < halfResolution ; y++ ) {
+            memset( _Dest + y * stride, 0, halfResolution * _NumChannels );
+        }
+        return;
+    }
 
-                    color += *(s + ch);
+    uint16_t * rowSum = (uint16_t *)StackAlloc( rowSize * sizeof( uint16_t ) );
 
-                    s += Layer.NumChannels;
+    const __m128i zero = _mm_setzero_si128();
 
-                    color += *(s + ch);
+    for ( int y = 0 ; y < halfResolution ; y++ ) {
+        const byte * row0 = _Source + y * 2 * stride;
+        const byte * row1 = row0 + stride;
 
-                    color >>= 2;
-                }
+        int i = 0;
+        for ( ; i + 16 <= rowSize ; i += 16 ) {
+            __m128i a = _mm_loadu_si128( (const __m128i *)( row0 + i ) );
+            __m128i b = _mm_loadu_si128( (const __m128i *)( row1 + i ) );
 
-                d = &_Downsample[ (y * _Struct.PageResolutionB + x) * Layer.NumChannels ];
+            _mm_storeu_si128( (__m128i *)( rowSum + i ), _mm_add_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) ) );
+            _mm_storeu_si128( (__m128i *)( rowSum + i + 8 ), _mm_add_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) ) );
+        }
+        for ( ; i < rowSize ; i++ ) {
+            rowSum[i] = row0[i] + row1[i];
+        }
 
-                *(d + ch) = color;
+        byte * d = _Dest + y * stride;
+        const uint16_t * sum = rowSum;
+        for ( int x = 0 ; x < halfResolution ; x++ ) {
+            for ( int ch = 0 ; ch < _NumChannels ; ch++ ) {
+                d[ch] = ( sum[ch] + sum[ch + _NumChannels] ) >> 2;
+            }
+            d += _NumChannels;
+            sum += _NumChannels * 2;
+        }
+    }
+}
 
-                color = 0;
-                if ( src10 ) {
-                    s = &src10[ (y * _Struct.PageResolutionB + x) * Layer.NumChannels * 2 ];
+void VT_Downsample( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, SVirtualTextureLayer::SCachedPage * _Pages[4], byte * _Downsample ) {
+    const int borderOffset = ( (VT_PAGE_BORDER_WIDTH) * _Struct.PageResolutionB + (VT_PAGE_BORDER_WIDTH) ) * Layer.NumChannels;
+    const byte * src00 = _Pages[0] ? _Pages[0]->Image.GetData() + borderOffset : NULL;
+    const byte * src01 = _Pages[1] ? _Pages[1]->Image.GetData() + borderOffset : NULL;
+    const byte * src10 = _Pages[2] ? _Pages[2]->Image.GetData() + borderOffset : NULL;
+    const byte * src11 = _Pages[3] ? _Pages[3]->Image.GetData() + borderOffset : NULL;
 
-                    color += *(s + ch);
+    const int halfResolution = _Struct.PageResolution >> 1;
 
-                    s += Layer.NumChannels;
+    _Downsample += borderOffset;
 
-                    color += *(s + ch);
+    VT_DownsampleQuarter( _Struct, Layer.NumChannels, src00, _Downsample );
+    VT_DownsampleQuarter( _Struct, Layer.NumChannels, src10, _Downsample + halfResolution * Layer.NumChannels );
+    VT_DownsampleQuarter( _Struct, Layer.NumChannels, src01, _Downsample + halfResolution * _Struct.PageResolutionB * Layer.NumChannels );
+    VT_DownsampleQuarter( _Struct, Layer.NumChannels, src11, _Downsample + ( halfResolution * _Struct.PageResolutionB + halfResolution ) * Layer.NumChannels );
+}
 
-                    s += ( _Struct.PageResolutionB - 1 ) * Layer.NumChannels;
+void VT_MakeLods( SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, const APageBitfield * _DirtyPages ) {
+    TPodVectorHeap< byte > marked;
 
-                    color += *(s + ch);
+    for ( int sourceLod = _Struct.NumLods - 1 ; sourceLod > 0 ; sourceLod-- ) {
 
-                    s += Layer.NumChannels;
+        int destLod = sourceLod - 1;
 
-                    color += *(s + ch);
+        unsigned int numDestPages = 1 << destLod;
 
-                    color >>= 2;
-                }
+        marked.ResizeInvalidate( numDestPages * numDestPages );
+        marked.ZeroMem();
 
-                d += ( _Struct.PageResolution >> 1 ) * Layer.NumChannels;
+        // Destination pages of one lod are independent, so process rows of them in parallel
+        GAsyncJobManager.ParallelFor( numDestPages, [&]( int _First, int _Last )
+        {
+            SVirtualTextureLayer::SCachedPage * pages[4];
 
-                *(d + ch) = color;
+            for ( unsigned int destY = _First ; destY < (unsigned int)_Last ; destY++ ) {
+                for ( unsigned int destX = 0 ; destX < numDestPages ; destX++ ) {
 
-                color = 0;
-                if ( src01 ) {
-                    s = &src01[ (y * _Struct.PageResolutionB + x) * Layer.NumChannels * 2 ];
+                    unsigned int dst = QuadTreeGetRelativeFromXY( destX, destY, destLod );
+                    unsigned int absoluteIndex = QuadTreeRelativeToAbsoluteIndex( dst, destLod );
 
-                    color += *(s + ch);
+                    if ( _DirtyPages && !_DirtyPages->IsMarked( absoluteIndex ) ) {
+                        continue;
+                    }
 
-                    s += Layer.NumChannels;
+                    unsigned int x = destX << 1;
+                    unsigned int y = destY << 1;
 
-                    color += *(s + ch);
+                    unsigned int src00 = QuadTreeGetRelativeFromXY( x,   y,   sourceLod );
+                    unsigned int src10 = QuadTreeGetRelativeFromXY( x+1, y,   sourceLod );
+                    unsigned int src01 = QuadTreeGetRelativeFromXY( x,   y+1, sourceLod );
+                    unsigned int src11 = QuadTreeGetRelativeFromXY( x+1, y+1, sourceLod );
 
-                    s += ( _Struct.PageResolutionB - 1 ) * Layer.NumChannels;
+                    if ( !VT_LoadQuad( _Struct, Layer, src00, src10, src01, src11, sourceLod, pages ) ) {
+                        continue;
+                    }
 
-                    color += *(s + ch);
+                    SVirtualTextureLayer::SCachedPage * cachedPage = VT_OpenCachedPage( _Struct, Layer, absoluteIndex, SVirtualTextureLayer::OpenEmpty, true );
+                    if ( cachedPage ) {
+                        VT_Downsample( _Struct, Layer, pages, cachedPage->Image.GetData() );
 
-                    s += Layer.NumChannels;
+                        // Page bitfield is not thread safe, mark pages after the lod is done
+                        marked[destY * numDestPages + destX] = 1;
 
-                    color += *(s + ch);
+                        VT_CloseCachedPage( cachedPage );
+                    }
 
-                    color >>= 2;
+                    for ( int i = 0 ; i < 4 ; i++ ) {
+                        VT_CloseCachedPage( pages[i] );
+                    }
                 }
+            }
+        } );
 
-                d = &_Downsample[ ( ( y + (_Struct.PageResolution>>1) ) * _Struct.PageResolutionB + x) * Layer.NumChannels ];
-
-                *(d + ch) = color;
-
-                color = 0;
-                if ( src11 ) {
-                    s = &src11[ (y * _Struct.PageResolutionB + x) * Layer.NumChannels * 2 ];
-
-                    color += *(s + ch);
-
-                    s += Layer.NumChannels;
-
-                    color += *(s + ch);
-
-                    s += ( _Struct.PageResolutionB - 1 ) * Layer.NumChannels;
-
-                    color += *(s + ch);
-
-                    s += Layer.NumChannels;
-
-                    color += *(s + ch);
-
-                    color >>= 2;
+        for ( unsigned int destY = 0 ; destY < numDestPages ; destY++ ) {
+            for ( unsigned int destX = 0 ; destX < numDestPages ; destX++ ) {
+                if ( marked[destY * numDestPages + destX] ) {
+                    _Struct.PageBitfield.Mark( QuadTreeRelativeToAbsoluteIndex( QuadTreeGetRelativeFromXY( destX, destY, destLod ), destLod ) );
                 }
-
-                d += ( _Struct.PageResolution >> 1 ) * Layer.NumChannels;
-
-                *(d + ch) = color;
             }
         }
     }
 }
 
-void VT_MakeLods( SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer ) {
-    SVirtualTextureLayer::SCachedPage * pages[4];
-
-    for ( int sourceLod = _Struct.NumLods - 1 ; sourceLod > 0 ; sourceLod-- ) {
-
-        unsigned int numLodPages = 1 << sourceLod;
-
-        int destLod = sourceLod - 1;
+void VT_PropagateDirtyPages( const SVirtualTextureStructure & _Struct, APageBitfield & _DirtyPages ) {
+    for ( int lod = _Struct.NumLods - 1 ; lod > 0 ; lod-- ) {
+        unsigned int numLodPages = QuadTreeCalcLodNodes( lod );
+        unsigned int firstPage = QuadTreeRelativeToAbsoluteIndex( 0, lod );
 
-        for ( unsigned int y = 0 ; y < numLodPages ; y += 2 ) {
-            for ( unsigned int x = 0 ; x < numLodPages ; x += 2 ) {
-
-                unsigned int src00 = QuadTreeGetRelativeFromXY( x,   y,   sourceLod );
-                unsigned int src10 = QuadTreeGetRelativeFromXY( x+1, y,   sourceLod );
-                unsigned int src01 = QuadTreeGetRelativeFromXY( x,   y+1, sourceLod );
-                unsigned int src11 = QuadTreeGetRelativeFromXY( x+1, y+1, sourceLod );
+        for ( unsigned int relativeIndex = 0 ; relativeIndex < numLodPages ; relativeIndex++ ) {
+            if ( _DirtyPages.IsMarked( firstPage + relativeIndex ) ) {
+                _DirtyPages.Mark( QuadTreeGetParentFromRelative( relativeIndex, lod ) );
+            }
+        }
+    }
+}
 
-                if ( !VT_LoadQuad( _Struct, Layer, src00, src10, src01, src11, sourceLod, pages ) ) {
-                    continue;
-                }
+void VT_ExpandDirtyPages( const SVirtualTextureStructure & _Struct, APageBitfield const & _DirtyPages, APageBitfield & _BorderPages ) {
+    _BorderPages.ResizeInvalidate( _Struct.NumQuadTreeNodes );
+    _BorderPages.UnmarkAll();
 
-                unsigned int dst = QuadTreeGetRelativeFromXY( x >> 1, y >> 1, destLod );
-                unsigned int absoluteIndex = QuadTreeRelativeToAbsoluteIndex( dst, destLod );
+    for ( int lod = 0 ; lod < _Struct.NumLods ; lod++ ) {
+        int numPages = 1 << lod;
 
-                SVirtualTextureLayer::SCachedPage * cachedPage = VT_OpenCachedPage( _Struct, Layer, absoluteIndex, SVirtualTextureLayer::OpenEmpty, true );
-                if ( !cachedPage ) {
+        for ( int y = 0 ; y < numPages ; y++ ) {
+            for ( int x = 0 ; x < numPages ; x++ ) {
+                if ( !_DirtyPages.IsMarked( QuadTreeRelativeToAbsoluteIndex( QuadTreeGetRelativeFromXY( x, y, lod ), lod ) ) ) {
                     continue;
                 }
 
-                VT_Downsample( _Struct, Layer, pages, cachedPage->Image.GetData() );
-                _Struct.PageBitfield.Mark( absoluteIndex );
-
-                //AFileStream f;
-                //f.OpenWrite( Core::Fmt("page_%d.bmp", absoluteIndex ) );
-                //WriteBMP( f, _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels, cachedPage->Image.GetData() );
-
-                VT_CloseCachedPage( cachedPage );
-
-                for ( int i = 0 ; i < 4 ; i++ ) {
-                    VT_CloseCachedPage( pages[i] );
+                // Borders of neighbours are copied from this page
+                for ( int ny = Math::Max( y - 1, 0 ) ; ny <= Math::Min( y + 1, numPages - 1 ) ; ny++ ) {
+                    for ( int nx = Math::Max( x - 1, 0 ) ; nx <= Math::Min( x + 1, numPages - 1 ) ; nx++ ) {
+                        _BorderPages.Mark( QuadTreeRelativeToAbsoluteIndex( QuadTreeGetRelativeFromXY( nx, ny, lod ), lod ) );
+                    }
                 }
             }
         }
@@ -628,24 +759,24 @@ static void VT_SynchronizePageBitfieldWithHDD_Lod( APageBitfield & BitField, int
 
     // TODO: Rewrite to support FindFirstFileW
 
-    if ( (fh = FindFirstFileA( (AString( _LodPath ) +  "*.png").CStr(), &fd )) != INVALID_HANDLE_VALUE ) {
+    const int extLen = strlen( PAGE_EXTENSION );
+
+    if ( (fh = FindFirstFileA( (AString( _LodPath ) +  "*" PAGE_EXTENSION).CStr(), &fd )) != INVALID_HANDLE_VALUE ) {
         do {
             int len = strlen( fd.cFileName );
-            if ( len < 4 ) {
+            if ( len <= extLen ) {
                 // Invalid name
-                AN_ASSERT_( 0, "Never reached" );
                 continue;
             }
 
-            if ( !Core::Stricmp( &fd.cFileName[len - 4], ".png" ) ) {
-                // extension is not .png
-                AN_ASSERT_( 0, "Never reached" );
+            if ( Core::Stricmp( &fd.cFileName[len - extLen], PAGE_EXTENSION ) ) {
+                // extension is not PAGE_EXTENSION
                 continue;
             }
 
-            fd.cFileName[len - 4] = 0;
+            fd.cFileName[len - extLen] = 0;
             relativeIndex = atoi( fd.cFileName );
-            fd.cFileName[len - 4] = '.';
+            fd.cFileName[len - extLen] = '.';
 
             if ( relativeIndex >= validMax ) {
                 // invalid index (out of range)
@@ -675,6 +806,7 @@ static void VT_SynchronizePageBitfieldWithHDD_Lod( APageBitfield & BitField, int
     }
 
     unsigned int validMax = QuadTreeCalcLodNodes( _Lod );
+    const int extLen = strlen( PAGE_EXTENSION );
 
     while ( ( entry = readdir( dp ) ) != NULL ) {
         lstat( entry->d_name, &statBuff );
@@ -685,18 +817,18 @@ static void VT_SynchronizePageBitfieldWithHDD_Lod( APageBitfield & BitField, int
 //        relativeIndex64 = common::HexToInt64( entry->d_name, len );
 
         int l = strlen( entry->d_name );
-        if ( l < 4 ) {
+        if ( l <= extLen ) {
             continue; // no extension
         }
 
-        if ( !strcasecmp( &entry->d_name[ l - 4 ], PAGE_EXTENSION ) ) {
+        if ( strcasecmp( &entry->d_name[ l - extLen ], PAGE_EXTENSION ) ) {
             // extension is not PAGE_EXTENSION
             continue;
         }
 
-        entry->d_name[ l - 4 ] = 0;
+        entry->d_name[ l - extLen ] = 0;
         relativeIndex = atoi( entry->d_name );
-        entry->d_name[ l - 4 ] = '.';
+        entry->d_name[ l - extLen ] = '.';
 
         if ( relativeIndex >= validMax ) {
             // invalid index (out of range)
@@ -1139,99 +1271,119 @@ void VT_GenerateBorder_DR( SVirtualTextureStructure & _Struct, SVirtualTextureLa
     VT_CloseCachedPage( cachedPage );
 }
 
-void VT_GenerateBordersLod( SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, int _Lod ) {
+void VT_GenerateBordersLod( SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, int _Lod, const APageBitfield * _DirtyPages ) {
     int numLodPages = QuadTreeCalcLodNodes( _Lod );
     unsigned int absoluteIndex = QuadTreeRelativeToAbsoluteIndex( 0, _Lod );
 
-    for ( int i = 0 ; i < numLodPages ; i++ ) {
-        unsigned int pageIndex = absoluteIndex + i;
+    // Page borders are written and only interior of neighbour pages is read, so pages are processed in parallel
+    GAsyncJobManager.ParallelFor( numLodPages, [&]( int _First, int _Last )
+    {
+        for ( int i = _First ; i < _Last ; i++ ) {
+            unsigned int pageIndex = absoluteIndex + i;
 
-        if ( !_Struct.PageBitfield.IsMarked( pageIndex ) ) {
-            continue;
-        }
+            if ( !_Struct.PageBitfield.IsMarked( pageIndex ) ) {
+                continue;
+            }
 
-        SVirtualTextureLayer::SCachedPage * cachedPage = VT_OpenCachedPage( _Struct, Layer, pageIndex, SVirtualTextureLayer::OpenActual, true );
-        if ( !cachedPage ) {
-            continue;
-        }
+            if ( _DirtyPages && !_DirtyPages->IsMarked( pageIndex ) ) {
+                continue;
+            }
 
-        byte * ImageData = cachedPage->Image.GetData();
+            SVirtualTextureLayer::SCachedPage * cachedPage = VT_OpenCachedPage( _Struct, Layer, pageIndex, SVirtualTextureLayer::OpenActual, true );
+            if ( !cachedPage ) {
+                continue;
+            }
 
-        // borders
-        VT_GenerateBorder_L( _Struct, Layer, i, _Lod, ImageData );
-        VT_GenerateBorder_R( _Struct, Layer, i, _Lod, ImageData );
-        VT_GenerateBorder_U( _Struct, Layer, i, _Lod, ImageData );
-        VT_GenerateBorder_D( _Struct, Layer, i, _Lod, ImageData );
+            byte * ImageData = cachedPage->Image.GetData();
 
-        // corners
-        VT_GenerateBorder_UL( _Struct, Layer, i, _Lod, ImageData );
-        VT_GenerateBorder_UR( _Struct, Layer, i, _Lod, ImageData );
-        VT_GenerateBorder_DL( _Struct, Layer, i, _Lod, ImageData );
-        VT_GenerateBorder_DR( _Struct, Layer, i, _Lod, ImageData );
+            // borders
+            VT_GenerateBorder_L( _Struct, Layer, i, _Lod, ImageData );
+            VT_GenerateBorder_R( _Struct, Layer, i, _Lod, ImageData );
+            VT_GenerateBorder_U( _Struct, Layer, i, _Lod, ImageData );
+            VT_GenerateBorder_D( _Struct, Layer, i, _Lod, ImageData );
 
-        //AFileStream f;
-        //f.OpenWrite( Core::Fmt("page_%d.bmp", pageIndex ) );
-        //WriteBMP( f, _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels, cachedPage->Image.GetData() );
+            // corners
+            VT_GenerateBorder_UL( _Struct, Layer, i, _Lod, ImageData );
+            VT_GenerateBorder_UR( _Struct, Layer, i, _Lod, ImageData );
+            VT_GenerateBorder_DL( _Struct, Layer, i, _Lod, ImageData );
+            VT_GenerateBorder_DR( _Struct, Layer, i, _Lod, ImageData );
 
-        VT_CloseCachedPage( cachedPage );
-    }
+            //AFileStream f;
+            //f.OpenWrite( Core::Fmt("page_%d.bmp", pageIndex ) );
+            //WriteBMP( f, _Struct.PageResolutionB, _Struct.PageResolutionB, Layer.NumChannels, cachedPage->Image.GetData() );
+
+            VT_CloseCachedPage( cachedPage );
+        }
+    }, 64 );
 }
 
-void VT_GenerateBorders( SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer ) {
+void VT_GenerateBorders( SVirtualTextureStructure & _Struct, SVirtualTextureLayer & Layer, const APageBitfield * _DirtyPages ) {
     for ( int i = 0 ; i < _Struct.NumLods ; i++ ) {
-        VT_GenerateBordersLod( _Struct, Layer, i );
+        VT_GenerateBordersLod( _Struct, Layer, i, _DirtyPages );
     }
 }
 
-SFileOffset VT_WritePage( SVirtualTextureFileHandle * File, SFileOffset Offset, const SVirtualTextureStructure & _Struct, SVirtualTextureLayer * _Layers, int _NumLayers, unsigned int _PageIndex ) {
-    int CompressedDataSize = 0;
+// Pack page layers into one buffer and compress it. Returns stored data that points to _PageData or _CompressedData.
+static const byte * VT_PackPage( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer * _Layers, int _NumLayers, unsigned int _PageIndex, EVirtualTexturePageCompression _Compression, TPodVectorHeap< byte > & _PageData, TPodVectorHeap< byte > & _CompressedData, size_t & _StoredSize ) {
+    size_t PageSize = 0;
     for ( int Layer = 0 ; Layer < _NumLayers ; Layer++ ) {
-        CompressedDataSize = Math::Max( CompressedDataSize, _Layers[Layer].SizeInBytes );
+        PageSize += _Layers[Layer].SizeInBytes;
     }
 
-    byte * CompressedData = NULL;
+    _PageData.ResizeInvalidate( PageSize );
+
+    byte * LayerData = _PageData.ToPtr();
 
     for ( int Layer = 0 ; Layer < _NumLayers ; Layer++ ) {
         SVirtualTextureLayer::SCachedPage * cachedPage = VT_OpenCachedPage( _Struct, _Layers[ Layer ], _PageIndex, SVirtualTextureLayer::OpenActual, false );
         if ( !cachedPage ) {
             GLogger.Printf( "VT_WritePage: couldn't open page Layer %d : %d\n", Layer, _PageIndex );
-            Offset += _Layers[Layer].SizeInBytes;
+            Core::ZeroMem( LayerData, _Layers[Layer].SizeInBytes );
+            LayerData += _Layers[Layer].SizeInBytes;
             continue;
         }
 
         if ( _Layers[Layer].PageCompressionMethod ) {
+            _Layers[Layer].PageCompressionMethod( cachedPage->Image.GetData(), LayerData );
+        } else {
+            Core::Memcpy( LayerData, cachedPage->Image.GetData(), _Layers[Layer].SizeInBytes );
+        }
 
-            if ( !CompressedData ) {
-                CompressedData = ( byte * )GHeapMemory.Alloc( CompressedDataSize );
-            }
+        LayerData += _Layers[Layer].SizeInBytes;
 
-            _Layers[Layer].PageCompressionMethod( cachedPage->Image.GetData(), CompressedData );
+        VT_CloseCachedPage( cachedPage );
+    }
 
-            File->Write( CompressedData, _Layers[Layer].SizeInBytes, Offset );
+    _StoredSize = PageSize;
 
-            //Core::ZeroMem( CompressedData, _Layers[Layer].SizeInBytes );
-            //File->Read( CompressedData, _Layers[Layer].SizeInBytes, Offset );
+    if ( _Compression == VT_PAGE_COMPRESSION_FASTLZ ) {
+        size_t CompressedSize;
 
-            
-            //AFileStream f;
-            //f.OpenWrite( Core::Fmt( "page_%d_%d.bmp", Layer, Offset ) );
-            //WriteBMP( f, 128, 128, 3, CompressedData );
-        } else {
-            File->Write( cachedPage->Image.GetData(), _Layers[Layer].SizeInBytes, Offset );
+        _CompressedData.ResizeInvalidate( Core::FastLZMaxCompressedSize( PageSize ) );
+
+        // Page that can't be compressed is stored as is. Reader distinguishes it by the size.
+        if ( Core::FastLZCompress( _CompressedData.ToPtr(), &CompressedSize, _PageData.ToPtr(), PageSize ) && CompressedSize < PageSize ) {
+            _StoredSize = CompressedSize;
+            return _CompressedData.ToPtr();
         }
+    }
 
+    return _PageData.ToPtr();
+}
 
-        Offset += _Layers[Layer].SizeInBytes;
+SFileOffset VT_WritePage( SVirtualTextureFileHandle * File, SFileOffset Offset, const SVirtualTextureStructure & _Struct, SVirtualTextureLayer * _Layers, int _NumLayers, unsigned int _PageIndex, EVirtualTexturePageCompression _Compression ) {
+    TPodVectorHeap< byte > PageData;
+    TPodVectorHeap< byte > CompressedData;
+    size_t StoredSize;
 
-        VT_CloseCachedPage( cachedPage );
-    }
+    const byte * StoredData = VT_PackPage( _Struct, _Layers, _NumLayers, _PageIndex, _Compression, PageData, CompressedData, StoredSize );
 
-    GHeapMemory.Free( CompressedData );
+    File->Write( StoredData, StoredSize, Offset );
 
-    return Offset;
+    return Offset + StoredSize;
 }
 
-bool VT_WriteFile( const SVirtualTextureStructure & _Struct, int _MaxLods, SVirtualTextureLayer * _Layers, int _NumLayers, const char * FileName ) {
+bool VT_WriteFile( const SVirtualTextureStructure & _Struct, int _MaxLods, SVirtualTextureLayer * _Layers, int _NumLayers, const char * FileName, EVirtualTexturePageCompression _Compression ) {
     SVirtualTextureFileHandle fileHandle;
     SFileOffset fileOffset;
     SVirtualTexturePIT pit;
@@ -1302,18 +1454,45 @@ bool VT_WriteFile( const SVirtualTextureStructure & _Struct, int _MaxLods, SVirt
     // write page address tables
     fileOffset += addressTable.Write( &fileHandle, fileOffset );
 
+    // write page compression
+    tmp = _Compression;
+    fileHandle.Write( &tmp, sizeof( byte ), fileOffset );
+    fileOffset += sizeof( byte );
+
+    // write num stored pages
+    uint32_t numStoredPages = 0;
+    for ( unsigned int i = 0 ; i < addressTable.TotalPages ; i++ ) {
+        if ( _Struct.PageBitfield.IsMarked( i ) ) {
+            numStoredPages++;
+        }
+    }
+    fileHandle.Write( &numStoredPages, sizeof( numStoredPages ), fileOffset );
+    fileOffset += sizeof( numStoredPages );
+
+    // Page offsets are written after the pages, reserve space for them
+    SFileOffset pageOffsetsPos = fileOffset;
+    fileOffset += sizeof( uint64_t ) * ( numStoredPages + 1 );
+
+    SFileOffset firstPageOffset = fileOffset;
+
+    TPodVectorHeap< uint64_t > pageOffsets;
+    pageOffsets.Reserve( numStoredPages + 1 );
+
+    TPodVectorHeap< unsigned int > pageOrder;
+    pageOrder.Reserve( numStoredPages );
+
     // Кол-во страниц в LOD'ах от 0 до 4
     unsigned int numFirstPages = Math::Min< unsigned int >( 85, addressTable.TotalPages );
 
-    // Записываем страницы LOD'ов 0-4
+    // Страницы LOD'ов 0-4
     for ( unsigned int i = 0 ; i < numFirstPages ; i++ ) {
         if ( _Struct.PageBitfield.IsMarked( i ) ) {
-            fileOffset = VT_WritePage( &fileHandle, fileOffset, _Struct, _Layers, _NumLayers, i );
+            pageOrder.Append( i );
         }
     }
 
     if ( addressTable.TableSize ) {
-        // Записываем остальные страницы
+        // Остальные страницы
         for ( int lodNum = 4 ; lodNum < addressTable.NumLods ; lodNum++ ) {
             int          addrTableLod = lodNum - 4;
             unsigned int numNodes = 1 << ( addrTableLod + addrTableLod );
@@ -1329,13 +1508,55 @@ bool VT_WriteFile( const SVirtualTextureStructure & _Struct, int _MaxLods, SVirt
                     unsigned int absoluteIndex = QuadTreeRelativeToAbsoluteIndex( relativeIndex, lodNum );
 
                     if ( _Struct.PageBitfield.IsMarked( absoluteIndex ) ) {
-                        fileOffset = VT_WritePage( &fileHandle, fileOffset, _Struct, _Layers, _NumLayers, absoluteIndex );
+                        pageOrder.Append( absoluteIndex );
                     }
                 }
             }
         }
     }
 
+    AN_ASSERT( pageOrder.Size() == numStoredPages );
+
+    // Pages are packed and compressed in parallel by chunks, then written in file order.
+    // Chunk size bounds the memory used by packed pages.
+    struct SPackedPage
+    {
+        TPodVectorHeap< byte > PageData;
+        TPodVectorHeap< byte > CompressedData;
+        const byte * StoredData;
+        size_t StoredSize;
+    };
+    const int chunkSize = 256;
+    std::vector< SPackedPage > packedPages( chunkSize );
+
+    for ( int chunkStart = 0 ; chunkStart < pageOrder.Size() ; chunkStart += chunkSize ) {
+        int numChunkPages = Math::Min( chunkSize, pageOrder.Size() - chunkStart );
+
+        GAsyncJobManager.ParallelFor( numChunkPages, [&]( int _First, int _Last )
+        {
+            for ( int i = _First ; i < _Last ; i++ ) {
+                SPackedPage & packed = packedPages[i];
+                packed.StoredData = VT_PackPage( _Struct, _Layers, _NumLayers, pageOrder[chunkStart + i], _Compression, packed.PageData, packed.CompressedData, packed.StoredSize );
+            }
+        } );
+
+        for ( int i = 0 ; i < numChunkPages ; i++ ) {
+            SPackedPage & packed = packedPages[i];
+
+            pageOffsets.Append( fileOffset - firstPageOffset );
+
+            fileHandle.Write( packed.StoredData, packed.StoredSize, fileOffset );
+            fileOffset += packed.StoredSize;
+        }
+    }
+
+    pageOffsets.Append( fileOffset - firstPageOffset );
+
+    AN_ASSERT( pageOffsets.Size() == numStoredPages + 1 );
+
+    // write page offsets
+    fileHandle.Write( pageOffsets.ToPtr(), sizeof( uint64_t ) * pageOffsets.Size(), pageOffsetsPos );
+
     return true;
 }
 
@@ -1515,6 +1736,92 @@ void VT_RemoveHDDData( SVirtualTextureStructure & _Struct, SVirtualTextureLayer
 //    }
 //}
 
+#define VT_MANIFEST_ID      0x464d5456 // "VTMF"
+#define VT_MANIFEST_VERSION 1
+
+// Manifest stores rects layout and checksums of rect images from the last build.
+// It is used by incremental build to find out rects that were changed.
+static void VT_WriteManifest( const char * _FileName,
+                              const SVirtualTextureStructure & _Struct,
+                              int _PageWidthLog2,
+                              int _NumLayers,
+                              const std::vector< SRectangleBinBack_RectNode > & _BinRects,
+                              const TPodVectorHeap< uint32_t > & _Checksums ) {
+    AFileStream f;
+
+    if ( !f.OpenWrite( _FileName ) ) {
+        GLogger.Printf( "VT_WriteManifest: couldn't write %s\n", _FileName );
+        return;
+    }
+
+    f.WriteUInt32( VT_MANIFEST_ID );
+    f.WriteUInt32( VT_MANIFEST_VERSION );
+    f.WriteUInt32( _PageWidthLog2 );
+    f.WriteUInt32( _Struct.NumLods );
+    f.WriteUInt32( _NumLayers );
+    f.WriteUInt32( _BinRects.size() );
+
+    for ( int rectIndex = 0 ; rectIndex < (int)_BinRects.size() ; rectIndex++ ) {
+        SRectangleBinBack_RectNode const & rect = _BinRects[ rectIndex ];
+
+        f.WriteUInt32( rect.x );
+        f.WriteUInt32( rect.y );
+        f.WriteUInt32( rect.width );
+        f.WriteUInt32( rect.height );
+        f.WriteUInt32( rect.transposed );
+
+        for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
+            f.WriteUInt32( _Checksums[ rectIndex * _NumLayers + layerIndex ] );
+        }
+    }
+
+    f.WriteUInt32( VT_MANIFEST_ID );
+}
+
+// Returns true if manifest matches current rects layout
+static bool VT_ReadManifest( const char * _FileName,
+                             const SVirtualTextureStructure & _Struct,
+                             int _PageWidthLog2,
+                             int _NumLayers,
+                             const std::vector< SRectangleBinBack_RectNode > & _BinRects,
+                             TPodVectorHeap< uint32_t > & _Checksums ) {
+    AFileStream f;
+
+    if ( !f.OpenRead( _FileName ) ) {
+        return false;
+    }
+
+    if ( f.ReadUInt32() != VT_MANIFEST_ID
+         || f.ReadUInt32() != VT_MANIFEST_VERSION
+         || f.ReadUInt32() != (uint32_t)_PageWidthLog2
+         || f.ReadUInt32() != (uint32_t)_Struct.NumLods
+         || f.ReadUInt32() != (uint32_t)_NumLayers
+         || f.ReadUInt32() != (uint32_t)_BinRects.size() ) {
+        return false;
+    }
+
+    _Checksums.ResizeInvalidate( _BinRects.size() * _NumLayers );
+
+    for ( int rectIndex = 0 ; rectIndex < (int)_BinRects.size() ; rectIndex++ ) {
+        SRectangleBinBack_RectNode const & rect = _BinRects[ rectIndex ];
+
+        if ( f.ReadUInt32() != (uint32_t)rect.x
+             || f.ReadUInt32() != (uint32_t)rect.y
+             || f.ReadUInt32() != (uint32_t)rect.width
+             || f.ReadUInt32() != (uint32_t)rect.height
+             || f.ReadUInt32() != (uint32_t)rect.transposed ) {
+            return false;
+        }
+
+        for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
+            _Checksums[ rectIndex * _NumLayers + layerIndex ] = f.ReadUInt32();
+        }
+    }
+
+    // Manifest was completely written
+    return f.ReadUInt32() == VT_MANIFEST_ID;
+}
+
 bool VT_CreateVirtualTexture( const SVirtualTextureLayerDesc * _Layers,
                               int _NumLayers,
                               const char * _OutputFileName,
@@ -1525,7 +1832,8 @@ bool VT_CreateVirtualTexture( const SVirtualTextureLayerDesc * _Layers,
                               std::vector< SRectangleBinBack_RectNode > & _BinRects,
                               unsigned int & _BinWidth,
                               unsigned int & _BinHeight,
-                              int _MaxCachedPages ) {
+                              int _MaxCachedPages,
+                              bool _bIncremental ) {
 //_MaxCachedPages=1;// FIXME: for debug
     Core::MakeDir( _OutputFileName, true );
 
@@ -1564,30 +1872,106 @@ bool VT_CreateVirtualTexture( const SVirtualTextureLayerDesc * _Layers,
 
     int numRects = _BinRects.size();
 
+    AString manifestFileName = AString( _TempDir ) + "/manifest.bin";
+
+    TPodVectorHeap< uint32_t > prevChecksums;
+    TPodVectorHeap< uint32_t > checksums;
+    checksums.Resize( numRects * _NumLayers );
+    checksums.ZeroMem();
+
+    APageBitfield dirtyPages;
+    bool bUpdate = false;
+
+    if ( _bIncremental ) {
+        bUpdate = VT_ReadManifest( manifestFileName.CStr(), vtStruct, _PageWidthLog2, _NumLayers, _BinRects, prevChecksums );
+
+        if ( bUpdate ) {
+            GLogger.Printf( "VT_CreateVirtualTexture: updating %s\n", _OutputFileName );
+
+            // Pages from the previous build
+            VT_SynchronizePageBitfieldWithHDD( vtStruct, vtLayers[ 0 ] );
+
+            dirtyPages.ResizeInvalidate( vtStruct.NumQuadTreeNodes );
+            dirtyPages.UnmarkAll();
+        } else {
+            // Pages from the previous build are useless if rects layout was changed
+            for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
+                VT_RemoveHDDData( vtStruct, vtLayers[ layerIndex ], true, true );
+            }
+        }
+    }
+
+    int numChangedRects = 0;
+
     for ( int rectIndex = 0 ; rectIndex < numRects ; rectIndex++ ) {
         SRectangleBinBack_RectNode & rect = _BinRects[ rectIndex ];
 
+        bool bChanged = false;
+
         for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
 
             void * imageData = _Layers[ layerIndex ].LoadLayerImage( rect.userdata, rect.width * vtStruct.PageResolution, rect.height * vtStruct.PageResolution );
 
             if ( imageData ) {
 
+                if ( _bIncremental ) {
+                    uint32_t & checksum = checksums[ rectIndex * _NumLayers + layerIndex ];
+
+                    // Image checksum. Never zero to distinguish from the rect that was not built
+                    checksum = Core::Crc32( 0, (const byte *)imageData, rect.width * vtStruct.PageResolution * rect.height * vtStruct.PageResolution * vtLayers[ layerIndex ].NumChannels ) | 1;
+
+                    if ( bUpdate && checksum == prevChecksums[ rectIndex * _NumLayers + layerIndex ] ) {
+                        _Layers[ layerIndex ].FreeLayerImage( imageData );
+                        continue;
+                    }
+                }
+
                 VT_PutImageIntoPages( vtStruct, vtLayers[ layerIndex ], rect, (const byte *)imageData );
 
+                bChanged = true;
+
                 _Layers[ layerIndex ].FreeLayerImage( imageData );
             }
         }
+
+        if ( bUpdate && bChanged ) {
+            numChangedRects++;
+
+            int lod = vtStruct.NumLods - 1;
+
+            for ( int y = 0 ; y < rect.height ; y++ ) {
+                for ( int x = 0 ; x < rect.width ; x++ ) {
+                    dirtyPages.Mark( QuadTreeRelativeToAbsoluteIndex( QuadTreeGetRelativeFromXY( rect.x + x, rect.y + y, lod ), lod ) );
+                }
+            }
+
+            // Rect pages on disk are changing. If the build is interrupted, this rect must be rebuilt next time.
+            for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
+                prevChecksums[ rectIndex * _NumLayers + layerIndex ] = 0;
+            }
+        }
+    }
+
+    APageBitfield borderPages;
+
+    if ( bUpdate ) {
+        GLogger.Printf( "Changed rects: %d from %d\n", numChangedRects, numRects );
+
+        VT_WriteManifest( manifestFileName.CStr(), vtStruct, _PageWidthLog2, _NumLayers, _BinRects, prevChecksums );
+
+        VT_PropagateDirtyPages( vtStruct, dirtyPages );
+        VT_ExpandDirtyPages( vtStruct, dirtyPages, borderPages );
     }
+
 //VT_FitPageData( vtLayers[ 0],true);// FIXME: for debug
     for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
-        VT_MakeLods( vtStruct, vtLayers[ layerIndex ] );
+        VT_MakeLods( vtStruct, vtLayers[ layerIndex ], bUpdate ? &dirtyPages : nullptr );
 
 //VT_FitPageData( vtLayers[ layerIndex],true);// FIXME: for debug
     }
 
     for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
-        VT_GenerateBorders( vtStruct, vtLayers[ layerIndex ] );
+        VT_GenerateBorders( vtStruct, vtLayers[ layerIndex ], bUpdate ? &borderPages : nullptr );
 
 //VT_FitPageData( vtLayers[ layerIndex],true);// FIXME: for debug
     }
@@ -1601,6 +1985,17 @@ bool VT_CreateVirtualTexture( const SVirtualTextureLayerDesc * _Layers,
     CreateMinImage( vtCache1, (AString( _outputFileName ) + "_1.png").CStr() );
 #endif
 
+    if ( _bIncremental ) {
+        // Keep pages for the next build
+        for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
+            VT_FitPageData( vtLayers[ layerIndex ], true );
+        }
+
+        VT_WriteManifest( manifestFileName.CStr(), vtStruct, _PageWidthLog2, _NumLayers, _BinRects, checksums );
+
+        return true;
+    }
+
     for ( int layerIndex = 0 ; layerIndex < _NumLayers ; layerIndex++ ) {
         // Запрещаем дамп страниц кеша, которые еще находятся в оперативной памяти
         vtLayers[ layerIndex ].bAllowDump = false;
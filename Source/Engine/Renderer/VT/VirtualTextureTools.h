@@ -34,6 +34,7 @@ SOFTWARE.
 
 #include <Core/Public/CoreMath.h>
 #include <Core/Public/BitMask.h>
+#include <Core/Public/Thread.h>
 #include "RectangleBinPack.h"
 
 #include <unordered_map>
@@ -91,9 +92,21 @@ struct SVirtualTextureLayer
             GZoneMemory.Free( p );
         }
 
+        // Состояние страницы. Страница загружается и сбрасывается на диск вне блокировки слоя,
+        // другие потоки, открывающие эту страницу, ждут завершения
+        enum EState {
+            STATE_LOADED,   // Данные страницы загружены
+            STATE_LOADING,  // Страница загружается из файла
+            STATE_FAILED,   // Не удалось загрузить страницу, она удалена из кеша
+            STATE_DUMPING,  // Страница сбрасывается на диск
+            STATE_DUMPED    // Страница сброшена на диск и удалена из кеша
+        };
+
         SVirtualTextureImage  Image;
         bool        bNeedToSave;
-        int         Used;
+        AAtomicInt  Used;
+        AAtomicInt  State;
+        int64_t     LastUse;        // Время последнего открытия страницы (для LRU)
     };
 
     AString         Path;
@@ -113,6 +126,9 @@ struct SVirtualTextureLayer
 
     std::unordered_map< unsigned int, SCachedPage * > Pages;
 
+    int64_t         UseCounter;
+
+    AMutex          Lock;           // Страницы кеша открываются из нескольких потоков
 };
 
 // Создает структуру виртуальной текстуры, на выходе _struct и binRects
@@ -134,6 +150,7 @@ SVirtualTextureLayer::SCachedPage * VT_FindInCache( SVirtualTextureLayer & _cach
 
 // Чистка кеша, сброс (запись) страниц кеша на диск в случае переполнения
 // если _forceFit = true, то запись страниц кеша на диск в любом случае.
+// Иначе из кеша удаляются давно не использованные страницы, пока кеш не заполнен на 3/4.
 // Если страница кеша в текущий момент открыта, то она остается в кеше в любом случае.
 void VT_FitPageData( SVirtualTextureLayer & _cache, bool _forceFit = false );
 
@@ -163,8 +180,15 @@ bool VT_LoadQuad( const SVirtualTextureStructure & _struct,
 // Лодирование четырех страниц
 void VT_Downsample( const SVirtualTextureStructure & _Struct, SVirtualTextureLayer::SCachedPage * _pages[4], byte * _downsample );
 
-// Создает лоды VT
-void VT_MakeLods( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache );
+// Создает лоды VT. Страницы одного лода обрабатываются параллельно.
+// Если задан _dirtyPages, то пересчитываются только отмеченные страницы (см. VT_PropagateDirtyPages)
+void VT_MakeLods( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, const APageBitfield * _dirtyPages = nullptr );
+
+// Отмечает родителей измененных страниц, чтобы пересчитать их лоды
+void VT_PropagateDirtyPages( const SVirtualTextureStructure & _struct, APageBitfield & _dirtyPages );
+
+// Отмечает соседей измененных страниц, чтобы пересчитать их бордеры
+void VT_ExpandDirtyPages( const SVirtualTextureStructure & _struct, APageBitfield const & _dirtyPages, APageBitfield & _borderPages );
 
 // Синхронизирует page bitfield с жестким диском (заново заполняет pageBitfield на основе страниц,
 // хранящихся на диске
@@ -185,14 +209,14 @@ void VT_GenerateBorder_UL( SVirtualTextureStructure & _struct, SVirtualTextureLa
 void VT_GenerateBorder_UR( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, unsigned int _relativeIndex, int _lod, byte * _pageData );
 void VT_GenerateBorder_DL( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, unsigned int _relativeIndex, int _lod, byte * _pageData );
 void VT_GenerateBorder_DR( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, unsigned int _relativeIndex, int _lod, byte * _pageData );
-void VT_GenerateBordersLod( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, int _lod );
-void VT_GenerateBorders( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache );
+void VT_GenerateBordersLod( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, int _lod, const APageBitfield * _dirtyPages = nullptr );
+void VT_GenerateBorders( SVirtualTextureStructure & _struct, SVirtualTextureLayer & _cache, const APageBitfield * _dirtyPages = nullptr );
 
 // Пишет страницу в файл VT
-SFileOffset VT_WritePage( SVirtualTextureFileHandle * File, SFileOffset _offset, const SVirtualTextureStructure & _Struct, SVirtualTextureLayer * _Layers, int _numLayers, unsigned int _PageIndex );
+SFileOffset VT_WritePage( SVirtualTextureFileHandle * File, SFileOffset _offset, const SVirtualTextureStructure & _Struct, SVirtualTextureLayer * _Layers, int _numLayers, unsigned int _PageIndex, EVirtualTexturePageCompression _Compression );
 
 // Пишет файл VT
-bool VT_WriteFile( const SVirtualTextureStructure & _struct, int _maxLods, SVirtualTextureLayer * _Layers, int _numLayers, const char * _fileName );
+bool VT_WriteFile( const SVirtualTextureStructure & _struct, int _maxLods, SVirtualTextureLayer * _Layers, int _numLayers, const char * _fileName, EVirtualTexturePageCompression _Compression = VT_PAGE_COMPRESSION_FASTLZ );
 
 struct SVirtualTextureLayerDesc {
     int     SizeInBytes;   // Размер страницы после компрессии
@@ -205,6 +229,9 @@ struct SVirtualTextureLayerDesc {
     void    (*PageCompressionMethod)( const void * _InputData, void * _OutputData );
 };
 
+// Создает виртуальную текстуру.
+// Если _bIncremental = true, то страницы сохраняются во временном каталоге вместе со списком прямоугольников,
+// и при следующей сборке пересчитываются только страницы измененных прямоугольников.
 bool VT_CreateVirtualTexture( const SVirtualTextureLayerDesc * _Layers,
                               int _NumLayers,
                               const char * _OutputFileName,
@@ -215,7 +242,8 @@ bool VT_CreateVirtualTexture( const SVirtualTextureLayerDesc * _Layers,
                               std::vector< SRectangleBinBack_RectNode > & _BinRects,
                               unsigned int & _BinWidth,
                               unsigned int & _BinHeight,
-                              int _MaxCachedPages = 32768 );
+                              int _MaxCachedPages = 32768,
+                              bool _bIncremental = false );
 
 void VT_TransformTextureCoords( float * _TexCoord,
                                 unsigned int _NumVerts,
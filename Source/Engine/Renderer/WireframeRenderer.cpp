@@ -106,17 +106,21 @@ void AddWireframePass( AFrameGraph & FrameGraph, AFrameGraphTexture * RenderTarg
         drawCmd.InstanceCount = 1;
         drawCmd.StartInstanceLocation = 0;
 
-        for ( int i = 0 ; i < GRenderView->InstanceCount ; i++ ) {
+        for ( int i = 0 ; i < GRenderView->InstanceCount ; ) {
             SRenderInstance const * instance = GFrameData->Instances[GRenderView->FirstInstance + i];
 
+            // Merged instances are drawn with one instanced draw call
+            i += instance->InstanceCount;
+
             if ( !BindMaterialWireframePass( instance ) ) {
                 continue;
             }
 
             BindTextures( instance->MaterialInstance, instance->Material->WireframePassTextureCount );
             BindSkeleton( instance->SkeletonOffset, instance->SkeletonSize );
-            BindInstanceConstants( instance );
+            BindInstanceConstants( instance, instance->InstanceCount );
 
+            drawCmd.InstanceCount = instance->InstanceCount;
             drawCmd.IndexCountPerInstance = instance->IndexCount;
             drawCmd.StartIndexLocation = instance->StartIndexLocation;
             drawCmd.BaseVertexLocation = instance->BaseVertexLocation;
@@ -29,11 +29,21 @@ SOFTWARE.
 */
 
 #include <Runtime/Public/AsyncJobManager.h>
+#include <Runtime/Public/Profiler.h>
 #include <Core/Public/Logger.h>
+#include <Core/Public/CoreMath.h>
+#include <Core/Public/Core.h>
+#include <Core/Public/Memory.h>
 
 constexpr int AAsyncJobManager::MAX_WORKER_THREADS;
 constexpr int AAsyncJobManager::MAX_JOB_LISTS;
 
+/** Failed job fetches before idle worker thread goes to sleep */
+static constexpr int MAX_IDLE_SPINS = 64;
+
+/** Worker thread index for current thread, -1 for non-worker threads */
+static thread_local int WorkerThreadIndex = -1;
+
 AAsyncJobManager::AAsyncJobManager() {
 }
 
@@ -42,7 +52,7 @@ void AAsyncJobManager::Initialize( int _NumWorkerThreads, int _NumJobLists ) {
         GLogger.Printf( "AAsyncJobManager::Initialize: NumWorkerThreads > MAX_WORKER_THREADS\n" );
         _NumWorkerThreads = MAX_WORKER_THREADS;
     } else if ( _NumWorkerThreads <= 0 ) {
-        _NumWorkerThreads = MAX_WORKER_THREADS;
+        _NumWorkerThreads = AThread::NumHardwareThreads > 0 ? Math::Min( AThread::NumHardwareThreads, MAX_WORKER_THREADS ) : 4;
     }
 
     AN_ASSERT( _NumJobLists >= 1 && _NumJobLists <= MAX_JOB_LISTS );
@@ -57,8 +67,12 @@ void AAsyncJobManager::Initialize( int _NumWorkerThreads, int _NumJobLists ) {
     }
 
     TotalJobs.Store( 0 );
+    NextQueue.Store( 0 );
 
     NumWorkerThreads = _NumWorkerThreads;
+    for ( int i = 0 ; i < NumWorkerThreads ; i++ ) {
+        Queues[i].Head = 0;
+    }
     for ( int i = 0 ; i < NumWorkerThreads ; i++ ) {
         Contexts[i].JobManager = this;
         Contexts[i].ThreadId = i;
@@ -84,6 +98,12 @@ void AAsyncJobManager::Deinitialize() {
     for ( int i = 0 ; i < NumWorkerThreads ; i++ ) {
         WorkerThread[i].Join();
     }
+
+    for ( int i = 0 ; i < NumWorkerThreads ; i++ ) {
+        AN_ASSERT( Queues[i].Jobs.Size() == Queues[i].Head );
+        Queues[i].Jobs.Free();
+        Queues[i].Head = 0;
+    }
 }
 
 void AAsyncJobManager::NotifyThreads() {
@@ -99,8 +119,11 @@ void AAsyncJobManager::_WorkerThreadRoutine( void * _Data ) {
 }
 
 void AAsyncJobManager::WorkerThreadRoutine( int _ThreadId ) {
-    SAsyncJob job = {};
-    bool haveJob;
+    WorkerThreadIndex = _ThreadId;
+
+    char threadName[32];
+    Core::Sprintf( threadName, sizeof( threadName ), "Worker %d", _ThreadId );
+    GProfiler.SetThreadName( threadName );
 
 #ifdef AN_ACTIVE_THREADS_COUNTERS
     NumActiveThreads.Increment();
@@ -114,80 +137,320 @@ void AAsyncJobManager::WorkerThreadRoutine( int _ThreadId ) {
 
         //GLogger.Printf( "Thread waiting %d\n", _ThreadId );
 
+        // Don't keep small blocks in the cache of idle thread
+        GZoneMemory.TrimThreadCache();
+
         EventNotify[ _ThreadId ].Wait();
 
 #ifdef AN_ACTIVE_THREADS_COUNTERS
         NumActiveThreads.Increment();
 #endif
 
-        for ( int currentList = 0 ; TotalJobs.Load() > 0 ; currentList++ ) {
+        // Counter is increased after the job was pushed to the queue, so fetching can only fail for a short period
+        // while other thread is between pop and counter decrement or holds the queue lock. Spin for a while, then
+        // sleep on the event. The wait has a timeout, so a job that was skipped on a busy queue is not left behind.
+        int numFailedFetches = 0;
+        while ( TotalJobs.Load() > 0 ) {
+            SAsyncJob * job = FetchJob( _ThreadId );
+            if ( !job ) {
+                if ( ++numFailedFetches < MAX_IDLE_SPINS ) {
+                    YieldCPU();
+                } else {
+                    bool bTimedOut;
+                    EventNotify[ _ThreadId ].WaitTimeout( 1, bTimedOut );
+                    numFailedFetches = 0;
+                }
+                continue;
+            }
+
+            numFailedFetches = 0;
+
+            ExecuteJob( job );
+        }
+    }
+
+#ifdef AN_ACTIVE_THREADS_COUNTERS
+    NumActiveThreads.Decrement();
+#endif
+
+    WorkerThreadIndex = -1;
+
+    GLogger.Printf( "Terminating worker thread (%d)\n", _ThreadId );
+}
+
+void AAsyncJobManager::PushJob( SAsyncJob * _Job ) {
+    int queueIndex = WorkerThreadIndex;
+
+    // Jobs from non-worker threads are distributed between workers
+    if ( queueIndex < 0 ) {
+        queueIndex = ( NextQueue.FetchIncrement() & 0x7fffffff ) % NumWorkerThreads;
+    }
 
-            int fetchIndex = ( _ThreadId + currentList ) % NumJobLists;
+    SWorkerQueue & queue = Queues[queueIndex];
+    {
+        ASpinLockGuard lockGuard( queue.Lock );
+        queue.Jobs.Append( _Job );
+    }
 
-            AAsyncJobList * jobList = &JobList[ fetchIndex ];
+    TotalJobs.Increment();
+}
 
-            // Check if list have a jobs
-            if ( jobList->FetchCount.Load() > 0 ) {
+SAsyncJob * AAsyncJobManager::FetchJob( int _ThreadId ) {
+    SAsyncJob * job = nullptr;
 
-                haveJob = false;
+    // Non-worker threads can only steal
+    if ( _ThreadId < 0 ) {
+        _ThreadId = ( NextQueue.FetchIncrement() & 0x7fffffff ) % NumWorkerThreads;
 
-                // fetch job
-                {
-                    AMutexGurad syncGuard( jobList->SubmitSync );
+        SWorkerQueue & queue = Queues[_ThreadId];
+        ASpinLockGuard lockGuard( queue.Lock );
+        if ( queue.Jobs.Size() > queue.Head ) {
+            job = queue.Jobs[queue.Head++];
+            if ( queue.Jobs.Size() == queue.Head ) {
+                queue.Jobs.Clear();
+                queue.Head = 0;
+            }
+        }
+    } else {
+        // Pop from own queue (LIFO for cache locality)
+        SWorkerQueue & queue = Queues[_ThreadId];
+        ASpinLockGuard lockGuard( queue.Lock );
+        if ( queue.Jobs.Size() > queue.Head ) {
+            job = queue.Jobs.Last();
+            queue.Jobs.RemoveLast();
+            if ( queue.Jobs.Size() == queue.Head ) {
+                queue.Jobs.Clear();
+                queue.Head = 0;
+            }
+        }
+    }
 
-                    //if ( jobList->FetchLock.Increment() == 1 )
-                    //{
-                    if ( jobList->SubmittedJobs ) {
-                        job = *jobList->SubmittedJobs;
-                        jobList->SubmittedJobs = job.Next;
-                        haveJob = true;
+    // Steal from other queues (FIFO, oldest jobs are usually the biggest ones)
+    for ( int i = 1 ; !job && i < NumWorkerThreads ; i++ ) {
+        SWorkerQueue & queue = Queues[( _ThreadId + i ) % NumWorkerThreads];
 
-                        jobList->FetchCount.Decrement();
-                        TotalJobs.Decrement();
-                    }
-                    //    jobList->FetchLock.Decrement();
-                    //} else {
-                    //    jobList->FetchLock.Decrement();
-                    //}
-                }
+        if ( !queue.Lock.TryLock() ) {
+            continue;
+        }
+        if ( queue.Jobs.Size() > queue.Head ) {
+            job = queue.Jobs[queue.Head++];
+            if ( queue.Jobs.Size() == queue.Head ) {
+                queue.Jobs.Clear();
+                queue.Head = 0;
+            }
+        }
+        queue.Lock.Unlock();
+    }
+
+    if ( job ) {
+        TotalJobs.Decrement();
+    }
+
+    return job;
+}
+
+void AAsyncJobManager::ExecuteJob( SAsyncJob * _Job ) {
+    AN_PROFILER_SCOPE( "AsyncJob" );
 
-                if ( haveJob ) {
-                    job.Callback( job.Data );
+    if ( _Job->TaskGroup ) {
+        ATaskGroup * taskGroup = _Job->TaskGroup;
 
-                    // Check if this was last processed job in the list
-                    if ( jobList->SubmittedJobsCount.Decrement() == 0 ) {
-                        AMutexGurad syncGuard( jobList->SubmitSync );
+        _Job->Callback( _Job->Data );
 
-                        // Check for new submits
-                        if ( !jobList->SubmittedJobs && jobList->SubmittedJobsCount.Load() == 0 ) {
+        // Job storage belongs to the group, so don't touch the job after this
+        taskGroup->PendingJobs.Decrement();
+        return;
+    }
+
+    AAsyncJobList * jobList = _Job->JobList;
 
-                            // Check if already signalled from other thread
-                            if ( !jobList->bSignalled ) {
-                                jobList->bSignalled = true;
-                                jobList->EventDone.Signal();
-                            }
-                        }
-                    }
+    _Job->Callback( _Job->Data );
+
+    // Release continuations
+    if ( _Job->NumContinuations > 0 ) {
+        bool bHaveNewJobs = false;
+        {
+            ASpinLockGuard lockGuard( jobList->DependencyLock );
+            for ( int i = 0 ; i < _Job->NumContinuations ; i++ ) {
+                SAsyncJob * continuation = &jobList->JobPool[ _Job->Continuations[i] ];
+                if ( --continuation->NumDependencies == 0 ) {
+                    PushJob( continuation );
+                    bHaveNewJobs = true;
                 }
             }
         }
+        if ( bHaveNewJobs ) {
+            NotifyThreads();
+        }
     }
 
-#ifdef AN_ACTIVE_THREADS_COUNTERS
-    NumActiveThreads.Decrement();
-#endif
+    // Check if this was last processed job in the list
+    if ( jobList->SubmittedJobsCount.Decrement() == 0 ) {
+        AMutexGurad syncGuard( jobList->SubmitSync );
+
+        // Check for new submits
+        if ( jobList->SubmittedJobsCount.Load() == 0 ) {
+
+            // Check if already signalled from other thread
+            if ( !jobList->bSignalled.Load() ) {
+                jobList->bSignalled.Store( true );
+                jobList->EventDone.Signal();
+            }
+        }
+    }
+}
+
+bool AAsyncJobManager::TryExecuteJob() {
+    if ( TotalJobs.Load() <= 0 ) {
+        return false;
+    }
+
+    SAsyncJob * job = FetchJob( WorkerThreadIndex );
+    if ( !job ) {
+        return false;
+    }
+
+    ExecuteJob( job );
+    return true;
+}
+
+namespace {
+
+struct SParallelForContext
+{
+    void (*Callback)( int, int, void * );
+    void * Data;
+    int Count;
+    int MinBatchSize;
+    int NumThreads;
+    AAtomicInt NextIndex;
+};
 
-    GLogger.Printf( "Terminating worker thread (%d)\n", _ThreadId );
+}
+
+static void ParallelForWork( void * _Data ) {
+    SParallelForContext * context = ( SParallelForContext * )_Data;
+
+    for ( ;; ) {
+        int first = context->NextIndex.Load();
+        int last;
+        do {
+            if ( first >= context->Count ) {
+                return;
+            }
+
+            // Guided chunking: big batches first, smaller batches as work runs out to balance the tail
+            int remaining = context->Count - first;
+            int batchSize = Math::Max( context->MinBatchSize, remaining / ( context->NumThreads * 2 ) );
+            last = first + Math::Min( batchSize, remaining );
+        } while ( !context->NextIndex.CompareExchangeWeak( first, last ) );
+
+        context->Callback( first, last, context->Data );
+    }
+}
+
+void AAsyncJobManager::ParallelFor( int _Count, void (*_Callback)( int, int, void * ), void * _Data, int _MinBatchSize ) {
+    if ( _Count <= 0 ) {
+        return;
+    }
+
+    _MinBatchSize = Math::Max( _MinBatchSize, 1 );
+
+    int numBatches = ( _Count + _MinBatchSize - 1 ) / _MinBatchSize;
+
+    // Small workload, don't wake up worker threads
+    if ( numBatches <= 1 || NumWorkerThreads == 0 ) {
+        _Callback( 0, _Count, _Data );
+        return;
+    }
+
+    // Current thread is working too
+    int numJobs = Math::Min( numBatches - 1, NumWorkerThreads );
+
+    SParallelForContext context;
+    context.Callback = _Callback;
+    context.Data = _Data;
+    context.Count = _Count;
+    context.MinBatchSize = _MinBatchSize;
+    context.NumThreads = numJobs + 1;
+    context.NextIndex.Store( 0 );
+
+    ATaskGroup taskGroup( this );
+    for ( int i = 0 ; i < numJobs ; i++ ) {
+        taskGroup.PushJob( ParallelForWork, &context );
+    }
+    NotifyThreads();
+
+    ParallelForWork( &context );
+
+    taskGroup.Wait();
+}
+
+ATaskGroup::ATaskGroup( AAsyncJobManager * _JobManager )
+    : JobManager( _JobManager )
+{
+    FirstBlock.Next = nullptr;
+    CurrentBlock = &FirstBlock;
+    NumJobsInBlock = 0;
+    PendingJobs.Store( 0 );
+}
+
+ATaskGroup::~ATaskGroup() {
+    Wait();
+
+    SJobBlock * block = FirstBlock.Next;
+    while ( block ) {
+        SJobBlock * next = block->Next;
+        GHeapMemory.Free( block );
+        block = next;
+    }
+}
+
+void ATaskGroup::Run( void (*_Callback)( void * ), void * _Data ) {
+    PushJob( _Callback, _Data );
+
+    JobManager->NotifyThreads();
+}
+
+void ATaskGroup::PushJob( void (*_Callback)( void * ), void * _Data ) {
+    if ( NumJobsInBlock == JOB_BLOCK_SIZE ) {
+        if ( !CurrentBlock->Next ) {
+            CurrentBlock->Next = ( SJobBlock * )GHeapMemory.Alloc( sizeof( SJobBlock ) );
+            CurrentBlock->Next->Next = nullptr;
+        }
+        CurrentBlock = CurrentBlock->Next;
+        NumJobsInBlock = 0;
+    }
+
+    SAsyncJob * job = &CurrentBlock->Jobs[NumJobsInBlock++];
+    job->Callback = _Callback;
+    job->Data = _Data;
+    job->JobList = nullptr;
+    job->TaskGroup = this;
+    job->NumDependencies = 0;
+    job->NumContinuations = 0;
+
+    PendingJobs.Increment();
+
+    JobManager->PushJob( job );
+}
+
+void ATaskGroup::Wait() {
+    while ( PendingJobs.Load() > 0 ) {
+        if ( !JobManager->TryExecuteJob() ) {
+            YieldCPU();
+        }
+    }
+
+    // All jobs are done, job storage can be reused
+    CurrentBlock = &FirstBlock;
+    NumJobsInBlock = 0;
 }
 
 AAsyncJobList::AAsyncJobList() {
-    JobList = nullptr;
-    SubmittedJobs = nullptr;
     SubmittedJobsCount.Store( 0 );
-    FetchCount.Store( 0 );
-    //FetchLock.Store( 0 );
     NumPendingJobs = 0;
-    bSignalled = false;
+    bSignalled.Store( false );
 }
 
 AAsyncJobList::~AAsyncJobList() {
@@ -201,20 +464,49 @@ void AAsyncJobList::SetMaxParallelJobs( int _MaxParallelJobs ) {
     JobPool.Clear();
 }
 
-void AAsyncJobList::AddJob( void (*_Callback)( void * ), void * _Data ) {
+int AAsyncJobList::AddJob( void (*_Callback)( void * ), void * _Data ) {
     if ( JobPool.Size() == JobPool.Capacity() ) {
         GLogger.Printf( "Warning: AAsyncJobList::AddJob: job pool overflow, use SetMaxParallelJobs to reserve proper pool size (current size %d)\n", JobPool.Capacity() );
 
-        SubmitAndWait();
-        SetMaxParallelJobs( JobPool.Capacity() * 2 );
+        // Worker queues keep pointers to the submitted jobs, so they must be done before the pool is moved.
+        // Pending jobs are not in the queues yet and job handles are indices, so the handles stay valid.
+        WaitSubmittedJobs();
+
+        JobPool.Reserve( JobPool.Capacity() * 2 );
     }
 
     SAsyncJob & job = JobPool.Append();
     job.Callback = _Callback;
     job.Data = _Data;
-    job.Next = JobList;
-    JobList = &job;
+    job.JobList = this;
+    job.TaskGroup = nullptr;
+    // Submitter holds one reference until the job list is submitted
+    job.NumDependencies = 1;
+    job.NumContinuations = 0;
     NumPendingJobs++;
+
+    return JobPool.Size() - 1;
+}
+
+void AAsyncJobList::AddDependency( int _Job, int _DependsOn ) {
+    const int firstPending = JobPool.Size() - NumPendingJobs;
+
+    AN_ASSERT( _Job >= firstPending && _Job < JobPool.Size() );
+    AN_ASSERT( _DependsOn >= firstPending && _DependsOn < JobPool.Size() );
+    AN_ASSERT( _Job != _DependsOn );
+
+    if ( _Job < firstPending || _DependsOn < firstPending ) {
+        GLogger.Printf( "Warning: AAsyncJobList::AddDependency: job is already submitted\n" );
+        return;
+    }
+
+    SAsyncJob & dependency = JobPool[_DependsOn];
+    if ( dependency.NumContinuations == MAX_JOB_CONTINUATIONS ) {
+        CriticalError( "AAsyncJobList::AddDependency: MAX_JOB_CONTINUATIONS hit\n" );
+    }
+
+    dependency.Continuations[dependency.NumContinuations++] = _Job;
+    JobPool[_Job].NumDependencies++;
 }
 
 void AAsyncJobList::Submit() {
@@ -226,40 +518,60 @@ void AAsyncJobManager::SubmitJobList( AAsyncJobList * InJobList ) {
         return;
     }
 
-    SAsyncJob * headJob = &InJobList->JobPool[ InJobList->JobPool.Size() - InJobList->NumPendingJobs ];
-    AN_ASSERT( headJob->Next == nullptr );
+    const int firstJob = InJobList->JobPool.Size() - InJobList->NumPendingJobs;
+    const int numJobs = InJobList->NumPendingJobs;
 
     // lock section
     {
         AMutexGurad syncGuard( InJobList->SubmitSync );
 
-        headJob->Next = InJobList->SubmittedJobs;
-        InJobList->SubmittedJobs = InJobList->JobList;
+        InJobList->SubmittedJobsCount.Add( numJobs );
 
-        InJobList->SubmittedJobsCount.Add( InJobList->NumPendingJobs );
-        InJobList->FetchCount.Add( InJobList->NumPendingJobs );
+        InJobList->bSignalled.Store( false );
+    }
 
-        TotalJobs.Add( InJobList->NumPendingJobs );
+    InJobList->NumPendingJobs = 0;
 
-        InJobList->bSignalled = false;
+    // Release submitter reference. Jobs without dependencies become ready here, the rest are
+    // pushed by the worker that finishes their last dependency.
+    bool bHaveNewJobs = false;
+    {
+        ASpinLockGuard lockGuard( InJobList->DependencyLock );
+        for ( int i = firstJob ; i < firstJob + numJobs ; i++ ) {
+            SAsyncJob * job = &InJobList->JobPool[i];
+            if ( --job->NumDependencies == 0 ) {
+                PushJob( job );
+                bHaveNewJobs = true;
+            }
+        }
     }
 
-    NotifyThreads();
-    InJobList->JobList = nullptr;
-    InJobList->NumPendingJobs = 0;
+    if ( bHaveNewJobs ) {
+        NotifyThreads();
+    }
+}
+
+void AAsyncJobList::WaitSubmittedJobs() {
+    if ( JobPool.Size() == NumPendingJobs ) {
+        return;
+    }
+
+    while ( !bSignalled.Load() ) {
+        // Help worker threads while the list is in progress
+        if ( JobManager->TryExecuteJob() ) {
+            continue;
+        }
+        EventDone.Wait();
+    }
+
+    AN_ASSERT( SubmittedJobsCount.Load() == 0 );
 }
 
 void AAsyncJobList::Wait() {
     int jobsCount = JobPool.Size() - NumPendingJobs;
 
     if ( jobsCount > 0 ) {
-        while ( !bSignalled ) {
-            EventDone.Wait();
-        }
-
-        AN_ASSERT( SubmittedJobsCount.Load() == 0 );
-        AN_ASSERT( FetchCount.Load() == 0 );
-        AN_ASSERT( SubmittedJobs == nullptr );
+        WaitSubmittedJobs();
 
         if ( NumPendingJobs > 0 ) {
 
@@ -267,9 +579,12 @@ void AAsyncJobList::Wait() {
 
             JobPool.Remove( 0, jobsCount );
 
-            JobList = JobPool.ToPtr() + ( NumPendingJobs - 1 );
-            for ( int i = 1 ; i < NumPendingJobs ; i++ ) {
-                JobPool[i].Next = &JobPool[i - 1];
+            // Fixup job handles
+            for ( int i = 0 ; i < NumPendingJobs ; i++ ) {
+                SAsyncJob & job = JobPool[i];
+                for ( int c = 0 ; c < job.NumContinuations ; c++ ) {
+                    job.Continuations[c] -= jobsCount;
+                }
             }
 
         } else {
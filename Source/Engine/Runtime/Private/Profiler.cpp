@@ -0,0 +1,322 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <Runtime/Public/Profiler.h>
+#include <Runtime/Public/RuntimeVariable.h>
+#include <Core/Public/Logger.h>
+#include <Core/Public/Memory.h>
+#include <Core/Public/Core.h>
+#include <Core/Public/CoreMath.h>
+
+#include <stdio.h>
+
+ARuntimeVariable rt_Profiler( _CTS( "rt_Profiler" ), _CTS( "0" ) );
+
+AProfiler GProfiler;
+
+static thread_local void * ThreadBuffer = nullptr;
+static thread_local int ThreadBufferGeneration = -1;
+static thread_local char ThreadName[32] = {};
+
+AN_FORCEINLINE int64_t ProfilerTime()
+{
+    return StdChrono::duration_cast< StdChrono::nanoseconds >( StdChrono::high_resolution_clock::now().time_since_epoch() ).count();
+}
+
+void AProfiler::Initialize()
+{
+    StartTime = ProfilerTime();
+    NumThreads.Store( 0 );
+    bDumpRequested.Store( false );
+    bEnabled = rt_Profiler;
+
+    SetThreadName( "Main" );
+}
+
+void AProfiler::Deinitialize()
+{
+    bEnabled = false;
+
+    ASpinLockGuard guard( RegisterLock );
+
+    Generation.Increment();
+
+    int numThreads = NumThreads.Load();
+    for ( int i = 0 ; i < numThreads ; i++ ) {
+        GHeapMemory.Free( Threads[i]->Events );
+        GHeapMemory.Free( Threads[i] );
+        Threads[i] = nullptr;
+    }
+    NumThreads.Store( 0 );
+}
+
+void AProfiler::SetThreadName( const char * _Name )
+{
+    Core::Strcpy( ThreadName, sizeof( ThreadName ), _Name );
+
+    if ( ThreadBuffer && ThreadBufferGeneration == Generation.Load() ) {
+        SThreadBuffer * buffer = ( SThreadBuffer * )ThreadBuffer;
+        ASpinLockGuard guard( RegisterLock );
+        Core::Strcpy( buffer->Name, sizeof( buffer->Name ), _Name );
+    }
+}
+
+AProfiler::SThreadBuffer * AProfiler::GetThreadBuffer()
+{
+    int generation = Generation.Load();
+
+    if ( ThreadBuffer && ThreadBufferGeneration == generation ) {
+        return ( SThreadBuffer * )ThreadBuffer;
+    }
+
+    ASpinLockGuard guard( RegisterLock );
+
+    int threadIndex = NumThreads.Load();
+    if ( threadIndex == MAX_THREADS ) {
+        return nullptr;
+    }
+
+    SThreadBuffer * buffer = ( SThreadBuffer * )GHeapMemory.ClearedAlloc( sizeof( SThreadBuffer ) );
+    buffer->Events = ( SEvent * )GHeapMemory.Alloc( sizeof( SEvent ) * RING_BUFFER_SIZE );
+    buffer->NumEvents.Store( 0 );
+    buffer->ThreadIndex = threadIndex;
+    if ( ThreadName[0] ) {
+        Core::Strcpy( buffer->Name, sizeof( buffer->Name ), ThreadName );
+    } else {
+        Core::Sprintf( buffer->Name, sizeof( buffer->Name ), "Thread %d", threadIndex );
+    }
+
+    Threads[threadIndex] = buffer;
+    NumThreads.Store( threadIndex + 1 );
+
+    ThreadBuffer = buffer;
+    ThreadBufferGeneration = generation;
+
+    return buffer;
+}
+
+AN_FORCEINLINE void AProfiler::WriteEvent( SEvent & _Event )
+{
+    SThreadBuffer * buffer = GetThreadBuffer();
+    if ( !buffer ) {
+        return;
+    }
+
+    _Event.TimeStamp = ProfilerTime();
+
+    // Only the owner thread writes the buffer. The event is published by the counter.
+    int64_t numEvents = buffer->NumEvents.LoadRelaxed();
+
+    buffer->Events[numEvents & ( RING_BUFFER_SIZE - 1 )] = _Event;
+
+    buffer->NumEvents.Store( numEvents + 1 );
+}
+
+void AProfiler::BeginScope( const char * _Name )
+{
+    SEvent event;
+    event.Name = _Name;
+    event.Type = EVENT_BEGIN;
+    event.Value = 0;
+    WriteEvent( event );
+}
+
+void AProfiler::EndScope()
+{
+    SEvent event;
+    event.Name = nullptr;
+    event.Type = EVENT_END;
+    event.Value = 0;
+    WriteEvent( event );
+}
+
+void AProfiler::Counter( const char * _Name, double _Value )
+{
+    SEvent event;
+    event.Name = _Name;
+    event.Type = EVENT_COUNTER;
+    event.Value = _Value;
+    WriteEvent( event );
+}
+
+void AProfiler::NextFrame( int _FrameNumber )
+{
+    if ( bEnabled ) {
+        SEvent event;
+        event.Name = "Frame";
+        event.Type = EVENT_FRAME;
+        event.FrameNumber = _FrameNumber;
+        WriteEvent( event );
+    }
+
+    if ( bDumpRequested.Load() ) {
+        bDumpRequested.Store( false );
+        WriteChromeTrace( DumpFileName );
+    }
+
+    bEnabled = rt_Profiler;
+}
+
+void AProfiler::RequestDump( const char * _FileName )
+{
+    Core::Strcpy( DumpFileName, sizeof( DumpFileName ), _FileName );
+    bDumpRequested.Store( true );
+}
+
+int64_t AProfiler::CopyEvents( SThreadBuffer const * _Buffer, SEvent * _Events, int64_t & _NumEvents ) const
+{
+    int64_t numEvents = _Buffer->NumEvents.Load();
+    int64_t firstEvent = numEvents > RING_BUFFER_SIZE ? numEvents - RING_BUFFER_SIZE : 0;
+
+    // Events keep their ring buffer positions in the snapshot
+    for ( int64_t n = firstEvent ; n < numEvents ; n++ ) {
+        int index = n & ( RING_BUFFER_SIZE - 1 );
+        _Events[index] = _Buffer->Events[index];
+    }
+
+    // Order the copy before the counter is read again
+    std::atomic_thread_fence( std::memory_order_acquire );
+
+    // The owner thread could overwrite the oldest events while they were copied. Event numEventsAfter
+    // can be in the middle of writing to the slot of event numEventsAfter - RING_BUFFER_SIZE.
+    int64_t numEventsAfter = _Buffer->NumEvents.Load();
+    int64_t firstValid = numEventsAfter - RING_BUFFER_SIZE + 1;
+    if ( firstEvent < firstValid ) {
+        firstEvent = Math::Min( firstValid, numEvents );
+    }
+
+    _NumEvents = numEvents;
+
+    return firstEvent;
+}
+
+static void WriteJsonString( FILE * f, const char * _String )
+{
+    fputc( '\"', f );
+    for ( const char * s = _String ; *s ; s++ ) {
+        if ( *s == '\"' || *s == '\\' ) {
+            fputc( '\\', f );
+        }
+        fputc( *s, f );
+    }
+    fputc( '\"', f );
+}
+
+bool AProfiler::WriteChromeTrace( const char * _FileName )
+{
+    FILE * f = fopen( _FileName, "w" );
+    if ( !f ) {
+        GLogger.Printf( "AProfiler::WriteChromeTrace: couldn't open %s\n", _FileName );
+        return false;
+    }
+
+    // Owner threads keep writing the ring buffers, so events are copied to the snapshot first
+    SEvent * events = ( SEvent * )GHeapMemory.Alloc( sizeof( SEvent ) * RING_BUFFER_SIZE );
+
+    ASpinLockGuard guard( RegisterLock );
+
+    fprintf( f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+
+    bool bFirst = true;
+    auto separator = [&]()
+    {
+        if ( !bFirst ) {
+            fprintf( f, ",\n" );
+        }
+        bFirst = false;
+    };
+
+    int numThreads = NumThreads.Load();
+    for ( int i = 0 ; i < numThreads ; i++ ) {
+        SThreadBuffer * buffer = Threads[i];
+
+        separator();
+        fprintf( f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", buffer->ThreadIndex );
+        WriteJsonString( f, buffer->Name );
+        fprintf( f, "}}" );
+
+        int64_t numEvents;
+        int64_t firstEvent = CopyEvents( buffer, events, numEvents );
+
+        int depth = 0;
+        double lastTimeStamp = 0;
+
+        for ( int64_t n = firstEvent ; n < numEvents ; n++ ) {
+            SEvent const & event = events[n & ( RING_BUFFER_SIZE - 1 )];
+
+            // Microseconds
+            double ts = ( event.TimeStamp - StartTime ) * 0.001;
+            lastTimeStamp = ts;
+
+            switch ( event.Type ) {
+            case EVENT_BEGIN:
+                separator();
+                fprintf( f, "{\"name\":" );
+                WriteJsonString( f, event.Name );
+                fprintf( f, ",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, buffer->ThreadIndex );
+                depth++;
+                break;
+            case EVENT_END:
+                // Skip end markers whose begin markers were overwritten in the ring buffer
+                if ( depth > 0 ) {
+                    separator();
+                    fprintf( f, "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, buffer->ThreadIndex );
+                    depth--;
+                }
+                break;
+            case EVENT_COUNTER:
+                separator();
+                fprintf( f, "{\"name\":" );
+                WriteJsonString( f, event.Name );
+                fprintf( f, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%f}}", ts, buffer->ThreadIndex, event.Value );
+                break;
+            case EVENT_FRAME:
+                separator();
+                fprintf( f, "{\"name\":\"Frame %lld\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ( long long )event.FrameNumber, ts, buffer->ThreadIndex );
+                break;
+            }
+        }
+
+        // Close scopes that are still open
+        while ( depth-- > 0 ) {
+            separator();
+            fprintf( f, "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", lastTimeStamp, buffer->ThreadIndex );
+        }
+    }
+
+    fprintf( f, "\n]}\n" );
+    fclose( f );
+
+    GHeapMemory.Free( events );
+
+    GLogger.Printf( "Profiler trace was written to %s\n", _FileName );
+
+    return true;
+}
@@ -0,0 +1,144 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <Runtime/Public/RadixSort.h>
+#include <Runtime/Public/Runtime.h>
+#include <Core/Public/Core.h>
+
+/** Arrays of this size or smaller are sorted by insertion sort */
+static constexpr int RADIX_SORT_SMALL_ARRAY = 128;
+
+/** Min items per chunk for parallel passes */
+static constexpr int RADIX_SORT_MIN_CHUNK_SIZE = 8192;
+
+static constexpr int RADIX_SORT_MAX_CHUNKS = 16;
+
+static void InsertionSort( SRadixSortItem * Items, int Count ) {
+    for ( int i = 1 ; i < Count ; i++ ) {
+        SRadixSortItem item = Items[i];
+        int j = i - 1;
+        while ( j >= 0 && Items[j].Key > item.Key ) {
+            Items[j + 1] = Items[j];
+            j--;
+        }
+        Items[j + 1] = item;
+    }
+}
+
+void RadixSort( SRadixSortItem * Items, SRadixSortItem * Temp, int Count ) {
+    if ( Count <= RADIX_SORT_SMALL_ARRAY ) {
+        InsertionSort( Items, Count );
+        return;
+    }
+
+    const int maxChunks = Math::Min( GAsyncJobManager.GetNumWorkerThreads(), RADIX_SORT_MAX_CHUNKS );
+    const int numChunks = Math::Max( 1, Math::Min( Count / RADIX_SORT_MIN_CHUNK_SIZE, maxChunks ) );
+
+    uint32_t histograms[RADIX_SORT_MAX_CHUNKS][256];
+    uint64_t chunkKeyDiff[RADIX_SORT_MAX_CHUNKS];
+
+    SRadixSortItem * src = Items;
+    SRadixSortItem * dst = Temp;
+    int shift;
+
+    auto chunkFirst = [Count, numChunks]( int InChunk ) {
+        return (int)( (int64_t)Count * InChunk / numChunks );
+    };
+
+    auto forEachChunk = [numChunks]( auto const & InFunc ) {
+        if ( numChunks > 1 ) {
+            GAsyncJobManager.ParallelFor( numChunks, InFunc );
+        } else {
+            InFunc( 0, 1 );
+        }
+    };
+
+    // Find the key bits that differ, passes for the bytes where all keys are equal can be skipped
+    const uint64_t firstKey = Items[0].Key;
+    forEachChunk( [&]( int InFirstChunk, int InLastChunk ) {
+        for ( int chunk = InFirstChunk ; chunk < InLastChunk ; chunk++ ) {
+            uint64_t diff = 0;
+            for ( int i = chunkFirst( chunk ), last = chunkFirst( chunk + 1 ) ; i < last ; i++ ) {
+                diff |= src[i].Key ^ firstKey;
+            }
+            chunkKeyDiff[chunk] = diff;
+        }
+    } );
+
+    uint64_t keyDiff = 0;
+    for ( int chunk = 0 ; chunk < numChunks ; chunk++ ) {
+        keyDiff |= chunkKeyDiff[chunk];
+    }
+
+    auto countDigits = [&]( int InFirstChunk, int InLastChunk ) {
+        for ( int chunk = InFirstChunk ; chunk < InLastChunk ; chunk++ ) {
+            uint32_t * histogram = histograms[chunk];
+            Core::ZeroMem( histogram, sizeof( histograms[0] ) );
+            for ( int i = chunkFirst( chunk ), last = chunkFirst( chunk + 1 ) ; i < last ; i++ ) {
+                histogram[( src[i].Key >> shift ) & 0xff]++;
+            }
+        }
+    };
+
+    auto scatter = [&]( int InFirstChunk, int InLastChunk ) {
+        for ( int chunk = InFirstChunk ; chunk < InLastChunk ; chunk++ ) {
+            uint32_t * offsets = histograms[chunk];
+            for ( int i = chunkFirst( chunk ), last = chunkFirst( chunk + 1 ) ; i < last ; i++ ) {
+                dst[offsets[( src[i].Key >> shift ) & 0xff]++] = src[i];
+            }
+        }
+    };
+
+    for ( shift = 0 ; shift < 64 ; shift += 8 ) {
+        if ( ( ( keyDiff >> shift ) & 0xff ) == 0 ) {
+            continue;
+        }
+
+        forEachChunk( countDigits );
+
+        // Digit-major, chunk-minor offsets keep the sort stable
+        uint32_t offset = 0;
+        for ( int digit = 0 ; digit < 256 ; digit++ ) {
+            for ( int chunk = 0 ; chunk < numChunks ; chunk++ ) {
+                uint32_t count = histograms[chunk][digit];
+                histograms[chunk][digit] = offset;
+                offset += count;
+            }
+        }
+
+        forEachChunk( scatter );
+
+        std::swap( src, dst );
+    }
+
+    if ( src != Items ) {
+        Core::Memcpy( Items, src, sizeof( SRadixSortItem ) * Count );
+    }
+}
@@ -33,12 +33,14 @@ SOFTWARE.
 #include <Runtime/Public/RuntimeVariable.h>
 #include <Runtime/Public/EngineInterface.h>
 #include <Runtime/Public/InputDefs.h>
+#include <Runtime/Public/Profiler.h>
 
 #include <Core/Public/Logger.h>
 #include <Core/Public/HashFunc.h>
 #include <Core/Public/WindowsDefs.h>
 #include <Core/Public/Document.h>
 #include <Core/Public/Core.h>
+#include <Core/Public/MemoryTracker.h>
 
 #include "GPUSync.h"
 
@@ -139,6 +141,8 @@ ARuntime::ARuntime( struct SEntryDecl const & _EntryDecl )
 
     int jobManagerThreadCount = AThread::NumHardwareThreads ? Math::Min( AThread::NumHardwareThreads, GAsyncJobManager.MAX_WORKER_THREADS )
         : GAsyncJobManager.MAX_WORKER_THREADS;
+    GProfiler.Initialize();
+
     GAsyncJobManager.Initialize( jobManagerThreadCount, MAX_RUNTIME_JOB_LISTS );
 
     GRenderFrontendJobList = GAsyncJobManager.GetAsyncJobList( RENDER_FRONTEND_JOB_LIST );
@@ -227,6 +231,8 @@ ARuntime::~ARuntime()
 
     GAsyncJobManager.Deinitialize();
 
+    GProfiler.Deinitialize();
+
     GPUSync.Reset();
 
     VertexMemoryGPU.Reset();
@@ -459,6 +465,8 @@ const char * ARuntime::GetExecutableName()
 
 void * ARuntime::AllocFrameMem( size_t _SizeInBytes )
 {
+    GMemoryTracker.TrackFrameAlloc( _SizeInBytes );
+
     return FrameMemory.Allocate( _SizeInBytes );
 }
 
@@ -924,6 +932,8 @@ void ARuntime::NewFrame()
 
     FrameNumber++;
 
+    GProfiler.NextFrame( FrameNumber );
+
     // Keep memory statistics
     MaxFrameMemoryUsage = Math::Max( MaxFrameMemoryUsage, FrameMemory.GetTotalMemoryUsage() );
     FrameMemoryUsedPrev = FrameMemory.GetTotalMemoryUsage();
@@ -931,6 +941,8 @@ void ARuntime::NewFrame()
     // Free frame memory for new frame
     FrameMemory.Reset();
 
+    GMemoryTracker.NextFrame();
+
     if ( bPostChangeVideoMode ) {
         bPostChangeVideoMode = false;
         SetVideoMode( DesiredMode );
@@ -66,6 +66,8 @@ void AVertexMemoryGPU::Deallocate( SVertexHandle * _Handle )
         return;
     }
 
+    Revision++;
+
     if ( _Handle->Size > VERTEX_MEMORY_GPU_BLOCK_SIZE ) {
         DeallocateHuge( _Handle );
         return;
@@ -108,6 +110,8 @@ void AVertexMemoryGPU::Update( SVertexHandle * _Handle, size_t _ByteOffset, size
 
 void AVertexMemoryGPU::Defragment( bool bDeallocateEmptyBlocks, bool bForceUpload )
 {
+    Revision++;
+
     struct {
         bool operator()( SVertexHandle const * A, SVertexHandle const * B ) {
             return A->Size > B->Size;
@@ -210,6 +214,8 @@ int AVertexMemoryGPU::FindBlock( size_t _RequiredSize )
 
 SVertexHandle * AVertexMemoryGPU::Allocate( size_t _SizeInBytes, const void * _Data, SGetMemoryCallback _GetMemoryCB, void * _UserPointer )
 {
+    Revision++;
+
     if ( _SizeInBytes > VERTEX_MEMORY_GPU_BLOCK_SIZE ) {
         // Huge block
 
@@ -34,6 +34,12 @@ SOFTWARE.
 
 //#define AN_ACTIVE_THREADS_COUNTERS
 
+/** Max jobs that can continue after a job */
+constexpr int MAX_JOB_CONTINUATIONS = 8;
+
+class AAsyncJobList;
+class ATaskGroup;
+
 /** Job for job list */
 struct SAsyncJob
 {
@@ -41,8 +47,15 @@ struct SAsyncJob
     void (*Callback)( void * );
     /** Data that will be passed for the job */
     void *Data;
-    /** Pointer to the next job in job list */
-    SAsyncJob * Next;
+    /** Job list that owns the job */
+    AAsyncJobList * JobList;
+    /** Task group that owns the job (if job was started by task group) */
+    ATaskGroup * TaskGroup;
+    /** Number of unfinished jobs this job depends on (plus one reference held by the submitter) */
+    int NumDependencies;
+    /** Jobs that depend on this job (indices in the job pool) */
+    int Continuations[MAX_JOB_CONTINUATIONS];
+    int NumContinuations;
 };
 
 class AAsyncJobManager;
@@ -61,8 +74,11 @@ public:
     /** Get job pool size */
     int GetMaxParallelJobs() const;
 
-    /** Add job to the list */
-    void AddJob( void (*_Callback)( void * ), void * _Data );
+    /** Add job to the list. Returns job handle that can be used to set job dependencies before submit. */
+    int AddJob( void (*_Callback)( void * ), void * _Data );
+
+    /** Job will not start until the dependency job is done. Both jobs must be added to the list and not submitted yet. */
+    void AddDependency( int _Job, int _DependsOn );
 
     /** Submit jobs to worker threads */
     void Submit();
@@ -77,34 +93,80 @@ private:
     AAsyncJobList();
     ~AAsyncJobList();
 
+    /** Block current thread while submitted jobs are in working threads. Pending jobs are kept. */
+    void WaitSubmittedJobs();
+
     AAsyncJobManager * JobManager;
 
     TPodVector< SAsyncJob, 1024 > JobPool;
-    SAsyncJob * JobList;
     int NumPendingJobs;
 
-    SAsyncJob * SubmittedJobs;
     AMutex SubmitSync;
 
     AAtomicInt SubmittedJobsCount;
-    AAtomicInt FetchCount;
-    //AAtomicInt FetchLock;
+
+    /** Guards job dependency counters */
+    ASpinLock DependencyLock;
 
     ASyncEvent EventDone;
-    bool       bSignalled;      // FIXME: must be atomic?
+    AAtomicBool bSignalled;
 };
 
 AN_FORCEINLINE int AAsyncJobList::GetMaxParallelJobs() const {
     return JobPool.Capacity();
 }
 
+/** Task group. Jobs are started immediately, the group counts unfinished jobs. Wait() helps
+to execute pending jobs, so it can be used from worker threads (nested waits). */
+class ATaskGroup final
+{
+    AN_FORBID_COPY( ATaskGroup )
+
+    friend class AAsyncJobManager;
+
+public:
+    explicit ATaskGroup( AAsyncJobManager * _JobManager );
+    ~ATaskGroup();
+
+    /** Start job */
+    void Run( void (*_Callback)( void * ), void * _Data );
+
+    /** Execute pending jobs on current thread until all group jobs are done */
+    void Wait();
+
+    /** Check if all group jobs are done */
+    bool IsDone() const { return PendingJobs.Load() == 0; }
+
+private:
+    static constexpr int JOB_BLOCK_SIZE = 32;
+
+    /** Start job without waking up worker threads */
+    void PushJob( void (*_Callback)( void * ), void * _Data );
+
+    /** Jobs are allocated by blocks to keep job pointers valid while they are in worker queues */
+    struct SJobBlock
+    {
+        SAsyncJob Jobs[JOB_BLOCK_SIZE];
+        SJobBlock * Next;
+    };
+
+    AAsyncJobManager * JobManager;
+    SJobBlock FirstBlock;
+    SJobBlock * CurrentBlock;
+    int NumJobsInBlock;
+    AAtomicInt PendingJobs;
+};
+
 /** Job manager */
 class AAsyncJobManager final
 {
     AN_FORBID_COPY( AAsyncJobManager )
 
+    friend class AAsyncJobList;
+    friend class ATaskGroup;
+
 public:
-    static constexpr int MAX_WORKER_THREADS = 4;
+    static constexpr int MAX_WORKER_THREADS = 32;
     static constexpr int MAX_JOB_LISTS = 4;
 
     AAsyncJobManager();
@@ -126,6 +188,20 @@ public:
     /** Get worker threads count */
     int GetNumWorkerThreads() const { return NumWorkerThreads; }
 
+    /** Fetch one pending job and execute it on current thread. Returns false if there is no pending jobs. */
+    bool TryExecuteJob();
+
+    /** Calls _Callback( First, Last, _Data ) for the sub-ranges of [0, _Count) on worker threads and current thread.
+    Sub-ranges are not smaller than _MinBatchSize (except the last one) and shrink as work runs out. Blocks current thread
+    (helping to execute pending jobs) while all ranges are processed. */
+    void ParallelFor( int _Count, void (*_Callback)( int, int, void * ), void * _Data, int _MinBatchSize = 1 );
+
+    /** Parallel for with lambda/functor: _Func( First, Last ) */
+    template< typename T >
+    void ParallelFor( int _Count, T const & _Func, int _MinBatchSize = 1 ) {
+        ParallelFor( _Count, []( int _First, int _Last, void * _Data ) { ( *( T const * )_Data )( _First, _Last ); }, ( void * )&_Func, _MinBatchSize );
+    }
+
 #ifdef AN_ACTIVE_THREADS_COUNTERS
     int GetNumActiveThreads() const { return NumActiveThreads.Load(); }
 #endif
@@ -136,6 +212,15 @@ private:
 
     void WorkerThreadRoutine( int _ThreadId );
 
+    /** Push ready job to the worker queue. Current worker queue is used for worker threads. */
+    void PushJob( SAsyncJob * _Job );
+
+    /** Pop job from own queue or steal it from other workers */
+    SAsyncJob * FetchJob( int _ThreadId );
+
+    /** Execute job and release its continuations */
+    void ExecuteJob( SAsyncJob * _Job );
+
     AThread     WorkerThread[MAX_WORKER_THREADS];
     int         NumWorkerThreads;
 
@@ -145,9 +230,22 @@ private:
 
     ASyncEvent  EventNotify[MAX_WORKER_THREADS];
 
+    /** Per-worker job deque. Owner pops from the back, thieves steal from the front. */
+    struct alignas(64) SWorkerQueue {
+        ASpinLock Lock;
+        TPodVector< SAsyncJob *, 256, 256, AHeapAllocator<16> > Jobs;
+        int Head;
+    };
+
+    SWorkerQueue Queues[MAX_WORKER_THREADS];
+
+    /** Round robin queue index for jobs pushed from non-worker threads */
+    AAtomicInt  NextQueue;
+
     AAsyncJobList JobList[MAX_JOB_LISTS];
     int         NumJobLists;
 
+    /** Number of jobs in the worker queues */
     AAtomicInt  TotalJobs;
 
     struct SContext {
@@ -0,0 +1,183 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Core/Public/Thread.h>
+
+/**
+
+AProfiler
+
+Low-overhead hierarchical CPU profiler.
+
+Each thread writes scope begin/end markers and counters to its own ring buffer, so
+recording doesn't take any locks. The last events of all threads can be written offline
+in Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+
+Enabled by "rt_Profiler" runtime variable. The trace is requested by ProfilerDump console
+command and written at the frame boundary.
+
+Scope and counter names must be string literals (or have static lifetime).
+
+*/
+class AProfiler final
+{
+    AN_FORBID_COPY( AProfiler )
+
+public:
+    static constexpr int MAX_THREADS = 64;
+    static constexpr int RING_BUFFER_SIZE = 1 << 16;  // events per thread, must be power of two
+
+    AProfiler() {}
+
+    /** Initialize profiler (main thread only) */
+    void Initialize();
+
+    /** Deinitialize profiler (main thread only). Worker threads must be stopped. */
+    void Deinitialize();
+
+    /** Is profiling enabled */
+    bool IsEnabled() const { return bEnabled; }
+
+    /** Set name of the current thread (used in the trace) */
+    void SetThreadName( const char * _Name );
+
+    /** Begin scope on the current thread */
+    void BeginScope( const char * _Name );
+
+    /** End scope on the current thread */
+    void EndScope();
+
+    /** Record counter value on the current thread */
+    void Counter( const char * _Name, double _Value );
+
+    /** Frame boundary hook (main thread only). Writes requested trace. */
+    void NextFrame( int _FrameNumber );
+
+    /** Request trace dump at the next frame boundary */
+    void RequestDump( const char * _FileName );
+
+    /** Write the trace immediately. Events are copied from the ring buffers, so other threads can keep recording. */
+    bool WriteChromeTrace( const char * _FileName );
+
+private:
+    enum EEventType
+    {
+        EVENT_BEGIN,
+        EVENT_END,
+        EVENT_COUNTER,
+        EVENT_FRAME
+    };
+
+    struct SEvent
+    {
+        const char * Name;
+        int64_t TimeStamp;  // nanoseconds
+        union
+        {
+            double Value;
+            int64_t FrameNumber;
+        };
+        int Type;
+        int Pad;
+    };
+
+    struct SThreadBuffer
+    {
+        SEvent * Events;
+        /** Total number of events written by the owner thread */
+        AAtomicLong NumEvents;
+        int ThreadIndex;
+        char Name[32];
+    };
+
+    SThreadBuffer * GetThreadBuffer();
+
+    /** Write event to the ring buffer of the current thread. Time stamp is set here. */
+    void WriteEvent( SEvent & _Event );
+
+    /** Copy the last events of the thread. Events that were overwritten while copying are dropped.
+    Returns index of the first copied event. */
+    int64_t CopyEvents( SThreadBuffer const * _Buffer, SEvent * _Events, int64_t & _NumEvents ) const;
+
+    bool bEnabled = false;
+
+    ASpinLock RegisterLock;
+    SThreadBuffer * Threads[MAX_THREADS] = {};
+    AAtomicInt NumThreads;
+
+    /** Generation of thread buffers. Thread local pointers are invalidated after Deinitialize. */
+    AAtomicInt Generation;
+
+    int64_t StartTime = 0;
+
+    AAtomicBool bDumpRequested;
+    char DumpFileName[256];
+};
+
+extern AProfiler GProfiler;
+
+/** Profiler scope */
+class AProfilerScope final
+{
+    AN_FORBID_COPY( AProfilerScope )
+
+public:
+    explicit AProfilerScope( const char * _Name )
+    {
+        bActive = GProfiler.IsEnabled();
+        if ( bActive ) {
+            GProfiler.BeginScope( _Name );
+        }
+    }
+
+    ~AProfilerScope()
+    {
+        if ( bActive ) {
+            GProfiler.EndScope();
+        }
+    }
+
+private:
+    bool bActive;
+};
+
+#define AN_PROFILER_CONCAT_( a, b ) a ## b
+#define AN_PROFILER_CONCAT( a, b ) AN_PROFILER_CONCAT_( a, b )
+
+/** Profile the scope */
+#define AN_PROFILER_SCOPE( _Name ) AProfilerScope AN_PROFILER_CONCAT( profilerScope, __LINE__ )( _Name )
+
+/** Profile the function */
+#define AN_PROFILER_FUNCTION() AN_PROFILER_SCOPE( __FUNCTION__ )
+
+/** Record counter */
+#define AN_PROFILER_COUNTER( _Name, _Value ) do { if ( GProfiler.IsEnabled() ) GProfiler.Counter( _Name, _Value ); } while ( 0 )
@@ -134,6 +134,9 @@ public:
     /** Total block count */
     int GetBlocksCount() const { return Blocks.Size(); }
 
+    /** Incremented when chunks are allocated, deallocated or relocated, so physical buffers and offsets taken before may be invalid */
+    uint32_t GetRevision() const { return Revision; }
+
 private:
     /** Find a free block */
     int FindBlock( size_t _RequiredSize );
@@ -177,6 +180,7 @@ private:
 
     size_t UsedMemory;
     size_t UsedMemoryHuge;
+    uint32_t Revision = 0;
 };
 
 class AStreamedMemoryGPU : public ARefCounted {
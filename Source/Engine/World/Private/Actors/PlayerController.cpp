@@ -29,6 +29,7 @@ SOFTWARE.
 */
 
 #include <World/Public/Actors/PlayerController.h>
+#include <World/Public/Render/StaticDrawCache.h>
 #include <World/Public/Components/InputComponent.h>
 #include <World/Public/Components/CameraComponent.h>
 #include <World/Public/World.h>
@@ -31,6 +31,8 @@ SOFTWARE.
 #include <World/Public/Base/GameModuleInterface.h>
 #include <World/Public/Resource/Material.h>
 #include <Runtime/Public/Runtime.h>
+#include <Runtime/Public/Profiler.h>
+#include <Core/Public/MemoryTracker.h>
 
 AN_CLASS_META( IGameModule )
 
@@ -38,6 +40,8 @@ IGameModule::IGameModule()
 {
     AddCommand( "quit", { this, &IGameModule::Quit }, "Quit from application" );
     AddCommand( "RebuildMaterials", { this, &IGameModule::RebuildMaterials }, "Rebuild materials" );
+    AddCommand( "MemoryReport", { this, &IGameModule::MemoryReport }, "Write memory report (requires -bMemoryTracking)" );
+    AddCommand( "ProfilerDump", { this, &IGameModule::ProfilerDump }, "Write profiler trace in Chrome trace format (requires rt_Profiler)" );
 }
 
 void IGameModule::OnGameClose()
@@ -64,3 +68,13 @@ void IGameModule::RebuildMaterials( ARuntimeCommandProcessor const & _Proc )
 {
     AMaterial::RebuildMaterials();
 }
+
+void IGameModule::MemoryReport( ARuntimeCommandProcessor const & _Proc )
+{
+    GMemoryTracker.DumpReport( _Proc.GetArgsCount() > 1 ? _Proc.GetArg( 1 ) : "memory_report.txt" );
+}
+
+void IGameModule::ProfilerDump( ARuntimeCommandProcessor const & _Proc )
+{
+    GProfiler.RequestDump( _Proc.GetArgsCount() > 1 ? _Proc.GetArg( 1 ) : "profiler_trace.json" );
+}
@@ -182,11 +182,21 @@ void ADrawable::OnTransformDirty() {
     Super::OnTransformDirty();
 
     UpdateWorldBounds();
+
+    MarkRenderDirty();
+}
+
+void ADrawable::OnMotionBehaviorChanged() {
+    Super::OnMotionBehaviorChanged();
+
+    UpdateMovable();
 }
 
 void ADrawable::InitializeComponent() {
     Super::InitializeComponent();
 
+    UpdateMovable();
+
     GetLevel()->AddPrimitive( &Primitive );
 
     UpdateWorldBounds();
@@ -271,6 +281,27 @@ bool ADrawable::IsOutdoor() const {
     return Primitive.bIsOutdoor;
 }
 
+void ADrawable::UpdateMovable() {
+    const bool bNonMovable = GetMotionBehavior() == MB_STATIC && !bSkinnedMesh;
+
+    if ( Primitive.bNonMovable == bNonMovable ) {
+        return;
+    }
+
+    Primitive.bNonMovable = bNonMovable;
+
+    MarkRenderDirty();
+
+    if ( IsInitialized() )
+    {
+        GetLevel()->MarkPrimitive( &Primitive );
+    }
+}
+
+bool ADrawable::IsMovable() const {
+    return !Primitive.bNonMovable;
+}
+
 void ADrawable::PreRenderUpdate( SRenderFrontendDef const * _Def ) {
     if ( VisFrame != _Def->FrameNumber ) {
         VisFrame = _Def->FrameNumber;
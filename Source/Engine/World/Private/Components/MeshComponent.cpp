@@ -249,6 +249,8 @@ void AMeshComponent::SetMesh( AIndexedMesh * _Mesh ) {
 
     NotifyMeshChanged();
 
+    MarkRenderDirty();
+
     // Mark to update world bounds
     UpdateWorldBounds();
 
@@ -264,6 +266,8 @@ void AMeshComponent::ClearMaterials() {
         }
     }
     Materials.Clear();
+
+    MarkRenderDirty();
 }
 
 void AMeshComponent::CopyMaterialsFromMeshResource() {
@@ -278,6 +282,8 @@ void AMeshComponent::CopyMaterialsFromMeshResource() {
 void AMeshComponent::SetMaterialInstance( int _SubpartIndex, AMaterialInstance * _Instance ) {
     AN_ASSERT( _SubpartIndex >= 0 );
 
+    MarkRenderDirty();
+
     if ( _SubpartIndex >= Materials.Size() ) {
 
         if ( _Instance ) {
@@ -299,6 +299,8 @@ void APhysicalBody::SetMotionBehavior( EMotionBehavior _MotionBehavior )
     MotionBehavior = _MotionBehavior;
 
     UpdatePhysicsAttribs();
+
+    OnMotionBehaviorChanged();
 }
 
 void APhysicalBody::SetAINavigationBehavior( EAINavigationBehavior _AINavigationBehavior )
@@ -324,7 +324,7 @@ void AEngineInstance::ShowStats()
         AStreamedMemoryGPU * streamedMemory = GRuntime->GetStreamedMemoryGPU();
 
         const float y_step = 22;
-        const int numLines = 13;
+        const int numLines = 14;
 
         Float2 pos( 8, 8 );
         pos.Y = Canvas.GetHeight() - numLines * y_step;
@@ -344,6 +344,7 @@ void AEngineInstance::ShowStats()
         Canvas.DrawTextUTF8( pos, AColor4::White(), Core::Fmt("Polycount: %d", stat.PolyCount ), nullptr, true ); pos.Y += y_step;
         Canvas.DrawTextUTF8( pos, AColor4::White(), Core::Fmt("ShadowMapPolyCount: %d", stat.ShadowMapPolyCount ), nullptr, true ); pos.Y += y_step;
         Canvas.DrawTextUTF8( pos, AColor4::White(), Core::Fmt("Frontend time: %d msec", stat.FrontendTime ), nullptr, true ); pos.Y += y_step;
+        Canvas.DrawTextUTF8( pos, AColor4::White(), Core::Fmt("Culled by budget: %d lights, %d probes", stat.CulledLights, stat.CulledProbes ), nullptr, true ); pos.Y += y_step;
         Canvas.DrawTextUTF8( pos, AColor4::White(), Core::Fmt("Audio channels: %d active, %d virtual", GAudioSystem.GetMixer()->GetNumActiveChannels(), GAudioSystem.GetMixer()->GetNumVirtualChannels() ), nullptr, true ); pos.Y += y_step;
         Canvas.PopFont();
     }
@@ -37,6 +37,7 @@ SOFTWARE.
 #include <World/Public/Components/PointLightComponent.h>
 #include <World/Public/Actors/PlayerController.h>
 #include <World/Public/Resource/Texture.h>
+#include <World/Public/Render/PrimitiveBVH.h>
 #include <Core/Public/BV/BvIntersect.h>
 #include <Core/Public/IntrusiveLinkedListMacro.h>
 #include <Runtime/Public/Runtime.h>
@@ -45,11 +46,17 @@ SOFTWARE.
 ARuntimeVariable com_DrawLevelAreaBounds( _CTS( "com_DrawLevelAreaBounds" ), _CTS( "0" ), VAR_CHEAT );
 ARuntimeVariable com_DrawLevelIndoorBounds( _CTS( "com_DrawLevelIndoorBounds" ), _CTS( "0" ), VAR_CHEAT );
 ARuntimeVariable com_DrawLevelPortals( _CTS( "com_DrawLevelPortals" ), _CTS( "0" ), VAR_CHEAT );
+ARuntimeVariable com_OccluderMinArea( _CTS( "com_OccluderMinArea" ), _CTS( "16" ), 0, _CTS( "Min area of level surface that is used as occluder" ) );
+ARuntimeVariable com_OccluderMaxTriangles( _CTS( "com_OccluderMaxTriangles" ), _CTS( "32" ), 0, _CTS( "Max triangles of level surface that is used as occluder" ) );
+ARuntimeVariable com_MaxOccluders( _CTS( "com_MaxOccluders" ), _CTS( "256" ), 0, _CTS( "Max level surfaces that are used as occluders" ) );
 
 AN_CLASS_META( ALevel )
 
 ALevel::APrimitiveLinkPool ALevel::PrimitiveLinkPool;
 
+/** Area trees are allocated from the pool */
+static TPoolAllocator< APrimitiveBVH, 32 > PrimitiveBVHPool;
+
 ALevel::ALevel() {
     ViewCluster = -1;
 
@@ -84,6 +91,10 @@ void ALevel::Initialize() {
     ViewMark = 0;
     ViewCluster = -1;
 
+    if ( Model ) {
+        Model->MarkOccluders( com_OccluderMinArea.GetFloat(), com_OccluderMaxTriangles.GetInteger(), com_MaxOccluders.GetInteger() );
+    }
+
     if ( bCompressedVisData && Visdata && PVSClustersCount > 0 )
     {
         // Allocate decompressed vis data
@@ -121,6 +132,8 @@ void ALevel::Purge() {
     RemoveLightmapUVChannels();
     RemoveVertexLightChannels();
 
+    PurgeAreaTrees();
+
     Areas.Free();
 
     PurgePortals();
@@ -708,8 +721,16 @@ void ALevel::AddPrimitiveToArea( SVisArea * Area, SPrimitiveDef * Primitive ) {
 
     // Create the area links
     link->Area = Area;
-    link->NextInArea = Area->Links;
-    Area->Links = link;
+    if ( Primitive->bNonMovable ) {
+        link->NextInArea = Area->NonMovableLinks;
+        Area->NonMovableLinks = link;
+        Area->NumNonMovable++;
+        Area->NonMovableChecksum += Core::PHHash64( (uint64_t)Primitive );
+        MarkAreaDirty( Area );
+    } else {
+        link->NextInArea = Area->Links;
+        Area->Links = link;
+    }
 }
 
 void ALevel::AddBoxRecursive( int InNodeIndex, SPrimitiveDef * InPrimitive ) {
@@ -839,27 +860,40 @@ void ALevel::LinkPrimitive( SPrimitiveDef * InPrimitive ) {
     }
 }
 
+static bool RemoveAreaLink( SPrimitiveLink ** InList, SPrimitiveLink * InLink ) {
+    SPrimitiveLink ** prev = InList;
+    while ( 1 ) {
+        SPrimitiveLink * walk = *prev;
+
+        if ( !walk ) {
+            return false;
+        }
+
+        if ( walk == InLink ) {
+            // remove this link
+            *prev = InLink->NextInArea;
+            return true;
+        }
+
+        prev = &walk->NextInArea;
+    }
+}
+
 void ALevel::UnlinkPrimitive( SPrimitiveDef * InPrimitive ) {
     SPrimitiveLink * link = InPrimitive->Links;
 
     while ( link ) {
-        AN_ASSERT( link->Area );
+        SVisArea * area = link->Area;
 
-        SPrimitiveLink ** prev = &link->Area->Links;
-        while ( 1 ) {
-            SPrimitiveLink * walk = *prev;
-
-            if ( !walk ) {
-                break;
-            }
+        AN_ASSERT( area );
 
-            if ( walk == link ) {
-                // remove this link
-                *prev = link->NextInArea;
-                break;
+        // The movable flag can be changed after the primitive was linked, so check both lists
+        if ( !RemoveAreaLink( &area->Links, link ) ) {
+            if ( RemoveAreaLink( &area->NonMovableLinks, link ) ) {
+                area->NumNonMovable--;
+                area->NonMovableChecksum -= Core::PHHash64( (uint64_t)InPrimitive );
+                MarkAreaDirty( area );
             }
-
-            prev = &walk->NextInArea;
         }
 
         SPrimitiveLink * free = link;
@@ -922,6 +956,59 @@ void ALevel::UpdatePrimitiveLinks() {
     }
 
     PrimitiveUpdateList = PrimitiveUpdateListTail = nullptr;
+
+    UpdateAreaTrees();
+}
+
+void ALevel::MarkAreaDirty( SVisArea * InArea ) {
+    if ( !InArea->bNonMovableDirty ) {
+        InArea->bNonMovableDirty = true;
+        DirtyAreas.Append( InArea );
+    }
+}
+
+void ALevel::UpdateAreaTrees() {
+    for ( SVisArea * area : DirtyAreas ) {
+        area->bNonMovableDirty = false;
+
+        if ( !area->NonMovableLinks ) {
+            FreeAreaTree( area );
+            continue;
+        }
+
+        if ( !area->PrimitiveBVH ) {
+            area->PrimitiveBVH = new ( PrimitiveBVHPool.Allocate() ) APrimitiveBVH;
+        }
+
+        // Primitives were moved only, so refit the tree if it's still good enough
+        if ( area->PrimitiveBVH->IsBuiltFor( area->NumNonMovable, area->NonMovableChecksum ) && area->PrimitiveBVH->Refit() ) {
+            continue;
+        }
+
+        area->PrimitiveBVH->Build( area->NonMovableLinks, area->NumNonMovable, area->NonMovableChecksum );
+    }
+
+    DirtyAreas.Clear();
+}
+
+void ALevel::FreeAreaTree( SVisArea * InArea ) {
+    if ( InArea->PrimitiveBVH ) {
+        InArea->PrimitiveBVH->~APrimitiveBVH();
+        PrimitiveBVHPool.Deallocate( InArea->PrimitiveBVH );
+        InArea->PrimitiveBVH = nullptr;
+    }
+}
+
+void ALevel::PurgeAreaTrees() {
+    for ( SVisArea & area : Areas ) {
+        FreeAreaTree( &area );
+        area.bNonMovableDirty = false;
+    }
+
+    FreeAreaTree( &OutdoorArea );
+    OutdoorArea.bNonMovableDirty = false;
+
+    DirtyAreas.Free();
 }
 
 void ALevel::MarkPrimitives() {
@@ -953,6 +1040,8 @@ void ALevel::RemovePrimitives() {
     }
 
     PrimitiveUpdateList = PrimitiveUpdateListTail = nullptr;
+
+    UpdateAreaTrees();
 #else
     UnmarkPrimitives();
 
@@ -984,6 +1073,62 @@ void ALevel::MarkPrimitive( SPrimitiveDef * InPrimitive ) {
 
 AN_CLASS_META( ABrushModel )
 
+int ABrushModel::MarkOccluders( float InMinArea, int InMaxTriangles, int InMaxOccluders ) {
+    struct SCandidate {
+        float Area;
+        int SurfaceIndex;
+    };
+
+    TPodVector< SCandidate > candidates;
+
+    for ( int surfaceIndex = 0 ; surfaceIndex < Surfaces.Size() ; surfaceIndex++ ) {
+        SSurfaceDef & surf = Surfaces[surfaceIndex];
+
+        surf.Flags &= ~SURF_OCCLUDER;
+
+        if ( surf.NumIndices / 3 > InMaxTriangles ) {
+            continue;
+        }
+
+        if ( surf.MaterialIndex < SurfaceMaterials.Size() && SurfaceMaterials[surf.MaterialIndex] ) {
+            AMaterial * material = SurfaceMaterials[surf.MaterialIndex]->GetMaterial();
+            if ( material->IsTranslucent() || material->IsAlphaMasked() ) {
+                continue;
+            }
+        }
+
+        SMeshVertex const * vertices = Vertices.ToPtr() + surf.FirstVertex;
+        unsigned int const * indices = Indices.ToPtr() + surf.FirstIndex;
+
+        float area = 0;
+        for ( int i = 0 ; i + 2 < surf.NumIndices ; i += 3 ) {
+            Float3 const & v0 = vertices[indices[i]].Position;
+            Float3 const & v1 = vertices[indices[i + 1]].Position;
+            Float3 const & v2 = vertices[indices[i + 2]].Position;
+
+            area += Math::Cross( v1 - v0, v2 - v0 ).Length() * 0.5f;
+        }
+
+        if ( area >= InMinArea ) {
+            SCandidate & candidate = candidates.Append();
+            candidate.Area = area;
+            candidate.SurfaceIndex = surfaceIndex;
+        }
+    }
+
+    const int numOccluders = Math::Clamp( InMaxOccluders, 0, candidates.Size() );
+
+    // Keep the largest surfaces
+    StdNthElement( candidates.Begin(), candidates.Begin() + numOccluders, candidates.End(),
+                   []( SCandidate const & A, SCandidate const & B ) { return A.Area > B.Area; } );
+
+    for ( int i = 0 ; i < numOccluders ; i++ ) {
+        Surfaces[candidates[i].SurfaceIndex].Flags |= SURF_OCCLUDER;
+    }
+
+    return numOccluders;
+}
+
 void ABrushModel::Purge() {
     Surfaces.Free();
 
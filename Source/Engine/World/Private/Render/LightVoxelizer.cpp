@@ -33,13 +33,24 @@ SOFTWARE.
 
 #include <Runtime/Public/RuntimeVariable.h>
 #include <Runtime/Public/Runtime.h>
+#include <Runtime/Public/Profiler.h>
+#include <Core/Public/Core.h>
 
+#include <immintrin.h>
 
-#define LIGHT_ITEMS_OFFSET 0
-#define DECAL_ITEMS_OFFSET 256
-#define PROBE_ITEMS_OFFSET 512
+#if defined( AN_COMPILER_MSVC )
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__( ( target( "avx2" ) ) )
+#endif
 
 ARuntimeVariable com_ClusterSSE( _CTS( "com_ClusterSSE" ), _CTS( "1" ), VAR_CHEAT );
+ARuntimeVariable com_ClusterAVX2( _CTS( "com_ClusterAVX2" ), _CTS( "1" ), VAR_CHEAT );
+ARuntimeVariable com_ClusterGridX( _CTS( "com_ClusterGridX" ), _CTS( "16" ), 0, _CTS( "Number of frustum clusters along screen width" ) );
+ARuntimeVariable com_ClusterGridY( _CTS( "com_ClusterGridY" ), _CTS( "8" ), 0, _CTS( "Number of frustum clusters along screen height" ) );
+ARuntimeVariable com_ClusterGridZ( _CTS( "com_ClusterGridZ" ), _CTS( "24" ), 0, _CTS( "Number of frustum cluster slices" ) );
+ARuntimeVariable com_ClusterSliceOffset( _CTS( "com_ClusterSliceOffset" ), _CTS( "20" ), 0, _CTS( "Number of logarithmic slices skipped near the camera" ) );
+ARuntimeVariable com_ClusterItemCapacity( _CTS( "com_ClusterItemCapacity" ), _CTS( "256" ), 0, _CTS( "Max lights, decals and probes per frustum cluster" ) );
 ARuntimeVariable com_ReverseNegativeZ( _CTS( "com_ReverseNegativeZ" ), _CTS( "1" ), VAR_CHEAT );
 ARuntimeVariable com_FreezeFrustumClusters( _CTS( "com_FreezeFrustumClusters" ), _CTS( "0" ), VAR_CHEAT );
 
@@ -241,25 +252,7 @@ void ALightVoxelizer::TransformItemsSSE() {
         _mm_store_ps( &bb_mins.X, bbMins );
         _mm_store_ps( &bb_maxs.X, bbMaxs );
 
-        AN_ASSERT( bb_mins.Z >= 0 );
-
-        info.MaxSlice = ceilf ( std::log2f( bb_mins.Z * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * FRUSTUM_SLICE_SCALE + FRUSTUM_SLICE_BIAS );
-        info.MinSlice = floorf( std::log2f( bb_maxs.Z * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * FRUSTUM_SLICE_SCALE + FRUSTUM_SLICE_BIAS );
-
-        info.MinClusterX = floorf( (bb_mins.X + 1.0f) * (0.5f * MAX_FRUSTUM_CLUSTERS_X) );
-        info.MaxClusterX = ceilf ( (bb_maxs.X + 1.0f) * (0.5f * MAX_FRUSTUM_CLUSTERS_X) );
-
-        info.MinClusterY = floorf( (bb_mins.Y + 1.0f) * (0.5f * MAX_FRUSTUM_CLUSTERS_Y) );
-        info.MaxClusterY = ceilf ( (bb_maxs.Y + 1.0f) * (0.5f * MAX_FRUSTUM_CLUSTERS_Y) );
-
-        info.MinSlice = Math::Max( info.MinSlice, 0 );
-        info.MaxSlice = Math::Clamp( info.MaxSlice, 1, MAX_FRUSTUM_CLUSTERS_Z );
-
-        AN_ASSERT( info.MinSlice >= 0 && info.MinSlice <= MAX_FRUSTUM_CLUSTERS_Z );
-        AN_ASSERT( info.MinClusterX >= 0 && info.MinClusterX <= MAX_FRUSTUM_CLUSTERS_X );
-        AN_ASSERT( info.MinClusterY >= 0 && info.MinClusterY <= MAX_FRUSTUM_CLUSTERS_Y );
-        AN_ASSERT( info.MaxClusterX >= 0 && info.MaxClusterX <= MAX_FRUSTUM_CLUSTERS_X );
-        AN_ASSERT( info.MaxClusterY >= 0 && info.MaxClusterY <= MAX_FRUSTUM_CLUSTERS_Y );
+        SetItemClusterRange( info, Float3( bb_mins.X, bb_mins.Y, bb_mins.Z ), Float3( bb_maxs.X, bb_maxs.Y, bb_maxs.Z ) );
     }
 }
 
@@ -341,66 +334,217 @@ void ALightVoxelizer::TransformItemsGeneric() {
         bb.Maxs.Y = Math::Clamp( bb.Maxs.Y, -1.0f, 1.0f );
         bb.Maxs.Z = Math::Clamp( bb.Maxs.Z, -1.0f, 1.0f );
 
-        AN_ASSERT( bb.Mins.Z >= 0 );
+        SetItemClusterRange( info, bb.Mins, bb.Maxs );
+    }
+}
+
+void ALightVoxelizer::SetItemClusterRange( SItemInfo & Info, Float3 const & Mins, Float3 const & Maxs ) {
+    AN_ASSERT( Mins.Z >= 0 );
+
+    Info.MaxSlice = ceilf ( std::log2f( Mins.Z * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * Grid.SliceScale + Grid.SliceBias );
+    Info.MinSlice = floorf( std::log2f( Maxs.Z * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * Grid.SliceScale + Grid.SliceBias );
+
+    Info.MinClusterX = floorf( (Mins.X + 1.0f) * (0.5f * Grid.NumClustersX) );
+    Info.MaxClusterX = ceilf ( (Maxs.X + 1.0f) * (0.5f * Grid.NumClustersX) );
+
+    Info.MinClusterY = floorf( (Mins.Y + 1.0f) * (0.5f * Grid.NumClustersY) );
+    Info.MaxClusterY = ceilf ( (Maxs.Y + 1.0f) * (0.5f * Grid.NumClustersY) );
 
-        info.MaxSlice = ceilf ( std::log2f( bb.Mins.Z * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * FRUSTUM_SLICE_SCALE + FRUSTUM_SLICE_BIAS );
-        info.MinSlice = floorf( std::log2f( bb.Maxs.Z * FRUSTUM_CLUSTER_ZRANGE + FRUSTUM_CLUSTER_ZNEAR ) * FRUSTUM_SLICE_SCALE + FRUSTUM_SLICE_BIAS );
+    Info.MinSlice = Math::Max( Info.MinSlice, 0 );
+    Info.MaxSlice = Math::Clamp( Info.MaxSlice, 1, Grid.NumClustersZ );
 
-        info.MinClusterX = floorf( (bb.Mins.X + 1.0f) * 0.5f * MAX_FRUSTUM_CLUSTERS_X );
-        info.MaxClusterX = ceilf ( (bb.Maxs.X + 1.0f) * 0.5f * MAX_FRUSTUM_CLUSTERS_X );
+    AN_ASSERT( Info.MinSlice >= 0 && Info.MinSlice <= Grid.NumClustersZ );
+    AN_ASSERT( Info.MinClusterX >= 0 && Info.MinClusterX <= Grid.NumClustersX );
+    AN_ASSERT( Info.MinClusterY >= 0 && Info.MinClusterY <= Grid.NumClustersY );
+    AN_ASSERT( Info.MaxClusterX >= 0 && Info.MaxClusterX <= Grid.NumClustersX );
+    AN_ASSERT( Info.MaxClusterY >= 0 && Info.MaxClusterY <= Grid.NumClustersY );
+}
 
-        info.MinClusterY = floorf( (bb.Mins.Y + 1.0f) * 0.5f * MAX_FRUSTUM_CLUSTERS_Y );
-        info.MaxClusterY = ceilf ( (bb.Maxs.Y + 1.0f) * 0.5f * MAX_FRUSTUM_CLUSTERS_Y );
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// AVX2 Math
+//
+// Eight box corners are processed at once, one corner per lane, in the same order as
+// in TransformItemsGeneric: lanes 0-3 have max Z, lanes 4-7 have min Z.
+//
+//////////////////////////////////////////////////////////////////////////////////////////////////////
 
-        info.MinSlice = Math::Max( info.MinSlice, 0 );
-        //info.MinClusterX = Math::Max( info.MinClusterX, 0 );
-        //info.MinClusterY = Math::Max( info.MinClusterY, 0 );
+constexpr int CORNER_MAX_X = 0x96; // lanes 1, 2, 4, 7
+constexpr int CORNER_MAX_Y = 0xcc; // lanes 2, 3, 6, 7
+constexpr int CORNER_MAX_Z = 0x0f; // lanes 0, 1, 2, 3
 
-        info.MaxSlice = Math::Clamp( info.MaxSlice, 1, MAX_FRUSTUM_CLUSTERS_Z );
-        //info.MaxSlice = Math::Max( info.MaxSlice, 1 );
-        //info.MaxClusterX = Math::Min( info.MaxClusterX, MAX_FRUSTUM_CLUSTERS_X );
-        //info.MaxClusterY = Math::Min( info.MaxClusterY, MAX_FRUSTUM_CLUSTERS_Y );
+template< int Mask >
+AVX2_TARGET AN_FORCEINLINE __m256 SelectCorners_AVX2( float Min, float Max ) {
+    return _mm256_blend_ps( _mm256_set1_ps( Min ), _mm256_set1_ps( Max ), Mask );
+}
+
+AVX2_TARGET AN_FORCEINLINE __m256 MultiplyAdd_AVX2( __m256 a, float b, __m256 c ) {
+    return _mm256_add_ps( _mm256_mul_ps( a, _mm256_set1_ps( b ) ), c );
+}
+
+AVX2_TARGET AN_FORCEINLINE float HorizontalMin_AVX2( __m256 v ) {
+    __m128 m = _mm_min_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+    m = _mm_min_ps( m, _mm_movehl_ps( m, m ) );
+    m = _mm_min_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+    return _mm_cvtss_f32( m );
+}
+
+AVX2_TARGET AN_FORCEINLINE float HorizontalMax_AVX2( __m256 v ) {
+    __m128 m = _mm_max_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+    m = _mm_max_ps( m, _mm_movehl_ps( m, m ) );
+    m = _mm_max_ss( m, _mm_shuffle_ps( m, m, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+    return _mm_cvtss_f32( m );
+}
 
-        AN_ASSERT( info.MinSlice >= 0 && info.MinSlice <= MAX_FRUSTUM_CLUSTERS_Z );
-        AN_ASSERT( info.MinClusterX >= 0 && info.MinClusterX <= MAX_FRUSTUM_CLUSTERS_X );
-        AN_ASSERT( info.MinClusterY >= 0 && info.MinClusterY <= MAX_FRUSTUM_CLUSTERS_Y );
-        AN_ASSERT( info.MaxClusterX >= 0 && info.MaxClusterX <= MAX_FRUSTUM_CLUSTERS_X );
-        AN_ASSERT( info.MaxClusterY >= 0 && info.MaxClusterY <= MAX_FRUSTUM_CLUSTERS_Y );
+/** Returns true if all eight points are outside of the [-1,1] range */
+AVX2_TARGET AN_FORCEINLINE bool IsOutside_AVX2( __m256 v ) {
+    return _mm256_movemask_ps( _mm256_cmp_ps( v, _mm256_set1_ps( 1.0f ), _CMP_GT_OQ ) ) == 0xff
+        || _mm256_movemask_ps( _mm256_cmp_ps( v, _mm256_set1_ps( -1.0f ), _CMP_LT_OQ ) ) == 0xff;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+
+AVX2_TARGET void ALightVoxelizer::TransformItemsAVX2() {
+    const __m256 Zero = _mm256_setzero_ps();
+    const __m256 One = _mm256_set1_ps( 1.0f );
+    const __m256 Extend = _mm256_set1_ps( 2.0f );
+    const __m256 NegativeZ = _mm256_set1_ps( 200.0f );
+    const bool bReverseNegativeZ = com_ReverseNegativeZ;
+    __m256 x, y, z, w;
+    __m256 xMins, xMaxs, yMins, yMaxs;
+    __m256 Mask;
+    Float3 bbMins, bbMaxs;
+
+    for ( int itemNum = 0 ; itemNum < ItemsCount ; itemNum++ ) {
+        SItemInfo & info = ItemInfos[itemNum];
+
+        // OBB to clipspace
+
+        __m256 CornerX = SelectCorners_AVX2< CORNER_MAX_X >( info.Mins.X, info.Maxs.X );
+        __m256 CornerY = SelectCorners_AVX2< CORNER_MAX_Y >( info.Mins.Y, info.Maxs.Y );
+        __m256 CornerZ = SelectCorners_AVX2< CORNER_MAX_Z >( info.Mins.Z, info.Maxs.Z );
+
+        x = MultiplyAdd_AVX2( CornerX, ViewProj[0].X, MultiplyAdd_AVX2( CornerY, ViewProj[1].X, MultiplyAdd_AVX2( CornerZ, ViewProj[2].X, _mm256_set1_ps( ViewProj[3].X ) ) ) );
+        y = MultiplyAdd_AVX2( CornerX, ViewProj[0].Y, MultiplyAdd_AVX2( CornerY, ViewProj[1].Y, MultiplyAdd_AVX2( CornerZ, ViewProj[2].Y, _mm256_set1_ps( ViewProj[3].Y ) ) ) );
+        z = MultiplyAdd_AVX2( CornerX, ViewProj[0].Z, MultiplyAdd_AVX2( CornerY, ViewProj[1].Z, MultiplyAdd_AVX2( CornerZ, ViewProj[2].Z, _mm256_set1_ps( ViewProj[3].Z ) ) ) );
+        w = MultiplyAdd_AVX2( CornerX, ViewProj[0].W, MultiplyAdd_AVX2( CornerY, ViewProj[1].W, MultiplyAdd_AVX2( CornerZ, ViewProj[2].W, _mm256_set1_ps( ViewProj[3].W ) ) ) );
+
+        // Point /= Point.W
+        x = _mm256_div_ps( x, w );
+        y = _mm256_div_ps( y, w );
+        z = _mm256_div_ps( z, w );
+
+        // Take care of nan received by division 0/0
+        x = _mm256_blendv_ps( x, One, _mm256_cmp_ps( x, x, _CMP_UNORD_Q ) );
+        y = _mm256_blendv_ps( y, One, _mm256_cmp_ps( y, y, _CMP_UNORD_Q ) );
+        z = _mm256_blendv_ps( z, One, _mm256_cmp_ps( z, z, _CMP_UNORD_Q ) );
+
+        // Points behind the camera
+        Mask = _mm256_cmp_ps( z, Zero, _CMP_LT_OQ );
+
+        if ( bReverseNegativeZ ) {
+            // reverse and extend bounds
+            __m256 xr = _mm256_sub_ps( Zero, x );
+            __m256 yr = _mm256_sub_ps( Zero, y );
+
+            xMins = _mm256_blendv_ps( x, _mm256_sub_ps( xr, Extend ), Mask );
+            xMaxs = _mm256_blendv_ps( x, _mm256_add_ps( xr, Extend ), Mask );
+            yMins = _mm256_blendv_ps( y, _mm256_sub_ps( yr, Extend ), Mask );
+            yMaxs = _mm256_blendv_ps( y, _mm256_add_ps( yr, Extend ), Mask );
+        } else {
+            xMins = xMaxs = x;
+            yMins = yMaxs = y;
+        }
+
+        z = _mm256_blendv_ps( z, NegativeZ, Mask );
+
+        // compute bounds, take care +-inf received by division w=0
+        bbMins.X = Math::Clamp( HorizontalMin_AVX2( xMins ), -1.0f, 1.0f );
+        bbMins.Y = Math::Clamp( HorizontalMin_AVX2( yMins ), -1.0f, 1.0f );
+        bbMins.Z = Math::Clamp( HorizontalMin_AVX2( z ), -1.0f, 1.0f );
+        bbMaxs.X = Math::Clamp( HorizontalMax_AVX2( xMaxs ), -1.0f, 1.0f );
+        bbMaxs.Y = Math::Clamp( HorizontalMax_AVX2( yMaxs ), -1.0f, 1.0f );
+        bbMaxs.Z = Math::Clamp( HorizontalMax_AVX2( z ), -1.0f, 1.0f );
+
+        SetItemClusterRange( info, bbMins, bbMaxs );
     }
 }
 
-void ALightVoxelizer::Reset() {
+ALightVoxelizer::ALightVoxelizer() {
     ItemsCount = 0;
-    bUseSSE = com_ClusterSSE;
+    bUseSSE = false;
+    bUseAVX2 = false;
+    Core::ZeroMem( &Grid, sizeof( Grid ) );
+    Core::ZeroMem( &Stat, sizeof( Stat ) );
 }
 
-struct SWork
-{
-    int SliceIndex;
-    ALightVoxelizer * Self;
-};
+void ALightVoxelizer::Reset() {
+    ItemsCount = 0;
+
+    SCPUInfo const * cpuInfo = Core::CPUInfo();
+
+    bUseAVX2 = com_ClusterAVX2 && cpuInfo->AVX2 && cpuInfo->OS_AVX;
+    bUseSSE = !bUseAVX2 && com_ClusterSSE;
+
+    if ( Grid.NumClustersX == 0
+         || com_ClusterGridX.IsModified()
+         || com_ClusterGridY.IsModified()
+         || com_ClusterGridZ.IsModified()
+         || com_ClusterSliceOffset.IsModified()
+         || com_ClusterItemCapacity.IsModified() ) {
+
+        Grid.Setup( com_ClusterGridX.GetInteger(),
+                    com_ClusterGridY.GetInteger(),
+                    com_ClusterGridZ.GetInteger(),
+                    com_ClusterSliceOffset.GetInteger(),
+                    com_ClusterItemCapacity.GetInteger() );
+
+        com_ClusterGridX.UnmarkModified();
+        com_ClusterGridY.UnmarkModified();
+        com_ClusterGridZ.UnmarkModified();
+        com_ClusterSliceOffset.UnmarkModified();
+        com_ClusterItemCapacity.UnmarkModified();
+
+        Items.ResizeInvalidate( Grid.GetNumClusters() * Grid.ItemCapacity * 3 );
+        ClusterData.ResizeInvalidate( Grid.GetNumClusters() );
+        ClusterData.ZeroMem();
+
+        GLogger.Printf( "Frustum cluster grid %d x %d x %d, %d items per cluster\n", Grid.NumClustersX, Grid.NumClustersY, Grid.NumClustersZ, Grid.ItemCapacity );
+    }
+}
 
 void ALightVoxelizer::Voxelize( SRenderView * RV ) {
-    ViewProj = RV->ClusterViewProjection;
-    ViewProjInv = RV->ClusterViewProjectionInversed;
+    AN_PROFILER_SCOPE( "ALightVoxelizer::Voxelize" );
 
     AStreamedMemoryGPU * streamedMemory = GRuntime->GetStreamedMemoryGPU();
 
-    // NOTE: we add MAX_CLUSTER_ITEMS*3 to resolve array overflow
-    int maxItems = MAX_TOTAL_CLUSTER_ITEMS + MAX_CLUSTER_ITEMS*3;
     int alignment = GEngine->GetRenderBackend()->ClusterPackedIndicesAlignment();
-    RV->ClusterPackedIndicesStreamHandle = streamedMemory->AllocateWithCustomAlignment( maxItems * sizeof( SClusterPackedIndex ),
+    RV->ClusterPackedIndicesStreamHandle = streamedMemory->AllocateWithCustomAlignment( MAX_TOTAL_CLUSTER_ITEMS * sizeof( SClusterPackedIndex ),
                                                                                         alignment,
                                                                                         nullptr );
     RV->ClusterPackedIndices = (SClusterPackedIndex *)streamedMemory->Map( RV->ClusterPackedIndicesStreamHandle );
 
-    pClusterHeaderData = RV->ClusterLookup;
-    pClusterPackedIndices = RV->ClusterPackedIndices;
+    RV->ClusterPackedIndexCount = Voxelize( RV->ClusterViewProjection, RV->ClusterViewProjectionInversed, RV->ClusterLookup, RV->ClusterPackedIndices );
+
+    // Shrink ClusterItems
+    streamedMemory->ShrinkLastAllocatedMemoryBlock( RV->ClusterPackedIndexCount * sizeof( SClusterPackedIndex ) );
+}
+
+int ALightVoxelizer::Voxelize( Float4x4 const & InViewProj, Float4x4 const & InViewProjInv, SClusterHeader * Headers, SClusterPackedIndex * PackedIndices ) {
+    AN_ASSERT( Grid.NumClustersX > 0 );
 
-    Core::ZeroMemSSE( ClusterData, sizeof( ClusterData ) );
+    ViewProj = InViewProj;
+    ViewProjInv = InViewProjInv;
+
+    pClusterHeaderData = Headers;
+    pClusterPackedIndices = PackedIndices;
+
+    ClusterData.ZeroMem();
 
     // Calc min/max slices
-    if ( bUseSSE ) {
+    if ( bUseAVX2 ) {
+        TransformItemsAVX2();
+    } else if ( bUseSSE ) {
         TransformItemsSSE();
     } else {
         TransformItemsGeneric();
@@ -408,45 +552,60 @@ void ALightVoxelizer::Voxelize( SRenderView * RV ) {
 
     ItemCounter.StoreRelaxed( 0 );
 
-    SWork works[MAX_FRUSTUM_CLUSTERS_Z];
+    GAsyncJobManager.ParallelFor( Grid.NumClustersZ, VoxelizeWork, this );
 
-    for ( int i = 0 ; i < MAX_FRUSTUM_CLUSTERS_Z ; i++ ) {
-        works[i].SliceIndex = i;
-        works[i].Self = this;
-        GRenderFrontendJobList->AddJob( VoxelizeWork, &works[i] );
+    Core::ZeroMem( &Stat, sizeof( Stat ) );
+    for ( int sliceIndex = 0 ; sliceIndex < Grid.NumClustersZ ; sliceIndex++ ) {
+        Stat.OverflowClusters += SliceStat[sliceIndex].OverflowClusters;
+        Stat.DroppedItems += SliceStat[sliceIndex].DroppedItems;
+        Stat.DroppedPackedItems += SliceStat[sliceIndex].DroppedPackedItems;
+        Stat.MaxClusterItems = Math::Max( Stat.MaxClusterItems, SliceStat[sliceIndex].MaxClusterItems );
     }
 
-    GRenderFrontendJobList->SubmitAndWait();
-
-    RV->ClusterPackedIndexCount = ItemCounter.Load();
+    int packedIndexCount = ItemCounter.Load();
 
-    if ( RV->ClusterPackedIndexCount > MAX_TOTAL_CLUSTER_ITEMS ) {
-        RV->ClusterPackedIndexCount = MAX_TOTAL_CLUSTER_ITEMS;
+    if ( packedIndexCount > MAX_TOTAL_CLUSTER_ITEMS ) {
+        packedIndexCount = MAX_TOTAL_CLUSTER_ITEMS;
 
         GLogger.Printf( "MAX_TOTAL_CLUSTER_ITEMS hit\n" );
     }
 
-    // Shrink ClusterItems
-    streamedMemory->ShrinkLastAllocatedMemoryBlock( RV->ClusterPackedIndexCount * sizeof( SClusterPackedIndex ) );
+    return packedIndexCount;
+}
+
+AN_FORCEINLINE void AddClusterItem( unsigned short * pClusterItems, unsigned short & Count, int Capacity, int ItemIndex ) {
+    // Keep counting on overflow to know how many items were dropped
+    if ( Count < Capacity ) {
+        pClusterItems[Count] = ItemIndex;
+    }
+    Count++;
 }
 
-void ALightVoxelizer::VoxelizeWork( void * _Data ) {
-    SWork * work = static_cast< SWork * >( _Data );
+void ALightVoxelizer::VoxelizeWork( int _FirstSlice, int _LastSlice, void * _Data ) {
+    ALightVoxelizer * self = static_cast< ALightVoxelizer * >( _Data );
 
-    work->Self->VoxelizeWork( work->SliceIndex );
+    for ( int sliceIndex = _FirstSlice ; sliceIndex < _LastSlice ; sliceIndex++ ) {
+        self->VoxelizeWork( sliceIndex );
+    }
 }
 
 void ALightVoxelizer::VoxelizeWork( int SliceIndex ) {
     alignas(16) Float3 ClusterMins;
     alignas(16) Float3 ClusterMaxs;
 
-    ClusterMins.Z = FRUSTUM_SLICE_ZCLIP[SliceIndex + 1];
-    ClusterMaxs.Z = FRUSTUM_SLICE_ZCLIP[SliceIndex];
+    ClusterMins.Z = Grid.SliceZClip[SliceIndex + 1];
+    ClusterMaxs.Z = Grid.SliceZClip[SliceIndex];
+
+    const int itemCapacity = Grid.ItemCapacity;
+    const int itemStride = itemCapacity * 3;
+    const int probeItemsOffset = itemCapacity * 2;
 
     SFrustumCluster * pCluster;
     unsigned short * pClusterItem;
 
-    if ( bUseSSE ) {
+    if ( bUseAVX2 ) {
+        VoxelizeSliceAVX2( SliceIndex );
+    } else if ( bUseSSE ) {
         //__m128 Zero = _mm_setzero_ps();
         __m128 OutsidePosPlane;
         __m128 OutsideNegPlane;
@@ -463,6 +622,8 @@ void ALightVoxelizer::VoxelizeWork( int SliceIndex ) {
         //alignas(16) int CullingResult;
         __m128 UniformBoxMinsSSE = _mm_set_ps( 0.0f, -1.0f, -1.0f, -1.0f );
         __m128 UniformBoxMaxsSSE = _mm_set_ps( 0.0f, 1.0f, 1.0f, 1.0f );
+        // All bits set. NOTE: _mm_set1_ps( static_cast< float >(0xffffffff) ) gives 4294967295.0f, not a mask
+        const __m128 AllBitsSSE = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
 
         for ( int ItemIndex = 0 ; ItemIndex < ItemsCount ; ItemIndex++ ) {
             SItemInfo & Info = ItemInfos[ItemIndex];
@@ -474,27 +635,27 @@ void ALightVoxelizer::VoxelizeWork( int SliceIndex ) {
             v_zzzz_min_mul_col2_add_col3 = _mm_add_ps( _mm_mul_ps( _mm_set_ps1( ClusterMins.Z ), Info.ClipToBoxMatSSE.col2 ), Info.ClipToBoxMatSSE.col3 );
             v_zzzz_max_mul_col2_add_col3 = _mm_add_ps( _mm_mul_ps( _mm_set_ps1( ClusterMaxs.Z ), Info.ClipToBoxMatSSE.col2 ), Info.ClipToBoxMatSSE.col3 );
 
-            pCluster = &ClusterData[SliceIndex][Info.MinClusterY][0];
-            pClusterItem = &Items[SliceIndex][Info.MinClusterY][0][0];
+            pCluster = &ClusterData[(SliceIndex * Grid.NumClustersY + Info.MinClusterY) * Grid.NumClustersX];
+            pClusterItem = &Items[(SliceIndex * Grid.NumClustersY + Info.MinClusterY) * Grid.NumClustersX * itemStride];
 
             for ( int ClusterY = Info.MinClusterY ; ClusterY < Info.MaxClusterY ; ClusterY++ ) {
 
-                ClusterMins.Y = ClusterY * FRUSTUM_CLUSTER_HEIGHT - 1.0f;
-                ClusterMaxs.Y = ClusterMins.Y + FRUSTUM_CLUSTER_HEIGHT;
+                ClusterMins.Y = ClusterY * Grid.ClusterHeight - 1.0f;
+                ClusterMaxs.Y = ClusterMins.Y + Grid.ClusterHeight;
 
                 v_yyyy_min_mul_col1 = _mm_mul_ps( _mm_set_ps1( ClusterMins.Y ), Info.ClipToBoxMatSSE.col1 );
                 v_yyyy_max_mul_col1 = _mm_mul_ps( _mm_set_ps1( ClusterMaxs.Y ), Info.ClipToBoxMatSSE.col1 );
 
                 for ( int ClusterX = Info.MinClusterX ; ClusterX < Info.MaxClusterX ; ClusterX++ ) {
 
-                    ClusterMins.X = ClusterX * FRUSTUM_CLUSTER_WIDTH - 1.0f;
-                    ClusterMaxs.X = ClusterMins.X + FRUSTUM_CLUSTER_WIDTH;
+                    ClusterMins.X = ClusterX * Grid.ClusterWidth - 1.0f;
+                    ClusterMaxs.X = ClusterMins.X + Grid.ClusterWidth;
 
                     v_xxxx_min_mul_col0 = _mm_mul_ps( _mm_set_ps1( ClusterMins.X ), Info.ClipToBoxMatSSE.col0 );
                     v_xxxx_max_mul_col0 = _mm_mul_ps( _mm_set_ps1( ClusterMaxs.X ), Info.ClipToBoxMatSSE.col0 );
 
-                    OutsidePosPlane = _mm_set1_ps( static_cast< float >(0xffffffff) );
-                    OutsideNegPlane = _mm_set1_ps( static_cast< float >(0xffffffff) );
+                    OutsidePosPlane = AllBitsSSE;
+                    OutsideNegPlane = AllBitsSSE;
 
                     PointSSE = sum_ps_3( v_xxxx_min_mul_col0, v_yyyy_min_mul_col1, v_zzzz_max_mul_col2_add_col3 );
                     PointSSE = _mm_div_ps( PointSSE, _mm_shuffle_ps( PointSSE, PointSSE, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );  // Point /= Point.W
@@ -557,16 +718,16 @@ void ALightVoxelizer::VoxelizeWork( int SliceIndex ) {
 
                     switch ( Info.Type ) {
                     case ITEM_TYPE_LIGHT:
-                        pClusterItem[ClusterX * (MAX_CLUSTER_ITEMS * 3) + LIGHT_ITEMS_OFFSET + ((pCluster + ClusterX)->LightsCount++ & (MAX_CLUSTER_ITEMS - 1))] = ItemIndex;
+                        AddClusterItem( pClusterItem + ClusterX * itemStride, (pCluster + ClusterX)->LightsCount, itemCapacity, ItemIndex );
                         break;
                     case ITEM_TYPE_PROBE:
-                        pClusterItem[ClusterX * (MAX_CLUSTER_ITEMS * 3) + PROBE_ITEMS_OFFSET + ((pCluster + ClusterX)->ProbesCount++ & (MAX_CLUSTER_ITEMS - 1))] = ItemIndex;
+                        AddClusterItem( pClusterItem + ClusterX * itemStride + probeItemsOffset, (pCluster + ClusterX)->ProbesCount, itemCapacity, ItemIndex );
                         break;
                     }
                 }
 
-                pCluster += MAX_FRUSTUM_CLUSTERS_X;
-                pClusterItem += MAX_FRUSTUM_CLUSTERS_X * MAX_CLUSTER_ITEMS * 3;
+                pCluster += Grid.NumClustersX;
+                pClusterItem += Grid.NumClustersX * itemStride;
             }
         }
     } else {
@@ -582,18 +743,18 @@ void ALightVoxelizer::VoxelizeWork( int SliceIndex ) {
                 continue;
             }
 
-            pCluster = &ClusterData[SliceIndex][Info.MinClusterY][0];
-            pClusterItem = &Items[SliceIndex][Info.MinClusterY][0][0];
+            pCluster = &ClusterData[(SliceIndex * Grid.NumClustersY + Info.MinClusterY) * Grid.NumClustersX];
+            pClusterItem = &Items[(SliceIndex * Grid.NumClustersY + Info.MinClusterY) * Grid.NumClustersX * itemStride];
 
             for ( int ClusterY = Info.MinClusterY ; ClusterY < Info.MaxClusterY ; ClusterY++ ) {
 
-                ClusterMins.Y = ClusterY * FRUSTUM_CLUSTER_HEIGHT - 1.0f;
-                ClusterMaxs.Y = ClusterMins.Y + FRUSTUM_CLUSTER_HEIGHT;
+                ClusterMins.Y = ClusterY * Grid.ClusterHeight - 1.0f;
+                ClusterMaxs.Y = ClusterMins.Y + Grid.ClusterHeight;
 
                 for ( int ClusterX = Info.MinClusterX ; ClusterX < Info.MaxClusterX ; ClusterX++ ) {
 
-                    ClusterMins.X = ClusterX * FRUSTUM_CLUSTER_WIDTH - 1.0f;
-                    ClusterMaxs.X = ClusterMins.X + FRUSTUM_CLUSTER_WIDTH;
+                    ClusterMins.X = ClusterX * Grid.ClusterWidth - 1.0f;
+                    ClusterMaxs.X = ClusterMins.X + Grid.ClusterWidth;
 
                     BoxPoints[0] = Float4( ClusterMins.X, ClusterMins.Y, ClusterMaxs.Z, 1.0f );
                     BoxPoints[1] = Float4( ClusterMaxs.X, ClusterMins.Y, ClusterMaxs.Z, 1.0f );
@@ -655,78 +816,165 @@ void ALightVoxelizer::VoxelizeWork( int SliceIndex ) {
 #endif
                     switch ( Info.Type ) {
                     case ITEM_TYPE_LIGHT:
-                        pClusterItem[ClusterX * (MAX_CLUSTER_ITEMS * 3) + LIGHT_ITEMS_OFFSET + ((pCluster + ClusterX)->LightsCount++ & (MAX_CLUSTER_ITEMS - 1))] = ItemIndex;
+                        AddClusterItem( pClusterItem + ClusterX * itemStride, (pCluster + ClusterX)->LightsCount, itemCapacity, ItemIndex );
                         break;
                     case ITEM_TYPE_PROBE:
-                        pClusterItem[ClusterX * (MAX_CLUSTER_ITEMS * 3) + PROBE_ITEMS_OFFSET + ((pCluster + ClusterX)->ProbesCount++ & (MAX_CLUSTER_ITEMS - 1))] = ItemIndex;
+                        AddClusterItem( pClusterItem + ClusterX * itemStride + probeItemsOffset, (pCluster + ClusterX)->ProbesCount, itemCapacity, ItemIndex );
                         break;
                     }
                 }
 
-                pCluster += MAX_FRUSTUM_CLUSTERS_X;
-                pClusterItem += MAX_FRUSTUM_CLUSTERS_X * MAX_CLUSTER_ITEMS * 3;
+                pCluster += Grid.NumClustersX;
+                pClusterItem += Grid.NumClustersX * itemStride;
             }
         }
     }
 
-    //    int i = 0;
+    const int numClustersPerSlice = Grid.NumClustersX * Grid.NumClustersY;
     int NumClusterItems;
+    int numLights, numDecals, numProbes;
 
-    SClusterHeader * pClusterHeader = pClusterHeaderData + SliceIndex * ( MAX_FRUSTUM_CLUSTERS_X * MAX_FRUSTUM_CLUSTERS_Y );
+    SClusterHeader * pClusterHeader = pClusterHeaderData + SliceIndex * numClustersPerSlice;
     SClusterPackedIndex * pItem;
     SItemInfo * pItemInfo;
 
-    pCluster = &ClusterData[SliceIndex][0][0];
-    pClusterItem = &Items[SliceIndex][0][0][0];
+    SLightVoxelizerStat & stat = SliceStat[SliceIndex];
+    Core::ZeroMem( &stat, sizeof( stat ) );
 
-    for ( int ClusterY = 0 ; ClusterY < MAX_FRUSTUM_CLUSTERS_Y ; ClusterY++ ) {
-        for ( int ClusterX = 0 ; ClusterX < MAX_FRUSTUM_CLUSTERS_X ; ClusterX++ ) {
+    pCluster = &ClusterData[SliceIndex * numClustersPerSlice];
+    pClusterItem = &Items[SliceIndex * numClustersPerSlice * itemStride];
 
-            pClusterHeader->NumLights = Math::Min< unsigned short >( pCluster->LightsCount, MAX_CLUSTER_ITEMS );
-            pClusterHeader->NumDecals = Math::Min< unsigned short >( pCluster->DecalsCount, MAX_CLUSTER_ITEMS );
-            pClusterHeader->NumProbes = Math::Min< unsigned short >( pCluster->ProbesCount, MAX_CLUSTER_ITEMS );
+    for ( int ClusterIndex = 0 ; ClusterIndex < numClustersPerSlice ; ClusterIndex++, pClusterHeader++, pCluster++, pClusterItem += itemStride ) {
 
-            NumClusterItems = Math::Max3( pClusterHeader->NumLights, pClusterHeader->NumDecals, pClusterHeader->NumProbes );
+        NumClusterItems = Math::Max3( pCluster->LightsCount, pCluster->DecalsCount, pCluster->ProbesCount );
 
-            int firstPackedIndex = ItemCounter.FetchAdd( NumClusterItems );
+        stat.MaxClusterItems = Math::Max( stat.MaxClusterItems, NumClusterItems );
 
-            pClusterHeader->FirstPackedIndex = firstPackedIndex & (MAX_TOTAL_CLUSTER_ITEMS - 1);
+        if ( NumClusterItems > itemCapacity ) {
+            stat.OverflowClusters++;
+            stat.DroppedItems += Math::Max( pCluster->LightsCount - itemCapacity, 0 )
+                               + Math::Max( pCluster->DecalsCount - itemCapacity, 0 )
+                               + Math::Max( pCluster->ProbesCount - itemCapacity, 0 );
+        }
 
-            pItem = &pClusterPackedIndices[pClusterHeader->FirstPackedIndex];
+        numLights = Math::Min< int >( pCluster->LightsCount, itemCapacity );
+        numDecals = Math::Min< int >( pCluster->DecalsCount, itemCapacity );
+        numProbes = Math::Min< int >( pCluster->ProbesCount, itemCapacity );
 
-            Core::ZeroMem( pItem, NumClusterItems * sizeof( SClusterPackedIndex ) );
+        NumClusterItems = Math::Max3( numLights, numDecals, numProbes );
 
-            for ( int t = 0 ; t < pClusterHeader->NumLights ; t++ ) {
-                pItemInfo = ItemInfos + pClusterItem[LIGHT_ITEMS_OFFSET + t];
+        int firstPackedIndex = ItemCounter.FetchAdd( NumClusterItems );
 
-                (pItem + t)->Indices |= pItemInfo->ListIndex;
-            }
+        if ( firstPackedIndex + NumClusterItems > MAX_TOTAL_CLUSTER_ITEMS ) {
+            // Out of packed indices, leave the cluster empty
+            stat.DroppedPackedItems += numLights + numDecals + numProbes;
+            numLights = numDecals = numProbes = 0;
+            firstPackedIndex = 0;
+            NumClusterItems = 0;
+        }
 
-            for ( int t = 0 ; t < pClusterHeader->NumProbes ; t++ ) {
-                pItemInfo = ItemInfos + pClusterItem[PROBE_ITEMS_OFFSET + t];
+        pClusterHeader->FirstPackedIndex = firstPackedIndex;
+        pClusterHeader->NumLights = numLights;
+        pClusterHeader->NumDecals = numDecals;
+        pClusterHeader->NumProbes = numProbes;
 
-                (pItem + t)->Indices |= pItemInfo->ListIndex << 24;
-            }
+        pItem = &pClusterPackedIndices[firstPackedIndex];
+
+        Core::ZeroMem( pItem, NumClusterItems * sizeof( SClusterPackedIndex ) );
 
-            //for ( int t = 0 ; t < pClusterHeader->NumDecals ; t++ ) {
-            //    i = DecalCounter.FetchIncrement() & 0x3ff;
+        for ( int t = 0 ; t < numLights ; t++ ) {
+            pItemInfo = ItemInfos + pClusterItem[t];
 
-            //    ( pItem + t )->Indices |= i << 12;
+            (pItem + t)->Indices |= pItemInfo->ListIndex;
+        }
 
-            //    Decals[ i ].Position = pCluster->Decals[ t ]->Position;
-            //}
+        for ( int t = 0 ; t < numProbes ; t++ ) {
+            pItemInfo = ItemInfos + pClusterItem[probeItemsOffset + t];
 
-            //for ( int t = 0 ; t < pClusterHeader->NumProbes ; t++ ) {
-            //    i = ProbeCounter.FetchIncrement() & 0xff;
+            (pItem + t)->Indices |= pItemInfo->ListIndex << 22;
+        }
 
-            //    ( pItem + t )->Indices |= i << 24;
+        //for ( int t = 0 ; t < numDecals ; t++ ) {
+        //    i = DecalCounter.FetchIncrement() & 0x3ff;
 
-            //    Probes[ i ].Position = pCluster->Probes[ t ]->Position;
-            //}
+        //    ( pItem + t )->Indices |= i << 12;
 
-            pClusterHeader++;
-            pCluster++;
-            pClusterItem += MAX_CLUSTER_ITEMS * 3;
+        //    Decals[ i ].Position = pCluster->Decals[ t ]->Position;
+        //}
+    }
+}
+
+AVX2_TARGET void ALightVoxelizer::VoxelizeSliceAVX2( int SliceIndex ) {
+    const int itemCapacity = Grid.ItemCapacity;
+    const int itemStride = itemCapacity * 3;
+    const int probeItemsOffset = itemCapacity * 2;
+
+    const __m256 CornerZ = SelectCorners_AVX2< CORNER_MAX_Z >( Grid.SliceZClip[SliceIndex + 1], Grid.SliceZClip[SliceIndex] );
+
+    __m256 zx, zy, zz, zw;
+    __m256 yx, yy, yz, yw;
+    __m256 x, y, z, w;
+    __m256 CornerX, CornerY;
+    float ClusterMinX, ClusterMinY;
+
+    SFrustumCluster * pCluster;
+    unsigned short * pClusterItem;
+
+    for ( int ItemIndex = 0 ; ItemIndex < ItemsCount ; ItemIndex++ ) {
+        SItemInfo & Info = ItemInfos[ItemIndex];
+
+        if ( SliceIndex < Info.MinSlice || SliceIndex >= Info.MaxSlice ) {
+            continue;
+        }
+
+        Float4x4 const & m = Info.ClipToBoxMat;
+
+        zx = MultiplyAdd_AVX2( CornerZ, m[2].X, _mm256_set1_ps( m[3].X ) );
+        zy = MultiplyAdd_AVX2( CornerZ, m[2].Y, _mm256_set1_ps( m[3].Y ) );
+        zz = MultiplyAdd_AVX2( CornerZ, m[2].Z, _mm256_set1_ps( m[3].Z ) );
+        zw = MultiplyAdd_AVX2( CornerZ, m[2].W, _mm256_set1_ps( m[3].W ) );
+
+        pCluster = &ClusterData[(SliceIndex * Grid.NumClustersY + Info.MinClusterY) * Grid.NumClustersX];
+        pClusterItem = &Items[(SliceIndex * Grid.NumClustersY + Info.MinClusterY) * Grid.NumClustersX * itemStride];
+
+        for ( int ClusterY = Info.MinClusterY ; ClusterY < Info.MaxClusterY ; ClusterY++ ) {
+
+            ClusterMinY = ClusterY * Grid.ClusterHeight - 1.0f;
+            CornerY = SelectCorners_AVX2< CORNER_MAX_Y >( ClusterMinY, ClusterMinY + Grid.ClusterHeight );
+
+            yx = MultiplyAdd_AVX2( CornerY, m[1].X, zx );
+            yy = MultiplyAdd_AVX2( CornerY, m[1].Y, zy );
+            yz = MultiplyAdd_AVX2( CornerY, m[1].Z, zz );
+            yw = MultiplyAdd_AVX2( CornerY, m[1].W, zw );
+
+            for ( int ClusterX = Info.MinClusterX ; ClusterX < Info.MaxClusterX ; ClusterX++ ) {
+
+                ClusterMinX = ClusterX * Grid.ClusterWidth - 1.0f;
+                CornerX = SelectCorners_AVX2< CORNER_MAX_X >( ClusterMinX, ClusterMinX + Grid.ClusterWidth );
+
+                // Cluster corners to box space
+                w = MultiplyAdd_AVX2( CornerX, m[0].W, yw );
+                x = _mm256_div_ps( MultiplyAdd_AVX2( CornerX, m[0].X, yx ), w );
+                y = _mm256_div_ps( MultiplyAdd_AVX2( CornerX, m[0].Y, yy ), w );
+                z = _mm256_div_ps( MultiplyAdd_AVX2( CornerX, m[0].Z, yz ), w );
+
+                if ( IsOutside_AVX2( x ) || IsOutside_AVX2( y ) || IsOutside_AVX2( z ) ) {
+                    // culled
+                    continue;
+                }
+
+                switch ( Info.Type ) {
+                case ITEM_TYPE_LIGHT:
+                    AddClusterItem( pClusterItem + ClusterX * itemStride, (pCluster + ClusterX)->LightsCount, itemCapacity, ItemIndex );
+                    break;
+                case ITEM_TYPE_PROBE:
+                    AddClusterItem( pClusterItem + ClusterX * itemStride + probeItemsOffset, (pCluster + ClusterX)->ProbesCount, itemCapacity, ItemIndex );
+                    break;
+                }
+            }
+
+            pCluster += Grid.NumClustersX;
+            pClusterItem += Grid.NumClustersX * itemStride;
         }
     }
 }
@@ -740,24 +988,26 @@ void ALightVoxelizer::GatherVoxelGeometry( TStdVectorHeap< Float3 > & LinePoints
 
     LinePoints.clear();
 
-    for ( int sliceIndex = 0 ; sliceIndex < MAX_FRUSTUM_CLUSTERS_Z ; sliceIndex++ ) {
+    for ( int sliceIndex = 0 ; sliceIndex < Grid.NumClustersZ ; sliceIndex++ ) {
+
+        clusterMins.Z = Grid.SliceZClip[ sliceIndex + 1 ];
+        clusterMaxs.Z = Grid.SliceZClip[ sliceIndex ];
 
-        clusterMins.Z = FRUSTUM_SLICE_ZCLIP[ sliceIndex + 1 ];
-        clusterMaxs.Z = FRUSTUM_SLICE_ZCLIP[ sliceIndex ];
+        for ( int clusterY = 0 ; clusterY < Grid.NumClustersY ; clusterY++ ) {
 
-        for ( int clusterY = 0 ; clusterY < MAX_FRUSTUM_CLUSTERS_Y ; clusterY++ ) {
+            clusterMins.Y = clusterY * Grid.ClusterHeight - 1.0f;
+            clusterMaxs.Y = clusterMins.Y + Grid.ClusterHeight;
 
-            clusterMins.Y = clusterY * FRUSTUM_CLUSTER_HEIGHT - 1.0f;
-            clusterMaxs.Y = clusterMins.Y + FRUSTUM_CLUSTER_HEIGHT;
+            for ( int clusterX = 0 ; clusterX < Grid.NumClustersX ; clusterX++ ) {
 
-            for ( int clusterX = 0 ; clusterX < MAX_FRUSTUM_CLUSTERS_X ; clusterX++ ) {
+                clusterMins.X = clusterX * Grid.ClusterWidth - 1.0f;
+                clusterMaxs.X = clusterMins.X + Grid.ClusterWidth;
 
-                clusterMins.X = clusterX * FRUSTUM_CLUSTER_WIDTH - 1.0f;
-                clusterMaxs.X = clusterMins.X + FRUSTUM_CLUSTER_WIDTH;
+                SFrustumCluster const & cluster = ClusterData[ ( sliceIndex * Grid.NumClustersY + clusterY ) * Grid.NumClustersX + clusterX ];
 
-                if (   ClusterData[ sliceIndex ][ clusterY ][ clusterX ].LightsCount > 0
-                    || ClusterData[ sliceIndex ][ clusterY ][ clusterX ].DecalsCount > 0
-                    || ClusterData[ sliceIndex ][ clusterY ][ clusterX ].ProbesCount > 0 ) {
+                if (   cluster.LightsCount > 0
+                    || cluster.DecalsCount > 0
+                    || cluster.ProbesCount > 0 ) {
                     p[ 0 ] = Float4( clusterMins.X, clusterMins.Y, clusterMins.Z, 1.0f );
                     p[ 1 ] = Float4( clusterMaxs.X, clusterMins.Y, clusterMins.Z, 1.0f );
                     p[ 2 ] = Float4( clusterMaxs.X, clusterMaxs.Y, clusterMins.Z, 1.0f );
@@ -793,7 +1043,9 @@ void ALightVoxelizer::DrawVoxels( ADebugRenderer * InRenderer )
         GatherVoxelGeometry( DebugLinePoints, viewProjInv );
     }
 
-    if ( bUseSSE )
+    if ( bUseAVX2 )
+        InRenderer->SetColor( AColor4( 0, 1, 0 ) );
+    else if ( bUseSSE )
         InRenderer->SetColor( AColor4( 0, 0, 1 ) );
     else
         InRenderer->SetColor( AColor4( 1, 0, 0 ) );
@@ -0,0 +1,445 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <World/Public/Render/OcclusionBuffer.h>
+#include <Runtime/Public/AsyncJobManager.h>
+
+#include <xmmintrin.h>
+
+// Minimal W to avoid division by zero for vertices at the eye plane
+static constexpr float MIN_CLIP_W = 1e-4f;
+
+// Bands are rasterized on the calling thread if there are too few triangles
+static constexpr int MIN_TRIANGLES_FOR_JOBS = 64;
+
+AOcclusionBuffer::AOcclusionBuffer()
+{
+    int totalSize = 0;
+    for ( int lod = 0 ; lod < NUM_LODS ; lod++ ) {
+        totalSize += Align( GetLodWidth( lod ) * GetLodHeight( lod ), 4 );
+    }
+
+    Storage.ResizeInvalidate( totalSize );
+
+    float * depth = Storage.ToPtr();
+    for ( int lod = 0 ; lod < NUM_LODS ; lod++ ) {
+        Lods[lod] = depth;
+        depth += Align( GetLodWidth( lod ) * GetLodHeight( lod ), 4 );
+    }
+
+    for ( int bin = 0 ; bin < NUM_BINS ; bin++ ) {
+        BinJobs[bin].Self = this;
+        BinJobs[bin].Bin = bin;
+    }
+
+    ViewProjection = Float4x4::Identity();
+    NumRasterizedTriangles = 0;
+}
+
+void AOcclusionBuffer::Clear( Float4x4 const & _ViewProjection )
+{
+    ViewProjection = _ViewProjection;
+
+    // Zero is the far plane for reversed depth
+    Core::ZeroMemSSE( Lods[0], sizeof( float ) * WIDTH * HEIGHT );
+
+    Triangles.Clear();
+    for ( int bin = 0 ; bin < NUM_BINS ; bin++ ) {
+        BinTriangles[bin].Clear();
+    }
+
+    NumRasterizedTriangles = 0;
+}
+
+void AOcclusionBuffer::RasterizeTriangles( void const * _Vertices, int _VertexStride, unsigned int const * _Indices, int _NumIndices )
+{
+    byte const * vertices = ( byte const * )_Vertices;
+
+    for ( int i = 0 ; i + 2 < _NumIndices ; i += 3 ) {
+        Float3 const & v0 = *( Float3 const * )( vertices + _Indices[i    ] * _VertexStride );
+        Float3 const & v1 = *( Float3 const * )( vertices + _Indices[i + 1] * _VertexStride );
+        Float3 const & v2 = *( Float3 const * )( vertices + _Indices[i + 2] * _VertexStride );
+
+        ClipAndAdd( v0, v1, v2 );
+    }
+}
+
+void AOcclusionBuffer::RasterizeBox( BvAxisAlignedBox const & _Box )
+{
+    static constexpr unsigned int BoxIndices[36] = {
+        0,1,3, 0,3,2, // -X
+        4,6,7, 4,7,5, // +X
+        0,4,5, 0,5,1, // -Y
+        2,3,7, 2,7,6, // +Y
+        0,2,6, 0,6,4, // -Z
+        1,5,7, 1,7,3  // +Z
+    };
+
+    Float3 corners[8];
+    for ( int i = 0 ; i < 8 ; i++ ) {
+        corners[i].X = ( i & 4 ) ? _Box.Maxs.X : _Box.Mins.X;
+        corners[i].Y = ( i & 2 ) ? _Box.Maxs.Y : _Box.Mins.Y;
+        corners[i].Z = ( i & 1 ) ? _Box.Maxs.Z : _Box.Mins.Z;
+    }
+
+    RasterizeTriangles( corners, sizeof( Float3 ), BoxIndices, 36 );
+}
+
+AN_FORCEINLINE Float4 TransformPoint( Float4x4 const & _Matrix, Float3 const & _Point )
+{
+    return _Matrix[0] * _Point.X + _Matrix[1] * _Point.Y + _Matrix[2] * _Point.Z + _Matrix[3];
+}
+
+// Distances to near clipping planes (reversed depth: Z <= W) and (W >= MIN_CLIP_W)
+AN_FORCEINLINE float ClipDistance( Float4 const & _Vertex, int _Plane )
+{
+    return _Plane == 0 ? _Vertex.W - _Vertex.Z : _Vertex.W - MIN_CLIP_W;
+}
+
+void AOcclusionBuffer::ClipAndAdd( Float3 const & _V0, Float3 const & _V1, Float3 const & _V2 )
+{
+    // Triangle clipped by two planes has at most 5 vertices
+    Float4 polygon[2][8];
+    int numPoints;
+
+    polygon[0][0] = TransformPoint( ViewProjection, _V0 );
+    polygon[0][1] = TransformPoint( ViewProjection, _V1 );
+    polygon[0][2] = TransformPoint( ViewProjection, _V2 );
+    numPoints = 3;
+
+    int src = 0;
+    for ( int plane = 0 ; plane < 2 ; plane++ ) {
+        Float4 const * in = polygon[src];
+        Float4 * out = polygon[src ^ 1];
+        int numOut = 0;
+
+        for ( int i = 0 ; i < numPoints ; i++ ) {
+            Float4 const & a = in[i];
+            Float4 const & b = in[( i + 1 ) % numPoints];
+
+            float da = ClipDistance( a, plane );
+            float db = ClipDistance( b, plane );
+
+            if ( da >= 0 ) {
+                out[numOut++] = a;
+            }
+            if ( ( da >= 0 ) != ( db >= 0 ) ) {
+                float t = da / ( da - db );
+                out[numOut++] = a + ( b - a ) * t;
+            }
+        }
+
+        numPoints = numOut;
+        src ^= 1;
+
+        if ( numPoints < 3 ) {
+            return;
+        }
+    }
+
+    // Project to screen
+    Float3 screen[8];
+    for ( int i = 0 ; i < numPoints ; i++ ) {
+        Float4 const & v = polygon[src][i];
+        float invW = 1.0f / v.W;
+        screen[i].X = ( v.X * invW * 0.5f + 0.5f ) * WIDTH;
+        screen[i].Y = ( v.Y * invW * 0.5f + 0.5f ) * HEIGHT;
+        screen[i].Z = v.Z * invW;
+    }
+
+    for ( int i = 2 ; i < numPoints ; i++ ) {
+        AddTriangle( screen[0], screen[i - 1], screen[i] );
+    }
+}
+
+void AOcclusionBuffer::AddTriangle( Float3 const & _V0, Float3 const & _V1, Float3 const & _V2 )
+{
+    float dx1 = _V1.X - _V0.X;
+    float dy1 = _V1.Y - _V0.Y;
+    float dx2 = _V2.X - _V0.X;
+    float dy2 = _V2.Y - _V0.Y;
+
+    float area = dx1 * dy2 - dx2 * dy1;
+    if ( Math::Abs( area ) < 1e-8f ) {
+        return;
+    }
+
+    // Occluders are two sided, make winding counter clockwise
+    Float3 const * v[3] = { &_V0, &_V1, &_V2 };
+    if ( area < 0 ) {
+        std::swap( v[1], v[2] );
+    }
+
+    // Bounding rect
+    float minXf = Math::Min3( v[0]->X, v[1]->X, v[2]->X );
+    float maxXf = Math::Max3( v[0]->X, v[1]->X, v[2]->X );
+    float minYf = Math::Min3( v[0]->Y, v[1]->Y, v[2]->Y );
+    float maxYf = Math::Max3( v[0]->Y, v[1]->Y, v[2]->Y );
+
+    int minX = Math::Max( ( int )Math::Floor( minXf ), 0 ) & ~3;
+    int maxX = Math::Min( ( int )Math::Ceil( maxXf ), WIDTH - 1 );
+    int minY = Math::Max( ( int )Math::Floor( minYf ), 0 );
+    int maxY = Math::Min( ( int )Math::Ceil( maxYf ), HEIGHT - 1 );
+
+    if ( minX > maxX || minY > maxY ) {
+        return;
+    }
+
+    NumRasterizedTriangles++;
+
+    const int index = Triangles.Size();
+
+    SScreenTriangle & triangle = Triangles.Append();
+    triangle.V[0] = *v[0];
+    triangle.V[1] = *v[1];
+    triangle.V[2] = *v[2];
+    triangle.MinX = minX;
+    triangle.MaxX = maxX;
+    triangle.MinY = minY;
+    triangle.MaxY = maxY;
+
+    for ( int bin = minY / BIN_HEIGHT ; bin <= maxY / BIN_HEIGHT ; bin++ ) {
+        BinTriangles[bin].Append( index );
+    }
+}
+
+void AOcclusionBuffer::RasterizeBinAsync( void * _Data )
+{
+    SBinJob * job = ( SBinJob * )_Data;
+
+    job->Self->RasterizeBin( job->Bin );
+}
+
+void AOcclusionBuffer::RasterizeBin( int _Bin )
+{
+    const int minY = _Bin * BIN_HEIGHT;
+    const int maxY = minY + BIN_HEIGHT - 1;
+
+    for ( int index : BinTriangles[_Bin] ) {
+        RasterizeTriangle( Triangles[index], minY, maxY );
+    }
+}
+
+void AOcclusionBuffer::RasterizeTriangle( SScreenTriangle const & _Triangle, int _MinY, int _MaxY )
+{
+    Float3 const * v[3] = { &_Triangle.V[0], &_Triangle.V[1], &_Triangle.V[2] };
+
+    const float dx1 = v[1]->X - v[0]->X;
+    const float dy1 = v[1]->Y - v[0]->Y;
+    const float dx2 = v[2]->X - v[0]->X;
+    const float dy2 = v[2]->Y - v[0]->Y;
+    const float area = dx1 * dy2 - dx2 * dy1;
+
+    const int minX = _Triangle.MinX;
+    const int maxX = _Triangle.MaxX;
+    const int minY = Math::Max( _Triangle.MinY, _MinY );
+    const int maxY = Math::Min( _Triangle.MaxY, _MaxY );
+
+    // Edge functions E(x,y) = A * x + B * y + C, positive inside
+    float edgeA[3], edgeB[3], edgeC[3];
+    for ( int i = 0 ; i < 3 ; i++ ) {
+        Float3 const & a = *v[i];
+        Float3 const & b = *v[( i + 1 ) % 3];
+        edgeA[i] = a.Y - b.Y;
+        edgeB[i] = b.X - a.X;
+        edgeC[i] = -( edgeA[i] * a.X + edgeB[i] * a.Y );
+    }
+
+    // Depth plane Z(x,y) = Zx * x + Zy * y + Z0
+    float dz1 = v[1]->Z - v[0]->Z;
+    float dz2 = v[2]->Z - v[0]->Z;
+    float invArea = 1.0f / area;
+    float zx = ( dz1 * dy2 - dz2 * dy1 ) * invArea;
+    float zy = ( dz2 * dx1 - dz1 * dx2 ) * invArea;
+    float z0 = v[0]->Z - zx * v[0]->X - zy * v[0]->Y;
+
+    const __m128 pixelOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 step = _mm_set1_ps( 4.0f );
+
+    __m128 a0 = _mm_set1_ps( edgeA[0] );
+    __m128 a1 = _mm_set1_ps( edgeA[1] );
+    __m128 a2 = _mm_set1_ps( edgeA[2] );
+    __m128 zxv = _mm_set1_ps( zx );
+
+    __m128 stepE0 = _mm_mul_ps( a0, step );
+    __m128 stepE1 = _mm_mul_ps( a1, step );
+    __m128 stepE2 = _mm_mul_ps( a2, step );
+    __m128 stepZ = _mm_mul_ps( zxv, step );
+
+    for ( int y = minY ; y <= maxY ; y++ ) {
+        float py = y + 0.5f;
+
+        __m128 px = _mm_add_ps( _mm_set1_ps( ( float )minX ), pixelOffsets );
+
+        __m128 e0 = _mm_add_ps( _mm_mul_ps( a0, px ), _mm_set1_ps( edgeB[0] * py + edgeC[0] ) );
+        __m128 e1 = _mm_add_ps( _mm_mul_ps( a1, px ), _mm_set1_ps( edgeB[1] * py + edgeC[1] ) );
+        __m128 e2 = _mm_add_ps( _mm_mul_ps( a2, px ), _mm_set1_ps( edgeB[2] * py + edgeC[2] ) );
+        __m128 z = _mm_add_ps( _mm_mul_ps( zxv, px ), _mm_set1_ps( zy * py + z0 ) );
+
+        float * row = Lods[0] + y * WIDTH;
+
+        for ( int x = minX ; x <= maxX ; x += 4 ) {
+            __m128 mask = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( e0, zero ), _mm_cmpge_ps( e1, zero ) ), _mm_cmpge_ps( e2, zero ) );
+
+            if ( _mm_movemask_ps( mask ) ) {
+                __m128 depth = _mm_load_ps( row + x );
+                __m128 nearest = _mm_max_ps( depth, z );
+                _mm_store_ps( row + x, _mm_or_ps( _mm_and_ps( mask, nearest ), _mm_andnot_ps( mask, depth ) ) );
+            }
+
+            e0 = _mm_add_ps( e0, stepE0 );
+            e1 = _mm_add_ps( e1, stepE1 );
+            e2 = _mm_add_ps( e2, stepE2 );
+            z = _mm_add_ps( z, stepZ );
+        }
+    }
+}
+
+void AOcclusionBuffer::BuildHiZ( AAsyncJobList * _JobList )
+{
+    if ( _JobList && Triangles.Size() >= MIN_TRIANGLES_FOR_JOBS ) {
+        for ( int bin = 0 ; bin < NUM_BINS ; bin++ ) {
+            if ( !BinTriangles[bin].IsEmpty() ) {
+                _JobList->AddJob( RasterizeBinAsync, &BinJobs[bin] );
+            }
+        }
+
+        _JobList->SubmitAndWait();
+    } else {
+        for ( int bin = 0 ; bin < NUM_BINS ; bin++ ) {
+            RasterizeBin( bin );
+        }
+    }
+
+    for ( int lod = 1 ; lod < NUM_LODS ; lod++ ) {
+        float const * src = Lods[lod - 1];
+        float * dst = Lods[lod];
+
+        const int srcWidth = GetLodWidth( lod - 1 );
+        const int srcHeight = GetLodHeight( lod - 1 );
+        const int width = GetLodWidth( lod );
+        const int height = GetLodHeight( lod );
+
+        for ( int y = 0 ; y < height ; y++ ) {
+            float const * row0 = src + Math::Min( y * 2, srcHeight - 1 ) * srcWidth;
+            float const * row1 = src + Math::Min( y * 2 + 1, srcHeight - 1 ) * srcWidth;
+            float * out = dst + y * width;
+
+            int x = 0;
+
+            if ( srcWidth >= 8 ) {
+                // Keep the farthest (minimal) depth of 2x2 texels
+                for ( ; x + 4 <= width ; x += 4 ) {
+                    __m128 a = _mm_min_ps( _mm_loadu_ps( row0 + x * 2 ), _mm_loadu_ps( row1 + x * 2 ) );
+                    __m128 b = _mm_min_ps( _mm_loadu_ps( row0 + x * 2 + 4 ), _mm_loadu_ps( row1 + x * 2 + 4 ) );
+                    __m128 even = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+                    __m128 odd = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+                    _mm_storeu_ps( out + x, _mm_min_ps( even, odd ) );
+                }
+            }
+
+            for ( ; x < width ; x++ ) {
+                int x0 = Math::Min( x * 2, srcWidth - 1 );
+                int x1 = Math::Min( x * 2 + 1, srcWidth - 1 );
+                out[x] = Math::Min( Math::Min( row0[x0], row0[x1] ), Math::Min( row1[x0], row1[x1] ) );
+            }
+        }
+    }
+}
+
+bool AOcclusionBuffer::IsBoxVisible( BvAxisAlignedBox const & _Box ) const
+{
+    float minX = Math::MaxValue< float >();
+    float minY = Math::MaxValue< float >();
+    float maxX = -Math::MaxValue< float >();
+    float maxY = -Math::MaxValue< float >();
+    float nearestDepth = 0;
+
+    for ( int i = 0 ; i < 8 ; i++ ) {
+        Float3 corner( ( i & 4 ) ? _Box.Maxs.X : _Box.Mins.X,
+                       ( i & 2 ) ? _Box.Maxs.Y : _Box.Mins.Y,
+                       ( i & 1 ) ? _Box.Maxs.Z : _Box.Mins.Z );
+
+        Float4 v = TransformPoint( ViewProjection, corner );
+
+        if ( v.W < MIN_CLIP_W || v.Z > v.W ) {
+            // Box intersects the near plane
+            return true;
+        }
+
+        float invW = 1.0f / v.W;
+        float x = ( v.X * invW * 0.5f + 0.5f ) * WIDTH;
+        float y = ( v.Y * invW * 0.5f + 0.5f ) * HEIGHT;
+
+        minX = Math::Min( minX, x );
+        minY = Math::Min( minY, y );
+        maxX = Math::Max( maxX, x );
+        maxY = Math::Max( maxY, y );
+        nearestDepth = Math::Max( nearestDepth, v.Z * invW );
+    }
+
+    int x0 = Math::Max( ( int )Math::Floor( minX ), 0 );
+    int y0 = Math::Max( ( int )Math::Floor( minY ), 0 );
+    int x1 = Math::Min( ( int )Math::Ceil( maxX ), WIDTH - 1 );
+    int y1 = Math::Min( ( int )Math::Ceil( maxY ), HEIGHT - 1 );
+
+    if ( x0 > x1 || y0 > y1 ) {
+        // Outside of the screen, leave it for frustum culling
+        return true;
+    }
+
+    // Select LOD where the rect covers at most 3x3 texels
+    int size = Math::Max( x1 - x0, y1 - y0 );
+    int lod = 0;
+    while ( ( size >> lod ) > 2 && lod < NUM_LODS - 1 ) {
+        lod++;
+    }
+
+    const int width = GetLodWidth( lod );
+    const int height = GetLodHeight( lod );
+
+    x0 = Math::Min( x0 >> lod, width - 1 );
+    y0 = Math::Min( y0 >> lod, height - 1 );
+    x1 = Math::Min( x1 >> lod, width - 1 );
+    y1 = Math::Min( y1 >> lod, height - 1 );
+
+    float const * depth = Lods[lod];
+
+    for ( int y = y0 ; y <= y1 ; y++ ) {
+        for ( int x = x0 ; x <= x1 ; x++ ) {
+            if ( nearestDepth >= depth[y * width + x] ) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
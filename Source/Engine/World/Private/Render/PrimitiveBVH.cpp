@@ -0,0 +1,389 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <World/Public/Render/PrimitiveBVH.h>
+#include <World/Public/Level.h>
+
+static constexpr int SAH_BINS = 12;
+
+// Relative cost of node traversal vs primitive test
+static constexpr float SAH_TRAVERSAL_COST = 1.0f;
+
+// Refitted tree is rebuilt when its root surface area grows up this factor
+static constexpr float REFIT_MAX_AREA_GROWTH = 2.0f;
+
+AN_FORCEINLINE float SurfaceArea( BvAxisAlignedBox const & InBounds )
+{
+    Float3 size = InBounds.Maxs - InBounds.Mins;
+    return size.X * size.Y + size.Y * size.Z + size.Z * size.X;
+}
+
+AN_FORCEINLINE BvAxisAlignedBox GetPrimitiveBounds( SPrimitiveDef const * InPrimitive )
+{
+    if ( InPrimitive->Type == VSD_PRIMITIVE_SPHERE ) {
+        return BvAxisAlignedBox( InPrimitive->Sphere.Center - InPrimitive->Sphere.Radius,
+                                 InPrimitive->Sphere.Center + InPrimitive->Sphere.Radius );
+    }
+    return InPrimitive->Box;
+}
+
+void APrimitiveBVH::Build( SPrimitiveLink const * InLinks, int InNumPrimitives, uint64_t InChecksum )
+{
+    Nodes.Clear();
+    Primitives.Clear();
+    BuildPrimitives.Clear();
+
+    NumPrimitives = InNumPrimitives;
+    Checksum = InChecksum;
+
+    for ( SPrimitiveLink const * link = InLinks ; link ; link = link->NextInArea ) {
+        SBuildPrimitive & buildPrimitive = BuildPrimitives.Append();
+        buildPrimitive.Primitive = link->Primitive;
+        buildPrimitive.Bounds = GetPrimitiveBounds( link->Primitive );
+        buildPrimitive.Centroid = buildPrimitive.Bounds.Center();
+    }
+
+    AN_ASSERT( BuildPrimitives.Size() == InNumPrimitives );
+
+    if ( BuildPrimitives.IsEmpty() ) {
+        BuildRootArea = 0;
+        return;
+    }
+
+    Nodes.Reserve( BuildPrimitives.Size() * 2 );
+
+    BuildRecursive( 0, BuildPrimitives.Size() );
+
+    Primitives.ResizeInvalidate( BuildPrimitives.Size() );
+    for ( int i = 0 ; i < BuildPrimitives.Size() ; i++ ) {
+        Primitives[i] = BuildPrimitives[i].Primitive;
+    }
+
+    BuildPrimitives.Free();
+
+    BuildRootArea = SurfaceArea( Nodes[0].Bounds );
+}
+
+int APrimitiveBVH::BuildRecursive( int InFirst, int InCount )
+{
+    int nodeIndex = Nodes.Size();
+
+    // Don't keep the reference to the node: the array can be reallocated by recursion
+    {
+        SNode & node = Nodes.Append();
+        node.FirstPrimitive = InFirst;
+        node.NumPrimitives = InCount;
+        node.RightChild = 0;
+        node.Bounds.Clear();
+    }
+
+    SBuildPrimitive * primitives = BuildPrimitives.ToPtr() + InFirst;
+
+    BvAxisAlignedBox bounds;
+    BvAxisAlignedBox centroidBounds;
+    bounds.Clear();
+    centroidBounds.Clear();
+    for ( int i = 0 ; i < InCount ; i++ ) {
+        bounds.AddAABB( primitives[i].Bounds );
+        centroidBounds.AddPoint( primitives[i].Centroid );
+    }
+
+    Nodes[nodeIndex].Bounds = bounds;
+
+    if ( InCount <= MAX_LEAF_PRIMITIVES ) {
+        return nodeIndex;
+    }
+
+    // Find the best split with binned SAH
+    struct SBin
+    {
+        BvAxisAlignedBox Bounds;
+        int Count;
+    };
+
+    float bestCost = Math::MaxValue< float >();
+    int bestAxis = -1;
+    int bestSplit = 0;
+
+    for ( int axis = 0 ; axis < 3 ; axis++ ) {
+        float minCentroid = centroidBounds.Mins[axis];
+        float extent = centroidBounds.Maxs[axis] - minCentroid;
+        if ( extent <= 0.0f ) {
+            continue;
+        }
+
+        SBin bins[SAH_BINS];
+        for ( int b = 0 ; b < SAH_BINS ; b++ ) {
+            bins[b].Bounds.Clear();
+            bins[b].Count = 0;
+        }
+
+        float scale = SAH_BINS / extent;
+        for ( int i = 0 ; i < InCount ; i++ ) {
+            int b = Math::Min( ( int )( ( primitives[i].Centroid[axis] - minCentroid ) * scale ), SAH_BINS - 1 );
+            bins[b].Bounds.AddAABB( primitives[i].Bounds );
+            bins[b].Count++;
+        }
+
+        // Sweep from the right to get right side areas
+        float rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        BvAxisAlignedBox accum;
+        accum.Clear();
+        int count = 0;
+        for ( int b = SAH_BINS - 1 ; b > 0 ; b-- ) {
+            if ( bins[b].Count ) {
+                accum.AddAABB( bins[b].Bounds );
+            }
+            count += bins[b].Count;
+            rightArea[b] = count ? SurfaceArea( accum ) : 0.0f;
+            rightCount[b] = count;
+        }
+
+        accum.Clear();
+        count = 0;
+        for ( int b = 0 ; b < SAH_BINS - 1 ; b++ ) {
+            if ( bins[b].Count ) {
+                accum.AddAABB( bins[b].Bounds );
+            }
+            count += bins[b].Count;
+
+            if ( !count || !rightCount[b + 1] ) {
+                continue;
+            }
+
+            float cost = SurfaceArea( accum ) * count + rightArea[b + 1] * rightCount[b + 1];
+            if ( cost < bestCost ) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    int mid;
+
+    float leafCost = SurfaceArea( bounds ) * InCount;
+    float splitCost = SurfaceArea( bounds ) * SAH_TRAVERSAL_COST + bestCost;
+
+    if ( bestAxis != -1 && splitCost < leafCost ) {
+        float minCentroid = centroidBounds.Mins[bestAxis];
+        float scale = SAH_BINS / ( centroidBounds.Maxs[bestAxis] - minCentroid );
+
+        // Partition primitives
+        int left = 0;
+        int right = InCount - 1;
+        while ( left <= right ) {
+            int b = Math::Min( ( int )( ( primitives[left].Centroid[bestAxis] - minCentroid ) * scale ), SAH_BINS - 1 );
+            if ( b <= bestSplit ) {
+                left++;
+            } else {
+                std::swap( primitives[left], primitives[right] );
+                right--;
+            }
+        }
+        mid = left;
+    } else {
+        if ( InCount <= MAX_LEAF_PRIMITIVES * 4 && bestAxis != -1 ) {
+            // Making a leaf is cheaper
+            return nodeIndex;
+        }
+        mid = 0;
+    }
+
+    if ( mid == 0 || mid == InCount ) {
+        // All centroids are in the same place, split in the middle
+        mid = InCount / 2;
+    }
+
+    BuildRecursive( InFirst, mid );
+
+    int rightChild = BuildRecursive( InFirst + mid, InCount - mid );
+
+    Nodes[nodeIndex].RightChild = rightChild;
+
+    return nodeIndex;
+}
+
+bool APrimitiveBVH::Refit()
+{
+    // Children are always stored after the parent, so walk in reverse order
+    for ( int nodeIndex = Nodes.Size() - 1 ; nodeIndex >= 0 ; nodeIndex-- ) {
+        SNode & node = Nodes[nodeIndex];
+
+        if ( node.RightChild == 0 ) {
+            node.Bounds.Clear();
+            for ( int i = 0 ; i < node.NumPrimitives ; i++ ) {
+                node.Bounds.AddAABB( GetPrimitiveBounds( Primitives[node.FirstPrimitive + i] ) );
+            }
+        } else {
+            node.Bounds = Nodes[nodeIndex + 1].Bounds;
+            node.Bounds.AddAABB( Nodes[node.RightChild].Bounds );
+        }
+    }
+
+    if ( Nodes.IsEmpty() ) {
+        return true;
+    }
+
+    return SurfaceArea( Nodes[0].Bounds ) <= BuildRootArea * REFIT_MAX_AREA_GROWTH;
+}
+
+void APrimitiveBVH::Purge()
+{
+    Nodes.Free();
+    Primitives.Free();
+    BuildPrimitives.Free();
+    NumPrimitives = 0;
+    Checksum = 0;
+    BuildRootArea = 0;
+}
+
+BvAxisAlignedBox const & APrimitiveBVH::GetBounds() const
+{
+    static const BvAxisAlignedBox EmptyBounds( Float3( 0.0f ), Float3( 0.0f ) );
+
+    return Nodes.IsEmpty() ? EmptyBounds : Nodes[0].Bounds;
+}
+
+void APrimitiveBVH::CullFrustum( PlaneF const * InCullPlanes, const int InCullPlanesCount, TPodVector< SPrimitiveDef * > & OutPrimitives ) const
+{
+    if ( Nodes.IsEmpty() ) {
+        return;
+    }
+
+    struct SStackEntry
+    {
+        int NodeIndex;
+        int CullBits;
+    };
+
+    SStackEntry stack[64];
+    int stackSize = 0;
+
+    AN_ASSERT( InCullPlanesCount <= 8 );
+
+    int signBits[8];
+    for ( int i = 0 ; i < InCullPlanesCount ; i++ ) {
+        signBits[i] = InCullPlanes[i].SignBits();
+    }
+
+    stack[stackSize].NodeIndex = 0;
+    stack[stackSize].CullBits = ( 1 << InCullPlanesCount ) - 1;
+    stackSize++;
+
+    while ( stackSize > 0 ) {
+        stackSize--;
+        int nodeIndex = stack[stackSize].NodeIndex;
+        int cullBits = stack[stackSize].CullBits;
+
+        SNode const & node = Nodes[nodeIndex];
+
+        // Test the node against the planes it still intersects
+        bool bCulled = false;
+        for ( int i = 0 ; i < InCullPlanesCount ; i++ ) {
+            if ( !( cullBits & ( 1 << i ) ) ) {
+                continue;
+            }
+
+            PlaneF const & plane = InCullPlanes[i];
+            int bits = signBits[i];
+
+            // Farthest point along the plane normal
+            Float3 p( ( bits & 1 ) ? node.Bounds.Mins.X : node.Bounds.Maxs.X,
+                      ( bits & 2 ) ? node.Bounds.Mins.Y : node.Bounds.Maxs.Y,
+                      ( bits & 4 ) ? node.Bounds.Mins.Z : node.Bounds.Maxs.Z );
+
+            if ( Math::Dot( plane.Normal, p ) + plane.D <= 0.0f ) {
+                bCulled = true;
+                break;
+            }
+
+            // Nearest point along the plane normal
+            Float3 n( ( bits & 1 ) ? node.Bounds.Maxs.X : node.Bounds.Mins.X,
+                      ( bits & 2 ) ? node.Bounds.Maxs.Y : node.Bounds.Mins.Y,
+                      ( bits & 4 ) ? node.Bounds.Maxs.Z : node.Bounds.Mins.Z );
+
+            if ( Math::Dot( plane.Normal, n ) + plane.D > 0.0f ) {
+                // Completely in front of the plane, children don't need this test
+                cullBits &= ~( 1 << i );
+            }
+        }
+
+        if ( bCulled ) {
+            continue;
+        }
+
+        SPrimitiveDef * const * primitives = Primitives.ToPtr() + node.FirstPrimitive;
+
+        // Accept the whole subtree if it's inside the frustum. Very deep subtrees that don't fit
+        // the stack are accepted conservatively.
+        if ( cullBits == 0 || stackSize + 2 > AN_ARRAY_SIZE( stack ) ) {
+            for ( int i = 0 ; i < node.NumPrimitives ; i++ ) {
+                OutPrimitives.Append( primitives[i] );
+            }
+            continue;
+        }
+
+        if ( node.RightChild == 0 ) {
+            // Leaf intersects the frustum, test each primitive
+            for ( int i = 0 ; i < node.NumPrimitives ; i++ ) {
+                BvAxisAlignedBox bounds = GetPrimitiveBounds( primitives[i] );
+
+                bool bInside = true;
+                for ( int k = 0 ; k < InCullPlanesCount && bInside ; k++ ) {
+                    if ( cullBits & ( 1 << k ) ) {
+                        PlaneF const & plane = InCullPlanes[k];
+                        int bits = signBits[k];
+
+                        Float3 p( ( bits & 1 ) ? bounds.Mins.X : bounds.Maxs.X,
+                                  ( bits & 2 ) ? bounds.Mins.Y : bounds.Maxs.Y,
+                                  ( bits & 4 ) ? bounds.Mins.Z : bounds.Maxs.Z );
+
+                        bInside = Math::Dot( plane.Normal, p ) + plane.D > 0.0f;
+                    }
+                }
+
+                if ( bInside ) {
+                    OutPrimitives.Append( primitives[i] );
+                }
+            }
+            continue;
+        }
+
+        stack[stackSize].NodeIndex = node.RightChild;
+        stack[stackSize].CullBits = cullBits;
+        stackSize++;
+
+        stack[stackSize].NodeIndex = nodeIndex + 1;
+        stack[stackSize].CullBits = cullBits;
+        stackSize++;
+    }
+}
@@ -41,6 +41,8 @@ SOFTWARE.
 #include <World/Public/EngineInstance.h>
 #include <Runtime/Public/Runtime.h>
 #include <Runtime/Public/ScopedTimeCheck.h>
+#include <Runtime/Public/Profiler.h>
+#include <Runtime/Public/RadixSort.h>
 #include <Core/Public/IntrusiveLinkedListMacro.h>
 
 ARuntimeVariable r_FixFrustumClusters( _CTS( "r_FixFrustumClusters" ), _CTS( "0" ), VAR_CHEAT );
@@ -51,6 +53,11 @@ ARuntimeVariable r_RenderTerrain( _CTS( "r_RenderTerrain" ), _CTS( "1" ), VAR_CH
 ARuntimeVariable r_ResolutionScaleX( _CTS( "r_ResolutionScaleX" ), _CTS( "1" ) );
 ARuntimeVariable r_ResolutionScaleY( _CTS( "r_ResolutionScaleY" ), _CTS( "1" ) );
 ARuntimeVariable r_RenderLightPortals( _CTS( "r_RenderLightPortals" ), _CTS( "1" ) );
+ARuntimeVariable r_RenderInstancesMT( _CTS( "r_RenderInstancesMT" ), _CTS( "1" ), 0, _CTS( "Generate mesh render instances in parallel" ) );
+ARuntimeVariable r_StaticDrawCache( _CTS( "r_StaticDrawCache" ), _CTS( "1" ), 0, _CTS( "Cache render instances of non-movable static meshes per view" ) );
+ARuntimeVariable r_InstanceBatching( _CTS( "r_InstanceBatching" ), _CTS( "1" ), 0, _CTS( "Merge identical static mesh instances into instanced draws" ) );
+ARuntimeVariable r_MaxLights( _CTS( "r_MaxLights" ), _CTS( "768" ), 0, _CTS( "Max point and spot lights per view. The most important lights are kept when exceeded" ) );
+ARuntimeVariable r_MaxProbes( _CTS( "r_MaxProbes" ), _CTS( "1024" ), 0, _CTS( "Max environment probes per view. The most important probes are kept when exceeded" ) );
 
 ARuntimeVariable com_DrawFrustumClusters( _CTS( "com_DrawFrustumClusters" ), _CTS( "0" ), VAR_CHEAT );
 
@@ -70,19 +77,30 @@ ARenderFrontend::~ARenderFrontend()
 {
 }
 
-struct SInstanceSortFunction {
-    bool operator() ( SRenderInstance const * _A, SRenderInstance * _B ) {
-        return _A->SortKey < _B->SortKey;
+/** Sort pointers to objects by their SortKey. Key/value pairs for the radix sort are allocated in frame memory. */
+template< typename T >
+static void SortByKey( T ** InObjects, int InCount ) {
+    if ( InCount < 2 ) {
+        return;
     }
-} InstanceSortFunction;
 
-struct SShadowInstanceSortFunction {
-    bool operator() ( SShadowRenderInstance const * _A, SShadowRenderInstance * _B ) {
-        return _A->SortKey < _B->SortKey;
+    SRadixSortItem * items = (SRadixSortItem *)GRuntime->AllocFrameMem( sizeof( SRadixSortItem ) * InCount * 2 );
+
+    for ( int i = 0 ; i < InCount ; i++ ) {
+        items[i].Key = InObjects[i]->SortKey;
+        items[i].Value = (uint64_t)(size_t)InObjects[i];
     }
-} ShadowInstanceSortFunction;
+
+    RadixSort( items, items + InCount, InCount );
+
+    for ( int i = 0 ; i < InCount ; i++ ) {
+        InObjects[i] = (T *)(size_t)items[i].Value;
+    }
+}
 
 void ARenderFrontend::Render( ACanvas * InCanvas ) {
+    AN_PROFILER_SCOPE( "ARenderFrontend::Render" );
+
     FrameData.FrameNumber = FrameNumber = GRuntime->SysFrameNumber();
     FrameData.DrawListHead = nullptr;
     FrameData.DrawListTail = nullptr;
@@ -90,6 +108,8 @@ void ARenderFrontend::Render( ACanvas * InCanvas ) {
     Stat.FrontendTime = Core::SysMilliseconds();
     Stat.PolyCount = 0;
     Stat.ShadowMapPolyCount = 0;
+    Stat.CulledLights = 0;
+    Stat.CulledProbes = 0;
 
     MaxViewportWidth = 1;
     MaxViewportHeight = 1;
@@ -134,13 +154,11 @@ void ARenderFrontend::Render( ACanvas * InCanvas ) {
     //int64_t t = GRuntime->SysMilliseconds();
 
     for ( SRenderView * view = FrameData.RenderViews ; view < &FrameData.RenderViews[FrameData.NumViews] ; view++ ) {
-        StdSort( FrameData.Instances.Begin() + view->FirstInstance,
-                 FrameData.Instances.Begin() + ( view->FirstInstance + view->InstanceCount ),
-                 InstanceSortFunction );
+        SortByKey( FrameData.Instances.ToPtr() + view->FirstInstance, view->InstanceCount );
 
-        StdSort( FrameData.TranslucentInstances.Begin() + view->FirstTranslucentInstance,
-                 FrameData.TranslucentInstances.Begin() + (view->FirstTranslucentInstance + view->TranslucentInstanceCount),
-                 InstanceSortFunction );
+        MergeInstances( view );
+
+        SortByKey( FrameData.TranslucentInstances.ToPtr() + view->FirstTranslucentInstance, view->TranslucentInstanceCount );
     }
     //GLogger.Printf( "Sort instances time %d instances count %d\n", GRuntime->SysMilliseconds() - t, FrameData.Instances.Size() + FrameData.ShadowInstances.Size() );
 
@@ -155,7 +173,134 @@ void ARenderFrontend::Render( ACanvas * InCanvas ) {
     Stat.FrontendTime = Core::SysMilliseconds() - Stat.FrontendTime;
 }
 
+struct SItemImportance {
+    float Importance;
+    int Index;
+};
+
+/** Approximates the light contribution to the view: solid angle of the light bounds (screen coverage at the given distance) scaled by light intensity */
+static float CalcItemImportance( Float3 const & ViewPosition, BvAxisAlignedBox const & Bounds, float Intensity ) {
+    const float radius = Bounds.Radius();
+    const float distance = Math::Max( Bounds.Center().Dist( ViewPosition ) - radius, 0.0f );
+    const float coverage = radius * radius / ( distance * distance + radius * radius + 0.0001f );
+
+    return coverage * Intensity;
+}
+
+/** Keeps Budget most important items in their original order. Returns number of dropped items. */
+template< typename T, typename TImportanceFunc >
+static int SelectImportantItems( TPodVector< T * > & Items, int Budget, TImportanceFunc const & ImportanceFunc ) {
+    const int count = Items.Size();
+
+    if ( count <= Budget ) {
+        return 0;
+    }
+
+    SItemImportance * importance = (SItemImportance *)GRuntime->AllocFrameMem( sizeof( SItemImportance ) * count );
+
+    for ( int i = 0 ; i < count ; i++ ) {
+        importance[i].Importance = ImportanceFunc( Items[i] );
+        importance[i].Index = i;
+    }
+
+    StdNthElement( importance, importance + Budget, importance + count,
+                   []( SItemImportance const & A, SItemImportance const & B ) { return A.Importance > B.Importance; } );
+
+    // Restore original order to keep light indices stable between frames
+    StdSort( importance, importance + Budget,
+             []( SItemImportance const & A, SItemImportance const & B ) { return A.Index < B.Index; } );
+
+    // Indices are ascending, so the source is never overwritten before it is read
+    for ( int i = 0 ; i < Budget ; i++ ) {
+        Items[i] = Items[importance[i].Index];
+    }
+
+    Items.Resize( Budget );
+
+    return count - Budget;
+}
+
+/** Instances can be drawn with one instanced draw call if they differ only by transform */
+static bool CanMergeInstances( SRenderInstance const * A, SRenderInstance const * B ) {
+    if ( A->Material != B->Material
+         || A->MaterialInstance != B->MaterialInstance
+         || A->SortKey != B->SortKey
+         || A->SkeletonSize != B->SkeletonSize
+         || A->VertexBuffer != B->VertexBuffer
+         || A->VertexBufferOffset != B->VertexBufferOffset
+         || A->IndexBuffer != B->IndexBuffer
+         || A->IndexBufferOffset != B->IndexBufferOffset
+         || A->IndexCount != B->IndexCount
+         || A->StartIndexLocation != B->StartIndexLocation
+         || A->BaseVertexLocation != B->BaseVertexLocation
+         || A->LightmapUVChannel != B->LightmapUVChannel
+         || A->Lightmap != B->Lightmap
+         || A->VertexLightChannel != B->VertexLightChannel ) {
+        return false;
+    }
+
+    if ( A->LightmapUVChannel && ( A->LightmapUVOffset != B->LightmapUVOffset || A->LightmapOffset != B->LightmapOffset ) ) {
+        return false;
+    }
+
+    if ( A->VertexLightChannel && A->VertexLightOffset != B->VertexLightOffset ) {
+        return false;
+    }
+
+    return true;
+}
+
+void ARenderFrontend::MergeInstances( SRenderView * InView ) {
+    if ( !r_InstanceBatching ) {
+        return;
+    }
+
+    AStreamedMemoryGPU * streamedMemory = GRuntime->GetStreamedMemoryGPU();
+
+    SRenderInstance ** instances = FrameData.Instances.ToPtr() + InView->FirstInstance;
+
+    // Identical instances have the same sort key, so they are adjacent after sorting.
+    // Merged instances stay in the list: the leading instance has InstanceCount > 1 and passes that support
+    // instancing skip the rest, other passes draw them one by one.
+    for ( int i = 0 ; i < InView->InstanceCount ; ) {
+        SRenderInstance * first = instances[i];
+
+        int count = 1;
+        if ( first->Material->bInstanceBatching && first->SkeletonSize == 0 ) {
+            while ( count < MAX_INSTANCE_BATCH
+                    && i + count < InView->InstanceCount
+                    && CanMergeInstances( first, instances[i + count] ) ) {
+                count++;
+            }
+        }
+
+        if ( count > 1 ) {
+            first->InstanceCount = count;
+            first->InstanceTransformsStreamHandle = streamedMemory->AllocateConstant( count * sizeof( SInstanceTransform ), nullptr );
+
+            SInstanceTransform * transforms = (SInstanceTransform *)streamedMemory->Map( first->InstanceTransformsStreamHandle );
+
+            for ( int k = 0 ; k < count ; k++ ) {
+                SRenderInstance const * instance = instances[i + k];
+                Float3x3 const & normalMatrix = instance->ModelNormalToViewSpace;
+
+                transforms[k].TransformMatrix = instance->Matrix;
+                transforms[k].TransformMatrixP = instance->MatrixP;
+
+                // Stored transposed, the same way as in the draw call constants
+                transforms[k].ModelNormalToViewSpace[0] = Float4( normalMatrix[0][0], normalMatrix[1][0], normalMatrix[2][0], 0.0f );
+                transforms[k].ModelNormalToViewSpace[1] = Float4( normalMatrix[0][1], normalMatrix[1][1], normalMatrix[2][1], 0.0f );
+                transforms[k].ModelNormalToViewSpace[2] = Float4( normalMatrix[0][2], normalMatrix[1][2], normalMatrix[2][2], 0.0f );
+            }
+        }
+
+        i += count;
+    }
+}
+
 void ARenderFrontend::RenderView( int _Index ) {
+    AN_PROFILER_SCOPE( "ARenderFrontend::RenderView" );
+
     SViewport * viewport = const_cast< SViewport * >( Viewports[ _Index ] );
     ARenderingParameters * RP = viewport->RenderingParams;
     ACameraComponent * camera = viewport->Camera;
@@ -294,7 +439,17 @@ void ARenderFrontend::RenderView( int _Index ) {
     view->ShadowMapMatricesStreamHandle = streamedMemory->AllocateConstant( size, nullptr );
     view->ShadowMapMatrices = (Float4x4 *)streamedMemory->Map( view->ShadowMapMatricesStreamHandle );
 
-    size_t numFrustumClusters = MAX_FRUSTUM_CLUSTERS_X * MAX_FRUSTUM_CLUSTERS_Y * MAX_FRUSTUM_CLUSTERS_Z;
+    LightVoxelizer.Reset();
+
+    SClusterGrid const & clusterGrid = LightVoxelizer.GetGrid();
+
+    view->NumClustersX = clusterGrid.NumClustersX;
+    view->NumClustersY = clusterGrid.NumClustersY;
+    view->NumClustersZ = clusterGrid.NumClustersZ;
+    view->ClusterSliceScale = clusterGrid.ViewSliceScale;
+    view->ClusterSliceBias = clusterGrid.ViewSliceBias;
+
+    size_t numFrustumClusters = clusterGrid.GetNumClusters();
 
     view->ClusterLookupStreamHandle = streamedMemory->AllocateConstant( numFrustumClusters * sizeof( SClusterHeader ), nullptr );
     view->ClusterLookup = (SClusterHeader *)streamedMemory->Map( view->ClusterLookupStreamHandle );
@@ -317,6 +472,17 @@ void ARenderFrontend::RenderView( int _Index ) {
 
     ViewRP = RP;
 
+    if ( r_StaticDrawCache ) {
+        if ( !RP->StaticDrawCache ) {
+            RP->StaticDrawCache = MakeUnique< AStaticDrawCache >();
+        }
+        StaticDrawCache = RP->StaticDrawCache.GetObject();
+        StaticDrawCache->BeginFrame( FrameNumber, view );
+    } else {
+        RP->StaticDrawCache.Reset();
+        StaticDrawCache = nullptr;
+    }
+
     QueryVisiblePrimitives( world );
 
     view->GlobalIrradianceMap = world->GetGlobalIrradianceMap();
@@ -628,6 +794,7 @@ void ARenderFrontend::QueryVisiblePrimitives( AWorld * InWorld ) {
     query.ViewUpVec = RenderDef.View->ViewUpVec;
     query.VisibilityMask = RenderDef.VisibilityMask;
     query.QueryMask = VSD_QUERY_MASK_VISIBLE | VSD_QUERY_MASK_VISIBLE_IN_LIGHT_PASS;// | VSD_QUERY_MASK_SHADOW_CAST;
+    query.ViewProjection = &RenderDef.View->ViewProjection;
 
     InWorld->QueryVisiblePrimitives( VisPrimitives, VisSurfaces, &VisPass, query );
 }
@@ -648,6 +815,7 @@ void ARenderFrontend::QueryShadowCasters( AWorld * InWorld, Float4x4 const & Lig
     query.ViewUpVec = LightBasis[1];
     query.VisibilityMask = RenderDef.VisibilityMask;
     query.QueryMask = VSD_QUERY_MASK_VISIBLE | VSD_QUERY_MASK_SHADOW_CAST;
+    query.ViewProjection = nullptr;
 #if 0
 #if 0
     Float3 clipBox[8] =
@@ -731,6 +899,7 @@ void ARenderFrontend::QueryShadowCasters( AWorld * InWorld, Float4x4 const & Lig
 void ARenderFrontend::AddRenderInstances( AWorld * InWorld )
 {
     AScopedTimeCheck TimeCheck( "AddRenderInstances" );
+    AN_PROFILER_SCOPE( "ARenderFrontend::AddRenderInstances" );
 
     SRenderView * view = RenderDef.View;
     ADrawable * drawable;
@@ -742,13 +911,23 @@ void ARenderFrontend::AddRenderInstances( AWorld * InWorld )
 
     VisLights.Clear();
     VisIBLs.Clear();
+    VisDrawables.Clear();
+
+    int numInstances = 0;
 
     for ( SPrimitiveDef * primitive : VisPrimitives ) {
 
         // TODO: Replace upcasting by something better (virtual function?)
 
         if ( nullptr != (drawable = Upcast< ADrawable >( primitive->Owner )) ) {
-            AddDrawable( drawable );
+            int drawableInstances = PrepareDrawable( drawable );
+            if ( drawableInstances > 0 ) {
+                SDrawableInstances & visDrawable = VisDrawables.Append();
+                visDrawable.Drawable = drawable;
+                visDrawable.FirstInstance = numInstances;
+                visDrawable.bStoreInCache = false;
+                numInstances += drawableInstances;
+            }
             continue;
         }
 
@@ -762,11 +941,7 @@ void ARenderFrontend::AddRenderInstances( AWorld * InWorld )
                 continue;
             }
 
-            if ( VisLights.Size() < MAX_LIGHTS ) {
-                VisLights.Append( light );
-            } else {
-                GLogger.Printf( "MAX_LIGHTS hit\n" );
-            }
+            VisLights.Append( light );
             continue;
         }
 
@@ -775,25 +950,17 @@ void ARenderFrontend::AddRenderInstances( AWorld * InWorld )
                 continue;
             }
 
-            if ( VisIBLs.Size() < MAX_PROBES ) {
-                VisIBLs.Append( ibl );
-            } else {
-                GLogger.Printf( "MAX_PROBES hit\n" );
-            }
+            VisIBLs.Append( ibl );
             continue;
         }
 
         GLogger.Printf( "Unhandled primitive\n" );
     }
 
-    if ( r_RenderSurfaces && !VisSurfaces.IsEmpty() ) {
-        struct SSortFunction {
-            bool operator() ( SSurfaceDef const * _A, SSurfaceDef const * _B ) {
-                return (_A->SortKey < _B->SortKey);
-            }
-        } SortFunction;
+    AddDrawableInstances( numInstances );
 
-        StdSort( VisSurfaces.ToPtr(), VisSurfaces.ToPtr() + VisSurfaces.Size(), SortFunction );
+    if ( r_RenderSurfaces && !VisSurfaces.IsEmpty() ) {
+        SortByKey( VisSurfaces.ToPtr(), VisSurfaces.Size() );
 
         AddSurfaces( VisSurfaces.ToPtr(), VisSurfaces.Size() );
     }
@@ -830,7 +997,18 @@ void ARenderFrontend::AddRenderInstances( AWorld * InWorld )
         view->NumDirectionalLights++;
     }
 
-    LightVoxelizer.Reset();
+    // Keep the most important lights and probes within the budget
+    const Float3 viewPosition = view->ViewPosition;
+
+    Stat.CulledLights += SelectImportantItems( VisLights, Math::Clamp( r_MaxLights.GetInteger(), 0, MAX_LIGHTS ),
+                                               [&viewPosition]( AAnalyticLightComponent const * Light ) {
+                                                   return CalcItemImportance( viewPosition, Light->GetWorldBounds(), Light->GetLumens() );
+                                               } );
+
+    Stat.CulledProbes += SelectImportantItems( VisIBLs, Math::Clamp( r_MaxProbes.GetInteger(), 0, MAX_PROBES ),
+                                               [&viewPosition]( AIBLComponent const * Probe ) {
+                                                   return CalcItemImportance( viewPosition, Probe->GetWorldBounds(), 1.0f );
+                                               } );
 
     // Allocate lights
     view->NumPointLights = VisLights.Size();
@@ -898,20 +1076,180 @@ void ARenderFrontend::AddRenderInstances( AWorld * InWorld )
     }
 }
 
-void ARenderFrontend::AddDrawable( ADrawable * InComponent ) {
+enum EInstanceList : uint8_t
+{
+    INSTANCE_LIST_TRANSLUCENT = AN_BIT( 0 ),
+    INSTANCE_LIST_OUTLINE     = AN_BIT( 1 )
+};
+
+int ARenderFrontend::PrepareDrawable( ADrawable * InComponent ) {
+    // Everything that touches shared state (frame memory, streamed memory, per-frame caches of
+    // components, meshes and materials) is done here, on the frontend thread, in the visibility order.
+
+    if ( !r_RenderMeshes ) {
+        return 0;
+    }
+
     switch ( InComponent->GetDrawableType() ) {
     case DRAWABLE_STATIC_MESH:
-        AddStaticMesh( static_cast< AMeshComponent * >(InComponent) );
+    case DRAWABLE_SKINNED_MESH:
+    {
+        AMeshComponent * component = static_cast< AMeshComponent * >(InComponent);
+
+        component->PreRenderUpdate( &RenderDef );
+
+        const int numSubparts = component->GetMesh()->GetSubparts().Size();
+        for ( int subpartIndex = 0; subpartIndex < numSubparts; subpartIndex++ ) {
+            AMaterialInstance * materialInstance = component->GetMaterialInstance( subpartIndex );
+            AN_ASSERT( materialInstance );
+
+            materialInstance->PreRenderUpdate( FrameNumber );
+        }
+        return numSubparts;
+    }
+    case DRAWABLE_PROCEDURAL_MESH:
+    {
+        AProceduralMeshComponent * component = static_cast< AProceduralMeshComponent * >(InComponent);
+
+        component->PreRenderUpdate( &RenderDef );
+
+        AProceduralMesh * mesh = component->GetMesh();
+        if ( !mesh ) {
+            return 0;
+        }
+
+        mesh->PreRenderUpdate( &RenderDef );
+
+        if ( mesh->IndexCache.IsEmpty() ) {
+            return 0;
+        }
+
+        AMaterialInstance * materialInstance = component->GetMaterialInstance();
+        AN_ASSERT( materialInstance );
+
+        materialInstance->PreRenderUpdate( FrameNumber );
+        return 1;
+    }
+    default:
         break;
+    }
+    return 0;
+}
+
+void ARenderFrontend::AddDrawableInstances( int InNumInstances ) {
+    if ( InNumInstances == 0 ) {
+        return;
+    }
+
+    AN_PROFILER_SCOPE( "ARenderFrontend::AddDrawableInstances" );
+
+    // Each drawable fills its own range of the instance array, so workers don't share any output
+    SRenderInstance * instances = (SRenderInstance *)GRuntime->AllocFrameMem( sizeof( SRenderInstance ) * InNumInstances );
+
+    InstanceLists.ResizeInvalidate( InNumInstances );
+
+    auto addInstances = [this, instances]( int InFirst, int InLast )
+    {
+        for ( int i = InFirst ; i < InLast ; i++ ) {
+            SDrawableInstances & visDrawable = VisDrawables[i];
+
+            visDrawable.bStoreInCache = AddDrawable( visDrawable.Drawable, instances + visDrawable.FirstInstance, InstanceLists.ToPtr() + visDrawable.FirstInstance );
+        }
+    };
+
+    if ( r_RenderInstancesMT ) {
+        GAsyncJobManager.ParallelFor( VisDrawables.Size(), addInstances, 32 );
+    } else {
+        addInstances( 0, VisDrawables.Size() );
+    }
+
+    // Merge in the visibility order, so the frame lists are the same as if they were filled serially
+    SRenderView * view = RenderDef.View;
+    for ( int i = 0 ; i < InNumInstances ; i++ ) {
+        SRenderInstance * instance = &instances[i];
+
+        if ( InstanceLists[i] & INSTANCE_LIST_TRANSLUCENT ) {
+            FrameData.TranslucentInstances.Append( instance );
+            view->TranslucentInstanceCount++;
+        } else {
+            FrameData.Instances.Append( instance );
+            view->InstanceCount++;
+        }
+
+        if ( InstanceLists[i] & INSTANCE_LIST_OUTLINE ) {
+            FrameData.OutlineInstances.Append( instance );
+            view->OutlineInstanceCount++;
+        }
+
+        RenderDef.PolyCount += instance->IndexCount / 3;
+    }
+
+    UpdateStaticDrawCache( instances );
+}
+
+static void GetStaticDrawCacheKey( AMeshComponent const * InComponent, AStaticDrawCache::SKey & Key ) {
+    Key.ComponentRevision = InComponent->GetRenderRevision();
+    Key.MeshRevision = InComponent->GetMesh()->GetRevision();
+    Key.VertexMemoryRevision = GRuntime->GetVertexMemoryGPU()->GetRevision();
+    Key.MaterialRevision = AMaterialInstance::GetMaterialRevision();
+    Key.LightmapUVChannel = InComponent->LightmapUVChannel;
+    Key.VertexLightChannel = InComponent->VertexLightChannel;
+    Key.LightmapBlock = InComponent->LightmapBlock;
+    Key.SubpartBaseVertexOffset = InComponent->SubpartBaseVertexOffset;
+    Key.LightmapOffset = InComponent->LightmapOffset;
+    Key.bOutline = InComponent->bOutline;
+}
+
+void ARenderFrontend::UpdateStaticDrawCache( SRenderInstance const * Instances ) {
+    if ( !StaticDrawCache ) {
+        return;
+    }
+
+    // Store the instances that were built without the cache. It is done serially after the instances were added in parallel.
+    for ( SDrawableInstances const & visDrawable : VisDrawables ) {
+        if ( !visDrawable.bStoreInCache ) {
+            continue;
+        }
+
+        AMeshComponent * component = static_cast< AMeshComponent * >( visDrawable.Drawable );
+
+        const int numSubparts = component->GetMesh()->GetSubparts().Size();
+
+        StaticDrawCacheSubparts.ResizeInvalidate( numSubparts );
+
+        for ( int i = 0 ; i < numSubparts ; i++ ) {
+            AStaticDrawCache::SSubpart & subpart = StaticDrawCacheSubparts[i];
+
+            subpart.Instance = Instances[visDrawable.FirstInstance + i];
+            subpart.MaterialInstance = component->GetMaterialInstance( i );
+            subpart.Lists = InstanceLists[visDrawable.FirstInstance + i];
+            subpart.Priority = subpart.MaterialInstance->GetMaterial()->GetRenderingPriority();
+            if ( component->GetMotionBehavior() != MB_STATIC ) {
+                subpart.Priority |= RENDERING_GEOMETRY_PRIORITY_DYNAMIC;
+            }
+        }
+
+        AStaticDrawCache::SKey key;
+        GetStaticDrawCacheKey( component, key );
+
+        StaticDrawCache->Store( component->Id, key, component->GetWorldRotation().ToMatrix(), StaticDrawCacheSubparts.ToPtr(), numSubparts );
+    }
+}
+
+bool ARenderFrontend::AddDrawable( ADrawable * InComponent, SRenderInstance * Instances, uint8_t * Lists ) {
+    switch ( InComponent->GetDrawableType() ) {
+    case DRAWABLE_STATIC_MESH:
+        return AddStaticMesh( static_cast< AMeshComponent * >(InComponent), Instances, Lists );
     case DRAWABLE_SKINNED_MESH:
-        AddSkinnedMesh( static_cast< ASkinnedComponent * >(InComponent) );
+        AddSkinnedMesh( static_cast< ASkinnedComponent * >(InComponent), Instances, Lists );
         break;
     case DRAWABLE_PROCEDURAL_MESH:
-        AddProceduralMesh( static_cast< AProceduralMeshComponent * >(InComponent) );
+        AddProceduralMesh( static_cast< AProceduralMeshComponent * >(InComponent), Instances, Lists );
         break;
     default:
         break;
     }
+    return false;
 }
 
 void ARenderFrontend::AddTerrain( ATerrainComponent * InComponent ) {
@@ -970,8 +1308,11 @@ void ARenderFrontend::AddTerrain( ATerrainComponent * InComponent ) {
 
     // Update resource
     terrainView->SetTerrain( terrainResource );
+    // Pixels per unit of geometric error at unit distance (orthographic: at any distance)
+    float errorScale = view->ProjectionMatrix[1][1] * view->Height * 0.5f;
+
     // Update view
-    terrainView->Update( TerrainMesh, localViewPosition, localFrustum );
+    terrainView->Update( TerrainMesh, localViewPosition, localFrustum, errorScale, view->bPerspective );
 
     if ( terrainView->GetIndirectBufferDrawCount() == 0 )
     {
@@ -1002,25 +1343,36 @@ void ARenderFrontend::AddTerrain( ATerrainComponent * InComponent ) {
     view->TerrainInstanceCount++;
 }
 
-void ARenderFrontend::AddStaticMesh( AMeshComponent * InComponent ) {
+bool ARenderFrontend::AddStaticMesh( AMeshComponent * InComponent, SRenderInstance * Instances, uint8_t * Lists ) {
     AIndexedMesh * mesh = InComponent->GetMesh();
 
-    if ( !r_RenderMeshes ) {
-        return;
-    }
+    // Non-movable meshes take complete instances from the static draw cache of the view
+    bool bCacheable = StaticDrawCache && !InComponent->IsMovable();
 
-    InComponent->PreRenderUpdate( &RenderDef );
+    if ( bCacheable ) {
+        AStaticDrawCache::SKey key;
+        GetStaticDrawCacheKey( InComponent, key );
+
+        AStaticDrawCache::SEntry * entry = StaticDrawCache->Find( InComponent->Id, key );
+        if ( entry && entry->NumSubparts == mesh->GetSubparts().Size() ) {
+            AddCachedStaticMesh( InComponent, entry, Instances, Lists );
+            return false;
+        }
+    }
 
     Float3x4 const & componentWorldTransform = InComponent->GetWorldTransformMatrix();
 
-    // TODO: optimize: parallel, sse, check if transformable
+    // TODO: optimize: sse
     Float4x4 instanceMatrix = RenderDef.View->ViewProjection * componentWorldTransform;
     Float4x4 instanceMatrixP = RenderDef.View->ViewProjectionP * InComponent->RenderTransformMatrix;
 
-    Float3x3 worldRotation = InComponent->GetWorldRotation().ToMatrix();
+    // The instances are stored after the component kept its transform for a frame, so the cached MatrixP doesn't lag behind
+    bCacheable = bCacheable && InComponent->RenderTransformMatrix == componentWorldTransform;
 
     InComponent->RenderTransformMatrix = componentWorldTransform;
 
+    Float3x3 worldRotation = InComponent->GetWorldRotation().ToMatrix();
+
     ALevel * level = InComponent->GetLevel();
 
     AIndexedMeshSubpartArray const & subparts = mesh->GetSubparts();
@@ -1038,24 +1390,14 @@ void ARenderFrontend::AddStaticMesh( AMeshComponent * InComponent ) {
 
         AMaterial * material = materialInstance->GetMaterial();
 
+        // Frame data was allocated by PrepareDrawable, so this is just a lookup
         SMaterialFrameData * materialInstanceFrameData = materialInstance->PreRenderUpdate( FrameNumber );
 
         // Add render instance
-        SRenderInstance * instance = (SRenderInstance *)GRuntime->AllocFrameMem( sizeof( SRenderInstance ) );
-
-        if ( material->IsTranslucent() ) {
-            FrameData.TranslucentInstances.Append( instance );
-            RenderDef.View->TranslucentInstanceCount++;
-        }
-        else {
-            FrameData.Instances.Append( instance );
-            RenderDef.View->InstanceCount++;
-        }
+        SRenderInstance * instance = &Instances[subpartIndex];
 
-        if ( InComponent->bOutline ) {
-            FrameData.OutlineInstances.Append( instance );
-            RenderDef.View->OutlineInstanceCount++;
-        }
+        Lists[subpartIndex] = ( material->IsTranslucent() ? INSTANCE_LIST_TRANSLUCENT : 0 )
+                            | ( InComponent->bOutline ? INSTANCE_LIST_OUTLINE : 0 );
 
         instance->Material = material->GetGPUResource();
         instance->MaterialInstance = materialInstanceFrameData;
@@ -1085,6 +1427,7 @@ void ARenderFrontend::AddStaticMesh( AMeshComponent * InComponent ) {
         instance->SkeletonOffset = 0;
         instance->SkeletonOffsetMB = 0;
         instance->SkeletonSize = 0;
+        instance->InstanceCount = 1;
         instance->Matrix = instanceMatrix;
         instance->MatrixP = instanceMatrixP;
         instance->ModelNormalToViewSpace = RenderDef.View->NormalToViewMatrix * worldRotation;
@@ -1095,19 +1438,29 @@ void ARenderFrontend::AddStaticMesh( AMeshComponent * InComponent ) {
         }
 
         instance->GenerateSortKey( priority, (uint64_t)mesh );
-
-        RenderDef.PolyCount += instance->IndexCount / 3;
     }
+
+    return bCacheable;
 }
 
-void ARenderFrontend::AddSkinnedMesh( ASkinnedComponent * InComponent ) {
-    AIndexedMesh * mesh = InComponent->GetMesh();
+void ARenderFrontend::AddCachedStaticMesh( AMeshComponent * InComponent, AStaticDrawCache::SEntry * InEntry, SRenderInstance * Instances, uint8_t * Lists ) {
+    StaticDrawCache->GetInstances( InEntry, InComponent->GetWorldTransformMatrix(), Instances, Lists );
 
-    if ( !r_RenderMeshes ) {
-        return;
+    AStaticDrawCache::SSubpart const * subparts = StaticDrawCache->GetSubparts( InEntry );
+
+    const uint64_t mesh = (uint64_t)InComponent->GetMesh();
+
+    for ( int subpartIndex = 0 ; subpartIndex < InEntry->NumSubparts ; subpartIndex++ ) {
+        SRenderInstance * instance = &Instances[subpartIndex];
+
+        // Frame data was allocated by PrepareDrawable, so this is just a lookup
+        instance->MaterialInstance = subparts[subpartIndex].MaterialInstance->PreRenderUpdate( FrameNumber );
+        instance->GenerateSortKey( subparts[subpartIndex].Priority, mesh );
     }
+}
 
-    InComponent->PreRenderUpdate( &RenderDef );
+void ARenderFrontend::AddSkinnedMesh( ASkinnedComponent * InComponent, SRenderInstance * Instances, uint8_t * Lists ) {
+    AIndexedMesh * mesh = InComponent->GetMesh();
 
     size_t skeletonOffset = 0;
     size_t skeletonOffsetMB = 0;
@@ -1136,23 +1489,14 @@ void ARenderFrontend::AddSkinnedMesh( ASkinnedComponent * InComponent ) {
 
         AMaterial * material = materialInstance->GetMaterial();
 
+        // Frame data was allocated by PrepareDrawable, so this is just a lookup
         SMaterialFrameData * materialInstanceFrameData = materialInstance->PreRenderUpdate( FrameNumber );
 
         // Add render instance
-        SRenderInstance * instance = (SRenderInstance *)GRuntime->AllocFrameMem( sizeof( SRenderInstance ) );
-
-        if ( material->IsTranslucent() ) {
-            FrameData.TranslucentInstances.Append( instance );
-            RenderDef.View->TranslucentInstanceCount++;
-        } else {
-            FrameData.Instances.Append( instance );
-            RenderDef.View->InstanceCount++;
-        }
+        SRenderInstance * instance = &Instances[subpartIndex];
 
-        if ( InComponent->bOutline ) {
-            FrameData.OutlineInstances.Append( instance );
-            RenderDef.View->OutlineInstanceCount++;
-        }
+        Lists[subpartIndex] = ( material->IsTranslucent() ? INSTANCE_LIST_TRANSLUCENT : 0 )
+                            | ( InComponent->bOutline ? INSTANCE_LIST_OUTLINE : 0 );
 
         instance->Material = material->GetGPUResource();
         instance->MaterialInstance = materialInstanceFrameData;
@@ -1173,6 +1517,7 @@ void ARenderFrontend::AddSkinnedMesh( ASkinnedComponent * InComponent ) {
         instance->SkeletonOffset = skeletonOffset;
         instance->SkeletonOffsetMB = skeletonOffsetMB;
         instance->SkeletonSize = skeletonSize;
+        instance->InstanceCount = 1;
         instance->Matrix = instanceMatrix;
         instance->MatrixP = instanceMatrixP;
         instance->ModelNormalToViewSpace = RenderDef.View->NormalToViewMatrix * worldRotation;
@@ -1183,28 +1528,11 @@ void ARenderFrontend::AddSkinnedMesh( ASkinnedComponent * InComponent ) {
         priority |= RENDERING_GEOMETRY_PRIORITY_DYNAMIC;
 
         instance->GenerateSortKey( priority, (uint64_t)mesh );
-
-        RenderDef.PolyCount += instance->IndexCount / 3;
     }
 }
 
-void ARenderFrontend::AddProceduralMesh( AProceduralMeshComponent * InComponent ) {
-    if ( !r_RenderMeshes ) {
-        return;
-    }
-
-    InComponent->PreRenderUpdate( &RenderDef );
-
+void ARenderFrontend::AddProceduralMesh( AProceduralMeshComponent * InComponent, SRenderInstance * Instances, uint8_t * Lists ) {
     AProceduralMesh * mesh = InComponent->GetMesh();
-    if ( !mesh ) {
-        return;
-    }
-
-    mesh->PreRenderUpdate( &RenderDef );
-
-    if ( mesh->IndexCache.IsEmpty() ) {
-        return;
-    }
 
     Float3x4 const & componentWorldTransform = InComponent->GetWorldTransformMatrix();
 
@@ -1219,24 +1547,14 @@ void ARenderFrontend::AddProceduralMesh( AProceduralMeshComponent * InComponent
 
     AMaterial * material = materialInstance->GetMaterial();
 
+    // Frame data was allocated by PrepareDrawable, so this is just a lookup
     SMaterialFrameData * materialInstanceFrameData = materialInstance->PreRenderUpdate( FrameNumber );
 
     // Add render instance
-    SRenderInstance * instance = (SRenderInstance *)GRuntime->AllocFrameMem( sizeof( SRenderInstance ) );
+    SRenderInstance * instance = Instances;
 
-    if ( material->IsTranslucent() ) {
-        FrameData.TranslucentInstances.Append( instance );
-        RenderDef.View->TranslucentInstanceCount++;
-    }
-    else {
-        FrameData.Instances.Append( instance );
-        RenderDef.View->InstanceCount++;
-    }
-
-    if ( InComponent->bOutline ) {
-        FrameData.OutlineInstances.Append( instance );
-        RenderDef.View->OutlineInstanceCount++;
-    }
+    *Lists = ( material->IsTranslucent() ? INSTANCE_LIST_TRANSLUCENT : 0 )
+           | ( InComponent->bOutline ? INSTANCE_LIST_OUTLINE : 0 );
 
     instance->Material = material->GetGPUResource();
     instance->MaterialInstance = materialInstanceFrameData;
@@ -1255,6 +1573,7 @@ void ARenderFrontend::AddProceduralMesh( AProceduralMeshComponent * InComponent
     instance->SkeletonOffset = 0;
     instance->SkeletonOffsetMB = 0;
     instance->SkeletonSize = 0;
+    instance->InstanceCount = 1;
     instance->Matrix = instanceMatrix;
     instance->MatrixP = instanceMatrixP;
     instance->ModelNormalToViewSpace = RenderDef.View->NormalToViewMatrix * InComponent->GetWorldRotation().ToMatrix();
@@ -1265,8 +1584,6 @@ void ARenderFrontend::AddProceduralMesh( AProceduralMeshComponent * InComponent
     }
 
     instance->GenerateSortKey( priority, (uint64_t)mesh );
-
-    RenderDef.PolyCount += instance->IndexCount / 3;
 }
 
 void ARenderFrontend::AddShadowmap_StaticMesh( SLightShadowmap * ShadowMap, AMeshComponent * InComponent ) {
@@ -1602,9 +1919,7 @@ void ARenderFrontend::AddDirectionalShadowmapInstances( AWorld * InWorld ) {
             RenderDef.ShadowMapPolyCount += instance->IndexCount / 3;
         }
 
-        StdSort( FrameData.ShadowInstances.Begin() + shadowMap->FirstShadowInstance,
-                 FrameData.ShadowInstances.Begin() + (shadowMap->FirstShadowInstance + shadowMap->ShadowInstanceCount),
-                 ShadowInstanceSortFunction );
+        SortByKey( FrameData.ShadowInstances.ToPtr() + shadowMap->FirstShadowInstance, shadowMap->ShadowInstanceCount );
 
         if ( r_RenderLightPortals ) {
             // Add light portals
@@ -1893,6 +2208,7 @@ void ARenderFrontend::AddSurface( ALevel * Level, AMaterialInstance * MaterialIn
     instance->SkeletonOffset = 0;
     instance->SkeletonOffsetMB = 0;
     instance->SkeletonSize = 0;
+    instance->InstanceCount = 1;
     instance->Matrix = RenderDef.View->ViewProjection;
     instance->MatrixP = RenderDef.View->ViewProjectionP;
     instance->ModelNormalToViewSpace = RenderDef.View->NormalToViewMatrix;
@@ -2016,22 +2332,14 @@ void ARenderFrontend::AddLightShadowmap( AAnalyticLightComponent * Light, float
         }
 
         if ( r_RenderSurfaces && !VisSurfaces.IsEmpty() ) {
-            struct SSortFunction {
-                bool operator() ( SSurfaceDef const * _A, SSurfaceDef const * _B ) {
-                    return (_A->SortKey < _B->SortKey);
-                }
-            } SortFunction;
-
-            StdSort( VisSurfaces.ToPtr(), VisSurfaces.ToPtr() + VisSurfaces.Size(), SortFunction );
+            SortByKey( VisSurfaces.ToPtr(), VisSurfaces.Size() );
 
             AddShadowmapSurfaces( shadowMap, VisSurfaces.ToPtr(), VisSurfaces.Size() );
 
             totalSurfaces += VisSurfaces.Size();
         }
 
-        StdSort( FrameData.ShadowInstances.Begin() + shadowMap->FirstShadowInstance,
-                 FrameData.ShadowInstances.Begin() + (shadowMap->FirstShadowInstance + shadowMap->ShadowInstanceCount),
-                 ShadowInstanceSortFunction );
+        SortByKey( FrameData.ShadowInstances.ToPtr() + shadowMap->FirstShadowInstance, shadowMap->ShadowInstanceCount );
 
         totalInstances += shadowMap->ShadowInstanceCount;
     }
@@ -0,0 +1,197 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <World/Public/Render/StaticDrawCache.h>
+
+void AStaticDrawCache::BeginFrame( int InFrameNumber, SRenderView const * InView ) {
+    FrameNumber = InFrameNumber;
+
+    if ( ViewRevision == 0
+         || InView->ViewProjection != ViewProjection
+         || InView->ViewProjectionP != ViewProjectionP
+         || InView->NormalToViewMatrix != NormalToViewMatrix ) {
+        ViewProjection = InView->ViewProjection;
+        ViewProjectionP = InView->ViewProjectionP;
+        NormalToViewMatrix = InView->NormalToViewMatrix;
+
+        // Zero is reserved for entries that must be rebuilt
+        if ( ++ViewRevision == 0 ) {
+            ViewRevision = 1;
+            for ( SEntry & entry : Entries ) {
+                entry.ViewRevision = 0;
+            }
+        }
+    }
+
+    if ( FrameNumber - LastCompactFrame >= MAX_UNUSED_FRAMES ) {
+        Compact();
+    }
+}
+
+int AStaticDrawCache::FindIndex( uint64_t InComponentId ) const {
+    const int key = Core::PHHash64( InComponentId );
+    for ( int i = EntryHash.First( key ) ; i != -1 ; i = EntryHash.Next( i ) ) {
+        if ( Entries[i].ComponentId == InComponentId ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+AStaticDrawCache::SEntry * AStaticDrawCache::Find( uint64_t InComponentId, SKey const & InKey ) {
+    if ( Entries.IsEmpty() ) {
+        return nullptr;
+    }
+
+    int i = FindIndex( InComponentId );
+    if ( i == -1 || Entries[i].Key != InKey ) {
+        return nullptr;
+    }
+
+    SEntry & entry = Entries[i];
+    entry.LastFrame = FrameNumber;
+    return &entry;
+}
+
+void AStaticDrawCache::UpdateView( SEntry * InEntry, Float3x4 const & InWorldTransform ) {
+    Float4x4 instanceMatrix = ViewProjection * InWorldTransform;
+    Float4x4 instanceMatrixP = ViewProjectionP * InWorldTransform;
+    Float3x3 modelNormalToViewSpace = NormalToViewMatrix * InEntry->WorldRotation;
+
+    SSubpart * subparts = Subparts.ToPtr() + InEntry->FirstSubpart;
+
+    for ( int i = 0 ; i < InEntry->NumSubparts ; i++ ) {
+        SRenderInstance & instance = subparts[i].Instance;
+
+        instance.Matrix = instanceMatrix;
+        instance.MatrixP = instanceMatrixP;
+        instance.ModelNormalToViewSpace = modelNormalToViewSpace;
+    }
+
+    InEntry->ViewRevision = ViewRevision;
+}
+
+void AStaticDrawCache::GetInstances( SEntry * InEntry, Float3x4 const & InWorldTransform, SRenderInstance * Instances, uint8_t * Lists ) {
+    if ( InEntry->ViewRevision != ViewRevision ) {
+        UpdateView( InEntry, InWorldTransform );
+    }
+
+    SSubpart const * subparts = Subparts.ToPtr() + InEntry->FirstSubpart;
+
+    for ( int i = 0 ; i < InEntry->NumSubparts ; i++ ) {
+        Instances[i] = subparts[i].Instance;
+        Lists[i] = subparts[i].Lists;
+    }
+}
+
+void AStaticDrawCache::Store( uint64_t InComponentId, SKey const & InKey, Float3x3 const & InWorldRotation, SSubpart const * InSubparts, int InNumSubparts ) {
+    int i = FindIndex( InComponentId );
+
+    SEntry * entry;
+    if ( i == -1 ) {
+        EntryHash.Insert( Core::PHHash64( InComponentId ), Entries.Size() );
+
+        entry = &Entries.Append();
+        entry->ComponentId = InComponentId;
+        entry->FirstSubpart = Subparts.Size();
+        entry->NumSubparts = InNumSubparts;
+        Subparts.Resize( Subparts.Size() + InNumSubparts );
+    } else {
+        entry = &Entries[i];
+
+        if ( entry->NumSubparts != InNumSubparts ) {
+            // Old subparts are removed at next Compact()
+            NumGarbageSubparts += entry->NumSubparts;
+
+            entry->FirstSubpart = Subparts.Size();
+            entry->NumSubparts = InNumSubparts;
+            Subparts.Resize( Subparts.Size() + InNumSubparts );
+        }
+    }
+
+    entry->Key = InKey;
+    entry->WorldRotation = InWorldRotation;
+    entry->ViewRevision = ViewRevision;
+    entry->LastFrame = FrameNumber;
+
+    Core::Memcpy( Subparts.ToPtr() + entry->FirstSubpart, InSubparts, sizeof( SSubpart ) * InNumSubparts );
+}
+
+void AStaticDrawCache::Compact() {
+    LastCompactFrame = FrameNumber;
+
+    int numEntries = 0;
+    int numUnused = 0;
+
+    for ( int i = 0 ; i < Entries.Size() ; i++ ) {
+        numUnused += FrameNumber - Entries[i].LastFrame > MAX_UNUSED_FRAMES;
+    }
+
+    if ( numUnused == 0 && NumGarbageSubparts == 0 ) {
+        return;
+    }
+
+    // Replaced entries take subparts from the end of the array, so the subpart ranges are not in the entry order.
+    // Live subparts are gathered into a separate array.
+    CompactSubparts.Clear();
+
+    for ( int i = 0 ; i < Entries.Size() ; i++ ) {
+        SEntry const & entry = Entries[i];
+
+        if ( FrameNumber - entry.LastFrame > MAX_UNUSED_FRAMES ) {
+            continue;
+        }
+
+        const int firstSubpart = CompactSubparts.Size();
+
+        CompactSubparts.Append( Subparts.ToPtr() + entry.FirstSubpart, entry.NumSubparts );
+
+        Entries[numEntries] = entry;
+        Entries[numEntries].FirstSubpart = firstSubpart;
+
+        numEntries++;
+    }
+
+    Entries.Resize( numEntries );
+    Subparts = CompactSubparts;
+    NumGarbageSubparts = 0;
+
+    EntryHash.Clear();
+    for ( int i = 0 ; i < Entries.Size() ; i++ ) {
+        EntryHash.Insert( Core::PHHash64( Entries[i].ComponentId ), i );
+    }
+}
+
+void AStaticDrawCache::Clear() {
+    Entries.Clear();
+    Subparts.Clear();
+    EntryHash.Clear();
+    NumGarbageSubparts = 0;
+}
@@ -28,12 +28,10 @@ SOFTWARE.
 
 */
 
-// TODO: Future: HIZ culler, Software depth rasterizer, Occluders:
+// TODO: Future:
 // CPU Frustum cull / SSE/ MT = for outdoor
 // Portal cull / Area PVS = for indoor
 // Occluders (inverse kind of frustum culling) = for indoor & outdoor
-// Software occluder rasterizer + HIZ occludee culling
-// AABB-tree for static outdoor/indoor geometry
 
 // FIXME: Replace AABB culling to OBB culling?
 
@@ -41,13 +39,21 @@ SOFTWARE.
 #include <World/Public/Render/vsd.h>
 #include <World/Public/Render/RenderWorld.h>
 #include <World/Public/Level.h>
+#include <World/Public/Render/PrimitiveBVH.h>
 #include <Runtime/Public/ScopedTimeCheck.h>
+#include <Runtime/Public/Profiler.h>
 
 static const SWorldRaycastFilter DefaultRaycastFilter;
 
 ARuntimeVariable vsd_FrustumCullingMT( _CTS( "vsd_FrustumCullingMT" ), _CTS( "1" ) );
 ARuntimeVariable vsd_FrustumCullingSSE( _CTS( "vsd_FrustumCullingSSE" ), _CTS( "1" ) );
 ARuntimeVariable vsd_FrustumCullingType( _CTS( "vsd_FrustumCullingType" ), _CTS( "0" ), 0, _CTS( "0 - combined, 1 - separate, 2 - simple" ) );
+ARuntimeVariable vsd_PortalFlowMT( _CTS( "vsd_PortalFlowMT" ), _CTS( "1" ), 0, _CTS( "Traverse independent portal subtrees in parallel" ) );
+ARuntimeVariable vsd_PrimitiveBVH( _CTS( "vsd_PrimitiveBVH" ), _CTS( "1" ), 0, _CTS( "Cull non-movable primitives with the area BVH" ) );
+ARuntimeVariable vsd_OcclusionCulling( _CTS( "vsd_OcclusionCulling" ), _CTS( "1" ), 0, _CTS( "Software occlusion culling by SURF_OCCLUDER surfaces and primitives" ) );
+ARuntimeVariable vsd_OcclusionCullingMT( _CTS( "vsd_OcclusionCullingMT" ), _CTS( "1" ), 0, _CTS( "Rasterize occluder screen bands in parallel" ) );
+ARuntimeVariable vsd_MaxOccluders( _CTS( "vsd_MaxOccluders" ), _CTS( "32" ), 0, _CTS( "Max occluders rasterized per view" ) );
+ARuntimeVariable vsd_OccluderTriangleBudget( _CTS( "vsd_OccluderTriangleBudget" ), _CTS( "1024" ), 0, _CTS( "Max occluder triangles rasterized per view" ) );
 
 enum EFrustumCullingType {
     CULLING_TYPE_COMBINED,
@@ -58,8 +64,8 @@ enum EFrustumCullingType {
 void AVSD::ProcessLevelVisibility( ALevel * InLevel ) {
     CurLevel = InLevel;
 
-    ViewFrustum = PortalStack[ 0 ].AreaFrustum;
-    ViewFrustumPlanes = PortalStack[ 0 ].PlanesCount; // Can be 4 or 5
+    ViewFrustum = ViewPortalStack.AreaFrustum;
+    ViewFrustumPlanes = ViewPortalStack.PlanesCount; // Can be 4 or 5
 
     int cullBits = 0;
 
@@ -87,11 +93,13 @@ void AVSD::ProcessLevelVisibility( ALevel * InLevel ) {
     {
         SVisArea * area = InLevel->FindArea( ViewPosition );
 
-        FlowThroughPortals_r( area );
+        FlowThroughPortals( area );
     }
 }
 
 void AVSD::QueryVisiblePrimitives( AWorld * InWorld, TPodVector< SPrimitiveDef * > & VisPrimitives, TPodVector< SSurfaceDef * > & VisSurfs, int * VisPass, SVisibilityQuery const & InQuery ) {
+    AN_PROFILER_SCOPE( "AVSD::QueryVisiblePrimitives" );
+
     //int QueryVisiblePrimitivesTime = GRuntime->SysMicroseconds();
 
     ++VisQueryMarker;
@@ -128,6 +136,7 @@ void AVSD::QueryVisiblePrimitives( AWorld * InWorld, TPodVector< SPrimitiveDef *
     Dbg_CulledBySurfaceBounds = 0;
     Dbg_CulledByPrimitiveBounds = 0;
     Dbg_TotalPrimitiveBounds = 0;
+    Dbg_CulledByOcclusion = 0;
 
 #ifdef DEBUG_PORTAL_SCISSORS
     DebugScissors.Clear();
@@ -152,18 +161,17 @@ void AVSD::QueryVisiblePrimitives( AWorld * InWorld, TPodVector< SPrimitiveDef *
     // w = tan( half_fov_x_rad ) * znear * 2;
     // h = tan( half_fov_y_rad ) * znear * 2;
 
-    PortalStackPos = 0;
-    PortalStack[ 0 ].AreaFrustum[ 0 ] = *InQuery.FrustumPlanes[ 0 ];
-    PortalStack[ 0 ].AreaFrustum[ 1 ] = *InQuery.FrustumPlanes[ 1 ];
-    PortalStack[ 0 ].AreaFrustum[ 2 ] = *InQuery.FrustumPlanes[ 2 ];
-    PortalStack[ 0 ].AreaFrustum[ 3 ] = *InQuery.FrustumPlanes[ 3 ];
-    PortalStack[ 0 ].AreaFrustum[ 4 ] = *InQuery.FrustumPlanes[ 4 ]; // far plane
-    PortalStack[ 0 ].PlanesCount = 5;
-    PortalStack[ 0 ].Portal = NULL;
-    PortalStack[ 0 ].Scissor.MinX = x;
-    PortalStack[ 0 ].Scissor.MinY = y;
-    PortalStack[ 0 ].Scissor.MaxX = -x;
-    PortalStack[ 0 ].Scissor.MaxY = -y;
+    ViewPortalStack.AreaFrustum[ 0 ] = *InQuery.FrustumPlanes[ 0 ];
+    ViewPortalStack.AreaFrustum[ 1 ] = *InQuery.FrustumPlanes[ 1 ];
+    ViewPortalStack.AreaFrustum[ 2 ] = *InQuery.FrustumPlanes[ 2 ];
+    ViewPortalStack.AreaFrustum[ 3 ] = *InQuery.FrustumPlanes[ 3 ];
+    ViewPortalStack.AreaFrustum[ 4 ] = *InQuery.FrustumPlanes[ 4 ]; // far plane
+    ViewPortalStack.PlanesCount = 5;
+    ViewPortalStack.Portal = NULL;
+    ViewPortalStack.Scissor.MinX = x;
+    ViewPortalStack.Scissor.MinY = y;
+    ViewPortalStack.Scissor.MaxX = -x;
+    ViewPortalStack.Scissor.MaxY = -y;
 
     for ( ALevel * level : InWorld->GetArrayOfLevels() ) {
         ProcessLevelVisibility( level );
@@ -214,6 +222,10 @@ void AVSD::QueryVisiblePrimitives( AWorld * InWorld, TPodVector< SPrimitiveDef *
         }
     }
 
+    if ( InQuery.ViewProjection && vsd_OcclusionCulling ) {
+        CullOccluded( *InQuery.ViewProjection );
+    }
+
 #ifdef DEBUG_TRAVERSING_COUNTERS
     GLogger.Printf( "VSD: VisFrame %d\n", Dbg_SkippedByVisFrame );
     GLogger.Printf( "VSD: PlaneOfs %d\n", Dbg_SkippedByPlaneOffset );
@@ -224,6 +236,7 @@ void AVSD::QueryVisiblePrimitives( AWorld * InWorld, TPodVector< SPrimitiveDef *
     GLogger.Printf( "VSD: PassedPortals %d\n", Dbg_PassedPortals );
     GLogger.Printf( "VSD: StackDeep %d\n", Dbg_StackDeep );
     GLogger.Printf( "VSD: CullMiss: %d\n", Dbg_CullMiss );
+    GLogger.Printf( "VSD: Occluded: %d\n", Dbg_CulledByOcclusion );
 #endif
 
     //QueryVisiblePrimitivesTime = GRuntime->SysMicroseconds() - QueryVisiblePrimitivesTime;
@@ -233,21 +246,263 @@ void AVSD::QueryVisiblePrimitives( AWorld * InWorld, TPodVector< SPrimitiveDef *
     //GLogger.Printf( "Frustum culling time %d microsec. Culled %d from %d primitives. Submits %d\n", Dbg_FrustumCullingTime, Dbg_CulledByPrimitiveBounds, Dbg_TotalPrimitiveBounds, CullSubmits.Size() );
 }
 
-void AVSD::FlowThroughPortals_r( SVisArea const * InArea ) {
-    SPortalStack * prevStack = &PortalStack[ PortalStackPos ];
+/** Occluder significance: squared size of the bounds divided by squared distance to the viewer */
+static float OccluderScore( BvAxisAlignedBox const & InBounds, Float3 const & InViewPosition ) {
+    const float sizeSqr = ( InBounds.Maxs - InBounds.Mins ).LengthSqr();
+    const float distSqr = InBounds.Center().DistSqr( InViewPosition );
+
+    return sizeSqr / Math::Max( distSqr, 1.0f );
+}
+
+void AVSD::SelectOccluders() {
+    Occluders.Clear();
+
+    int numTriangles = 0;
+
+    for ( SSurfaceDef * surf : *pVisSurfs ) {
+        if ( surf->Flags & SURF_OCCLUDER ) {
+            SOccluder & occluder = Occluders.Append();
+            occluder.Score = OccluderScore( surf->Bounds, ViewPosition );
+            occluder.NumTriangles = surf->NumIndices / 3;
+            occluder.Surface = surf;
+            occluder.Primitive = nullptr;
+            numTriangles += occluder.NumTriangles;
+        }
+    }
+
+    for ( SPrimitiveDef * primitive : *pVisPrimitives ) {
+        if ( ( primitive->Flags & SURF_OCCLUDER ) && primitive->Type == VSD_PRIMITIVE_BOX ) {
+            SOccluder & occluder = Occluders.Append();
+            occluder.Score = OccluderScore( primitive->Box, ViewPosition );
+            occluder.NumTriangles = 12;
+            occluder.Surface = nullptr;
+            occluder.Primitive = primitive;
+            numTriangles += occluder.NumTriangles;
+        }
+    }
+
+    const int maxOccluders = Math::Max( vsd_MaxOccluders.GetInteger(), 0 );
+    const int triangleBudget = vsd_OccluderTriangleBudget.GetInteger();
+
+    if ( Occluders.Size() <= maxOccluders && numTriangles <= triangleBudget ) {
+        return;
+    }
+
+    // Keep the most significant occluders that fit the budget
+    StdSort( Occluders.Begin(), Occluders.End(),
+             []( SOccluder const & A, SOccluder const & B ) { return A.Score > B.Score; } );
+
+    int numSelected = 0;
+    numTriangles = 0;
+    for ( SOccluder const & occluder : Occluders ) {
+        if ( numSelected == maxOccluders ) {
+            break;
+        }
+        if ( numTriangles + occluder.NumTriangles > triangleBudget ) {
+            // Smaller occluders may still fit
+            continue;
+        }
+        numTriangles += occluder.NumTriangles;
+        Occluders[numSelected++] = occluder;
+    }
+    Occluders.Resize( numSelected );
+}
+
+void AVSD::CullOccluded( Float4x4 const & InViewProjection ) {
+    AN_PROFILER_SCOPE( "AVSD::CullOccluded" );
+
+    SelectOccluders();
+
+    if ( Occluders.IsEmpty() ) {
+        return;
+    }
+
+    OcclusionBuffer.Clear( InViewProjection );
+
+    for ( SOccluder const & occluder : Occluders ) {
+        if ( occluder.Surface ) {
+            SSurfaceDef const * surf = occluder.Surface;
+            ABrushModel const * model = surf->Model;
+
+            OcclusionBuffer.RasterizeTriangles( model->Vertices.ToPtr() + surf->FirstVertex, sizeof( SMeshVertex ),
+                                                model->Indices.ToPtr() + surf->FirstIndex, surf->NumIndices );
+        } else {
+            OcclusionBuffer.RasterizeBox( occluder.Primitive->Box );
+        }
+    }
+
+    OcclusionBuffer.BuildHiZ( vsd_OcclusionCullingMT ? GRenderFrontendJobList : nullptr );
+
+    // Remove occluded primitives and surfaces. Occluders are tested too: they can be hidden by other occluders.
+    int numVisible = 0;
+    for ( SPrimitiveDef * primitive : *pVisPrimitives ) {
+        BvAxisAlignedBox bounds;
+
+        if ( primitive->Type == VSD_PRIMITIVE_BOX ) {
+            bounds = primitive->Box;
+        } else {
+            bounds.Mins = primitive->Sphere.Center - primitive->Sphere.Radius;
+            bounds.Maxs = primitive->Sphere.Center + primitive->Sphere.Radius;
+        }
+
+        if ( OcclusionBuffer.IsBoxVisible( bounds ) ) {
+            ( *pVisPrimitives )[numVisible++] = primitive;
+        } else {
+            primitive->VisPass = 0;
+            Dbg_CulledByOcclusion++;
+        }
+    }
+    pVisPrimitives->Resize( numVisible );
+
+    numVisible = 0;
+    for ( SSurfaceDef * surf : *pVisSurfs ) {
+        if ( OcclusionBuffer.IsBoxVisible( surf->Bounds ) ) {
+            ( *pVisSurfs )[numVisible++] = surf;
+        } else {
+            surf->VisPass = 0;
+            Dbg_CulledByOcclusion++;
+        }
+    }
+    pVisSurfs->Resize( numVisible );
+}
+
+thread_local AVSD::SPortalStack AVSD::PortalStack[AVSD::MAX_PORTAL_STACK];
+
+// Max portal graph depth where the flow is split to the tasks
+static constexpr int MAX_PORTAL_FLOW_SPLIT_DEPTH = 3;
+
+void AVSD::FlowThroughPortals( SVisArea const * InArea ) {
+    PortalFlowTasks.Clear();
+
+    SPortalFlowTask & rootTask = PortalFlowTasks.Append();
+    rootTask.Stack = ViewPortalStack;
+    rootTask.Area = InArea;
+    rootTask.StackPos = 0;
+    rootTask.bAreaOnly = false;
+
+    int numThreads = vsd_PortalFlowMT ? GAsyncJobManager.GetNumWorkerThreads() : 1;
+
+    #ifdef DEBUG_TRAVERSING_COUNTERS
+    // Debug counters are not thread safe
+    numThreads = 1;
+    #endif
+
+    // Split the portal graph to independent subtrees. The task list keeps the order of
+    // the recursive traversal, so the result doesn't depend on the number of threads.
+    for ( int depth = 0 ; depth < MAX_PORTAL_FLOW_SPLIT_DEPTH && PortalFlowTasks.Size() < numThreads ; depth++ ) {
+        bool bSplit = false;
+
+        PortalFlowTasksNext.Clear();
+
+        for ( SPortalFlowTask const & task : PortalFlowTasks ) {
+            if ( task.bAreaOnly || task.StackPos == ( MAX_PORTAL_STACK - 1 ) ) {
+                PortalFlowTasksNext.Append( task );
+                continue;
+            }
+
+            SPortalFlowTask areaTask = task;
+            areaTask.bAreaOnly = true;
+            PortalFlowTasksNext.Append( areaTask );
+
+            for ( SPortalLink const * portal = task.Area->PortalList; portal; portal = portal->Next ) {
+                if ( portal->Portal->bBlocked ) {
+                    // Portal is closed
+                    continue;
+                }
+
+                SPortalFlowTask subtreeTask;
+                if ( !CalcPortalStack( &subtreeTask.Stack, &task.Stack, portal ) ) {
+                    continue;
+                }
+                subtreeTask.Area = portal->ToArea;
+                subtreeTask.StackPos = task.StackPos + 1;
+                subtreeTask.bAreaOnly = false;
+                PortalFlowTasksNext.Append( subtreeTask );
+
+                bSplit = true;
+            }
+        }
+
+        PortalFlowTasks = PortalFlowTasksNext;
+
+        if ( !bSplit ) {
+            break;
+        }
+    }
+
+    if ( PortalFlowVisits.Size() < PortalFlowTasks.Size() ) {
+        PortalFlowVisits.Resize( PortalFlowTasks.Size() );
+    }
+
+    if ( PortalFlowTasks.Size() > 1 ) {
+        GAsyncJobManager.ParallelFor( PortalFlowTasks.Size(), [this]( int InFirst, int InLast )
+        {
+            for ( int i = InFirst ; i < InLast ; i++ ) {
+                ExecutePortalFlowTask( i );
+            }
+        } );
+    } else {
+        ExecutePortalFlowTask( 0 );
+    }
+
+    // Cull primitives in the same order as they were reached by the flow
+    for ( int i = 0 ; i < PortalFlowTasks.Size() ; i++ ) {
+        for ( SPortalFlowVisit const & visit : PortalFlowVisits[i] ) {
+            if ( visit.Portal ) {
+                // Mark visited
+                visit.Portal->Portal->VisMark = VisQueryMarker;
+
+                #ifdef DEBUG_PORTAL_SCISSORS
+                DebugScissors.Append( visit.Scissor );
+                #endif
+            }
+
+            CullPrimitives( visit.Area, visit.AreaFrustum, visit.PlanesCount );
+        }
+    }
+}
+
+void AVSD::ExecutePortalFlowTask( int InTaskIndex ) {
+    SPortalFlowTask const & task = PortalFlowTasks[InTaskIndex];
+    TPodVector< SPortalFlowVisit > & visits = PortalFlowVisits[InTaskIndex];
+
+    visits.Clear();
+
+    if ( task.bAreaOnly ) {
+        AddPortalFlowVisit( visits, task.Area, &task.Stack );
+        return;
+    }
+
+    PortalStack[ task.StackPos ] = task.Stack;
+
+    FlowThroughPortals_r( visits, task.Area, task.StackPos );
+}
+
+void AVSD::AddPortalFlowVisit( TPodVector< SPortalFlowVisit > & OutVisits, SVisArea const * InArea, SPortalStack const * InStack ) {
+    SPortalFlowVisit & visit = OutVisits.Append();
+
+    visit.Area = InArea;
+    visit.Portal = InStack->Portal;
+    for ( int i = 0 ; i < InStack->PlanesCount ; i++ ) {
+        visit.AreaFrustum[i] = InStack->AreaFrustum[i];
+    }
+    visit.PlanesCount = InStack->PlanesCount;
+    visit.Scissor = InStack->Scissor;
+}
+
+void AVSD::FlowThroughPortals_r( TPodVector< SPortalFlowVisit > & OutVisits, SVisArea const * InArea, int InStackPos ) {
+    SPortalStack * prevStack = &PortalStack[ InStackPos ];
     SPortalStack * stack = prevStack + 1;
 
-    CullPrimitives( InArea, prevStack->AreaFrustum, prevStack->PlanesCount );
+    AddPortalFlowVisit( OutVisits, InArea, prevStack );
 
-    if ( PortalStackPos == ( MAX_PORTAL_STACK - 1 ) ) {
+    if ( InStackPos == ( MAX_PORTAL_STACK - 1 ) ) {
         GLogger.Printf( "MAX_PORTAL_STACK hit\n" );
         return;
     }
 
-    ++PortalStackPos;
-
     #ifdef DEBUG_TRAVERSING_COUNTERS
-    Dbg_StackDeep = Math::Max( Dbg_StackDeep, PortalStackPos );
+    Dbg_StackDeep = Math::Max( Dbg_StackDeep, InStackPos + 1 );
     #endif
 
     for ( SPortalLink const * portal = InArea->PortalList; portal; portal = portal->Next ) {
@@ -268,13 +523,8 @@ void AVSD::FlowThroughPortals_r( SVisArea const * InArea ) {
             continue;
         }
 
-        // Mark visited
-        portal->Portal->VisMark = VisQueryMarker;
-
-        FlowThroughPortals_r( portal->ToArea );
+        FlowThroughPortals_r( OutVisits, portal->ToArea, InStackPos + 1 );
     }
-
-    --PortalStackPos;
 }
 
 bool AVSD::CalcPortalStack( SPortalStack * OutStack, SPortalStack const * InPrevStack, SPortalLink const * InPortal ) {
@@ -297,7 +547,7 @@ bool AVSD::CalcPortalStack( SPortalStack * OutStack, SPortalStack const * InPrev
 
     } else {
 
-        //for ( int i = 0 ; i < PortalStackPos ; i++ ) {
+        //for ( int i = 0 ; i < InStackPos ; i++ ) {
         //    if ( PortalStack[ i ].Portal == InPortal ) {
         //        GLogger.Printf( "Recursive!\n" );
         //    }
@@ -383,10 +633,6 @@ bool AVSD::CalcPortalStack( SPortalStack * OutStack, SPortalStack const * InPrev
         }
     }
 
-    #ifdef DEBUG_PORTAL_SCISSORS
-    DebugScissors.Append( OutStack->Scissor );
-    #endif
-
     #ifdef DEBUG_TRAVERSING_COUNTERS
     Dbg_PassedPortals++;
     #endif
@@ -400,8 +646,8 @@ bool AVSD::CalcPortalStack( SPortalStack * OutStack, SPortalStack const * InPrev
 // Fast polygon clipping. Without memory allocations.
 //
 
-static float ClipDistances[ MAX_HULL_POINTS ];
-static EPlaneSide ClipSides[ MAX_HULL_POINTS ];
+static thread_local float ClipDistances[ MAX_HULL_POINTS ];
+static thread_local EPlaneSide ClipSides[ MAX_HULL_POINTS ];
 
 bool AVSD::ClipPolygonFast( Float3 const * InPoints, const int InNumPoints, SPortalHull * Out, PlaneF const & InClipPlane, const float InEpsilon ) {
     int front = 0;
@@ -475,7 +721,7 @@ bool AVSD::ClipPolygonFast( Float3 const * InPoints, const int InNumPoints, SPor
 }
 
 AVSD::SPortalHull * AVSD::CalcPortalWinding( SPortalLink const * InPortal, SPortalStack const * InStack ) {
-    static SPortalHull PortalHull[ 2 ];
+    static thread_local SPortalHull PortalHull[ 2 ];
 
     int flip = 0;
 
@@ -653,7 +899,63 @@ void AVSD::CullPrimitives( SVisArea const * InArea, PlaneF const * InCullPlanes,
         }
     }
 
-    for ( SPrimitiveLink * link = InArea->Links ; link ; link = link->NextInArea ) {
+    bool bUseBVH = InArea->PrimitiveBVH && vsd_PrimitiveBVH;
+
+    if ( bUseBVH )
+    {
+        BVHPrimitives.Clear();
+
+        InArea->PrimitiveBVH->CullFrustum( InCullPlanes, InCullPlanesCount, BVHPrimitives );
+
+        #ifdef DEBUG_TRAVERSING_COUNTERS
+        Dbg_CulledByPrimitiveBounds += InArea->NumNonMovable - BVHPrimitives.Size();
+        #endif
+
+        for ( SPrimitiveDef * primitive : BVHPrimitives ) {
+
+            if ( primitive->VisMark == VisQueryMarker )
+            {
+                // Primitive visibility already processed
+                continue;
+            }
+
+            // Mark primitive visibility processed
+            primitive->VisMark = VisQueryMarker;
+
+            // Filter query group
+            if ( ( primitive->QueryGroup & VisQueryMask ) != VisQueryMask )
+            {
+                continue;
+            }
+
+            // Check primitive visibility group is not visible
+            if ( ( primitive->VisGroup & VisibilityMask ) == 0 )
+            {
+                continue;
+            }
+
+            // Perform face culling
+            if ( ( primitive->Flags & SURF_PLANAR_TWOSIDED_MASK ) == SURF_PLANAR && FaceCull( primitive ) )
+            {
+                #ifdef DEBUG_TRAVERSING_COUNTERS
+                Dbg_CulledByDotProduct++;
+                #endif
+                continue;
+            }
+
+            // Mark primitive visible
+            primitive->VisPass = VisQueryMarker;
+
+            // Add primitive to vis list
+            pVisPrimitives->Append( primitive );
+        }
+    }
+
+    // Non-movable primitives are processed per primitive if the tree is not used
+    SPrimitiveLink * primitiveLists[2] = { InArea->Links, bUseBVH ? nullptr : InArea->NonMovableLinks };
+
+    for ( SPrimitiveLink * primitiveList : primitiveLists )
+    for ( SPrimitiveLink * link = primitiveList ; link ; link = link->NextInArea ) {
 
         AN_ASSERT( link->Area == InArea );
 
@@ -1143,6 +1445,90 @@ void AVSD::SubmitCullingJobs( SCullJobSubmit & InSubmit ) {
     }
 }
 
+thread_local AVSD::SRaycast AVSD::Raycast;
+thread_local SWorldRaycastResult * AVSD::pRaycastResult;
+thread_local TPodVector< SBoxHitResult > * AVSD::pBoundsRaycastResult;
+
+// Max tasks the batched raycasts are split to
+static constexpr int MAX_RAYCAST_BATCH_TASKS = 64;
+
+void AVSD::SRaycastProcessedSet::Clear() {
+    if ( Count > 0 ) {
+        Core::ZeroMem( Table.ToPtr(), Table.Size() * sizeof( Table[0] ) );
+        Count = 0;
+    }
+}
+
+bool AVSD::SRaycastProcessedSet::Contains( void const * InObject ) const {
+    if ( Count == 0 ) {
+        return false;
+    }
+
+    const int mask = Table.Size() - 1;
+    for ( int i = Core::PHHash64( (uint64_t)InObject ) & mask ; Table[i] ; i = ( i + 1 ) & mask ) {
+        if ( Table[i] == InObject ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AVSD::SRaycastProcessedSet::Insert( void const * InObject ) {
+    if ( ( Count + 1 ) * 2 > Table.Size() ) {
+        // Grow and rehash
+        TPodVector< void const * > oldTable = Table;
+
+        Table.ResizeInvalidate( Math::Max( 64, Table.Size() * 2 ) );
+        Table.ZeroMem();
+        Count = 0;
+
+        for ( void const * object : oldTable ) {
+            if ( object ) {
+                Insert( object );
+            }
+        }
+    }
+
+    const int mask = Table.Size() - 1;
+    int i = Core::PHHash64( (uint64_t)InObject ) & mask;
+    for ( ; Table[i] ; i = ( i + 1 ) & mask ) {
+        if ( Table[i] == InObject ) {
+            return;
+        }
+    }
+    Table[i] = InObject;
+    Count++;
+}
+
+template< typename T >
+AN_FORCEINLINE bool AVSD::IsRaycastProcessed( T const * InObject ) const {
+    if ( Raycast.ProcessedSet ) {
+        return Raycast.ProcessedSet->Contains( InObject );
+    }
+    return InObject->VisMark == VisQueryMarker;
+}
+
+template< typename T >
+AN_FORCEINLINE void AVSD::MarkRaycastProcessed( T * InObject ) {
+    if ( Raycast.ProcessedSet ) {
+        Raycast.ProcessedSet->Insert( InObject );
+    } else {
+        InObject->VisMark = VisQueryMarker;
+    }
+}
+
+template< typename T >
+AN_FORCEINLINE void AVSD::MarkRaycastVisible( T * InObject ) {
+    // Batched raycasts don't write to shared objects
+    if ( !Raycast.ProcessedSet ) {
+        InObject->VisPass = VisQueryMarker;
+    }
+}
+
+AN_FORCEINLINE bool AVSD::RaycastFaceCull( SPrimitiveDef const * InPrimitive ) const {
+    return InPrimitive->Face.Dist( Raycast.RayStart ) < 0.0f;
+}
+
 AN_INLINE bool RayIntersectTriangleFast( Float3 const & _RayStart, Float3 const & _RayDir, Float3 const & _P0, Float3 const & _P1, Float3 const & _P2, float & _U, float & _V ) {
     const Float3 e1 = _P1 - _P0;
     const Float3 e2 = _P2 - _P0;
@@ -1267,7 +1653,7 @@ void AVSD::RaycastSurface( SSurfaceDef * Self )
                     Raycast.NumHits++;
 
                     // Mark as visible
-                    Self->VisPass = VisQueryMarker;
+                    MarkRaycastVisible( Self );
 
                     break;
                 }
@@ -1302,7 +1688,7 @@ void AVSD::RaycastSurface( SSurfaceDef * Self )
                     rcPrimitive.NumHits = 1;
 
                     // Mark as visible
-                    Self->VisPass = VisQueryMarker;
+                    MarkRaycastVisible( Self );
 
                     break;
                 }
@@ -1357,7 +1743,7 @@ void AVSD::RaycastSurface( SSurfaceDef * Self )
                         Raycast.Material = brushModel->SurfaceMaterials[Self->MaterialIndex];
 
                         // Mark as visible
-                        Self->VisPass = VisQueryMarker;
+                        MarkRaycastVisible( Self );
                     }
                 }
             }
@@ -1389,7 +1775,7 @@ void AVSD::RaycastSurface( SSurfaceDef * Self )
                         hitResult.Material = brushModel->SurfaceMaterials[Self->MaterialIndex];
 
                         // Mark as visible
-                        Self->VisPass = VisQueryMarker;
+                        MarkRaycastVisible( Self );
 
                         // Find closest hit
                         if ( d < pRaycastResult->Hits[closestHit].Distance ) {
@@ -1443,7 +1829,7 @@ void AVSD::RaycastPrimitive( SPrimitiveDef * Self )
             //Raycast.LightingLevel = Self->Owner->ParentLevel.GetObject();
 
             // Mark primitive visible
-            Self->VisPass = VisQueryMarker;
+            MarkRaycastVisible( Self );
         }
     }
     else
@@ -1477,7 +1863,7 @@ void AVSD::RaycastPrimitive( SPrimitiveDef * Self )
             rcPrimitive.ClosestHit = closestHit;
 
             // Mark primitive visible
-            Self->VisPass = VisQueryMarker;
+            MarkRaycastVisible( Self );
         }
     }
 }
@@ -1486,7 +1872,7 @@ void AVSD::RaycastArea( SVisArea * InArea )
 {
     float boxMin, boxMax;
 
-    if ( InArea->VisMark == VisQueryMarker )
+    if ( IsRaycastProcessed( InArea ) )
     {
         // Area raycast already processed
         //GLogger.Printf( "Area raycast already processed\n" );
@@ -1494,35 +1880,35 @@ void AVSD::RaycastArea( SVisArea * InArea )
     }
 
     // Mark area raycast processed
-    InArea->VisMark = VisQueryMarker;
+    MarkRaycastProcessed( InArea );
     
     if ( InArea->NumSurfaces > 0 )
     {
-        ABrushModel * model = CurLevel->Model;
+        ABrushModel * model = Raycast.Level->Model;
 
-        int const * pSurfaceIndex = &CurLevel->AreaSurfaces[InArea->FirstSurface];
+        int const * pSurfaceIndex = &Raycast.Level->AreaSurfaces[InArea->FirstSurface];
 
         for ( int i = 0 ; i < InArea->NumSurfaces ; i++, pSurfaceIndex++ ) {
 
             SSurfaceDef * surf = &model->Surfaces[*pSurfaceIndex];
 
-            if ( surf->VisMark == VisQueryMarker )
+            if ( IsRaycastProcessed( surf ) )
             {
                 // Surface raycast already processed
                 continue;
             }
 
             // Mark surface raycast processed
-            surf->VisMark = VisQueryMarker;
+            MarkRaycastProcessed( surf );
 
             // Filter query group
-            if ( (surf->QueryGroup & VisQueryMask) != VisQueryMask )
+            if ( (surf->QueryGroup & Raycast.QueryMask) != Raycast.QueryMask )
             {
                 continue;
             }
 
             // Check surface visibility group is not visible
-            if ( (surf->VisGroup & VisibilityMask) == 0 )
+            if ( (surf->VisGroup & Raycast.VisibilityMask) == 0 )
             {
                 continue;
             }
@@ -1538,38 +1924,41 @@ void AVSD::RaycastArea( SVisArea * InArea )
         }
     }
 
-    for ( SPrimitiveLink * link = InArea->Links ; link ; link = link->NextInArea ) {
+    SPrimitiveLink * primitiveLists[2] = { InArea->Links, InArea->NonMovableLinks };
+
+    for ( SPrimitiveLink * primitiveList : primitiveLists )
+    for ( SPrimitiveLink * link = primitiveList ; link ; link = link->NextInArea ) {
         SPrimitiveDef * primitive = link->Primitive;
 
-        if ( primitive->VisMark == VisQueryMarker )
+        if ( IsRaycastProcessed( primitive ) )
         {
             // Primitive raycast already processed
             continue;
         }
 
         // Filter query group
-        if ( (primitive->QueryGroup & VisQueryMask) != VisQueryMask )
+        if ( (primitive->QueryGroup & Raycast.QueryMask) != Raycast.QueryMask )
         {
             // Mark primitive raycast processed
-            primitive->VisMark = VisQueryMarker;
+            MarkRaycastProcessed( primitive );
             continue;
         }
 
         // Check primitive visibility group is not visible
-        if ( (primitive->VisGroup & VisibilityMask) == 0 )
+        if ( (primitive->VisGroup & Raycast.VisibilityMask) == 0 )
         {
             // Mark primitive raycast processed
-            primitive->VisMark = VisQueryMarker;
+            MarkRaycastProcessed( primitive );
             continue;
         }
 
         if ( ( primitive->Flags & SURF_PLANAR_TWOSIDED_MASK ) == SURF_PLANAR )
         {
             // Perform face culling
-            if ( FaceCull( primitive ) )
+            if ( RaycastFaceCull( primitive ) )
             {
                 // Face successfully culled
-                primitive->VisMark = VisQueryMarker;
+                MarkRaycastProcessed( primitive );
                 continue;
             }
         }
@@ -1607,7 +1996,7 @@ void AVSD::RaycastArea( SVisArea * InArea )
         }
 
         // Mark primitive raycast processed
-        primitive->VisMark = VisQueryMarker;
+        MarkRaycastProcessed( primitive );
 
         RaycastPrimitive( primitive );
 
@@ -1624,7 +2013,7 @@ void AVSD::RaycastPrimitiveBounds( SVisArea * InArea )
 {
     float boxMin, boxMax;
 
-    if ( InArea->VisMark == VisQueryMarker )
+    if ( IsRaycastProcessed( InArea ) )
     {
         // Area raycast already processed
         //GLogger.Printf( "Area raycast already processed\n" );
@@ -1632,35 +2021,35 @@ void AVSD::RaycastPrimitiveBounds( SVisArea * InArea )
     }
 
     // Mark area raycast processed
-    InArea->VisMark = VisQueryMarker;
+    MarkRaycastProcessed( InArea );
 
     if ( InArea->NumSurfaces > 0 )
     {
-        ABrushModel * model = CurLevel->Model;
+        ABrushModel * model = Raycast.Level->Model;
 
-        int const * pSurfaceIndex = &CurLevel->AreaSurfaces[InArea->FirstSurface];
+        int const * pSurfaceIndex = &Raycast.Level->AreaSurfaces[InArea->FirstSurface];
 
         for ( int i = 0 ; i < InArea->NumSurfaces ; i++, pSurfaceIndex++ ) {
 
             SSurfaceDef * surf = &model->Surfaces[*pSurfaceIndex];
 
-            if ( surf->VisMark == VisQueryMarker )
+            if ( IsRaycastProcessed( surf ) )
             {
                 // Surface raycast already processed
                 continue;
             }
 
             // Mark surface raycast processed
-            surf->VisMark = VisQueryMarker;
+            MarkRaycastProcessed( surf );
 
             // Filter query group
-            if ( (surf->QueryGroup & VisQueryMask) != VisQueryMask )
+            if ( (surf->QueryGroup & Raycast.QueryMask) != Raycast.QueryMask )
             {
                 continue;
             }
 
             // Check surface visibility group is not visible
-            if ( (surf->VisGroup & VisibilityMask) == 0 )
+            if ( (surf->VisGroup & Raycast.VisibilityMask) == 0 )
             {
                 continue;
             }
@@ -1682,7 +2071,7 @@ void AVSD::RaycastPrimitiveBounds( SVisArea * InArea )
             }
 
             // Mark as visible
-            surf->VisPass = VisQueryMarker;
+            MarkRaycastVisible( surf );
 
             if ( Raycast.bClosest )
             {
@@ -1711,28 +2100,31 @@ void AVSD::RaycastPrimitiveBounds( SVisArea * InArea )
         }
     }
 
-    for ( SPrimitiveLink * link = InArea->Links ; link ; link = link->NextInArea ) {
+    SPrimitiveLink * primitiveLists[2] = { InArea->Links, InArea->NonMovableLinks };
+
+    for ( SPrimitiveLink * primitiveList : primitiveLists )
+    for ( SPrimitiveLink * link = primitiveList ; link ; link = link->NextInArea ) {
         SPrimitiveDef * primitive = link->Primitive;
 
-        if ( primitive->VisMark == VisQueryMarker )
+        if ( IsRaycastProcessed( primitive ) )
         {
             // Primitive raycast already processed
             continue;
         }
 
         // Filter query group
-        if ( (primitive->QueryGroup & VisQueryMask) != VisQueryMask )
+        if ( (primitive->QueryGroup & Raycast.QueryMask) != Raycast.QueryMask )
         {
             // Mark primitive raycast processed
-            primitive->VisMark = VisQueryMarker;
+            MarkRaycastProcessed( primitive );
             continue;
         }
 
         // Check primitive visibility group is not visible
-        if ( (primitive->VisGroup & VisibilityMask) == 0 )
+        if ( (primitive->VisGroup & Raycast.VisibilityMask) == 0 )
         {
             // Mark primitive raycast processed
-            primitive->VisMark = VisQueryMarker;
+            MarkRaycastProcessed( primitive );
             continue;
         }
 
@@ -1769,10 +2161,10 @@ void AVSD::RaycastPrimitiveBounds( SVisArea * InArea )
         }
 
         // Mark primitive raycast processed
-        primitive->VisMark = VisQueryMarker;
+        MarkRaycastProcessed( primitive );
 
         // Mark primitive visible
-        primitive->VisPass = VisQueryMarker;
+        MarkRaycastVisible( primitive );
 
         if ( Raycast.bClosest )
         {
@@ -1808,9 +2200,9 @@ void AVSD::LevelRaycast_r( int InNodeIndex ) {
 
     while ( 1 ) {
         if ( InNodeIndex < 0 ) {
-            node = &CurLevel->Leafs[-1 - InNodeIndex];
+            node = &Raycast.Level->Leafs[-1 - InNodeIndex];
         } else {
-            node = CurLevel->Nodes.ToPtr() + InNodeIndex;
+            node = Raycast.Level->Nodes.ToPtr() + InNodeIndex;
         }
 
         if ( node->ViewMark != NodeViewMark )
@@ -1853,7 +2245,7 @@ bool AVSD::LevelRaycast2_r( int InNodeIndex, Float3 const & InRayStart, Float3 c
 
     if ( InNodeIndex < 0 ) {
 
-        SBinarySpaceLeaf const * leaf = &CurLevel->Leafs[-1 - InNodeIndex];
+        SBinarySpaceLeaf const * leaf = &Raycast.Level->Leafs[-1 - InNodeIndex];
 
 #if 0
         // FIXME: Add this additional checks?
@@ -1881,7 +2273,7 @@ bool AVSD::LevelRaycast2_r( int InNodeIndex, Float3 const & InRayStart, Float3 c
         return false;
     }
 
-    SBinarySpaceNode const * node = CurLevel->Nodes.ToPtr() + InNodeIndex;
+    SBinarySpaceNode const * node = Raycast.Level->Nodes.ToPtr() + InNodeIndex;
 
     float d1, d2;
 
@@ -1952,9 +2344,9 @@ void AVSD::LevelRaycastBounds_r( int InNodeIndex ) {
 
     while ( 1 ) {
         if ( InNodeIndex < 0 ) {
-            node = &CurLevel->Leafs[-1 - InNodeIndex];
+            node = &Raycast.Level->Leafs[-1 - InNodeIndex];
         } else {
-            node = CurLevel->Nodes.ToPtr() + InNodeIndex;
+            node = Raycast.Level->Nodes.ToPtr() + InNodeIndex;
         }
 
         if ( node->ViewMark != NodeViewMark )
@@ -1997,7 +2389,7 @@ bool AVSD::LevelRaycastBounds2_r( int InNodeIndex, Float3 const & InRayStart, Fl
 
     if ( InNodeIndex < 0 ) {
 
-        SBinarySpaceLeaf const * leaf = &CurLevel->Leafs[-1 - InNodeIndex];
+        SBinarySpaceLeaf const * leaf = &Raycast.Level->Leafs[-1 - InNodeIndex];
 
 #if 0
         float boxMin, boxMax;
@@ -2023,7 +2415,7 @@ bool AVSD::LevelRaycastBounds2_r( int InNodeIndex, Float3 const & InRayStart, Fl
         return false;
     }
 
-    SBinarySpaceNode const * node = CurLevel->Nodes.ToPtr() + InNodeIndex;
+    SBinarySpaceNode const * node = Raycast.Level->Nodes.ToPtr() + InNodeIndex;
 
     float d1, d2;
 
@@ -2093,13 +2485,13 @@ void AVSD::LevelRaycastPortals_r( SVisArea * InArea ) {
 
     for ( SPortalLink const * portal = InArea->PortalList; portal; portal = portal->Next ) {
 
-        if ( portal->Portal->VisMark == VisQueryMarker ) {
+        if ( IsRaycastProcessed( portal->Portal ) ) {
             // Already visited
             continue;
         }
 
         // Mark visited
-        portal->Portal->VisMark = VisQueryMarker;
+        MarkRaycastProcessed( portal->Portal );
 
         if ( portal->Portal->bBlocked ) {
             // Portal is closed
@@ -2155,13 +2547,13 @@ void AVSD::LevelRaycastBoundsPortals_r( SVisArea * InArea ) {
 
     for ( SPortalLink const * portal = InArea->PortalList; portal; portal = portal->Next ) {
 
-        if ( portal->Portal->VisMark == VisQueryMarker ) {
+        if ( IsRaycastProcessed( portal->Portal ) ) {
             // Already visited
             continue;
         }
 
         // Mark visited
-        portal->Portal->VisMark = VisQueryMarker;
+        MarkRaycastProcessed( portal->Portal );
 
         if ( portal->Portal->bBlocked ) {
             // Portal is closed
@@ -2213,7 +2605,7 @@ void AVSD::LevelRaycastBoundsPortals_r( SVisArea * InArea ) {
 }
 
 void AVSD::ProcessLevelRaycast( ALevel * InLevel ) {
-    CurLevel = InLevel;
+    Raycast.Level = InLevel;
 
     // TODO: check level bounds (ray/aabb overlap)?
 
@@ -2243,7 +2635,7 @@ void AVSD::ProcessLevelRaycast( ALevel * InLevel ) {
 }
 
 void AVSD::ProcessLevelRaycastBounds( ALevel * InLevel ) {
-    CurLevel = InLevel;
+    Raycast.Level = InLevel;
 
     // TODO: check level bounds (ray/aabb overlap)?
 
@@ -2269,16 +2661,11 @@ void AVSD::ProcessLevelRaycastBounds( ALevel * InLevel ) {
     }
 }
 
-bool AVSD::RaycastTriangles( AWorld * InWorld, SWorldRaycastResult & Result, Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter ) {
-    ++VisQueryMarker;
-
+bool AVSD::SetupRaycast( Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter ) {
     InFilter = InFilter ? InFilter : &DefaultRaycastFilter;
 
-    VisQueryMask = InFilter->QueryMask;
-    VisibilityMask = InFilter->VisibilityMask;
-
-    pRaycastResult = &Result;
-    pRaycastResult->Clear();
+    Raycast.QueryMask = InFilter->QueryMask;
+    Raycast.VisibilityMask = InFilter->VisibilityMask;
 
     Float3 rayVec = InRayEnd - InRayStart;
 
@@ -2294,14 +2681,29 @@ bool AVSD::RaycastTriangles( AWorld * InWorld, SWorldRaycastResult & Result, Flo
     Raycast.InvRayDir.X = 1.0f / Raycast.RayDir.X;
     Raycast.InvRayDir.Y = 1.0f / Raycast.RayDir.Y;
     Raycast.InvRayDir.Z = 1.0f / Raycast.RayDir.Z;
+    Raycast.HitDistanceMin = Raycast.RayLength;
+
+    return true;
+}
+
+bool AVSD::RaycastTriangles( AWorld * InWorld, SWorldRaycastResult & Result, Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter ) {
+    SWorldRaycastFilter const * filter = InFilter ? InFilter : &DefaultRaycastFilter;
+
+    ++VisQueryMarker;
+
+    Raycast.ProcessedSet = nullptr;
+
+    pRaycastResult = &Result;
+    pRaycastResult->Clear();
+
+    if ( !SetupRaycast( InRayStart, InRayEnd, filter ) ) {
+        return false;
+    }
+
     //Raycast.HitObject is unused
     //Raycast.HitLocation is unused
-    Raycast.HitDistanceMin = Raycast.RayLength;
     Raycast.bClosest = false;
 
-    // Set view position for face culling
-    ViewPosition = Raycast.RayStart;
-
     for ( ALevel * level : InWorld->GetArrayOfLevels() ) {
         ProcessLevelRaycast( level );
     }
@@ -2310,7 +2712,7 @@ bool AVSD::RaycastTriangles( AWorld * InWorld, SWorldRaycastResult & Result, Flo
         return false;
     }
 
-    if ( InFilter->bSortByDistance ) {
+    if ( filter->bSortByDistance ) {
         Result.Sort();
     }
 
@@ -2320,40 +2722,67 @@ bool AVSD::RaycastTriangles( AWorld * InWorld, SWorldRaycastResult & Result, Flo
 bool AVSD::RaycastClosest( AWorld * InWorld, SWorldRaycastClosestResult & Result, Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter ) {
     ++VisQueryMarker;
 
-    InFilter = InFilter ? InFilter : &DefaultRaycastFilter;
-
-    VisQueryMask = InFilter->QueryMask;
-    VisibilityMask = InFilter->VisibilityMask;
+    Raycast.ProcessedSet = nullptr;
 
-    //pRaycastResult = &Result;
-    //pRaycastResult->Clear();
     Result.Clear();
 
-    Float3 rayVec = InRayEnd - InRayStart;
+    if ( !SetupRaycast( InRayStart, InRayEnd, InFilter ) ) {
+        return false;
+    }
 
-    Raycast.RayLength = rayVec.Length();
+    return TraceClosest( InWorld, Result );
+}
 
-    if ( Raycast.RayLength < 0.0001f ) {
-        return false;
+int AVSD::RaycastClosestBatch( AWorld * InWorld, SWorldRaycastClosestResult * Results, bool * Hits, SWorldRay const * InRays, int InNumRays, SWorldRaycastFilter const * InFilter ) {
+    AN_PROFILER_SCOPE( "AVSD::RaycastClosestBatch" );
+
+    SWorldRaycastFilter const * filter = InFilter ? InFilter : &DefaultRaycastFilter;
+
+    const int numTasks = Math::Min( InNumRays, MAX_RAYCAST_BATCH_TASKS );
+
+    if ( RaycastProcessedSets.Size() < numTasks ) {
+        RaycastProcessedSets.Resize( numTasks );
     }
 
-    Raycast.RayStart = InRayStart;
-    Raycast.RayEnd = InRayEnd;
-    Raycast.RayDir = rayVec / Raycast.RayLength;
-    Raycast.InvRayDir.X = 1.0f / Raycast.RayDir.X;
-    Raycast.InvRayDir.Y = 1.0f / Raycast.RayDir.Y;
-    Raycast.InvRayDir.Z = 1.0f / Raycast.RayDir.Z;
+    AAtomicInt numHits( 0 );
+
+    GAsyncJobManager.ParallelFor( numTasks, [&]( int InFirstTask, int InLastTask )
+    {
+        int taskHits = 0;
+
+        for ( int task = InFirstTask ; task < InLastTask ; task++ ) {
+            Raycast.ProcessedSet = &RaycastProcessedSets[task];
+
+            const int firstRay = (int64_t)InNumRays * task / numTasks;
+            const int lastRay = (int64_t)InNumRays * ( task + 1 ) / numTasks;
+
+            for ( int i = firstRay ; i < lastRay ; i++ ) {
+                Raycast.ProcessedSet->Clear();
+
+                Results[i].Clear();
+
+                Hits[i] = SetupRaycast( InRays[i].Start, InRays[i].End, filter ) && TraceClosest( InWorld, Results[i] );
+
+                taskHits += Hits[i];
+            }
+        }
+
+        Raycast.ProcessedSet = nullptr;
+
+        numHits.FetchAdd( taskHits );
+    } );
+
+    return numHits.Load();
+}
+
+bool AVSD::TraceClosest( AWorld * InWorld, SWorldRaycastClosestResult & Result ) {
     Raycast.HitProxyType = HIT_PROXY_TYPE_UNKNOWN;
-    Raycast.HitLocation = InRayEnd;
-    Raycast.HitDistanceMin = Raycast.RayLength;
+    Raycast.HitLocation = Raycast.RayEnd;
     Raycast.bClosest = true;
     Raycast.pVertices = nullptr;
     Raycast.pLightmapVerts = nullptr;
     Raycast.NumHits = 0;
 
-    // Set view position for face culling
-    ViewPosition = Raycast.RayStart;
-
     for ( ALevel * level : InWorld->GetArrayOfLevels() ) {
         ProcessLevelRaycast( level );
 
@@ -2441,33 +2870,21 @@ bool AVSD::RaycastClosest( AWorld * InWorld, SWorldRaycastClosestResult & Result
 }
 
 bool AVSD::RaycastBounds( AWorld * InWorld, TPodVector< SBoxHitResult > & Result, Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter ) {
-    ++VisQueryMarker;
+    SWorldRaycastFilter const * filter = InFilter ? InFilter : &DefaultRaycastFilter;
 
-    InFilter = InFilter ? InFilter : &DefaultRaycastFilter;
+    ++VisQueryMarker;
 
-    VisQueryMask = InFilter->QueryMask;
-    VisibilityMask = InFilter->VisibilityMask;
+    Raycast.ProcessedSet = nullptr;
 
     pBoundsRaycastResult = &Result;
     pBoundsRaycastResult->Clear();
 
-    Float3 rayVec = InRayEnd - InRayStart;
-
-    Raycast.RayLength = rayVec.Length();
-
-    if ( Raycast.RayLength < 0.0001f ) {
+    if ( !SetupRaycast( InRayStart, InRayEnd, filter ) ) {
         return false;
     }
 
-    Raycast.RayStart = InRayStart;
-    Raycast.RayEnd = InRayEnd;
-    Raycast.RayDir = rayVec / Raycast.RayLength;
-    Raycast.InvRayDir.X = 1.0f / Raycast.RayDir.X;
-    Raycast.InvRayDir.Y = 1.0f / Raycast.RayDir.Y;
-    Raycast.InvRayDir.Z = 1.0f / Raycast.RayDir.Z;
     //Raycast.HitObject is unused
     //Raycast.HitLocation is unused
-    Raycast.HitDistanceMin = Raycast.RayLength;
     Raycast.bClosest = false;
 
     for ( ALevel * level : InWorld->GetArrayOfLevels() ) {
@@ -2478,7 +2895,7 @@ bool AVSD::RaycastBounds( AWorld * InWorld, TPodVector< SBoxHitResult > & Result
         return false;
     }
 
-    if ( InFilter->bSortByDistance ) {
+    if ( filter->bSortByDistance ) {
         struct ASortHit {
             bool operator() ( SBoxHitResult const & _A, SBoxHitResult const & _B ) {
                 return ( _A.DistanceMin < _B.DistanceMin );
@@ -2494,30 +2911,62 @@ bool AVSD::RaycastBounds( AWorld * InWorld, TPodVector< SBoxHitResult > & Result
 bool AVSD::RaycastClosestBounds( AWorld * InWorld, SBoxHitResult & Result, Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter ) {
     ++VisQueryMarker;
 
-    InFilter = InFilter ? InFilter : &DefaultRaycastFilter;
-
-    VisQueryMask = InFilter->QueryMask;
-    VisibilityMask = InFilter->VisibilityMask;
+    Raycast.ProcessedSet = nullptr;
 
     Result.Clear();
 
-    Float3 rayVec = InRayEnd - InRayStart;
+    if ( !SetupRaycast( InRayStart, InRayEnd, InFilter ) ) {
+        return false;
+    }
 
-    Raycast.RayLength = rayVec.Length();
+    return TraceClosestBounds( InWorld, Result );
+}
 
-    if ( Raycast.RayLength < 0.0001f ) {
-        return false;
+int AVSD::RaycastClosestBoundsBatch( AWorld * InWorld, SBoxHitResult * Results, bool * Hits, SWorldRay const * InRays, int InNumRays, SWorldRaycastFilter const * InFilter ) {
+    AN_PROFILER_SCOPE( "AVSD::RaycastClosestBoundsBatch" );
+
+    SWorldRaycastFilter const * filter = InFilter ? InFilter : &DefaultRaycastFilter;
+
+    const int numTasks = Math::Min( InNumRays, MAX_RAYCAST_BATCH_TASKS );
+
+    if ( RaycastProcessedSets.Size() < numTasks ) {
+        RaycastProcessedSets.Resize( numTasks );
     }
 
-    Raycast.RayStart = InRayStart;
-    Raycast.RayEnd = InRayEnd;
-    Raycast.RayDir = rayVec / Raycast.RayLength;
-    Raycast.InvRayDir.X = 1.0f / Raycast.RayDir.X;
-    Raycast.InvRayDir.Y = 1.0f / Raycast.RayDir.Y;
-    Raycast.InvRayDir.Z = 1.0f / Raycast.RayDir.Z;
+    AAtomicInt numHits( 0 );
+
+    GAsyncJobManager.ParallelFor( numTasks, [&]( int InFirstTask, int InLastTask )
+    {
+        int taskHits = 0;
+
+        for ( int task = InFirstTask ; task < InLastTask ; task++ ) {
+            Raycast.ProcessedSet = &RaycastProcessedSets[task];
+
+            const int firstRay = (int64_t)InNumRays * task / numTasks;
+            const int lastRay = (int64_t)InNumRays * ( task + 1 ) / numTasks;
+
+            for ( int i = firstRay ; i < lastRay ; i++ ) {
+                Raycast.ProcessedSet->Clear();
+
+                Results[i].Clear();
+
+                Hits[i] = SetupRaycast( InRays[i].Start, InRays[i].End, filter ) && TraceClosestBounds( InWorld, Results[i] );
+
+                taskHits += Hits[i];
+            }
+        }
+
+        Raycast.ProcessedSet = nullptr;
+
+        numHits.FetchAdd( taskHits );
+    } );
+
+    return numHits.Load();
+}
+
+bool AVSD::TraceClosestBounds( AWorld * InWorld, SBoxHitResult & Result ) {
     Raycast.HitProxyType = HIT_PROXY_TYPE_UNKNOWN;
     //Raycast.HitLocation is unused
-    Raycast.HitDistanceMin = Raycast.RayLength;
     Raycast.HitDistanceMax = Raycast.RayLength;
     Raycast.bClosest = true;
 
@@ -2542,8 +2991,8 @@ bool AVSD::RaycastClosestBounds( AWorld * InWorld, SBoxHitResult & Result, Float
         return false;
     }
 
-    Result.LocationMin = InRayStart + Raycast.RayDir * Raycast.HitDistanceMin;
-    Result.LocationMax = InRayStart + Raycast.RayDir * Raycast.HitDistanceMax;
+    Result.LocationMin = Raycast.RayStart + Raycast.RayDir * Raycast.HitDistanceMin;
+    Result.LocationMax = Raycast.RayStart + Raycast.RayDir * Raycast.HitDistanceMax;
     Result.DistanceMin = Raycast.HitDistanceMin;
     Result.DistanceMax = Raycast.HitDistanceMax;
     //Result.HitFractionMin = hitDistanceMin / rayLength;
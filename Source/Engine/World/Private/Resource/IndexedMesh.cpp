@@ -107,6 +107,8 @@ void AIndexedMesh::Initialize( int _NumVertices, int _NumIndices, int _NumSubpar
 }
 
 void AIndexedMesh::Purge() {
+    Revision++;
+
     for ( AIndexedMeshSubpart * subpart : Subparts ) {
         subpart->OwnerMesh = nullptr;
         subpart->RemoveRef();
@@ -1128,11 +1130,19 @@ AIndexedMeshSubpart::~AIndexedMeshSubpart() {
 void AIndexedMeshSubpart::SetBaseVertex( int _BaseVertex ) {
     BaseVertex = _BaseVertex;
     bAABBTreeDirty = true;
+
+    if ( OwnerMesh ) {
+        OwnerMesh->Revision++;
+    }
 }
 
 void AIndexedMeshSubpart::SetFirstIndex( int _FirstIndex ) {
     FirstIndex = _FirstIndex;
     bAABBTreeDirty = true;
+
+    if ( OwnerMesh ) {
+        OwnerMesh->Revision++;
+    }
 }
 
 void AIndexedMeshSubpart::SetVertexCount( int _VertexCount ) {
@@ -1142,6 +1152,10 @@ void AIndexedMeshSubpart::SetVertexCount( int _VertexCount ) {
 void AIndexedMeshSubpart::SetIndexCount( int _IndexCount ) {
     IndexCount = _IndexCount;
     bAABBTreeDirty = true;
+
+    if ( OwnerMesh ) {
+        OwnerMesh->Revision++;
+    }
 }
 
 void AIndexedMeshSubpart::SetMaterialInstance( AMaterialInstance * _MaterialInstance ) {
@@ -1151,6 +1165,10 @@ void AIndexedMeshSubpart::SetMaterialInstance( AMaterialInstance * _MaterialInst
         static TStaticResourceFinder< AMaterialInstance > DefaultMaterialInstance( _CTS( "/Default/MaterialInstance/Default" ) );
         MaterialInstance = DefaultMaterialInstance.GetObject();
     }
+
+    if ( OwnerMesh ) {
+        OwnerMesh->Revision++;
+    }
 }
 
 void AIndexedMeshSubpart::SetBoundingBox( BvAxisAlignedBox const & _BoundingBox ) {
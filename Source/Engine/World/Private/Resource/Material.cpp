@@ -42,6 +42,8 @@ AN_CLASS_META( AMaterialInstance )
 
 static AMaterial * GMaterials = nullptr, * GMaterialsTail = nullptr;
 
+uint32_t AMaterialInstance::MaterialRevision = 0;
+
 AMaterial::AMaterial() {
     INTRUSIVE_ADD( this, pNext, pPrev, GMaterials, GMaterialsTail );
 }
@@ -1017,6 +1019,8 @@ bool AMaterialInstance::LoadTextVersion( IBinaryStream & Stream ) {
 }
 
 void AMaterialInstance::SetMaterial( AMaterial * _Material ) {
+    MaterialRevision++;
+
     if ( !_Material ) {
         static TStaticResourceFinder< AMaterial > MaterialResource( _CTS( "/Default/Materials/Unlit" ) );
 
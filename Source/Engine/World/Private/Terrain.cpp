@@ -55,6 +55,9 @@ Future:
 #include <World/Public/Base/DebugRenderer.h>
 #include <Runtime/Public/RuntimeVariable.h>
 #include <Runtime/Public/Runtime.h>
+#include <Core/Public/Core.h>
+
+#include <xmmintrin.h>
 
 #include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
 #include "BulletCompatibility/BulletCompatibility.h"
@@ -65,6 +68,11 @@ static const unsigned short RESET_INDEX = 0xffff;
 ARuntimeVariable com_TerrainMinLod(_CTS("com_TerrainMinLod"),_CTS("0"));
 ARuntimeVariable com_TerrainMaxLod(_CTS("com_TerrainMaxLod"),_CTS("5"));
 ARuntimeVariable com_ShowTerrainMemoryUsage(_CTS("com_ShowTerrainMemoryUsage"),_CTS("0"));
+ARuntimeVariable com_TerrainHeightmapCacheSize(_CTS("com_TerrainHeightmapCacheSize"),_CTS("64"),0,_CTS("Heightmap tile cache size in megabytes"));
+ARuntimeVariable com_TerrainPixelError(_CTS("com_TerrainPixelError"),_CTS("2"),0,_CTS("Maximum projected terrain geometric error in pixels"));
+ARuntimeVariable com_TerrainUpdateBudget(_CTS("com_TerrainUpdateBudget"),_CTS("2"),0,_CTS("Clipmap update time budget per frame in milliseconds"));
+ARuntimeVariable com_TerrainNativeRaycast(_CTS("com_TerrainNativeRaycast"),_CTS("1"),0,_CTS("Use min/max height quadtree for terrain raycasts instead of Bullet heightfield"));
+ARuntimeVariable com_TerrainCompressHeightmap(_CTS("com_TerrainCompressHeightmap"),_CTS("0"),0,_CTS("Quantize heightmap tiles to 16 bits when baking"));
 
 void CreateTriangleStripPatch( int NumQuadsX, int NumQuadsY, TPodVector< STerrainVertex > & Vertices, TPodVector< unsigned short > & Indices )
 {
@@ -460,7 +468,7 @@ void ATerrainView::SetTerrain( ATerrain * InTerrain )
     }
 }
 
-void ATerrainView::Update( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum )
+void ATerrainView::Update( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum, float ErrorScale, bool bPerspective )
 {
     AN_ASSERT( TerrainMesh->GetTextureSize() == TextureSize );
 
@@ -471,11 +479,13 @@ void ATerrainView::Update( ATerrainMesh * TerrainMesh, Float3 const & ViewPositi
 
     StartInstanceLocation = 0;
 
+    Terrain->UpdateResidency();
+
     if ( !ViewFrustum.IsBoxVisible( Terrain->GetBoundingBox() ) ) {
         return;
     }
 
-    MakeView( TerrainMesh, ViewPosition, ViewFrustum );
+    MakeView( TerrainMesh, ViewPosition, ViewFrustum, ErrorScale, bPerspective );
 
     AStreamedMemoryGPU * pStreamedMemory = GRuntime->GetStreamedMemoryGPU();
 
@@ -689,12 +699,13 @@ void ATerrainView::AddCrackLines( STerrainLodInfo const & Lod )
     instance.QuadColor = AColor4( 0, 1, 0, 1.0f );
 }
 
-void ATerrainView::MakeView( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum )
+void ATerrainView::MakeView( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum, float ErrorScale, bool bPerspective )
 {
     int minLod = Math::Max( com_TerrainMinLod.GetInteger(), 0 );
     int maxLod = Math::Min( com_TerrainMaxLod.GetInteger(), MAX_TERRAIN_LODS-1 );
 
     float terrainH = Terrain->Height( ViewPosition.X, ViewPosition.Z, 0 );
+    float pixelError = Math::Max( com_TerrainPixelError.GetFloat(), 0.0f );
 
     // height above the terrain
     ViewHeight = Math::Max( ViewPosition.Y - terrainH, 0.0f );
@@ -724,10 +735,19 @@ void ATerrainView::MakeView( ATerrainMesh * TerrainMesh, Float3 const & ViewPosi
             (snapOffset.Y > 0.0f ? INTERIOR_TOP_LEFT : INTERIOR_BOTTOM_LEFT)
             : (snapOffset.Y > 0.0f ? INTERIOR_TOP_RIGHT : INTERIOR_BOTTOM_RIGHT);
 
-        if ( minLod < maxLod && gridExtent < ViewHeight * 2.5f ) {
-            minLod++;
-            //lodInfo.bForceUpdateTexture = true;
-            continue;
+        if ( lod == minLod && minLod < maxLod ) {
+            // Skip the level if the next coarser level represents its area within the screen-space error threshold.
+            // The closest point of the area is assumed to be right below the camera.
+            float geometricError = Terrain->GetGeometricError( lod + 1,
+                                                               lodInfo.Offset.X, lodInfo.Offset.Y,
+                                                               lodInfo.Offset.X + gridExtent, lodInfo.Offset.Y + gridExtent );
+            float distance = bPerspective ? Math::Max( ViewHeight, float( gridScale ) ) : 1.0f;
+
+            if ( geometricError * ErrorScale <= pixelError * distance ) {
+                minLod++;
+                //lodInfo.bForceUpdateTexture = true;
+                continue;
+            }
         }
 
         if ( maxLod - minLod > 5 ) {
@@ -1116,96 +1136,146 @@ void ATerrainView::AddPatches( ATerrainMesh * TerrainMesh, BvFrustum const & Vie
 
 void ATerrainView::UpdateRect( STerrainLodInfo const & Lod, STerrainLodInfo const & CoarserLod, int MinX, int MaxX, int MinY, int MaxY )
 {
-    Int2 texelWorldPos;
-    float h[4];
-    Float3 n;
+    const int width = MaxX - MinX;
+    const int texelStep = Lod.GridScale;
+    const int worldX = ( MinX - Lod.TextureOffset.X ) * texelStep + Lod.Offset.X;
 
     const float InvGridSizeCoarse = 1.0f / CoarserLod.GridScale;
 
-    // TODO: Move this to GPU
+    // Heights of the row with one texel border and of the rows above and below, followed by normal components
+    float * heightUp = (float *)StackAlloc( ( width * 5 + 2 ) * sizeof( float ) );
+    float * heightCenter = heightUp + width;
+    float * heightDown = heightCenter + width + 2;
+    float * normalX = heightDown + width;
+    float * normalZ = normalX + width;
+
+    const __m128 normalY2 = _mm_set1_ps( 4.0f * texelStep * texelStep );
+    const __m128 half = _mm_set1_ps( 127.5f );
+
+    float h[4];
+
     for ( int y = MinY ; y < MaxY ; y++ ) {
-        for ( int x = MinX ; x < MaxX ; x++ ) {
-            int wrapX = x & TextureWrapMask;
-            int wrapY = y & TextureWrapMask;
-
-            // from texture space to world space
-            texelWorldPos.X = ( x - Lod.TextureOffset.X ) * Lod.GridScale + Lod.Offset.X;
-            texelWorldPos.Y = ( y - Lod.TextureOffset.Y ) * Lod.GridScale + Lod.Offset.Y;
-
-            AN_ASSERT( wrapX >= 0 && wrapY >= 0 );
-            AN_ASSERT( wrapX <= TextureSize-1 && wrapY <= TextureSize-1 );
-
-            int sampleLod = Lod.LodIndex;
-
-            Float2 & heightMap = Lod.HeightMap[ wrapY * TextureSize + wrapX ];
-            
-            heightMap.X = Terrain->Height( texelWorldPos.X, texelWorldPos.Y, sampleLod );
-
-            const int texelStep = Lod.GridScale;
-            h[0] = Terrain->Height(texelWorldPos.X,           texelWorldPos.Y-texelStep, sampleLod );
-            h[1] = Terrain->Height(texelWorldPos.X-texelStep, texelWorldPos.Y, sampleLod );
-            h[2] = Terrain->Height(texelWorldPos.X+texelStep, texelWorldPos.Y, sampleLod );
-            h[3] = Terrain->Height(texelWorldPos.X,           texelWorldPos.Y+texelStep, sampleLod );
-
-            // normal = tangent ^ binormal
-            // correct tangent t = cross( binormal, normal );
-            //Float3 n = Math::Cross( Float3( 0.0, h[3] - h[0], 2.0f * texelStep ),
-            //                        Float3( 2.0f * texelStep, h[2] - h[1], 0.0 ) );
-
-            n.X = h[1] - h[2];
-            n.Y = 2 * texelStep;
-            n.Z = h[0] - h[3];
-            //n.NormalizeSelf();
-            float invLength = Math::RSqrt( n.X*n.X + n.Y*n.Y + n.Z*n.Z );
-            n.X *= invLength;
-            n.Z *= invLength;
-
-            byte * normal = &Lod.NormalMap[ (wrapY * TextureSize + wrapX)*4 ];
-            normal[0] = n.X * 127.5f + 127.5f;
-            normal[1] = n.Z * 127.5f + 127.5f;
-
-            int ofsX = texelWorldPos.X - CoarserLod.Offset.X;
-            int ofsY = texelWorldPos.Y - CoarserLod.Offset.Y;
-
-            // from world space to texture space of coarser level
-            wrapX = ofsX / CoarserLod.GridScale + CoarserLod.TextureOffset.X;
-            wrapY = ofsY / CoarserLod.GridScale + CoarserLod.TextureOffset.Y;
-
-            // wrap coordinates
-            wrapX &= TextureWrapMask;
-            wrapY &= TextureWrapMask;
-            int wrapX2 = (wrapX + 1) & TextureWrapMask;
-            int wrapY2 = (wrapY + 1) & TextureWrapMask;
+        const int worldZ = ( y - Lod.TextureOffset.Y ) * texelStep + Lod.Offset.Y;
+
+        Terrain->HeightRow( worldX - texelStep, worldZ, Lod.LodIndex, width + 2, heightCenter );
+        Terrain->HeightRow( worldX, worldZ - texelStep, Lod.LodIndex, width, heightUp );
+        Terrain->HeightRow( worldX, worldZ + texelStep, Lod.LodIndex, width, heightDown );
+
+        // normal = tangent ^ binormal
+        // correct tangent t = cross( binormal, normal );
+        //Float3 n = Math::Cross( Float3( 0.0, h[3] - h[0], 2.0f * texelStep ),
+        //                        Float3( 2.0f * texelStep, h[2] - h[1], 0.0 ) );
+        int x = 0;
+        for ( ; x + 4 <= width ; x += 4 ) {
+            __m128 nx = _mm_sub_ps( _mm_loadu_ps( heightCenter + x ), _mm_loadu_ps( heightCenter + x + 2 ) );
+            __m128 nz = _mm_sub_ps( _mm_loadu_ps( heightUp + x ), _mm_loadu_ps( heightDown + x ) );
+            __m128 lengthSqr = _mm_add_ps( _mm_add_ps( _mm_mul_ps( nx, nx ), _mm_mul_ps( nz, nz ) ), normalY2 );
+            __m128 scale = _mm_mul_ps( _mm_rsqrt_ps( lengthSqr ), half );
+
+            _mm_storeu_ps( normalX + x, _mm_add_ps( _mm_mul_ps( nx, scale ), half ) );
+            _mm_storeu_ps( normalZ + x, _mm_add_ps( _mm_mul_ps( nz, scale ), half ) );
+        }
+        for ( ; x < width ; x++ ) {
+            float nx = heightCenter[x] - heightCenter[x + 2];
+            float nz = heightUp[x] - heightDown[x];
+            float scale = Math::RSqrt( nx*nx + nz*nz + 4.0f * texelStep * texelStep ) * 127.5f;
+
+            normalX[x] = nx * scale + 127.5f;
+            normalZ[x] = nz * scale + 127.5f;
+        }
+
+        // from world space to texture space of coarser level
+        int ofsY = worldZ - CoarserLod.Offset.Y;
+        int coarseY = ( ofsY / CoarserLod.GridScale + CoarserLod.TextureOffset.Y ) & TextureWrapMask;
+        int coarseY2 = ( coarseY + 1 ) & TextureWrapMask;
+        float fy = Math::Fract( float( ofsY ) * InvGridSizeCoarse );
+
+        Float2 const * coarseHeight0 = CoarserLod.HeightMap + coarseY * TextureSize;
+        Float2 const * coarseHeight1 = CoarserLod.HeightMap + coarseY2 * TextureSize;
+        byte const * coarseNormal0 = CoarserLod.NormalMap + coarseY * TextureSize * 4;
+        byte const * coarseNormal1 = CoarserLod.NormalMap + coarseY2 * TextureSize * 4;
+
+        const int wrapY = y & TextureWrapMask;
+
+        Float2 * heightMapRow = Lod.HeightMap + wrapY * TextureSize;
+        byte * normalMapRow = Lod.NormalMap + wrapY * TextureSize * 4;
+
+        for ( x = 0 ; x < width ; x++ ) {
+            int wrapX = ( MinX + x ) & TextureWrapMask;
+
+            Float2 & heightMap = heightMapRow[wrapX];
+            byte * normal = &normalMapRow[wrapX * 4];
+
+            heightMap.X = heightCenter[x + 1];
+
+            normal[0] = normalX[x];
+            normal[1] = normalZ[x];
+
+            int ofsX = worldX + x * texelStep - CoarserLod.Offset.X;
+
+            int coarseX = ( ofsX / CoarserLod.GridScale + CoarserLod.TextureOffset.X ) & TextureWrapMask;
+            int coarseX2 = ( coarseX + 1 ) & TextureWrapMask;
 
             float fx = Math::Fract( float( ofsX ) * InvGridSizeCoarse );
-            float fy = Math::Fract( float( ofsY ) * InvGridSizeCoarse );
 
-            h[0] = CoarserLod.HeightMap[wrapY * TextureSize + wrapX].X;
-            h[1] = CoarserLod.HeightMap[wrapY * TextureSize + wrapX2].X;
-            h[2] = CoarserLod.HeightMap[wrapY2 * TextureSize + wrapX2].X;
-            h[3] = CoarserLod.HeightMap[wrapY2 * TextureSize + wrapX].X;
+            h[0] = coarseHeight0[coarseX].X;
+            h[1] = coarseHeight0[coarseX2].X;
+            h[2] = coarseHeight1[coarseX2].X;
+            h[3] = coarseHeight1[coarseX].X;
 
             heightMap.Y = Math::Bilerp(h[0],h[1],h[3],h[2],Float2(fx,fy));
 
-            //float zf = floor( zf_zd );
-            //float zd = zf_zd / 512 + 256;
-
-            byte * n0 = &CoarserLod.NormalMap[(wrapY * TextureSize + wrapX)*4];
-            byte * n1 = &CoarserLod.NormalMap[(wrapY * TextureSize + wrapX2)*4];
-            byte * n2 = &CoarserLod.NormalMap[(wrapY2 * TextureSize + wrapX2)*4];
-            byte * n3 = &CoarserLod.NormalMap[(wrapY2 * TextureSize + wrapX)*4];
+            byte const * n0 = &coarseNormal0[coarseX * 4];
+            byte const * n1 = &coarseNormal0[coarseX2 * 4];
+            byte const * n2 = &coarseNormal1[coarseX2 * 4];
+            byte const * n3 = &coarseNormal1[coarseX * 4];
 
             normal[2] = Math::Clamp( Math::Bilerp( float( n0[0] ), float( n1[0] ), float( n3[0] ), float( n2[0] ), Float2( fx, fy ) ), 0.0f, 255.0f );
             normal[3] = Math::Clamp( Math::Bilerp( float( n0[1] ), float( n1[1] ), float( n3[1] ), float( n2[1] ), Float2( fx, fy ) ), 0.0f, 255.0f );
-
-            //heightMap.Y = CoarserLod.HeightMap[wrapY * TextureSize + wrapX].X;
         }
     }
 }
 
+void ATerrainView::UpdateRectsParallel( STerrainLodInfo const & Lod, STerrainLodInfo const & CoarserLod, SClipmapRect const * Rects, int NumRects )
+{
+    int numRows = 0;
+    for ( int i = 0 ; i < NumRects ; i++ ) {
+        SClipmapRect const & rect = Rects[i];
+
+        // Load heightmap tiles covering the rect and its one texel border used for normals
+        Terrain->MakeResident( Lod.LodIndex,
+                               ( rect.MinX - Lod.TextureOffset.X - 1 ) * Lod.GridScale + Lod.Offset.X,
+                               ( rect.MinY - Lod.TextureOffset.Y - 1 ) * Lod.GridScale + Lod.Offset.Y,
+                               ( rect.MaxX - Lod.TextureOffset.X ) * Lod.GridScale + Lod.Offset.X,
+                               ( rect.MaxY - Lod.TextureOffset.Y ) * Lod.GridScale + Lod.Offset.Y );
+
+        numRows += rect.MaxY - rect.MinY;
+    }
+
+    // Rows are independent, so split all rects of the level into row ranges
+    GAsyncJobManager.ParallelFor( numRows, [&]( int InFirstRow, int InLastRow )
+    {
+        int rowOffset = 0;
+        for ( int i = 0 ; i < NumRects ; i++ ) {
+            SClipmapRect const & rect = Rects[i];
+            int rectRows = rect.MaxY - rect.MinY;
+
+            int first = Math::Max( InFirstRow - rowOffset, 0 );
+            int last = Math::Min( InLastRow - rowOffset, rectRows );
+            if ( first < last ) {
+                UpdateRect( Lod, CoarserLod, rect.MinX, rect.MaxX, rect.MinY + first, rect.MinY + last );
+            }
+
+            rowOffset += rectRows;
+        }
+    }, 16 );
+}
+
 void ATerrainView::UpdateTextures()
 {
     const int count = TextureSize * TextureSize;
+    const int64_t budget = com_TerrainUpdateBudget.GetFloat() * 1000.0f;
+    const int64_t startTime = Core::SysMicroseconds();
 
     for ( int lod = MaxViewLod ; lod >= MinViewLod ; lod-- ) {
         STerrainLodInfo & lodInfo = LodInfo[lod];
@@ -1215,8 +1285,6 @@ void ATerrainView::UpdateTextures()
         DeltaMove.X = lodInfo.TextureOffset.X - lodInfo.PrevTextureOffset.X;
         DeltaMove.Y = lodInfo.TextureOffset.Y - lodInfo.PrevTextureOffset.Y;
 
-        lodInfo.PrevTextureOffset = lodInfo.TextureOffset;
-
         int Min[2] = {0,0};
         int Max[2] = {0,0};
 
@@ -1238,34 +1306,48 @@ void ATerrainView::UpdateTextures()
         int MaxX = Max[0];
         int MaxY = Max[1];
 
-        bool bUpdateToGPU = false;
+        SClipmapRect rects[2];
+        int numRects = 0;
 
         if ( Math::Abs( DeltaMove.X ) >= TextureSize || Math::Abs( DeltaMove.Y ) >= TextureSize || lodInfo.bForceUpdateTexture ) {
-
-            lodInfo.bForceUpdateTexture = false;
-
             // Update whole texture
-            UpdateRect( lodInfo,
-                        coarserLodInfo,
-                        lodInfo.TextureOffset.X, lodInfo.TextureOffset.X + TextureSize,
-                        lodInfo.TextureOffset.Y, lodInfo.TextureOffset.Y + TextureSize );
-
-            bUpdateToGPU = true;
+            rects[numRects++] = { lodInfo.TextureOffset.X, lodInfo.TextureOffset.X + TextureSize,
+                                  lodInfo.TextureOffset.Y, lodInfo.TextureOffset.Y + TextureSize };
         }
         else {
             if ( MinY != MaxY ) {
-                UpdateRect( lodInfo, coarserLodInfo, lodInfo.TextureOffset.X, lodInfo.TextureOffset.X + TextureSize, MinY, MaxY );
-
-                bUpdateToGPU = true;
+                rects[numRects++] = { lodInfo.TextureOffset.X, lodInfo.TextureOffset.X + TextureSize, MinY, MaxY };
             }
             if ( MinX != MaxX ) {
-                UpdateRect( lodInfo, coarserLodInfo, MinX, MaxX, lodInfo.TextureOffset.Y, lodInfo.TextureOffset.Y + TextureSize );
-
-                bUpdateToGPU = true;
+                // Skip rows already updated by the horizontal rect
+                int firstRow = lodInfo.TextureOffset.Y;
+                int lastRow = lodInfo.TextureOffset.Y + TextureSize;
+                if ( MinY != MaxY ) {
+                    if ( MinY == firstRow ) {
+                        firstRow = MaxY;
+                    } else {
+                        lastRow = MinY;
+                    }
+                }
+                rects[numRects++] = { MinX, MaxX, firstRow, lastRow };
             }
         }
 
+        bool bUpdateToGPU = numRects > 0;
+
+        if ( bUpdateToGPU && lod < MaxViewLod && Core::SysMicroseconds() - startTime > budget ) {
+            // Out of time budget: finer levels keep their previous state and will be updated
+            // in next frames. Meanwhile they are not rendered.
+            MinViewLod = lod + 1;
+            break;
+        }
+
+        lodInfo.PrevTextureOffset = lodInfo.TextureOffset;
+        lodInfo.bForceUpdateTexture = false;
+
         if ( bUpdateToGPU ) {
+            UpdateRectsParallel( lodInfo, coarserLodInfo, rects, numRects );
+
             RenderCore::STextureRect rect;
 
             rect.Offset.Lod = 0;
@@ -1473,111 +1555,92 @@ Float3 ATerrainView::VertexShader( STerrainVertex const & v )
     return result;
 }
 
-AN_CLASS_META( ATerrain )
-
-ATerrain::ATerrain()
+/** Heightfield collision shape reading heights through the streamed heightmap tiles */
+class ATerrainHeightfieldShape : public btHeightfieldTerrainShape
 {
-    HeightmapResolution = 4097;
+public:
+    ATerrainHeightfieldShape( ATerrainHeightmap const * InHeightmap )
+        : btHeightfieldTerrainShape( InHeightmap->GetResolution(), InHeightmap->GetResolution(),
+                                     InHeightmap, // heightfield data is never accessed directly
+                                     1, InHeightmap->GetMinHeight(), InHeightmap->GetMaxHeight(), 1, PHY_FLOAT, false /* bFlipQuadEdges */ )
+        , Heightmap( InHeightmap )
+    {
+        // Build accelerator from baked tile bounds instead of touching every sample
+        int numTiles = ( Heightmap->GetResolution() + TERRAIN_HEIGHTMAP_TILE_SIZE - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+        m_vboundsChunkSize = TERRAIN_HEIGHTMAP_TILE_SIZE;
+        m_vboundsGridWidth = numTiles;
+        m_vboundsGridLength = numTiles;
+        m_vboundsGrid.resize( numTiles * numTiles );
+        for ( int tileY = 0 ; tileY < numTiles ; tileY++ ) {
+            for ( int tileX = 0 ; tileX < numTiles ; tileX++ ) {
+                STerrainHeightmapTile const & tile = Heightmap->GetTileInfo( 0, tileX, tileY );
+                Range & range = m_vboundsGrid[tileY * numTiles + tileX];
+                range.min = tile.MinHeight;
+                range.max = tile.MaxHeight;
+            }
+        }
+    }
 
-    //Heightmap = (float *)GHeapMemory.Alloc( TERRAIN_SIZE*TERRAIN_SIZE*sizeof( float ) );
-    HeightmapLods = Math::Log2( (uint32_t)(HeightmapResolution-1) ) + 1;
+protected:
+    btScalar getRawHeightFieldValue( int x, int y ) const override
+    {
+        return Heightmap->Sample( 0, x, y );
+    }
 
-    Heightmap.Resize( HeightmapLods );
+private:
+    ATerrainHeightmap const * Heightmap;
+};
 
-    for ( int i = 0 ; i < HeightmapLods ; i++ ) {
-        int sz = 1 << (HeightmapLods - i - 1);
+AN_CLASS_META( ATerrain )
 
-        sz++;
+ATerrain::ATerrain()
+{
+    const char * heightmapFile = "heightmap.tiles";
 
-        Heightmap[i] = (float *)GHeapMemory.Alloc( sz*sz*sizeof( float ) );
-    }
+    if ( !Heightmap.Open( heightmapFile ) ) {
+        // Bake tiled heightmap from the legacy raw heightmap once (or when the baked file is outdated)
+        const int rawResolution = 4097;
 
-#if 0
-    for ( int y = 0 ; y < HeightmapResolution ; y++ ) {
-        for ( int x = 0 ; x < HeightmapResolution ; x++ ) {
-            Heightmap[0][y*HeightmapResolution + x] = Terrain( Float2( x, y ) * 0.5f );
-        }
-    }
+        float * rawHeightmap = (float *)GHeapMemory.ClearedAlloc( rawResolution*rawResolution*sizeof( float ) );
 
-    AFileStream f;
-    f.OpenWrite( "heightmap.dat" );
-    f.WriteBuffer( Heightmap[0], HeightmapResolution*HeightmapResolution*sizeof( float ) );
-#endif
-#if 1
-    AFileStream f;
-    f.OpenRead( "heightmap.dat" );
-    f.ReadBuffer( Heightmap[0], HeightmapResolution*HeightmapResolution*sizeof( float ) );
-#endif
-#if 0
-    Core::ZeroMem( Heightmap[0], HeightmapResolution*HeightmapResolution*sizeof( float ) );
-    AImage image;
-    if ( !image.Load( "swiss2min.png", nullptr, IMAGE_PF_R32F ) ) {
-        GRuntime->PostTerminateEvent();
-    }
-    for ( int y = 0 ; y < HeightmapResolution ; y++ ) {
-        for ( int x = 0 ; x < HeightmapResolution ; x++ ) {
-            int sx = (float)x / HeightmapResolution * image.GetWidth();
-            int sy = (float)y / HeightmapResolution * image.GetHeight();
-            Heightmap[0][y*HeightmapResolution + x] = ((float*)image.GetData())[sy * image.GetWidth() + sx] * 500;
+        AFileStream f;
+        if ( f.OpenRead( "heightmap.dat" ) ) {
+            f.ReadBuffer( rawHeightmap, rawResolution*rawResolution*sizeof( float ) );
         }
-    }
-#endif
-    float h1,h2,h3,h4;
-    int x, y;
-    for ( int i = 1 ; i < HeightmapLods ; i++ ) {
-        float * lod = Heightmap[i];
-        float * srcLod = Heightmap[i - 1];
-
-        int sz = 1 << (HeightmapLods - i - 1);
-        int sz2 = 1 << (HeightmapLods - i);
-
-        sz++;
-        sz2++;
-
-        for ( y = 0 ; y < sz - 1 ; y++ ) {
-            int src_y = y << 1;
-            for ( x = 0 ; x < sz - 1 ; x++ ) {
-                int src_x = x << 1;
-                h1 = srcLod[src_y * sz2 + src_x];
-                h2 = srcLod[src_y * sz2 + src_x + 1];
-                h3 = srcLod[(src_y + 1) * sz2 + src_x];
-                h4 = srcLod[(src_y + 1) * sz2 + src_x + 1];
-
-                lod[ y * sz + x ] = (h1+h2+h3+h4)*0.25f;
-            }
 
-            int src_x = x << 1;
-            h1 = srcLod[src_y * sz2 + src_x];
-            h2 = srcLod[(src_y + 1) * sz2 + src_x];
-            lod[y * sz + x] = (h1+h2)*0.5f;
-        }
+        ATerrainHeightmap::Bake( rawHeightmap, rawResolution, heightmapFile, com_TerrainCompressHeightmap );
 
-        int src_y = y << 1;
-        for ( x = 0 ; x < sz - 1 ; x++ ) {
-            int src_x = x << 1;
-            h1 = srcLod[src_y * sz2 + src_x];
-            h2 = srcLod[src_y * sz2 + src_x + 1];
+        GHeapMemory.Free( rawHeightmap );
 
-            lod[y * sz + x] = (h1+h2)*0.5f;
+        if ( !Heightmap.Open( heightmapFile ) ) {
+            GLogger.Printf( "ATerrain: couldn't open %s\n", heightmapFile );
         }
+    }
 
-        int src_x = x << 1;
-        lod[y * sz + x] = srcLod[src_y * sz2 + src_x];
+    SetupHeightmap();
+}
+
+ATerrain::ATerrain( const char * InHeightmapFile )
+{
+    if ( !Heightmap.Open( InHeightmapFile ) ) {
+        GLogger.Printf( "ATerrain: couldn't open %s\n", InHeightmapFile );
     }
 
-    MinHeight = 99999;
-    MaxHeight = -99999;
+    SetupHeightmap();
+}
+
+void ATerrain::SetupHeightmap()
+{
+    HeightmapResolution = Heightmap.GetResolution();
+    HeightmapLods = Heightmap.GetNumLods();
+    MinHeight = Heightmap.GetMinHeight();
+    MaxHeight = Heightmap.GetMaxHeight();
 
-    for ( y = 0 ; y < HeightmapResolution ; y++ ) {
-        for ( x = 0 ; x < HeightmapResolution ; x++ ) {
-            float h = Heightmap[0][y*HeightmapResolution + x];
-            MinHeight = Math::Min( MinHeight, h );
-            MaxHeight = Math::Max( MaxHeight, h );
-        }
+    if ( Heightmap.IsOpened() ) {
+        HeightfieldShape.Reset( new ATerrainHeightfieldShape( &Heightmap ) );
     }
 
-    HeightfieldShape = MakeUnique< btHeightfieldTerrainShape >( HeightmapResolution, HeightmapResolution, Heightmap[0], 1, MinHeight, MaxHeight, 1, PHY_FLOAT, false /* bFlipQuadEdges */ );
-    HeightfieldShape->buildAccelerator();
+    BuildHeightTree();
 
     int halfResolution = HeightmapResolution >> 1;
     ClipMin.X = halfResolution;
@@ -1595,9 +1658,6 @@ ATerrain::ATerrain()
 
 ATerrain::~ATerrain()
 {
-    for ( int i = 0 ; i < HeightmapLods ; i++ ) {
-        GHeapMemory.Free( Heightmap[i] );
-    }
 }
 
 float ATerrain::Height( int X, int Z, int Lod ) const
@@ -1610,10 +1670,368 @@ float ATerrain::Height( int X, int Z, int Lod ) const
 
     sampleX = Math::Clamp( sampleX + (lodResoultion>>1), 0, (lodResoultion-1) );
     sampleY = Math::Clamp( sampleY + (lodResoultion>>1), 0, (lodResoultion-1) );
-    return Heightmap[Lod][sampleY*lodResoultion + sampleX];
+    return Heightmap.Sample( Lod, sampleX, sampleY );
+}
+
+void ATerrain::HeightRow( int X, int Z, int Lod, int Count, float * Heights ) const
+{
+    AN_ASSERT(Lod>=0&&Lod<HeightmapLods );
+    int lodResoultion = ( 1 << (HeightmapLods - Lod - 1) ) + 1;
+    int halfResolution = lodResoultion >> 1;
+
+    Heightmap.SampleRow( Lod, (X >> Lod) + halfResolution, (Z >> Lod) + halfResolution, Count, Heights );
+}
+
+void ATerrain::MakeResident( int Lod, int MinX, int MinZ, int MaxX, int MaxZ ) const
+{
+    AN_ASSERT(Lod>=0&&Lod<HeightmapLods );
+    int lodResoultion = ( 1 << (HeightmapLods - Lod - 1) ) + 1;
+    int halfResolution = lodResoultion >> 1;
+
+    Heightmap.MakeResident( Lod,
+                            (MinX >> Lod) + halfResolution, (MinZ >> Lod) + halfResolution,
+                            (MaxX >> Lod) + halfResolution, (MaxZ >> Lod) + halfResolution );
+}
+
+float ATerrain::GetGeometricError( int Lod, int MinX, int MinZ, int MaxX, int MaxZ ) const
+{
+    AN_ASSERT(Lod>=0&&Lod<HeightmapLods );
+    int lodResoultion = ( 1 << (HeightmapLods - Lod - 1) ) + 1;
+    int halfResolution = lodResoultion >> 1;
+
+    int minTileX = Math::Clamp( (MinX >> Lod) + halfResolution, 0, lodResoultion - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+    int minTileY = Math::Clamp( (MinZ >> Lod) + halfResolution, 0, lodResoultion - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+    int maxTileX = Math::Clamp( (MaxX >> Lod) + halfResolution, 0, lodResoultion - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+    int maxTileY = Math::Clamp( (MaxZ >> Lod) + halfResolution, 0, lodResoultion - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+
+    float error = 0;
+    for ( int tileY = minTileY ; tileY <= maxTileY ; tileY++ ) {
+        for ( int tileX = minTileX ; tileX <= maxTileX ; tileX++ ) {
+            error = Math::Max( error, Heightmap.GetTileInfo( Lod, tileX, tileY ).GeometricError );
+        }
+    }
+    return error;
+}
+
+void ATerrain::UpdateResidency()
+{
+    Heightmap.UpdateResidency( GRuntime->SysFrameNumber(), (size_t)Math::Max( com_TerrainHeightmapCacheSize.GetInteger(), 0 ) << 20 );
+}
+
+void ATerrain::BuildHeightTree()
+{
+    HeightTree.Clear();
+    HeightTreeLevels = 0;
+
+    if ( !Heightmap.IsOpened() ) {
+        return;
+    }
+
+    // Tile bounds are baked with one extra row and column of samples, so they bound all quads starting inside the tile
+    int size = ( HeightmapResolution - 1 + TERRAIN_HEIGHTMAP_TILE_SIZE - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+
+    HeightTreeOffset[0] = 0;
+    HeightTreeSize[0] = size;
+    HeightTree.Resize( size * size );
+    for ( int z = 0 ; z < size ; z++ ) {
+        for ( int x = 0 ; x < size ; x++ ) {
+            STerrainHeightmapTile const & tile = Heightmap.GetTileInfo( 0, x, z );
+            HeightTree[z * size + x] = Float2( tile.MinHeight, tile.MaxHeight );
+        }
+    }
+    HeightTreeLevels = 1;
+
+    while ( size > 1 ) {
+        AN_ASSERT( HeightTreeLevels < AN_ARRAY_SIZE( HeightTreeOffset ) );
+
+        int childOffset = HeightTreeOffset[HeightTreeLevels - 1];
+        int childSize = size;
+        int offset = HeightTree.Size();
+
+        size = ( size + 1 ) >> 1;
+
+        HeightTreeOffset[HeightTreeLevels] = offset;
+        HeightTreeSize[HeightTreeLevels] = size;
+        HeightTree.Resize( offset + size * size );
+
+        for ( int z = 0 ; z < size ; z++ ) {
+            for ( int x = 0 ; x < size ; x++ ) {
+                Float2 bounds( Math::MaxValue< float >(), -Math::MaxValue< float >() );
+                for ( int cz = z << 1 ; cz < Math::Min( ( z << 1 ) + 2, childSize ) ; cz++ ) {
+                    for ( int cx = x << 1 ; cx < Math::Min( ( x << 1 ) + 2, childSize ) ; cx++ ) {
+                        Float2 const & child = HeightTree[childOffset + cz * childSize + cx];
+                        bounds.X = Math::Min( bounds.X, child.X );
+                        bounds.Y = Math::Max( bounds.Y, child.Y );
+                    }
+                }
+                HeightTree[offset + z * size + x] = bounds;
+            }
+        }
+
+        HeightTreeLevels++;
+    }
+}
+
+template< typename QuadCallback >
+void ATerrain::TraverseRay( Float3 const & RayStart, Float3 const & RayDir, float & MaxDistance, QuadCallback const & Callback ) const
+{
+    struct SNode
+    {
+        int Level;
+        int X;
+        int Z;
+    };
+
+    if ( !HeightTreeLevels ) {
+        return;
+    }
+
+    Float3 invRayDir;
+
+    invRayDir.X = 1.0f / RayDir.X;
+    invRayDir.Y = 1.0f / RayDir.Y;
+    invRayDir.Z = 1.0f / RayDir.Z;
+
+    const int halfResolution = HeightmapResolution >> 1;
+    const int numQuads = HeightmapResolution - 1;
+
+    // Children are pushed far to near, so the nodes are visited front to back
+    const int nearX = RayDir.X < 0.0f ? 1 : 0;
+    const int nearZ = RayDir.Z < 0.0f ? 1 : 0;
+
+    SNode stack[64];
+    int stackSize = 0;
+
+    stack[stackSize++] = { HeightTreeLevels - 1, 0, 0 };
+
+    BvAxisAlignedBox box;
+    float tmin, tmax;
+
+    while ( stackSize > 0 ) {
+        SNode node = stack[--stackSize];
+
+        int shift = node.Level + TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+        int minX = node.X << shift;
+        int minZ = node.Z << shift;
+        if ( minX >= numQuads || minZ >= numQuads ) {
+            continue;
+        }
+        int maxX = Math::Min( ( node.X + 1 ) << shift, numQuads );
+        int maxZ = Math::Min( ( node.Z + 1 ) << shift, numQuads );
+
+        Float2 const & bounds = HeightTree[HeightTreeOffset[node.Level] + node.Z * HeightTreeSize[node.Level] + node.X];
+
+        box.Mins.X = minX - halfResolution;
+        box.Mins.Y = bounds.X;
+        box.Mins.Z = minZ - halfResolution;
+        box.Maxs.X = maxX - halfResolution;
+        box.Maxs.Y = bounds.Y;
+        box.Maxs.Z = maxZ - halfResolution;
+
+        if ( !BvRayIntersectBox( RayStart, invRayDir, box, tmin, tmax ) || tmin > MaxDistance ) {
+            continue;
+        }
+
+        if ( node.Level == 0 ) {
+            TraverseQuads( RayStart, RayDir, invRayDir, Math::Max( tmin, 0.0f ), Math::Min( tmax, MaxDistance ), minX, maxX, minZ, maxZ, MaxDistance, Callback );
+            continue;
+        }
+
+        AN_ASSERT( stackSize + 4 <= AN_ARRAY_SIZE( stack ) );
+
+        for ( int i = 3 ; i >= 0 ; i-- ) {
+            stack[stackSize++] = { node.Level - 1, ( node.X << 1 ) + ( ( i & 1 ) ^ nearX ), ( node.Z << 1 ) + ( ( i >> 1 ) ^ nearZ ) };
+        }
+    }
+}
+
+template< typename QuadCallback >
+void ATerrain::TraverseQuads( Float3 const & RayStart, Float3 const & RayDir, Float3 const & InvRayDir, float TEnter, float TExit, int MinX, int MaxX, int MinZ, int MaxZ, float & MaxDistance, QuadCallback const & Callback ) const
+{
+    const int halfResolution = HeightmapResolution >> 1;
+
+    // Walk the quad grid (Amanatides & Woo)
+    float px = RayStart.X + RayDir.X * TEnter + halfResolution;
+    float pz = RayStart.Z + RayDir.Z * TEnter + halfResolution;
+
+    int x = Math::Clamp( (int)Math::Floor( px ), MinX, MaxX - 1 );
+    int z = Math::Clamp( (int)Math::Floor( pz ), MinZ, MaxZ - 1 );
+
+    int stepX, stepZ;
+    float nextX, nextZ;
+
+    if ( RayDir.X > 0.0f ) {
+        stepX = 1;
+        nextX = ( x + 1 - halfResolution - RayStart.X ) * InvRayDir.X;
+    } else if ( RayDir.X < 0.0f ) {
+        stepX = -1;
+        nextX = ( x - halfResolution - RayStart.X ) * InvRayDir.X;
+    } else {
+        stepX = 0;
+        nextX = Math::MaxValue< float >();
+    }
+
+    if ( RayDir.Z > 0.0f ) {
+        stepZ = 1;
+        nextZ = ( z + 1 - halfResolution - RayStart.Z ) * InvRayDir.Z;
+    } else if ( RayDir.Z < 0.0f ) {
+        stepZ = -1;
+        nextZ = ( z - halfResolution - RayStart.Z ) * InvRayDir.Z;
+    } else {
+        stepZ = 0;
+        nextZ = Math::MaxValue< float >();
+    }
+
+    const float deltaX = stepX ? Math::Abs( InvRayDir.X ) : 0.0f;
+    const float deltaZ = stepZ ? Math::Abs( InvRayDir.Z ) : 0.0f;
+
+    float t = TEnter;
+
+    for ( ;; ) {
+        float quadExit = Math::Min( Math::Min( nextX, nextZ ), TExit );
+
+        Callback( x, z, t, quadExit );
+
+        // Callback may shorten the ray
+        TExit = Math::Min( TExit, MaxDistance );
+
+        if ( quadExit >= TExit ) {
+            break;
+        }
+
+        if ( nextX < nextZ ) {
+            x += stepX;
+            t = nextX;
+            nextX += deltaX;
+            if ( x < MinX || x >= MaxX ) {
+                break;
+            }
+        } else {
+            z += stepZ;
+            t = nextZ;
+            nextZ += deltaZ;
+            if ( z < MinZ || z >= MaxZ ) {
+                break;
+            }
+        }
+    }
+}
+
+int ATerrain::RaycastQuad( Float3 const & RayStart, Float3 const & RayDir, int X, int Z, float TEnter, float TExit, float MaxDistance, bool bCullBackFace, STriangleHitResult * HitResult ) const
+{
+    const float Epsilon = 0.001f;
+
+    float h0 = Heightmap.Sample( 0, X, Z );
+    float h1 = Heightmap.Sample( 0, X + 1, Z );
+    float h2 = Heightmap.Sample( 0, X, Z + 1 );
+    float h3 = Heightmap.Sample( 0, X + 1, Z + 1 );
+
+    // Reject the quad by height range of the ray segment over it
+    float y0 = RayStart.Y + RayDir.Y * TEnter;
+    float y1 = RayStart.Y + RayDir.Y * TExit;
+    if ( Math::Min( y0, y1 ) > Math::Max( Math::Max( h0, h1 ), Math::Max( h2, h3 ) ) + Epsilon
+         || Math::Max( y0, y1 ) < Math::Min( Math::Min( h0, h1 ), Math::Min( h2, h3 ) ) - Epsilon ) {
+        return 0;
+    }
+
+    const int halfResolution = HeightmapResolution >> 1;
+    const float minX = X - halfResolution;
+    const float minZ = Z - halfResolution;
+    const float maxX = minX + 1.0f;
+    const float maxZ = minZ + 1.0f;
+
+    // Same triangulation and winding as btHeightfieldTerrainShape
+    Float3 triangles[2][3] =
+    {
+        { Float3( minX, h0, minZ ), Float3( minX, h2, maxZ ), Float3( maxX, h1, minZ ) },
+        { Float3( maxX, h1, minZ ), Float3( minX, h2, maxZ ), Float3( maxX, h3, maxZ ) }
+    };
+
+    int numHits = 0;
+    float d, u, v;
+    for ( Float3 const * tri : triangles ) {
+        if ( BvRayIntersectTriangle( RayStart, RayDir, tri[0], tri[1], tri[2], d, u, v, bCullBackFace ) && d <= MaxDistance ) {
+            STriangleHitResult & hit = HitResult[numHits++];
+            hit.Location = RayStart + RayDir * d;
+            hit.Normal = Math::Cross( tri[1] - tri[0], tri[2] - tri[0] ).Normalized();
+            hit.UV.X = u;
+            hit.UV.Y = v;
+            hit.Distance = d;
+            hit.Indices[0] = 0;
+            hit.Indices[1] = 0;
+            hit.Indices[2] = 0;
+            hit.Material = nullptr;
+        }
+    }
+    return numHits;
 }
 
 bool ATerrain::Raycast( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, TPodVector< STriangleHitResult > & HitResult ) const
+{
+    if ( !com_TerrainNativeRaycast ) {
+        return RaycastBullet( RayStart, RayDir, Distance, bCullBackFace, HitResult );
+    }
+
+    int firstHit = HitResult.Size();
+
+    TraverseRay( RayStart, RayDir, Distance, [&]( int X, int Z, float TEnter, float TExit )
+    {
+        STriangleHitResult hits[2];
+        int numHits = RaycastQuad( RayStart, RayDir, X, Z, TEnter, TExit, Distance, bCullBackFace, hits );
+        for ( int i = 0 ; i < numHits ; i++ ) {
+            HitResult.Append( hits[i] );
+        }
+    } );
+
+    return HitResult.Size() > firstHit;
+}
+
+bool ATerrain::RaycastClosest( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, STriangleHitResult & HitResult ) const
+{
+    if ( !com_TerrainNativeRaycast ) {
+        return RaycastClosestBullet( RayStart, RayDir, Distance, bCullBackFace, HitResult );
+    }
+
+    bool bHit = false;
+
+    // Closest hit shortens the ray, so farther nodes and quads are culled
+    TraverseRay( RayStart, RayDir, Distance, [&]( int X, int Z, float TEnter, float TExit )
+    {
+        STriangleHitResult hits[2];
+        int numHits = RaycastQuad( RayStart, RayDir, X, Z, TEnter, TExit, Distance, bCullBackFace, hits );
+        for ( int i = 0 ; i < numHits ; i++ ) {
+            if ( hits[i].Distance <= Distance ) {
+                HitResult = hits[i];
+                Distance = hits[i].Distance;
+                bHit = true;
+            }
+        }
+    } );
+
+    return bHit;
+}
+
+int ATerrain::RaycastClosestBatch( STerrainRay const * Rays, int NumRays, bool bCullBackFace, STriangleHitResult * Results, bool * Hits ) const
+{
+    AAtomicInt numHits( 0 );
+
+    GAsyncJobManager.ParallelFor( NumRays, [&]( int InFirstRay, int InLastRay )
+    {
+        int taskHits = 0;
+
+        for ( int i = InFirstRay ; i < InLastRay ; i++ ) {
+            Hits[i] = RaycastClosest( Rays[i].Start, Rays[i].Dir, Rays[i].Distance, bCullBackFace, Results[i] );
+
+            taskHits += Hits[i];
+        }
+
+        numHits.FetchAdd( taskHits );
+    }, 16 );
+
+    return numHits.Load();
+}
+
+bool ATerrain::RaycastBullet( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, TPodVector< STriangleHitResult > & HitResult ) const
 {
     class ATriangleRaycastCallback : public btTriangleCallback
     {
@@ -1679,9 +2097,11 @@ bool ATerrain::Raycast( Float3 const & RayStart, Float3 const & RayDir, float Di
     return triangleRaycastCallback.IntersectionCount > 0;
 }
 
-bool ATerrain::RaycastClosest( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, STriangleHitResult & HitResult ) const
+bool ATerrain::RaycastClosestBullet( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, STriangleHitResult & HitResult ) const
 {
-    #define FIRST_INTERSECTION_IS_CLOSEST
+    // Bullet reports both triangles of a quad in fixed order, so the first intersection is not always
+    // the closest one when back faces are not culled
+    //#define FIRST_INTERSECTION_IS_CLOSEST
 
     class ATriangleRaycastCallback : public btTriangleCallback
     {
@@ -1799,10 +2219,10 @@ bool ATerrain::GetTriangleVertices( float X, float Z, Float3 & V0, Float3 & V1,
     h3       h2
 
     */
-    float h0 = Heightmap[0][quadZ * HeightmapResolution + quadX];
-    float h1 = Heightmap[0][quadZ * HeightmapResolution + quadX + 1];
-    float h2 = Heightmap[0][(quadZ + 1) * HeightmapResolution + quadX + 1];
-    float h3 = Heightmap[0][(quadZ + 1) * HeightmapResolution + quadX];
+    float h0 = Heightmap.Sample( 0, quadX, quadZ );
+    float h1 = Heightmap.Sample( 0, quadX + 1, quadZ );
+    float h2 = Heightmap.Sample( 0, quadX + 1, quadZ + 1 );
+    float h3 = Heightmap.Sample( 0, quadX, quadZ + 1 );
 
     float maxX = minX + 1.0f;
     float maxZ = minZ + 1.0f;
@@ -0,0 +1,552 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include <World/Public/TerrainHeightmap.h>
+#include <Core/Public/Logger.h>
+#include <Core/Public/CoreMath.h>
+
+static const uint32_t HEIGHTMAP_FILE_MAGIC = 0x4d485441; // ATHM
+static const uint32_t HEIGHTMAP_FILE_VERSION = 2;
+
+static AN_FORCEINLINE int NumTilesForResolution( int Resolution )
+{
+    return ( Resolution + TERRAIN_HEIGHTMAP_TILE_SIZE - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+}
+
+static AN_FORCEINLINE int TileDim( int Resolution, int Tile )
+{
+    return Math::Min( TERRAIN_HEIGHTMAP_TILE_SIZE, Resolution - ( Tile << TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 ) );
+}
+
+static AN_FORCEINLINE uint32_t TileDataSize( int Width, int Height, bool bCompressed )
+{
+    return bCompressed ? 2 * sizeof( float ) + Width * Height * sizeof( uint16_t )
+                       : Width * Height * sizeof( float );
+}
+
+/** Maximum deviation of finer lod samples from bilinear reconstruction by coarser lod in the sample rect (inclusive) */
+static float CalcLodError( float const * fineLod, int fineResolution, float const * coarseLod, int coarseResolution, int MinX, int MinY, int MaxX, int MaxY )
+{
+    float error = 0;
+
+    for ( int y = MinY ; y <= MaxY ; y++ ) {
+        int cy = y >> 1;
+        int cy2 = cy + ( y & 1 );
+        for ( int x = MinX ; x <= MaxX ; x++ ) {
+            int cx = x >> 1;
+            int cx2 = cx + ( x & 1 );
+
+            float h = ( coarseLod[cy * coarseResolution + cx] + coarseLod[cy * coarseResolution + cx2]
+                      + coarseLod[cy2 * coarseResolution + cx] + coarseLod[cy2 * coarseResolution + cx2] ) * 0.25f;
+
+            error = Math::Max( error, Math::Abs( fineLod[y * fineResolution + x] - h ) );
+        }
+    }
+
+    return error;
+}
+
+static void DownsampleLod( float const * srcLod, int sz2, float * lod, int sz )
+{
+    float h1,h2,h3,h4;
+    int x, y;
+
+    for ( y = 0 ; y < sz - 1 ; y++ ) {
+        int src_y = y << 1;
+        for ( x = 0 ; x < sz - 1 ; x++ ) {
+            int src_x = x << 1;
+            h1 = srcLod[src_y * sz2 + src_x];
+            h2 = srcLod[src_y * sz2 + src_x + 1];
+            h3 = srcLod[(src_y + 1) * sz2 + src_x];
+            h4 = srcLod[(src_y + 1) * sz2 + src_x + 1];
+
+            lod[ y * sz + x ] = (h1+h2+h3+h4)*0.25f;
+        }
+
+        int src_x = x << 1;
+        h1 = srcLod[src_y * sz2 + src_x];
+        h2 = srcLod[(src_y + 1) * sz2 + src_x];
+        lod[y * sz + x] = (h1+h2)*0.5f;
+    }
+
+    int src_y = y << 1;
+    for ( x = 0 ; x < sz - 1 ; x++ ) {
+        int src_x = x << 1;
+        h1 = srcLod[src_y * sz2 + src_x];
+        h2 = srcLod[src_y * sz2 + src_x + 1];
+
+        lod[y * sz + x] = (h1+h2)*0.5f;
+    }
+
+    int src_x = x << 1;
+    lod[y * sz + x] = srcLod[src_y * sz2 + src_x];
+}
+
+ATerrainHeightmap::ATerrainHeightmap()
+    : bCompressed( false )
+    , Resolution( 0 )
+    , MinHeight( 0 )
+    , MaxHeight( 0 )
+    , Residency( nullptr )
+    , NumResidentTiles( 0 )
+    , CurrentFrame( 0 )
+    , PendingFreeFrame( 0 )
+{
+}
+
+ATerrainHeightmap::~ATerrainHeightmap()
+{
+    Close();
+}
+
+bool ATerrainHeightmap::Bake( float const * InHeightmap, int InResolution, const char * InFileName, bool bCompress )
+{
+    if ( InResolution < 2 || !IsPowerOfTwo( InResolution - 1 ) ) {
+        GLogger.Printf( "ATerrainHeightmap::Bake: heightmap resolution must be 2^n+1\n" );
+        return false;
+    }
+
+    const int numLods = Math::Log2( (uint32_t)(InResolution-1) ) + 1;
+
+    // Build mip pyramid
+    TPodVector< float * > mips;
+    mips.Resize( numLods );
+    mips[0] = const_cast< float * >( InHeightmap );
+    for ( int i = 1 ; i < numLods ; i++ ) {
+        int sz = ( 1 << (numLods - i - 1) ) + 1;
+        int sz2 = ( 1 << (numLods - i) ) + 1;
+
+        mips[i] = (float *)GHeapMemory.Alloc( sz*sz*sizeof( float ) );
+
+        DownsampleLod( mips[i - 1], sz2, mips[i], sz );
+    }
+
+    // Build tile table. Tile height range includes one extra row and column of samples
+    // so that it bounds all quads starting inside the tile. Geometric error is accumulated
+    // along the mip chain, so it bounds the deviation from the finest lod.
+    TPodVector< STerrainHeightmapTile > tiles;
+    int prevFirstTile = 0;
+    int prevNumTiles = 0;
+    uint64_t offset = 0;
+    float minHeight = 99999;
+    float maxHeight = -99999;
+    for ( int i = 0 ; i < numLods ; i++ ) {
+        int lodResolution = ( 1 << (numLods - i - 1) ) + 1;
+        int numTiles = NumTilesForResolution( lodResolution );
+        int firstTile = tiles.Size();
+        float const * lod = mips[i];
+
+        for ( int tileY = 0 ; tileY < numTiles ; tileY++ ) {
+            for ( int tileX = 0 ; tileX < numTiles ; tileX++ ) {
+                int x0 = tileX << TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+                int y0 = tileY << TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+                int x1 = Math::Min( x0 + TERRAIN_HEIGHTMAP_TILE_SIZE, lodResolution - 1 );
+                int y1 = Math::Min( y0 + TERRAIN_HEIGHTMAP_TILE_SIZE, lodResolution - 1 );
+
+                STerrainHeightmapTile & tile = tiles.Append();
+                tile.Offset = offset;
+                tile.Size = TileDataSize( TileDim( lodResolution, tileX ), TileDim( lodResolution, tileY ), bCompress );
+                tile.MinHeight = 99999;
+                tile.MaxHeight = -99999;
+                for ( int y = y0 ; y <= y1 ; y++ ) {
+                    for ( int x = x0 ; x <= x1 ; x++ ) {
+                        float h = lod[y * lodResolution + x];
+                        tile.MinHeight = Math::Min( tile.MinHeight, h );
+                        tile.MaxHeight = Math::Max( tile.MaxHeight, h );
+                    }
+                }
+
+                tile.GeometricError = 0;
+                if ( i > 0 ) {
+                    int fineResolution = ( lodResolution - 1 ) * 2 + 1;
+
+                    float childError = 0;
+                    for ( int childY = tileY * 2 ; childY < Math::Min( tileY * 2 + 2, prevNumTiles ) ; childY++ ) {
+                        for ( int childX = tileX * 2 ; childX < Math::Min( tileX * 2 + 2, prevNumTiles ) ; childX++ ) {
+                            childError = Math::Max( childError, tiles[prevFirstTile + childY * prevNumTiles + childX].GeometricError );
+                        }
+                    }
+
+                    tile.GeometricError = childError + CalcLodError( mips[i - 1], fineResolution, lod, lodResolution,
+                                                                     x0 * 2, y0 * 2,
+                                                                     Math::Min( x1 * 2, fineResolution - 1 ), Math::Min( y1 * 2, fineResolution - 1 ) );
+                }
+
+                offset += tile.Size;
+            }
+        }
+
+        prevFirstTile = firstTile;
+        prevNumTiles = numTiles;
+
+        if ( i == 0 ) {
+            for ( int n = 0 ; n < lodResolution*lodResolution ; n++ ) {
+                minHeight = Math::Min( minHeight, lod[n] );
+                maxHeight = Math::Max( maxHeight, lod[n] );
+            }
+        }
+    }
+
+    AFileStream f;
+    bool bResult = f.OpenWrite( InFileName );
+    if ( bResult ) {
+        const uint64_t headerSize = 9 * sizeof( uint32_t ) + tiles.Size() * ( sizeof( uint64_t ) + 4 * sizeof( uint32_t ) );
+
+        f.WriteUInt32( HEIGHTMAP_FILE_MAGIC );
+        f.WriteUInt32( HEIGHTMAP_FILE_VERSION );
+        f.WriteUInt32( InResolution );
+        f.WriteUInt32( numLods );
+        f.WriteUInt32( TERRAIN_HEIGHTMAP_TILE_SIZE );
+        f.WriteUInt32( bCompress );
+        f.WriteFloat( minHeight );
+        f.WriteFloat( maxHeight );
+        f.WriteUInt32( tiles.Size() );
+        for ( STerrainHeightmapTile const & tile : tiles ) {
+            f.WriteUInt64( headerSize + tile.Offset );
+            f.WriteUInt32( tile.Size );
+            f.WriteFloat( tile.MinHeight );
+            f.WriteFloat( tile.MaxHeight );
+            f.WriteFloat( tile.GeometricError );
+        }
+
+        TPodVector< byte > buffer;
+        buffer.Resize( TileDataSize( TERRAIN_HEIGHTMAP_TILE_SIZE, TERRAIN_HEIGHTMAP_TILE_SIZE, false ) );
+
+        STerrainHeightmapTile const * tile = tiles.ToPtr();
+        for ( int i = 0 ; i < numLods ; i++ ) {
+            int lodResolution = ( 1 << (numLods - i - 1) ) + 1;
+            int numTiles = NumTilesForResolution( lodResolution );
+            float const * lod = mips[i];
+
+            for ( int tileY = 0 ; tileY < numTiles ; tileY++ ) {
+                for ( int tileX = 0 ; tileX < numTiles ; tileX++, tile++ ) {
+                    int w = TileDim( lodResolution, tileX );
+                    int h = TileDim( lodResolution, tileY );
+                    float const * src = lod + ( tileY << TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 ) * lodResolution + ( tileX << TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 );
+
+                    if ( bCompress ) {
+                        float range = tile->MaxHeight - tile->MinHeight;
+                        float scale = range > 0.0f ? range / 65535.0f : 0.0f;
+                        float invScale = range > 0.0f ? 65535.0f / range : 0.0f;
+
+                        float * header = (float *)buffer.ToPtr();
+                        header[0] = Core::LittleFloat( tile->MinHeight );
+                        header[1] = Core::LittleFloat( scale );
+
+                        uint16_t * dst = (uint16_t *)( header + 2 );
+                        for ( int y = 0 ; y < h ; y++ ) {
+                            for ( int x = 0 ; x < w ; x++ ) {
+                                float q = ( src[y * lodResolution + x] - tile->MinHeight ) * invScale + 0.5f;
+                                *dst++ = Core::LittleWord( (uint16_t)Math::Clamp( q, 0.0f, 65535.0f ) );
+                            }
+                        }
+                    } else {
+                        float * dst = (float *)buffer.ToPtr();
+                        for ( int y = 0 ; y < h ; y++ ) {
+                            for ( int x = 0 ; x < w ; x++ ) {
+                                *dst++ = Core::LittleFloat( src[y * lodResolution + x] );
+                            }
+                        }
+                    }
+
+                    f.WriteBuffer( buffer.ToPtr(), tile->Size );
+                }
+            }
+        }
+    } else {
+        GLogger.Printf( "ATerrainHeightmap::Bake: couldn't write %s\n", InFileName );
+    }
+
+    for ( int i = 1 ; i < numLods ; i++ ) {
+        GHeapMemory.Free( mips[i] );
+    }
+
+    return bResult;
+}
+
+bool ATerrainHeightmap::Open( const char * InFileName )
+{
+    Close();
+
+    if ( !File.OpenRead( InFileName ) ) {
+        return false;
+    }
+
+    uint32_t magic = File.ReadUInt32();
+    uint32_t version = File.ReadUInt32();
+    if ( magic != HEIGHTMAP_FILE_MAGIC || version != HEIGHTMAP_FILE_VERSION ) {
+        GLogger.Printf( "ATerrainHeightmap::Open: %s has unexpected format or version\n", InFileName );
+        File.Close();
+        return false;
+    }
+
+    Resolution = File.ReadUInt32();
+    int numLods = File.ReadUInt32();
+    int tileSize = File.ReadUInt32();
+    bCompressed = !!File.ReadUInt32();
+    MinHeight = File.ReadFloat();
+    MaxHeight = File.ReadFloat();
+    int numTiles = File.ReadUInt32();
+
+    if ( tileSize != TERRAIN_HEIGHTMAP_TILE_SIZE || Resolution < 2 || !IsPowerOfTwo( Resolution - 1 ) || numLods != Math::Log2( (uint32_t)(Resolution-1) ) + 1 ) {
+        GLogger.Printf( "ATerrainHeightmap::Open: %s has invalid header\n", InFileName );
+        File.Close();
+        return false;
+    }
+
+    int firstTile = 0;
+    Lods.Resize( numLods );
+    for ( int i = 0 ; i < numLods ; i++ ) {
+        SLod & lod = Lods[i];
+        lod.Resolution = ( 1 << (numLods - i - 1) ) + 1;
+        lod.NumTiles = NumTilesForResolution( lod.Resolution );
+        lod.FirstTile = firstTile;
+        firstTile += lod.NumTiles * lod.NumTiles;
+    }
+
+    if ( firstTile != numTiles ) {
+        GLogger.Printf( "ATerrainHeightmap::Open: %s has invalid tile table\n", InFileName );
+        Lods.Clear();
+        File.Close();
+        return false;
+    }
+
+    Tiles.Resize( numTiles );
+    for ( STerrainHeightmapTile & tile : Tiles ) {
+        tile.Offset = File.ReadUInt64();
+        tile.Size = File.ReadUInt32();
+        tile.MinHeight = File.ReadFloat();
+        tile.MaxHeight = File.ReadFloat();
+        tile.GeometricError = File.ReadFloat();
+    }
+
+    Residency = new STileResidency[numTiles];
+    for ( int i = 0 ; i < numTiles ; i++ ) {
+        Residency[i].Data.StoreRelaxed( nullptr );
+        Residency[i].LastUse.StoreRelaxed( -1 );
+    }
+
+    return true;
+}
+
+void ATerrainHeightmap::Close()
+{
+    for ( int tileIndex : ResidentTiles ) {
+        GHeapMemory.Free( Residency[tileIndex].Data.LoadRelaxed() );
+    }
+    ResidentTiles.Clear();
+    NumResidentTiles.StoreRelaxed( 0 );
+
+    for ( float * data : PendingFree ) {
+        GHeapMemory.Free( data );
+    }
+    PendingFree.Clear();
+
+    delete [] Residency;
+    Residency = nullptr;
+
+    Tiles.Free();
+    Lods.Clear();
+    ReadBuffer.Free();
+    File.Close();
+}
+
+float const * ATerrainHeightmap::LoadTile( int TileIndex ) const
+{
+    TLockGuard< AMutex > lockGuard( FileLock );
+
+    STileResidency & residency = Residency[TileIndex];
+
+    // Other thread may load the tile while we were waiting for the lock
+    float * data = residency.Data.LoadRelaxed();
+    if ( data ) {
+        return data;
+    }
+
+    int lodIndex = Lods.Size() - 1;
+    while ( Lods[lodIndex].FirstTile > TileIndex ) {
+        lodIndex--;
+    }
+    SLod const & lod = Lods[lodIndex];
+    int tileY = ( TileIndex - lod.FirstTile ) / lod.NumTiles;
+    int tileX = ( TileIndex - lod.FirstTile ) - tileY * lod.NumTiles;
+    int w = TileDim( lod.Resolution, tileX );
+    int h = TileDim( lod.Resolution, tileY );
+
+    STerrainHeightmapTile const & tile = Tiles[TileIndex];
+
+    data = (float *)GHeapMemory.Alloc( TileBytes );
+
+    ReadBuffer.ResizeInvalidate( tile.Size );
+
+    File.SeekSet( tile.Offset );
+    File.ReadBuffer( ReadBuffer.ToPtr(), tile.Size );
+
+    if ( File.GetReadBytesCount() != (int)tile.Size || tile.Size != TileDataSize( w, h, bCompressed ) ) {
+        GLogger.Printf( "ATerrainHeightmap: failed to read tile %d\n", TileIndex );
+        for ( int i = 0 ; i < TERRAIN_HEIGHTMAP_TILE_SIZE * TERRAIN_HEIGHTMAP_TILE_SIZE ; i++ ) {
+            data[i] = tile.MinHeight;
+        }
+    } else if ( bCompressed ) {
+        float const * header = (float const *)ReadBuffer.ToPtr();
+        float minHeight = Core::LittleFloat( header[0] );
+        float scale = Core::LittleFloat( header[1] );
+        uint16_t const * src = (uint16_t const *)( header + 2 );
+        for ( int y = 0 ; y < h ; y++ ) {
+            float * dst = data + y * TERRAIN_HEIGHTMAP_TILE_SIZE;
+            for ( int x = 0 ; x < w ; x++ ) {
+                dst[x] = minHeight + Core::LittleWord( *src++ ) * scale;
+            }
+        }
+    } else {
+        float const * src = (float const *)ReadBuffer.ToPtr();
+        for ( int y = 0 ; y < h ; y++ ) {
+            float * dst = data + y * TERRAIN_HEIGHTMAP_TILE_SIZE;
+            for ( int x = 0 ; x < w ; x++ ) {
+                dst[x] = Core::LittleFloat( *src++ );
+            }
+        }
+    }
+
+    residency.LastUse.StoreRelaxed( CurrentFrame.LoadRelaxed() );
+    residency.Data.Store( data );
+
+    ResidentTiles.Append( TileIndex );
+    NumResidentTiles.Increment();
+
+    return data;
+}
+
+void ATerrainHeightmap::SampleRow( int Lod, int X, int Y, int Count, float * Heights ) const
+{
+    SLod const & lod = Lods[Lod];
+    const int last = lod.Resolution - 1;
+
+    Y = Math::Clamp( Y, 0, last );
+
+    const int tileRow = lod.FirstTile + ( Y >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 ) * lod.NumTiles;
+    const int rowOffset = ( Y & (TERRAIN_HEIGHTMAP_TILE_SIZE-1) ) * TERRAIN_HEIGHTMAP_TILE_SIZE;
+
+    int i = 0;
+
+    if ( X < 0 ) {
+        float h = GetTile( tileRow )[rowOffset];
+        for ( int n = Math::Min( -X, Count ) ; i < n ; i++ ) {
+            Heights[i] = h;
+        }
+    }
+
+    // Copy contiguous segments tile by tile
+    while ( i < Count && X + i <= last ) {
+        int x = X + i;
+        int tileX = x & (TERRAIN_HEIGHTMAP_TILE_SIZE-1);
+        int n = Math::Min( Math::Min( TERRAIN_HEIGHTMAP_TILE_SIZE - tileX, last - x + 1 ), Count - i );
+
+        float const * data = GetTile( tileRow + ( x >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 ) );
+
+        Core::Memcpy( Heights + i, data + rowOffset + tileX, n * sizeof( float ) );
+        i += n;
+    }
+
+    if ( i < Count ) {
+        float h = GetTile( tileRow + ( last >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 ) )[rowOffset + ( last & (TERRAIN_HEIGHTMAP_TILE_SIZE-1) )];
+        for ( ; i < Count ; i++ ) {
+            Heights[i] = h;
+        }
+    }
+}
+
+void ATerrainHeightmap::MakeResident( int Lod, int MinX, int MinY, int MaxX, int MaxY ) const
+{
+    SLod const & lod = Lods[Lod];
+
+    MinX = Math::Clamp( MinX, 0, lod.Resolution - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+    MinY = Math::Clamp( MinY, 0, lod.Resolution - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+    MaxX = Math::Clamp( MaxX, 0, lod.Resolution - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+    MaxY = Math::Clamp( MaxY, 0, lod.Resolution - 1 ) >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2;
+
+    for ( int tileY = MinY ; tileY <= MaxY ; tileY++ ) {
+        for ( int tileX = MinX ; tileX <= MaxX ; tileX++ ) {
+            GetTile( lod.FirstTile + tileY * lod.NumTiles + tileX );
+        }
+    }
+}
+
+void ATerrainHeightmap::UpdateResidency( int FrameNumber, size_t MaxResidentBytes )
+{
+    // Tiles evicted in previous frames are not accessed anymore
+    if ( PendingFreeFrame != FrameNumber ) {
+        for ( float * data : PendingFree ) {
+            GHeapMemory.Free( data );
+        }
+        PendingFree.Clear();
+    }
+
+    CurrentFrame.StoreRelaxed( FrameNumber );
+
+    // Samplers may load tiles concurrently
+    TLockGuard< AMutex > lockGuard( FileLock );
+
+    size_t residentBytes = ResidentTiles.Size() * TileBytes;
+    if ( residentBytes <= MaxResidentBytes ) {
+        return;
+    }
+
+    // Least recently used first
+    StdSort( ResidentTiles.Begin(), ResidentTiles.End(), [this]( int a, int b )
+    {
+        return Residency[a].LastUse.LoadRelaxed() < Residency[b].LastUse.LoadRelaxed();
+    } );
+
+    int numEvicted = 0;
+    for ( int tileIndex : ResidentTiles ) {
+        if ( residentBytes <= MaxResidentBytes ) {
+            break;
+        }
+
+        STileResidency & residency = Residency[tileIndex];
+        if ( residency.LastUse.LoadRelaxed() == FrameNumber ) {
+            break;
+        }
+
+        // Samplers may still read the tile, free it in the next frame
+        PendingFree.Append( residency.Data.LoadRelaxed() );
+        PendingFreeFrame = FrameNumber;
+        residency.Data.StoreRelaxed( nullptr );
+
+        residentBytes -= TileBytes;
+        numEvicted++;
+    }
+
+    if ( numEvicted > 0 ) {
+        ResidentTiles.Remove( 0, numEvicted );
+        NumResidentTiles.Sub( numEvicted );
+    }
+}
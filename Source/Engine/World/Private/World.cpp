@@ -41,6 +41,7 @@ SOFTWARE.
 #include <Core/Public/IntrusiveLinkedListMacro.h>
 
 #include <Runtime/Public/Runtime.h>
+#include <Runtime/Public/Profiler.h>
 
 AN_CLASS_META( AWorld )
 
@@ -559,6 +560,8 @@ void AWorld::UpdateSkinning()
 
 void AWorld::Tick( float _TimeStep )
 {
+    AN_PROFILER_SCOPE( "AWorld::Tick" );
+
     GameRunningTimeMicro = GameRunningTimeMicroAfterTick;
     GameplayTimeMicro = GameplayTimeMicroAfterTick;
 
@@ -612,6 +615,18 @@ bool AWorld::RaycastClosestBounds( SBoxHitResult & _Result, Float3 const & _RayS
     return vsd.RaycastClosestBounds( const_cast< AWorld * >( this ), _Result, _RayStart, _RayEnd, _Filter );
 }
 
+int AWorld::RaycastClosestBatch( SWorldRaycastClosestResult * _Results, bool * _Hits, SWorldRay const * _Rays, int _NumRays, SWorldRaycastFilter const * _Filter ) const
+{
+    AVSD & vsd = const_cast< AVSD & >(Vsd);
+    return vsd.RaycastClosestBatch( const_cast< AWorld * >( this ), _Results, _Hits, _Rays, _NumRays, _Filter );
+}
+
+int AWorld::RaycastClosestBoundsBatch( SBoxHitResult * _Results, bool * _Hits, SWorldRay const * _Rays, int _NumRays, SWorldRaycastFilter const * _Filter ) const
+{
+    AVSD & vsd = const_cast< AVSD & >(Vsd);
+    return vsd.RaycastClosestBoundsBatch( const_cast< AWorld * >( this ), _Results, _Hits, _Rays, _NumRays, _Filter );
+}
+
 void AWorld::QueryVisiblePrimitives( TPodVector< SPrimitiveDef * > & VisPrimitives, TPodVector< SSurfaceDef * > & VisSurfs, int * VisPass, SVisibilityQuery const & InQuery )
 {
     AVSD & vsd = const_cast< AVSD & >(Vsd);
@@ -40,6 +40,7 @@ SOFTWARE.
 #include <unordered_map>
 
 class AInputMappings;
+class AStaticDrawCache;
 
 class ARenderingParameters : public ABaseObject {
     AN_CLASS( ARenderingParameters, ABaseObject )
@@ -61,6 +62,9 @@ public:
 
     std::unordered_map< uint64_t, ATerrainView * > TerrainViews; // TODO: Needs to be cleaned from time to time
 
+    /** Render instances of non-movable static meshes. Managed by render frontend. */
+    TUniqueRef< AStaticDrawCache > StaticDrawCache;
+
     // TODO: TonemappingExposure, bTonemappingAutoExposure, TonemappingMethod:Disabled,Reinhard,Uncharted,etc
     // TODO: Wireframe color/line width
     // TODO: bBloomEnabled, BloomParams[4]
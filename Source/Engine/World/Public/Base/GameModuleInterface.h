@@ -70,4 +70,6 @@ public:
 private:
     void Quit( ARuntimeCommandProcessor const & _Proc );
     void RebuildMaterials( ARuntimeCommandProcessor const & _Proc );
+    void MemoryReport( ARuntimeCommandProcessor const & _Proc );
+    void ProfilerDump( ARuntimeCommandProcessor const & _Proc );
 };
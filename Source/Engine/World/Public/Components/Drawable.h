@@ -109,6 +109,15 @@ public:
 
     bool IsOutdoor() const;
 
+    /** Drawables with MB_STATIC motion behavior (except skinned meshes) are non-movable: they are culled with
+    the area BVH and their draw data is cached by the render frontend. Non-movable drawable still can be moved,
+    but every move refits the BVH and invalidates the cached draw data. */
+    bool IsMovable() const;
+
+    /** Incremented when transform, movable flag, mesh or materials of the drawable are changed.
+    Render frontend uses it to invalidate cached draw data. */
+    uint32_t GetRenderRevision() const { return RenderRevision; }
+
     /** Get overrided bounding box in local space */
     BvAxisAlignedBox const & GetBoundsOverride() const { return OverrideBoundingBox; }
 
@@ -149,12 +158,19 @@ protected:
     void InitializeComponent() override;
     void DeinitializeComponent() override;
     void OnTransformDirty() override;
+    void OnMotionBehaviorChanged() override;
 
     void UpdateWorldBounds();
 
+    /** Update non-movable flag of the primitive from motion behavior */
+    void UpdateMovable();
+
     /** Override to dynamic update mesh data */
     virtual void OnPreRenderUpdate( SRenderFrontendDef const * _Def ) {}
 
+    /** Invalidate cached draw data of the drawable */
+    void MarkRenderDirty() { RenderRevision++; }
+
     EDrawableType DrawableType = DRAWABLE_UNKNOWN;
 
     ADrawable * NextShadowCaster = nullptr;
@@ -164,6 +180,8 @@ protected:
 
     int VisFrame = -1;
 
+    uint32_t RenderRevision = 0;
+
     mutable BvAxisAlignedBox Bounds;
     mutable BvAxisAlignedBox WorldBounds;
     BvAxisAlignedBox OverrideBoundingBox;
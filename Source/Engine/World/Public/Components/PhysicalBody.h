@@ -343,6 +343,9 @@ protected:
 
     void UpdatePhysicsAttribs();
 
+    /** Called when motion behavior was changed */
+    virtual void OnMotionBehaviorChanged() {}
+
     void DrawDebug( ADebugRenderer * InRenderer ) override;
 
     virtual ACollisionModel const * GetMeshCollisionModel() const { return nullptr; }
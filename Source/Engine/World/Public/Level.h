@@ -52,6 +52,7 @@ struct SVisArea;
 struct SPrimitiveDef;
 struct SPortalLink;
 struct SPrimitiveLink;
+class APrimitiveBVH;
 
 enum VSD_PRIMITIVE
 {
@@ -186,7 +187,11 @@ enum ESurfaceFlags : uint8_t
     SURF_TWOSIDED = AN_BIT(1),
 
     /** Planar tow sided surface */
-    SURF_PLANAR_TWOSIDED_MASK = SURF_PLANAR | SURF_TWOSIDED
+    SURF_PLANAR_TWOSIDED_MASK = SURF_PLANAR | SURF_TWOSIDED,
+
+    /** Surface is used as occluder by software occlusion culling.
+    For primitives the bounding box is rasterized, so it must be inside of the visible geometry. */
+    SURF_OCCLUDER = AN_BIT(2)
 };
 
 struct SSurfaceDef
@@ -349,6 +354,9 @@ struct SPrimitiveDef
 
     /** Is primitive pending to remove from level */
     bool bPendingRemove : 1;
+
+    /** Primitive is non-movable. Non-movable primitives are culled by the area BVH. */
+    bool bNonMovable : 1;
 };
 
 struct SPrimitiveLink
@@ -419,11 +427,20 @@ struct SVisArea
     /** Movable primitives inside the area */
     SPrimitiveLink * Links;
 
-    /** Non-movable primitives if AABB tree is not present */
-    //SPrimitiveLink * NonMovableLinks;
+    /** Non-movable primitives inside the area */
+    SPrimitiveLink * NonMovableLinks;
 
     /** AABB tree for non-movable primitives */
-    //ATreeAABB * AABBTree;
+    APrimitiveBVH * PrimitiveBVH;
+
+    /** Count of the non-movable primitives */
+    int NumNonMovable;
+
+    /** Checksum of the non-movable primitive set. Used to decide between refit and rebuild of the tree. */
+    uint64_t NonMovableChecksum;
+
+    /** Non-movable primitives were changed, tree must be updated */
+    bool bNonMovableDirty;
 
     /** Baked surfaces attached to the area */
     int FirstSurface;
@@ -476,6 +493,12 @@ public:
     /** Lighting data will be used from that level. */
     TWeakRef< ALevel > ParentLevel;
 
+    /** Mark surfaces that are used as occluders by software occlusion culling. Surface is an occluder candidate
+    if it is opaque, its area is not less than InMinArea and it has at most InMaxTriangles triangles.
+    Translucent and alpha masked surfaces don't occlude. Only InMaxOccluders largest candidates are marked.
+    Returns number of occluders. */
+    int MarkOccluders( float InMinArea, int InMaxTriangles, int InMaxOccluders );
+
     void Purge();
 
 protected:
@@ -721,6 +744,17 @@ private:
 
     void AddPrimitiveToArea( SVisArea * Area, SPrimitiveDef * Primitive );
 
+    void MarkAreaDirty( SVisArea * InArea );
+
+    /** Refit or rebuild dirty area trees */
+    void UpdateAreaTrees();
+
+    /** Free the tree of the area */
+    void FreeAreaTree( SVisArea * InArea );
+
+    /** Destroy area trees */
+    void PurgeAreaTrees();
+
     /** Parent world */
     AWorld * OwnerWorld = nullptr;
 
@@ -742,6 +776,9 @@ private:
     /** Array of actors */
     TPodVector< AActor * > Actors;
 
+    /** Areas with changed non-movable primitives */
+    TPodVector< SVisArea * > DirtyAreas;
+
     BvAxisAlignedBox IndoorBounds;
 
     TPodVector< ALightmapUV * > LightmapUVs;
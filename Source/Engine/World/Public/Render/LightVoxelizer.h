@@ -93,35 +93,73 @@ struct SItemInfo
     uint8_t Type;
 };
 
+/** Cluster overflow accounting for the last voxelized view */
+struct SLightVoxelizerStat
+{
+    /** Clusters that received more items than the grid item capacity */
+    int OverflowClusters;
+
+    /** Items dropped by clusters overflow */
+    int DroppedItems;
+
+    /** Items dropped because MAX_TOTAL_CLUSTER_ITEMS was hit */
+    int DroppedPackedItems;
+
+    /** Max number of lights, decals or probes touching a single cluster (before clamping) */
+    int MaxClusterItems;
+};
+
 class ALightVoxelizer {
 public:
+    ALightVoxelizer();
+
     void Reset();
 
     bool IsSSE() const { return bUseSSE; };
 
+    bool IsAVX2() const { return bUseAVX2; }
+
     SItemInfo * AllocItem() {
         AN_ASSERT( ItemsCount < MAX_ITEMS );
         return &ItemInfos[ItemsCount++];
     }
 
+    /** Grid used by the next Voxelize call. Updated by Reset. */
+    SClusterGrid const & GetGrid() const { return Grid; }
+
+    /** Overflow statistics of the last Voxelize call */
+    SLightVoxelizerStat const & GetStat() const { return Stat; }
+
     void Voxelize( SRenderView * RV );
 
+    /** Voxelize items to user memory. Headers must hold GetGrid().GetNumClusters() elements,
+    PackedIndices must hold MAX_TOTAL_CLUSTER_ITEMS elements. Returns number of packed indices. */
+    int Voxelize( Float4x4 const & InViewProj, Float4x4 const & InViewProjInv, SClusterHeader * Headers, SClusterPackedIndex * PackedIndices );
+
     void DrawVoxels( ADebugRenderer * InRenderer );
 
 private:
-    static void VoxelizeWork( void * _Data );
+    static void VoxelizeWork( int _FirstSlice, int _LastSlice, void * _Data );
 
     void VoxelizeWork( int SliceIndex );
 
+    void VoxelizeSliceAVX2( int SliceIndex );
+
     void TransformItemsSSE();
+    void TransformItemsAVX2();
     void TransformItemsGeneric();
 
+    void SetItemClusterRange( SItemInfo & Info, Float3 const & Mins, Float3 const & Maxs );
+
     void GatherVoxelGeometry( TStdVectorHeap< Float3 > & LinePoints, Float4x4 const & ViewProjectionInversed );
 
     SItemInfo ItemInfos[MAX_ITEMS];
     int ItemsCount;
 
-    unsigned short Items[MAX_FRUSTUM_CLUSTERS_Z][MAX_FRUSTUM_CLUSTERS_Y][MAX_FRUSTUM_CLUSTERS_X][MAX_CLUSTER_ITEMS * 3]; // TODO: optimize size!!! 4 MB
+    SClusterGrid Grid;
+
+    /** Per-cluster item lists: lights, decals and probes, Grid.ItemCapacity for each */
+    TPodVector< unsigned short, 32, 32, AHeapAllocator<16> > Items;
     AAtomicInt ItemCounter;
     Float4x4 ViewProj;
     Float4x4 ViewProjInv;
@@ -132,12 +170,16 @@ private:
         unsigned short ProbesCount;
     };
 
-    alignas(16) SFrustumCluster ClusterData[MAX_FRUSTUM_CLUSTERS_Z][MAX_FRUSTUM_CLUSTERS_Y][MAX_FRUSTUM_CLUSTERS_X];
+    TPodVector< SFrustumCluster, 32, 32, AHeapAllocator<16> > ClusterData;
 
     SClusterHeader * pClusterHeaderData;
     SClusterPackedIndex * pClusterPackedIndices;
 
+    SLightVoxelizerStat SliceStat[MAX_FRUSTUM_CLUSTERS_Z];
+    SLightVoxelizerStat Stat;
+
     TStdVectorHeap< Float3 > DebugLinePoints;
 
     bool bUseSSE;
+    bool bUseAVX2;
 };
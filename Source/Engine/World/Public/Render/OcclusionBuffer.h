@@ -0,0 +1,144 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Core/Public/CoreMath.h>
+#include <Core/Public/BV/BvAxisAlignedBox.h>
+#include <Core/Public/PodVector.h>
+
+class AAsyncJobList;
+
+/**
+
+AOcclusionBuffer
+
+Software occlusion culling. Occluder triangles are rasterized on the CPU into a low resolution
+depth buffer, then the buffer is reduced to a hierarchical Z pyramid and bounding boxes are
+tested against it.
+
+Triangles are transformed, clipped and binned to horizontal screen bands when they are added.
+The bands are rasterized by BuildHiZ, in parallel if a job list is given: each band owns its rows
+of the depth buffer, so no synchronization is required.
+
+The buffer stores reversed clip space depth (Z/W, 1 is near, 0 is far) that is used by the
+engine projection matrices. Each pyramid texel keeps the farthest depth of the texels below.
+
+The class does not depend on the renderer, so it can be used headless.
+
+Example:
+
+occlusionBuffer.Clear( viewProjection );
+occlusionBuffer.RasterizeTriangles( vertices, sizeof( SMeshVertex ), indices, numIndices );
+occlusionBuffer.BuildHiZ( jobList );
+bool bVisible = occlusionBuffer.IsBoxVisible( bounds );
+
+*/
+class AOcclusionBuffer
+{
+    AN_FORBID_COPY( AOcclusionBuffer )
+
+public:
+    /** Buffer resolution. Width must be multiple of 4 */
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 128;
+    static constexpr int NUM_LODS = 9;
+
+    /** Height of the screen band. Bands are rasterized independently. */
+    static constexpr int BIN_HEIGHT = 16;
+    static constexpr int NUM_BINS = HEIGHT / BIN_HEIGHT;
+
+    AOcclusionBuffer();
+
+    /** Clear depth and set view projection matrix */
+    void Clear( Float4x4 const & _ViewProjection );
+
+    /** Add indexed triangles. Vertex position (Float3 in world space) must be at the beginning of the vertex. */
+    void RasterizeTriangles( void const * _Vertices, int _VertexStride, unsigned int const * _Indices, int _NumIndices );
+
+    /** Add solid box */
+    void RasterizeBox( BvAxisAlignedBox const & _Box );
+
+    /** Rasterize added triangles and build hierarchical Z pyramid. Must be called before visibility tests.
+    Screen bands are rasterized by the jobs if _JobList is not null. The jobs are submitted and waited here. */
+    void BuildHiZ( AAsyncJobList * _JobList = nullptr );
+
+    /** Test box against hierarchical Z. Returns false if the box is completely hidden by occluders. */
+    bool IsBoxVisible( BvAxisAlignedBox const & _Box ) const;
+
+    /** Number of triangles that passed clipping since last Clear */
+    int GetNumRasterizedTriangles() const { return NumRasterizedTriangles; }
+
+    /** Depth of the LOD (0 is full resolution) */
+    float const * GetDepth( int _Lod ) const { return Lods[_Lod]; }
+
+    int GetLodWidth( int _Lod ) const { return Math::Max( WIDTH >> _Lod, 1 ); }
+
+    int GetLodHeight( int _Lod ) const { return Math::Max( HEIGHT >> _Lod, 1 ); }
+
+private:
+    /** Triangle in screen space with counter clockwise winding */
+    struct SScreenTriangle
+    {
+        Float3 V[3];
+        int MinX;
+        int MaxX;
+        int MinY;
+        int MaxY;
+    };
+
+    struct SBinJob
+    {
+        AOcclusionBuffer * Self;
+        int Bin;
+    };
+
+    void ClipAndAdd( Float3 const & _V0, Float3 const & _V1, Float3 const & _V2 );
+    void AddTriangle( Float3 const & _V0, Float3 const & _V1, Float3 const & _V2 );
+    void RasterizeBin( int _Bin );
+    void RasterizeTriangle( SScreenTriangle const & _Triangle, int _MinY, int _MaxY );
+    static void RasterizeBinAsync( void * _Data );
+
+    Float4x4 ViewProjection;
+
+    /** Storage of all LODs */
+    TPodVector< float, 32, 32, AHeapAllocator<16> > Storage;
+
+    float * Lods[NUM_LODS];
+
+    TPodVector< SScreenTriangle > Triangles;
+
+    /** Indices of the triangles that overlap the band */
+    TPodVector< int > BinTriangles[NUM_BINS];
+
+    SBinJob BinJobs[NUM_BINS];
+
+    int NumRasterizedTriangles;
+};
@@ -0,0 +1,120 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Core/Public/PodVector.h>
+#include <Core/Public/BV/BvAxisAlignedBox.h>
+#include <Core/Public/Plane.h>
+
+struct SPrimitiveDef;
+struct SPrimitiveLink;
+
+/**
+
+APrimitiveBVH
+
+Bounding volume hierarchy for non-movable primitives of the area.
+
+The tree is built with binned SAH and stored in depth-first order: the left child follows
+its parent, so primitives of any subtree are contiguous. This allows to accept whole subtree
+at once when its bounds are completely inside the frustum.
+
+When non-movable primitives are moved without changing the set of primitives, the tree is
+refitted instead of rebuilt.
+
+*/
+class APrimitiveBVH
+{
+    AN_FORBID_COPY( APrimitiveBVH )
+
+public:
+    /** Max primitives in leaf */
+    static constexpr int MAX_LEAF_PRIMITIVES = 4;
+
+    APrimitiveBVH() {}
+
+    /** Build the tree for the list of primitive links (linked by NextInArea) */
+    void Build( SPrimitiveLink const * InLinks, int InNumPrimitives, uint64_t InChecksum );
+
+    /** Update node bounds after primitives were moved. Returns false if the tree quality is degraded and it should be rebuilt. */
+    bool Refit();
+
+    /** Free the tree */
+    void Purge();
+
+    /** Returns true if the tree was built for the same set of primitives */
+    bool IsBuiltFor( int InNumPrimitives, uint64_t InChecksum ) const
+    {
+        return NumPrimitives == InNumPrimitives && Checksum == InChecksum;
+    }
+
+    /** Hierarchical frustum culling. Appends primitives intersecting the frustum. */
+    void CullFrustum( PlaneF const * InCullPlanes, const int InCullPlanesCount, TPodVector< SPrimitiveDef * > & OutPrimitives ) const;
+
+    /** Tree bounds */
+    BvAxisAlignedBox const & GetBounds() const;
+
+    bool IsEmpty() const { return Nodes.IsEmpty(); }
+
+    int GetPrimitiveCount() const { return NumPrimitives; }
+
+private:
+    struct SNode
+    {
+        BvAxisAlignedBox Bounds;
+
+        /** First primitive of the subtree */
+        int FirstPrimitive;
+
+        /** Number of primitives in the subtree */
+        int NumPrimitives;
+
+        /** Index of the right child. Zero for the leafs. Left child is next to the node. */
+        int RightChild;
+    };
+
+    struct SBuildPrimitive
+    {
+        BvAxisAlignedBox Bounds;
+        Float3 Centroid;
+        SPrimitiveDef * Primitive;
+    };
+
+    int BuildRecursive( int InFirst, int InCount );
+
+    TPodVector< SNode > Nodes;
+    TPodVector< SPrimitiveDef * > Primitives;
+    TPodVector< SBuildPrimitive > BuildPrimitives;
+
+    int NumPrimitives = 0;
+    uint64_t Checksum = 0;
+    float BuildRootArea = 0;
+};
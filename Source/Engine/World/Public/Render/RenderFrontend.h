@@ -37,6 +37,7 @@ SOFTWARE.
 #include <World/Public/World.h>
 #include <World/Public/Terrain.h>
 #include <World/Public/Render/LightVoxelizer.h>
+#include <World/Public/Render/StaticDrawCache.h>
 
 class AAnalyticLightComponent;
 class AIBLComponent;
@@ -48,6 +49,9 @@ struct SRenderFrontendStat {
     int PolyCount;
     int ShadowMapPolyCount;
     int FrontendTime;
+    /** Visible lights and probes dropped by r_MaxLights/r_MaxProbes budgets */
+    int CulledLights;
+    int CulledProbes;
 };
 
 class ARenderFrontend : public ABaseObject
@@ -68,16 +72,21 @@ public:
 private:
     void RenderCanvas( ACanvas * InCanvas );
     void RenderView( int _Index );
+    void MergeInstances( SRenderView * InView );
 
     void QueryVisiblePrimitives( AWorld * InWorld );
     void QueryShadowCasters( AWorld * InWorld, Float4x4 const & LightViewProjection, Float3 const & LightPosition, Float3x3 const & LightBasis,
                              TPodVector< SPrimitiveDef * > & Primitives, TPodVector< SSurfaceDef * > & Surfaces );
     void AddRenderInstances( AWorld * InWorld );
-    void AddDrawable( ADrawable * InComponent );
+    int PrepareDrawable( ADrawable * InComponent );
+    void AddDrawableInstances( int InNumInstances );
+    void UpdateStaticDrawCache( SRenderInstance const * Instances );
+    bool AddDrawable( ADrawable * InComponent, SRenderInstance * Instances, uint8_t * Lists );
     void AddTerrain( ATerrainComponent * InComponent );
-    void AddStaticMesh( AMeshComponent * InComponent );
-    void AddSkinnedMesh( ASkinnedComponent * InComponent );
-    void AddProceduralMesh( AProceduralMeshComponent * InComponent );
+    bool AddStaticMesh( AMeshComponent * InComponent, SRenderInstance * Instances, uint8_t * Lists );
+    void AddCachedStaticMesh( AMeshComponent * InComponent, AStaticDrawCache::SEntry * InEntry, SRenderInstance * Instances, uint8_t * Lists );
+    void AddSkinnedMesh( ASkinnedComponent * InComponent, SRenderInstance * Instances, uint8_t * Lists );
+    void AddProceduralMesh( AProceduralMeshComponent * InComponent, SRenderInstance * Instances, uint8_t * Lists );
     void AddDirectionalShadowmapInstances( AWorld * InWorld );
     void AddShadowmap_StaticMesh( SLightShadowmap * ShadowMap, AMeshComponent * InComponent );
     void AddShadowmap_SkinnedMesh( SLightShadowmap * ShadowMap, ASkinnedComponent * InComponent );
@@ -106,6 +115,19 @@ private:
     TPodVector< AAnalyticLightComponent * > VisLights;
     TPodVector< AIBLComponent * > VisIBLs;
 
+    struct SDrawableInstances {
+        ADrawable * Drawable;
+        int FirstInstance;
+        /** Instances must be stored to the static draw cache */
+        bool bStoreInCache;
+    };
+
+    /** Visible drawables and their first instance in the frame instance array */
+    TPodVector< SDrawableInstances > VisDrawables;
+
+    /** Frame lists (INSTANCE_LIST_*) for each instance */
+    TPodVector< uint8_t > InstanceLists;
+
     int VisPass = 0;
 
     // TODO: We can keep ready shadowCasters[] and boxes[]
@@ -125,6 +147,10 @@ private:
     SRenderFrontendDef RenderDef;
     ARenderingParameters * ViewRP;
 
+    /** Render instances of non-movable static meshes. Owned by the rendering parameters of the current view. Null if disabled. */
+    AStaticDrawCache * StaticDrawCache = nullptr;
+    TPodVector< AStaticDrawCache::SSubpart > StaticDrawCacheSubparts;
+
     TRef< ATexture > PhotometricProfiles;
 
     TRef< ATerrainMesh > TerrainMesh;
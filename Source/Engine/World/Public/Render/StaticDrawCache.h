@@ -0,0 +1,177 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Renderer/RenderDefs.h>
+#include <Core/Public/Hash.h>
+
+class AMaterial;
+class AMaterialInstance;
+
+/**
+
+AStaticDrawCache
+
+Per-view cache of complete render instances of non-movable static meshes. Entries are keyed by component.
+Each entry keeps, for every subpart, the render instance as it was added for the view last time: materials,
+GPU buffers, index ranges, lightmap, clip space matrices and the normal-to-view matrix, and also the instance
+lists and rendering priority.
+
+While the component and the view are unchanged, the instances are copied as is. Only material frame data and
+the sort key (which depends on the frame data) are taken every frame. When the view changes, the matrices of an
+entry are rebuilt the first time the entry is used with the new view; the rest is kept.
+
+Entry is valid while its key matches the current component state. The key holds change counters that are
+incremented by events (ADrawable::GetRenderRevision for transform, movable flag, mesh and material changes,
+AIndexedMesh::GetRevision, AVertexMemoryGPU::GetRevision, AMaterialInstance::GetMaterialRevision) and a few
+public component fields that have no setters.
+
+Entries that are not used for a while are removed.
+
+*/
+class AStaticDrawCache
+{
+    AN_FORBID_COPY( AStaticDrawCache )
+
+public:
+    /** Unused entries are removed after this number of frames */
+    static constexpr int MAX_UNUSED_FRAMES = 256;
+
+    /** State of the component the entry was built from */
+    struct SKey
+    {
+        uint32_t ComponentRevision;
+        uint32_t MeshRevision;
+        uint32_t VertexMemoryRevision;
+        uint32_t MaterialRevision;
+        void const * LightmapUVChannel;
+        void const * VertexLightChannel;
+        int LightmapBlock;
+        unsigned int SubpartBaseVertexOffset;
+        Float4 LightmapOffset;
+        bool bOutline;
+
+        bool operator==( SKey const & Rhs ) const {
+            return ComponentRevision == Rhs.ComponentRevision
+                && MeshRevision == Rhs.MeshRevision
+                && VertexMemoryRevision == Rhs.VertexMemoryRevision
+                && MaterialRevision == Rhs.MaterialRevision
+                && LightmapUVChannel == Rhs.LightmapUVChannel
+                && VertexLightChannel == Rhs.VertexLightChannel
+                && LightmapBlock == Rhs.LightmapBlock
+                && SubpartBaseVertexOffset == Rhs.SubpartBaseVertexOffset
+                && LightmapOffset == Rhs.LightmapOffset
+                && bOutline == Rhs.bOutline;
+        }
+
+        bool operator!=( SKey const & Rhs ) const { return !( *this == Rhs ); }
+    };
+
+    /** Cached mesh subpart */
+    struct SSubpart
+    {
+        /** Render instance as it was added for the view. Material frame data and sort key are from the frame the instance was cached. */
+        SRenderInstance Instance;
+
+        /** Material instance to take frame data from */
+        AMaterialInstance * MaterialInstance;
+
+        /** Instance list flags (INSTANCE_LIST_*) */
+        uint8_t Lists;
+
+        /** Material rendering priority */
+        uint8_t Priority;
+    };
+
+    struct SEntry
+    {
+        uint64_t ComponentId;
+        SKey Key;
+        Float3x3 WorldRotation;
+        /** View revision the matrices were built for. Zero if they must be rebuilt. */
+        uint32_t ViewRevision;
+        int FirstSubpart;
+        int NumSubparts;
+        int LastFrame;
+    };
+
+    AStaticDrawCache() {}
+
+    /** Start new frame of the view. Changes the view revision if the view matrices are changed.
+    Removes entries that were not used for MAX_UNUSED_FRAMES frames. */
+    void BeginFrame( int InFrameNumber, SRenderView const * InView );
+
+    /** Find entry of the component. Returns null if there is no entry or the key doesn't match.
+    Can be called from several threads for different components while the cache is not modified. */
+    SEntry * Find( uint64_t InComponentId, SKey const & InKey );
+
+    /** Copy cached instances and lists of the entry. If the view has changed since the instances were cached,
+    their matrices are rebuilt first. Entries are stored only for components that kept their transform since
+    the previous frame, so the world transform is used as the previous transform too.
+    Can be called from several threads for different entries. */
+    void GetInstances( SEntry * InEntry, Float3x4 const & InWorldTransform, SRenderInstance * Instances, uint8_t * Lists );
+
+    /** Subparts of the entry */
+    SSubpart const * GetSubparts( SEntry const * InEntry ) const { return Subparts.ToPtr() + InEntry->FirstSubpart; }
+
+    /** Add or replace entry of the component. The instances must be built for the current view. */
+    void Store( uint64_t InComponentId, SKey const & InKey, Float3x3 const & InWorldRotation, SSubpart const * InSubparts, int InNumSubparts );
+
+    /** Drop all entries */
+    void Clear();
+
+    int GetEntryCount() const { return Entries.Size(); }
+
+    uint32_t GetViewRevision() const { return ViewRevision; }
+
+private:
+    int FindIndex( uint64_t InComponentId ) const;
+
+    /** Rebuild the matrices of the entry for the current view */
+    void UpdateView( SEntry * InEntry, Float3x4 const & InWorldTransform );
+
+    /** Remove unused entries and subparts of the replaced ones */
+    void Compact();
+
+    TPodVector< SEntry > Entries;
+    TPodVector< SSubpart > Subparts;
+    TPodVector< SSubpart > CompactSubparts;
+    THash<> EntryHash;
+    int NumGarbageSubparts = 0;
+    int FrameNumber = 0;
+    int LastCompactFrame = 0;
+
+    /** View matrices the instances are built with */
+    Float4x4 ViewProjection;
+    Float4x4 ViewProjectionP;
+    Float3x3 NormalToViewMatrix;
+    uint32_t ViewRevision = 0;
+};
@@ -32,6 +32,7 @@ SOFTWARE.
 
 //#include <World/Public/World.h>
 #include <Runtime/Public/Runtime.h>
+#include <World/Public/Render/OcclusionBuffer.h>
 
 class AWorld;
 struct SVisibilityQuery;
@@ -39,6 +40,7 @@ struct SBoxHitResult;
 struct SWorldRaycastClosestResult;
 struct SWorldRaycastResult;
 struct SWorldRaycastFilter;
+struct SWorldRay;
 
 class AVSD
 {
@@ -53,6 +55,10 @@ public:
 
     bool RaycastClosestBounds( AWorld * InWorld, SBoxHitResult & Result, Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter );
 
+    int RaycastClosestBatch( AWorld * InWorld, SWorldRaycastClosestResult * Results, bool * Hits, SWorldRay const * InRays, int InNumRays, SWorldRaycastFilter const * InFilter );
+
+    int RaycastClosestBoundsBatch( AWorld * InWorld, SBoxHitResult * Results, bool * Hits, SWorldRay const * InRays, int InNumRays, SWorldRaycastFilter const * InFilter );
+
     void DrawDebug( ADebugRenderer * InRenderer );
 
 private:
@@ -80,8 +86,36 @@ private:
         SPortalScissor Scissor;
     };
 
-    SPortalStack PortalStack[MAX_PORTAL_STACK];
-    int PortalStackPos;
+    /** Root of the portal stack (view frustum) */
+    SPortalStack ViewPortalStack;
+
+    /** Portal stacks are thread local: independent area subtrees are traversed in parallel */
+    static thread_local SPortalStack PortalStack[MAX_PORTAL_STACK];
+
+    //
+    // Portal flow
+    //
+
+    /** Area reached by portal flow */
+    struct SPortalFlowVisit {
+        SVisArea const * Area;
+        SPortalLink const * Portal; // Portal that was passed to reach the area. Null for the view area.
+        PlaneF AreaFrustum[MAX_CULL_PLANES];
+        int PlanesCount;
+        SPortalScissor Scissor;
+    };
+
+    /** Independent part of the portal flow */
+    struct SPortalFlowTask {
+        SPortalStack Stack;
+        SVisArea const * Area;
+        int StackPos;
+        bool bAreaOnly; // Area portals are processed by other tasks
+    };
+
+    TPodVector< SPortalFlowTask > PortalFlowTasks;
+    TPodVector< SPortalFlowTask > PortalFlowTasksNext;
+    TStdVector< TPodVector< SPortalFlowVisit > > PortalFlowVisits;
 
     //
     // Portal hull
@@ -150,6 +184,26 @@ private:
     int Dbg_CulledBySurfaceBounds;
     int Dbg_CulledByPrimitiveBounds;
     int Dbg_TotalPrimitiveBounds;
+    int Dbg_CulledByOcclusion;
+
+    //
+    // Software occlusion culling
+    //
+
+    /** Occluder candidate. Only the most significant candidates are rasterized. */
+    struct SOccluder
+    {
+        float Score;
+        int NumTriangles;
+        SSurfaceDef const * Surface;
+        SPrimitiveDef const * Primitive;
+    };
+
+    AOcclusionBuffer OcclusionBuffer;
+    TPodVector< SOccluder > Occluders;
+
+    void SelectOccluders();
+    void CullOccluded( Float4x4 const & InViewProjection );
 
     //
     // Culling, SSE, multithreading
@@ -173,12 +227,16 @@ private:
 
     TPodVector< SCullJobSubmit > CullSubmits;
     TPodVector< SPrimitiveDef * > BoxPrimitives;
+    TPodVector< SPrimitiveDef * > BVHPrimitives;
     using AArrayOfBoundingBoxesSSE = TPodVector< BvAxisAlignedBoxSSE, 32, 32, AHeapAllocator<16> >;
     AArrayOfBoundingBoxesSSE BoundingBoxesSSE;
     TPodVector< int32_t, 32, 32, AHeapAllocator<16> > CullingResult;
 
     void ProcessLevelVisibility( ALevel * InLevel );
-    void FlowThroughPortals_r( SVisArea const * InArea );
+    void FlowThroughPortals( SVisArea const * InArea );
+    void FlowThroughPortals_r( TPodVector< SPortalFlowVisit > & OutVisits, SVisArea const * InArea, int InStackPos );
+    void ExecutePortalFlowTask( int InTaskIndex );
+    static void AddPortalFlowVisit( TPodVector< SPortalFlowVisit > & OutVisits, SVisArea const * InArea, SPortalStack const * InStack );
     bool CalcPortalStack( SPortalStack * OutStack, SPortalStack const * InPrevStack, SPortalLink const * InPortal );
     bool ClipPolygonFast( Float3 const * InPoints, const int InNumPoints, SPortalHull * Out, PlaneF const & _Plane, const float InEpsilon );
     SPortalHull * CalcPortalWinding( SPortalLink const * InPortal, SPortalStack const * InStack );
@@ -209,8 +267,27 @@ private:
         HIT_PROXY_TYPE_SURFACE
     };
 
+    /** Objects processed by the ray. Used by batched raycasts instead of shared VisMark markers. */
+    struct SRaycastProcessedSet
+    {
+        void Clear();
+        bool Contains( void const * InObject ) const;
+        void Insert( void const * InObject );
+
+    private:
+        TPodVector< void const * > Table;
+        int Count = 0;
+    };
+
     struct SRaycast
     {
+        ALevel * Level;
+        int QueryMask;
+        int VisibilityMask;
+
+        /** Set of processed objects for batched raycasts, null for single raycasts */
+        SRaycastProcessedSet * ProcessedSet;
+
         Float3 RayStart;
         Float3 RayEnd;
         Float3 RayDir;
@@ -240,9 +317,21 @@ private:
         bool bClosest;
     };
 
-    SRaycast Raycast;
-    SWorldRaycastResult * pRaycastResult;
-    TPodVector< SBoxHitResult > * pBoundsRaycastResult;
+    /** Raycast state is thread local: batched raycasts are traced in parallel */
+    static thread_local SRaycast Raycast;
+    static thread_local SWorldRaycastResult * pRaycastResult;
+    static thread_local TPodVector< SBoxHitResult > * pBoundsRaycastResult;
+
+    /** Processed sets for the batch tasks */
+    TStdVector< SRaycastProcessedSet > RaycastProcessedSets;
+
+    template< typename T > bool IsRaycastProcessed( T const * InObject ) const;
+    template< typename T > void MarkRaycastProcessed( T * InObject );
+    template< typename T > void MarkRaycastVisible( T * InObject );
+    bool RaycastFaceCull( SPrimitiveDef const * InPrimitive ) const;
+    bool SetupRaycast( Float3 const & InRayStart, Float3 const & InRayEnd, SWorldRaycastFilter const * InFilter );
+    bool TraceClosest( AWorld * InWorld, SWorldRaycastClosestResult & Result );
+    bool TraceClosestBounds( AWorld * InWorld, SBoxHitResult & Result );
 
     void RaycastSurface( SSurfaceDef * Self );
     void RaycastPrimitive( SPrimitiveDef * Self );
@@ -436,6 +436,9 @@ public:
     /** Get all mesh subparts */
     AIndexedMeshSubpartArray const & GetSubparts() const { return Subparts; }
 
+    /** Incremented when the mesh is reinitialized, subpart ranges or subpart material instances are changed */
+    uint32_t GetRevision() const { return Revision; }
+
     /** Max primitives per leaf. For raycasting */
     unsigned int GetRaycastPrimitivesPerLeaf() const { return RaycastPrimitivesPerLeaf; }
 
@@ -528,6 +531,7 @@ private:
     ASkin Skin;
     BvAxisAlignedBox BoundingBox;
     uint16_t RaycastPrimitivesPerLeaf = 16;
+    uint32_t Revision = 0;
     bool bSkinnedMesh = false;
     mutable bool bBoundingBoxDirty = false;
 };
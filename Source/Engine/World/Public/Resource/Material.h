@@ -58,6 +58,8 @@ public:
 
     bool IsTranslucent() const { return Def.bTranslucent; }
 
+    bool IsAlphaMasked() const { return Def.bAlphaMasking; }
+
     bool IsTwoSided() const { return Def.bTwoSided; }
 
     bool CanCastShadow() const { return !Def.bNoCastShadow; }
@@ -135,6 +137,9 @@ public:
     /** Get material. Never return null. */
     AMaterial * GetMaterial() const;
 
+    /** Incremented when material of any material instance is changed */
+    static uint32_t GetMaterialRevision() { return MaterialRevision; }
+
     /** Set texture for the slot */
     void SetTexture( int _TextureSlot, ATexture * _Texture );
 
@@ -172,4 +177,6 @@ private:
     TRef< ATexture > Textures[ MAX_MATERIAL_TEXTURES ];
     TRef< AVirtualTextureResource > VirtualTexture;
     int VisFrame = -1;
+
+    static uint32_t MaterialRevision;
 };
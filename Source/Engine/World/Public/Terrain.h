@@ -32,6 +32,7 @@ SOFTWARE.
 
 #include <Renderer/RenderDefs.h>
 #include <World/Public/HitTest.h>
+#include <World/Public/TerrainHeightmap.h>
 #include <World/Public/Base/BaseObject.h>
 
 class ADebugRenderer;
@@ -136,12 +137,22 @@ struct STerrainTriangle
     Float2 Texcoord;
 };
 
+struct STerrainRay
+{
+    Float3 Start;
+    /** Normalized ray direction */
+    Float3 Dir;
+    float Distance;
+};
+
 class ATerrain : public ABaseObject
 {
     AN_CLASS( ATerrain, ABaseObject )
 
 public:
     ATerrain();
+    /** Create terrain from baked heightmap file (see ATerrainHeightmap::Bake) */
+    explicit ATerrain( const char * InHeightmapFile );
     ~ATerrain();
 
     float GetMinHeight() const { return MinHeight; }
@@ -150,6 +161,20 @@ public:
 
     float Height( int X, int Z, int Lod ) const;
 
+    /** Fetch Count heights along X axis with one sample step of given lod. X and Z must be aligned to the lod sample step. */
+    void HeightRow( int X, int Z, int Lod, int Count, float * Heights ) const;
+
+    /** Maximum geometric error of the lod relative to the finest lod in the world space rect (inclusive) */
+    float GetGeometricError( int Lod, int MinX, int MinZ, int MaxX, int MaxZ ) const;
+
+    /** Load heightmap tiles covering the world space rect (inclusive) at given lod */
+    void MakeResident( int Lod, int MinX, int MinZ, int MaxX, int MaxZ ) const;
+
+    /** Evict heightmap tiles unused in current frame over the cache budget. Call from the main thread. */
+    void UpdateResidency();
+
+    ATerrainHeightmap const & GetHeightmap() const { return Heightmap; }
+
     Int2 const & GetClipMin() const { return ClipMin; }
     Int2 const & GetClipMax() const { return ClipMax; }
 
@@ -159,6 +184,8 @@ public:
     bool Raycast( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, TPodVector< STriangleHitResult > & HitResult ) const;
     /** Check ray intersection */
     bool RaycastClosest( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, STriangleHitResult & HitResult ) const;
+    /** Check ray intersection for a batch of rays. Rays are split between job workers. Returns number of hits */
+    int RaycastClosestBatch( STerrainRay const * Rays, int NumRays, bool bCullBackFace, STriangleHitResult * Results, bool * Hits ) const;
 
     bool GetTriangleVertices( float X, float Z, Float3 & V0, Float3 & V1, Float3 & V2 ) const;
 
@@ -171,12 +198,32 @@ public:
     class btHeightfieldTerrainShape * GetHeightfieldShape() const { return HeightfieldShape.GetObject(); }
 
 private:
+    void SetupHeightmap();
+
+    void BuildHeightTree();
+
+    template< typename QuadCallback >
+    void TraverseRay( Float3 const & RayStart, Float3 const & RayDir, float & MaxDistance, QuadCallback const & Callback ) const;
+
+    template< typename QuadCallback >
+    void TraverseQuads( Float3 const & RayStart, Float3 const & RayDir, Float3 const & InvRayDir, float TEnter, float TExit, int MinX, int MaxX, int MinZ, int MaxZ, float & MaxDistance, QuadCallback const & Callback ) const;
+
+    int RaycastQuad( Float3 const & RayStart, Float3 const & RayDir, int X, int Z, float TEnter, float TExit, float MaxDistance, bool bCullBackFace, STriangleHitResult * HitResult ) const;
+
+    bool RaycastBullet( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, TPodVector< STriangleHitResult > & HitResult ) const;
+    bool RaycastClosestBullet( Float3 const & RayStart, Float3 const & RayDir, float Distance, bool bCullBackFace, STriangleHitResult & HitResult ) const;
+
     int HeightmapResolution;
     int HeightmapLods;
-    TPodVector< float * > Heightmap;
+    ATerrainHeightmap Heightmap;
     float MinHeight;
     float MaxHeight;
     TUniqueRef< btHeightfieldTerrainShape > HeightfieldShape;
+    /** Min/max height quadtree. Leaves are heightmap tiles of the finest lod, levels are stored from leaves to root */
+    TPodVector< Float2 > HeightTree;
+    int HeightTreeOffset[16];
+    int HeightTreeSize[16];
+    int HeightTreeLevels = 0;
     Int2 ClipMin;
     Int2 ClipMax;
     BvAxisAlignedBox BoundingBox;
@@ -190,7 +237,8 @@ public:
 
     void SetTerrain( ATerrain * Mesh );
 
-    void Update( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum );
+    /** Update view. ErrorScale converts geometric error at unit distance to pixels. For orthographic views error doesn't depend on distance. */
+    void Update( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum, float ErrorScale, bool bPerspective );
 
     int GetTextureSize() const
     {
@@ -230,7 +278,7 @@ public:
     void DrawDebug( ADebugRenderer * InRenderer, ATerrainMesh * TerrainMesh );
 
 private:
-    void MakeView( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum );
+    void MakeView( ATerrainMesh * TerrainMesh, Float3 const & ViewPosition, BvFrustum const & ViewFrustum, float ErrorScale, bool bPerspective );
     void AddPatches( ATerrainMesh * TerrainMesh, BvFrustum const & ViewFrustum );
     void AddBlock( STerrainLodInfo const & Lod, Int2 const & Offset );
     void AddGapV( STerrainLodInfo const & Lod, Int2 const & Offset );
@@ -245,7 +293,16 @@ private:
     bool CullGapH( BvFrustum const & ViewFrustum, STerrainLodInfo const & Lod, Int2 const & Offset );
     bool CullInteriorTrim( BvFrustum const & ViewFrustum, STerrainLodInfo const & Lod );
 
+    struct SClipmapRect
+    {
+        int MinX;
+        int MaxX;
+        int MinY;
+        int MaxY;
+    };
+
     void UpdateTextures();
+    void UpdateRectsParallel( STerrainLodInfo const & Lod, STerrainLodInfo const & CoarserLod, SClipmapRect const * Rects, int NumRects );
     void UpdateRect( STerrainLodInfo const & Lod, STerrainLodInfo const & CoarserLod, int MinX, int MaxX, int MinY, int MaxY );
 
     STerrainPatchInstance & AddInstance()
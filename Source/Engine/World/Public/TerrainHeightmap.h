@@ -0,0 +1,176 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Core/Public/IO.h>
+#include <Core/Public/Thread.h>
+#include <Core/Public/Atomic.h>
+#include <Core/Public/PodVector.h>
+
+/** Heightmap tile width and height in samples */
+constexpr int TERRAIN_HEIGHTMAP_TILE_SIZE = 64;
+constexpr int TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2 = 6;
+
+/** Tile table entry of the baked heightmap file */
+struct STerrainHeightmapTile
+{
+    /** Tile data offset in the file */
+    uint64_t Offset;
+    /** Tile data size in bytes */
+    uint32_t Size;
+    /** Minimum and maximum height of the tile samples */
+    float MinHeight;
+    float MaxHeight;
+    /** Maximum height deviation of the tile from the finest lod */
+    float GeometricError;
+};
+
+/**
+
+ATerrainHeightmap
+
+Tiled heightmap pyramid baked offline. Tiles are streamed from the file on demand
+and kept in a LRU cache. Residency is driven by terrain views, tiles requested outside
+of the resident set are loaded synchronously.
+
+*/
+class ATerrainHeightmap
+{
+    AN_FORBID_COPY( ATerrainHeightmap )
+
+public:
+    ATerrainHeightmap();
+    ~ATerrainHeightmap();
+
+    /** Build mip pyramid from raw float heightmap and write the tiled file. Heightmap resolution must be 2^n+1.
+    If bCompress is true, tile samples are quantized to 16 bits relative to tile height range. */
+    static bool Bake( float const * InHeightmap, int InResolution, const char * InFileName, bool bCompress );
+
+    /** Open baked heightmap */
+    bool Open( const char * InFileName );
+
+    /** Free all resident tiles and close the file */
+    void Close();
+
+    bool IsOpened() const { return File.IsOpened(); }
+
+    int GetResolution() const { return Resolution; }
+
+    int GetNumLods() const { return Lods.Size(); }
+
+    int GetLodResolution( int Lod ) const { return Lods[Lod].Resolution; }
+
+    float GetMinHeight() const { return MinHeight; }
+
+    float GetMaxHeight() const { return MaxHeight; }
+
+    /** Tile table entry. Can be used for coarse height bounds without loading tile data */
+    STerrainHeightmapTile const & GetTileInfo( int Lod, int TileX, int TileY ) const
+    {
+        SLod const & lod = Lods[Lod];
+        return Tiles[lod.FirstTile + TileY * lod.NumTiles + TileX];
+    }
+
+    /** Fetch height sample. Sample coordinates must be in [0, LodResolution) range. Thread safe,
+    can run concurrently with UpdateResidency (see UpdateResidency). */
+    AN_FORCEINLINE float Sample( int Lod, int X, int Y ) const
+    {
+        SLod const & lod = Lods[Lod];
+        int tileIndex = lod.FirstTile + (Y >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2) * lod.NumTiles + (X >> TERRAIN_HEIGHTMAP_TILE_SIZE_LOG2);
+        float const * data = GetTile( tileIndex );
+        return data[(Y & (TERRAIN_HEIGHTMAP_TILE_SIZE-1)) * TERRAIN_HEIGHTMAP_TILE_SIZE + (X & (TERRAIN_HEIGHTMAP_TILE_SIZE-1))];
+    }
+
+    /** Fetch a row of height samples starting at X. Coordinates outside of the heightmap are clamped. Thread safe,
+    can run concurrently with UpdateResidency (see UpdateResidency). */
+    void SampleRow( int Lod, int X, int Y, int Count, float * Heights ) const;
+
+    /** Load tiles covering the sample rect (inclusive) and mark them as used in current frame */
+    void MakeResident( int Lod, int MinX, int MinY, int MaxX, int MaxY ) const;
+
+    /** Advance residency frame and evict least recently used tiles over the cache budget. Tiles used
+    in current frame are never evicted. Evicted tiles are unloaded at once, but their memory is released by the
+    first call in a later frame, so samplers running concurrently keep reading valid data. Sampling must not
+    span frames: a Sample/SampleRow/MakeResident call started in one frame must complete before
+    UpdateResidency is called with the next frame number. Calls of UpdateResidency must not overlap. */
+    void UpdateResidency( int FrameNumber, size_t MaxResidentBytes );
+
+    /** Total size of resident tiles */
+    size_t GetResidentBytes() const { return NumResidentTiles.Load() * TileBytes; }
+
+private:
+    struct SLod
+    {
+        int Resolution;
+        int NumTiles;
+        int FirstTile;
+    };
+
+    struct STileResidency
+    {
+        TAtomic< float * > Data;
+        TAtomic< int > LastUse;
+    };
+
+    AN_FORCEINLINE float const * GetTile( int TileIndex ) const
+    {
+        STileResidency & tile = Residency[TileIndex];
+        float * data = tile.Data.Load();
+        if ( !data ) {
+            return LoadTile( TileIndex );
+        }
+        int frame = CurrentFrame.LoadRelaxed();
+        if ( tile.LastUse.LoadRelaxed() != frame ) {
+            tile.LastUse.StoreRelaxed( frame );
+        }
+        return data;
+    }
+
+    float const * LoadTile( int TileIndex ) const;
+
+    static const size_t TileBytes = TERRAIN_HEIGHTMAP_TILE_SIZE * TERRAIN_HEIGHTMAP_TILE_SIZE * sizeof( float );
+
+    mutable AFileStream File;
+    mutable AMutex FileLock;
+    bool bCompressed;
+    int Resolution;
+    float MinHeight;
+    float MaxHeight;
+    TPodVector< SLod > Lods;
+    TPodVector< STerrainHeightmapTile > Tiles;
+    STileResidency * Residency;
+    mutable TPodVector< int > ResidentTiles;
+    mutable TPodVector< byte > ReadBuffer;
+    mutable AAtomicInt NumResidentTiles;
+    mutable AAtomicInt CurrentFrame;
+    TPodVector< float * > PendingFree;
+    int PendingFreeFrame;
+};
@@ -143,6 +143,9 @@ struct SVisibilityQuery
     /** Result filter */
     int QueryMask;
 
+    /** View projection matrix for occlusion culling. Can be null to disable occlusion culling. */
+    Float4x4 const * ViewProjection;
+
     // FIXME: add bool bQueryPrimitives, bool bQuerySurfaces?
 };
 
@@ -277,6 +280,13 @@ struct SWorldRaycastFilter
     }
 };
 
+/** Ray for batched raycasts */
+struct SWorldRay
+{
+    Float3 Start;
+    Float3 End;
+};
+
 /** AWorld. Defines a game map or editor/tool scene */
 class AWorld : public ABaseObject
 {
@@ -444,6 +454,16 @@ public:
     /** Per-bounds raycast */
     bool RaycastClosestBounds( SBoxHitResult & _Result, Float3 const & _RayStart, Float3 const & _RayEnd, SWorldRaycastFilter const * _Filter = nullptr ) const;
 
+    /** Per-triangle raycast of an array of rays. Each ray is traced separately as with RaycastClosest (there is no packet traversal),
+    rays are only distributed between job threads. Results are the same as for RaycastClosest.
+    _Hits receives true for each ray that hits anything. Returns the number of hits. The world must not be modified during the call. */
+    int RaycastClosestBatch( SWorldRaycastClosestResult * _Results, bool * _Hits, SWorldRay const * _Rays, int _NumRays, SWorldRaycastFilter const * _Filter = nullptr ) const;
+
+    /** Per-bounds raycast of an array of rays. Each ray is traced separately as with RaycastClosestBounds (there is no packet traversal),
+    rays are only distributed between job threads. Results are the same as for RaycastClosestBounds.
+    _Hits receives true for each ray that hits anything. Returns the number of hits. The world must not be modified during the call. */
+    int RaycastClosestBoundsBatch( SBoxHitResult * _Results, bool * _Hits, SWorldRay const * _Rays, int _NumRays, SWorldRaycastFilter const * _Filter = nullptr ) const;
+
     /** Trace collision bodies */
     bool Trace( TPodVector< SCollisionTraceResult > & _Result, Float3 const & _RayStart, Float3 const & _RayEnd, SCollisionQueryFilter const * _QueryFilter = nullptr ) const
     {
@@ -0,0 +1,527 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Audio mixer test
+
+Renders fixed voices through the float mixer into an offline device and compares the 16-bit output
+with a reference port of the previous integer mixer. The integer mixer accumulated samples on a bus
+scaled by 256 relative to 16-bit output and quantized the channel volume to 1/256 steps (1/512 for
+spatialized stereo), so test volumes are multiples of 512 and both paths must agree within rounding.
+Voices cover 8-bit, 16-bit and float samples, mono and stereo, direct, spatialized and HRTF mixing,
+with constant volume and with volume ramps. The integer mixer had no float path, float voices are
+compared with the reference of the same 16-bit signal.
+
+Two differences are expected and checked separately: a quiet channel (volume below 256) was truncated
+to silence by the integer mixer and is audible now, and 8-bit samples are scaled by 255 on the HRTF
+path as on all other paths (the integer mixer used 248 there).
+
+*/
+
+#include "TestCommon.h"
+
+#include <Audio/Public/AudioMixer.h>
+#include <Audio/Public/HRTF.h>
+#include <Core/Public/IO.h>
+
+extern "C" const size_t EmbeddedResources_Size;
+extern "C" const uint64_t EmbeddedResources_Data[];
+
+extern ARuntimeVariable Snd_VolumeRampSize;
+
+static constexpr int SAMPLE_RATE = 44100;
+static constexpr int TRANSFER_BUFFER_FRAMES = 4096;
+
+// Multiple of HRTF_BLOCK_LENGTH, so HRTF voice is filtered in one block sequence
+static constexpr int VOICE_FRAMES = 1024;
+
+// Size of the volume ramp arrays of the integer mixer
+static constexpr int OLD_VOLUME_RAMP_SIZE = 1024;
+
+// Truncations on the integer bus and float rounding, in 16-bit sample units
+static constexpr int MAX_ERROR = 1;
+
+static constexpr int QUIET_VOLUME = 200;
+
+enum EMixMode
+{
+    MIX_DIRECT,
+    MIX_SPATIALIZED,
+    MIX_HRTF
+};
+
+static const char * MixModeName[] = { "direct", "spatialized", "HRTF" };
+
+/** Voice samples */
+struct STestVoice
+{
+    int SampleBits;
+    int Channels;
+
+    /** Samples in 16-bit scale as the integer mixer read them (8-bit samples are scaled by 255) */
+    TPodVector< int16_t > Samples;
+
+    SAudioBuffer * pBuffer;
+};
+
+/** Deterministic test signal: two tones and noise with a few full scale peaks */
+static void GenerateSignal( int _Channels, int _Seed, TPodVector< int16_t > & _Signal ) {
+    STestRandom random( _Seed );
+
+    _Signal.Resize( VOICE_FRAMES * _Channels );
+
+    for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+        for ( int ch = 0 ; ch < _Channels ; ch++ ) {
+            float t = (float)i / SAMPLE_RATE;
+            float v = 0.55f * Math::Sin( Math::_2PI * 440.0f * t + ch )
+                    + 0.3f * Math::Sin( Math::_2PI * 3150.0f * t )
+                    + random.Range( -0.1f, 0.1f );
+
+            int s = (int)( v * 32767.0f );
+            if ( ( i % 97 ) == 13 ) {
+                s = ( i & 1 ) ? 32767 : -32768;
+            }
+            _Signal[i * _Channels + ch] = Math::Clamp( s, -32768, 32767 );
+        }
+    }
+}
+
+static void CreateVoice( int _SampleBits, int _Channels, TPodVector< int16_t > const & _Signal, STestVoice & _Voice ) {
+    const int sampleCount = VOICE_FRAMES * _Channels;
+
+    _Voice.SampleBits = _SampleBits;
+    _Voice.Channels = _Channels;
+    _Voice.Samples.Resize( sampleCount );
+
+    void * pFrames = GHeapMemory.Alloc( sampleCount * ( _SampleBits >> 3 ) );
+
+    for ( int i = 0 ; i < sampleCount ; i++ ) {
+        switch ( _SampleBits ) {
+        case 8:
+        {
+            uint8_t u = ( _Signal[i] >> 8 ) + 128;
+            ( (uint8_t *)pFrames )[i] = u;
+            _Voice.Samples[i] = ( (int)u - 128 ) * 255;
+            break;
+        }
+        case 16:
+            ( (int16_t *)pFrames )[i] = _Signal[i];
+            _Voice.Samples[i] = _Signal[i];
+            break;
+        case 32:
+            ( (float *)pFrames )[i] = _Signal[i] / 32767.0f;
+            _Voice.Samples[i] = _Signal[i];
+            break;
+        }
+    }
+
+    _Voice.pBuffer = new SAudioBuffer( VOICE_FRAMES, _Channels, _SampleBits, pFrames );
+}
+
+/** Volume ramp of the integer mixer. Ramp is stored in integer volume units */
+static int OldMakeVolumeRamp( const int _CurVol[2], const int _NewVol[2], int _Scale, int * _RampL, int * _RampR ) {
+    if ( _CurVol[0] == _NewVol[0] && _CurVol[1] == _NewVol[1] ) {
+        return 0;
+    }
+
+    int rampSize = Math::Min3( OLD_VOLUME_RAMP_SIZE, VOICE_FRAMES, Snd_VolumeRampSize.GetInteger() );
+    if ( rampSize < 0 ) {
+        return 0;
+    }
+
+    float increment0 = (float)( _NewVol[0] - _CurVol[0] ) / ( rampSize * _Scale );
+    float increment1 = (float)( _NewVol[1] - _CurVol[1] ) / ( rampSize * _Scale );
+
+    float lvolf = (float)_CurVol[0] / _Scale;
+    float rvolf = (float)_CurVol[1] / _Scale;
+
+    for ( int i = 0 ; i < rampSize ; i++ ) {
+        lvolf += increment0;
+        rvolf += increment1;
+
+        _RampL[i] = lvolf;
+        _RampR[i] = rvolf;
+    }
+
+    return rampSize;
+}
+
+/** Integer mixer without HRTF. Bus is scaled by 256 */
+static void OldRenderFrames( STestVoice const & _Voice, const int _CurVol[2], const int _NewVol[2], bool _bSpatialized, int * _Bus ) {
+    int16_t const * frames = _Voice.Samples.ToPtr();
+
+    static int rampL[OLD_VOLUME_RAMP_SIZE];
+    static int rampR[OLD_VOLUME_RAMP_SIZE];
+
+    // Mono
+    if ( _Voice.Channels == 1 ) {
+        int lvol = _NewVol[0] / 256;
+        int rvol = _NewVol[1] / 256;
+
+        int rampSize = OldMakeVolumeRamp( _CurVol, _NewVol, 256, rampL, rampR );
+
+        for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+            _Bus[i * 2]     += frames[i] * ( i < rampSize ? rampL[i] : lvol );
+            _Bus[i * 2 + 1] += frames[i] * ( i < rampSize ? rampR[i] : rvol );
+        }
+        return;
+    }
+
+    // Spatialized stereo, channels are combined and the volume is downscaled twice
+    if ( _bSpatialized ) {
+        int lvol = _NewVol[0] / 512;
+        int rvol = _NewVol[1] / 512;
+
+        int rampSize = OldMakeVolumeRamp( _CurVol, _NewVol, 512, rampL, rampR );
+
+        for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+            int s = (int)frames[i * 2] + (int)frames[i * 2 + 1];
+
+            _Bus[i * 2]     += s * ( i < rampSize ? rampL[i] : lvol );
+            _Bus[i * 2 + 1] += s * ( i < rampSize ? rampR[i] : rvol );
+        }
+        return;
+    }
+
+    // Background music/etc
+    int lvol = _NewVol[0] / 256;
+    int rvol = _NewVol[1] / 256;
+
+    int rampSize = OldMakeVolumeRamp( _CurVol, _NewVol, 256, rampL, rampR );
+
+    for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+        _Bus[i * 2]     += frames[i * 2]     * ( i < rampSize ? rampL[i] : lvol );
+        _Bus[i * 2 + 1] += frames[i * 2 + 1] * ( i < rampSize ? rampR[i] : rvol );
+    }
+}
+
+/** Integer mixer with HRTF. 8-bit samples are scaled by _Scale8Bit (248 in the integer mixer). Bus is scaled by 256 */
+static void OldRenderFramesHRTF( AAudioHRTF & _Hrtf, STestVoice const & _Voice, const int _CurVol[2], const int _NewVol[2], Float3 const & _Dir, int _Scale8Bit, int * _Bus ) {
+    const int historyExtraFrames = _Hrtf.GetFrameCount() - 1;
+
+    // Playback starts at the first frame, so the history is silent
+    TPodVector< float > framesF32;
+    framesF32.ResizeInvalidate( historyExtraFrames + VOICE_FRAMES );
+    Core::ZeroMem( framesF32.ToPtr(), historyExtraFrames * sizeof( float ) );
+
+    float * pFrames = framesF32.ToPtr() + historyExtraFrames;
+    void const * pRawSamples = _Voice.pBuffer->GetFrames();
+
+    for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+        if ( _Voice.SampleBits == 8 ) {
+            const float intToFloat = 1.0f / 256 / 32767;
+
+            uint8_t const * frames = (uint8_t const *)pRawSamples + i * _Voice.Channels;
+
+            if ( _Voice.Channels == 1 ) {
+                pFrames[i] = ( ( (int)frames[0] - 128 ) * _Scale8Bit * 256 ) * intToFloat;
+            } else {
+                pFrames[i] = ( ( (int)frames[0] - 128 ) * _Scale8Bit * 256 + ( (int)frames[1] - 128 ) * _Scale8Bit * 256 ) * ( intToFloat * 0.5f );
+            }
+        } else if ( _Voice.SampleBits == 16 ) {
+            const float intToFloat = 1.0f / 32767;
+
+            int16_t const * frames = (int16_t const *)pRawSamples + i * _Voice.Channels;
+
+            if ( _Voice.Channels == 1 ) {
+                pFrames[i] = frames[0] * intToFloat;
+            } else {
+                pFrames[i] = ( (int)frames[0] + (int)frames[1] ) * ( intToFloat * 0.5f );
+            }
+        } else {
+            float const * frames = (float const *)pRawSamples + i * _Voice.Channels;
+
+            if ( _Voice.Channels == 1 ) {
+                pFrames[i] = frames[0];
+            } else {
+                pFrames[i] = ( frames[0] + frames[1] ) * 0.5f;
+            }
+        }
+    }
+
+    TPodVector< float > stream;
+    stream.ResizeInvalidate( VOICE_FRAMES * 2 );
+
+    Float3 dir;
+    _Hrtf.ApplyHRTF( _Dir, _Dir, framesF32.ToPtr(), VOICE_FRAMES, stream.ToPtr(), dir );
+
+    // Volume ramp of the left channel is used for both channels
+    static int rampL[OLD_VOLUME_RAMP_SIZE];
+
+    int rampSize = 0;
+    if ( _CurVol[0] != _NewVol[0] || _CurVol[1] != _NewVol[1] ) {
+        rampSize = Math::Min3( OLD_VOLUME_RAMP_SIZE, VOICE_FRAMES, Snd_VolumeRampSize.GetInteger() );
+        if ( rampSize > 0 ) {
+            float scale = 256.0f / _Hrtf.GetFilterSize();
+            float increment0 = (float)( _NewVol[0] - _CurVol[0] ) / rampSize * scale;
+            float lvolf = (float)_CurVol[0] * scale;
+            for ( int i = 0 ; i < rampSize ; i++ ) {
+                lvolf += increment0;
+                rampL[i] = lvolf;
+            }
+        }
+    }
+
+    float vol = float( 65536 / 256 ) * _NewVol[0] / _Hrtf.GetFilterSize();
+    for ( int i = 0 ; i < rampSize ; i++ ) {
+        _Bus[i * 2]     += stream[i * 2]     * rampL[i];
+        _Bus[i * 2 + 1] += stream[i * 2 + 1] * rampL[i];
+    }
+    for ( int i = rampSize ; i < VOICE_FRAMES ; i++ ) {
+        _Bus[i * 2]     += stream[i * 2]     * vol;
+        _Bus[i * 2 + 1] += stream[i * 2 + 1] * vol;
+    }
+}
+
+/** Write the integer bus to 16-bit samples */
+static void OldWriteSamples16( int const * _Bus, int16_t * _Out ) {
+    for ( int i = 0 ; i < VOICE_FRAMES * 2 ; i++ ) {
+        _Out[i] = Math::Clamp( _Bus[i] / 256, -32768, 32767 );
+    }
+}
+
+/** Render the voice alone with the float mixer, output is 16-bit stereo */
+static void RenderVoice( AAudioDevice & _Device, AAudioMixer & _Mixer, STestVoice const & _Voice, const int _CurVol[2], const int _NewVol[2], EMixMode _Mode, Float3 const & _Dir, int16_t * _Out ) {
+    const bool bSpatialized = _Mode != MIX_DIRECT;
+
+    Snd_HRTF.ForceBool( _Mode == MIX_HRTF );
+
+    SAudioChannel * channel = new SAudioChannel( 0, -1, 0, _Voice.pBuffer, nullptr, false, _CurVol, _Dir, bSpatialized, false );
+
+    // Volume is ramped from _CurVol to _NewVol
+    int newVol[2] = { _NewVol[0], _NewVol[1] };
+    channel->Commit( newVol, _Dir, bSpatialized, false );
+
+    _Mixer.SubmitChannel( channel );
+
+    const int64_t startFrame = _Mixer.GetRenderFrame();
+
+    _Mixer.RenderOffline( VOICE_FRAMES );
+
+    TEST_CHECK( channel->GetPlaybackPos() == VOICE_FRAMES );
+
+    // Mixer rejects the channel on next update
+    channel->RemoveRef();
+
+    const int wrapMask = _Device.GetTransferBufferSizeInFrames() - 1;
+
+    int16_t const * pTransferBuffer = (int16_t const *)_Device.MapTransferBuffer();
+    for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+        int frame = ( startFrame + i ) & wrapMask;
+        _Out[i * 2]     = pTransferBuffer[frame * 2];
+        _Out[i * 2 + 1] = pTransferBuffer[frame * 2 + 1];
+    }
+    _Device.UnmapTransferBuffer();
+}
+
+static int MaxDifference( int16_t const * _A, int16_t const * _B ) {
+    int maxDiff = 0;
+    for ( int i = 0 ; i < VOICE_FRAMES * 2 ; i++ ) {
+        maxDiff = Math::Max( maxDiff, Math::Abs( (int)_A[i] - (int)_B[i] ) );
+    }
+    return maxDiff;
+}
+
+/** The integer mixer stored the volume ramp in whole volume steps (1/256 of full volume, 1/512 for spatialized
+stereo), so inside the ramp its output differs by up to one step of the frame samples */
+static int OldRampStepError( STestVoice const & _Voice, int _Frame, bool _bSpatialized ) {
+    int16_t const * frames = _Voice.Samples.ToPtr();
+
+    if ( _Voice.Channels == 1 ) {
+        return Math::Abs( (int)frames[_Frame] ) / 256;
+    }
+
+    if ( _bSpatialized ) {
+        return Math::Abs( (int)frames[_Frame * 2] + (int)frames[_Frame * 2 + 1] ) / 256;
+    }
+
+    return Math::Max( Math::Abs( (int)frames[_Frame * 2] ), Math::Abs( (int)frames[_Frame * 2 + 1] ) ) / 256;
+}
+
+/** Max difference from the integer mixer output. Ramp step error is subtracted on first _RampSize frames */
+static int MaxDifferenceOld( int16_t const * _Output, int16_t const * _Reference, STestVoice const & _Voice, int _RampSize, bool _bSpatialized ) {
+    int maxDiff = 0;
+    for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+        int stepError = i < _RampSize ? OldRampStepError( _Voice, i, _bSpatialized ) : 0;
+
+        for ( int ch = 0 ; ch < 2 ; ch++ ) {
+            int diff = Math::Abs( (int)_Output[i * 2 + ch] - (int)_Reference[i * 2 + ch] ) - stepError;
+            maxDiff = Math::Max( maxDiff, diff );
+        }
+    }
+    return maxDiff;
+}
+
+static int MaxAmplitude( int16_t const * _Samples ) {
+    int maxAmp = 0;
+    for ( int i = 0 ; i < VOICE_FRAMES * 2 ; i++ ) {
+        maxAmp = Math::Max( maxAmp, Math::Abs( (int)_Samples[i] ) );
+    }
+    return maxAmp;
+}
+
+static void RunTests( AArchive const & _Resources ) {
+    AAudioDevice device( SAMPLE_RATE, 16, 2, TRANSFER_BUFFER_FRAMES );
+    AAudioMixer mixer( &device, _Resources );
+    AAudioHRTF hrtf( device.GetSampleRate(), _Resources );
+
+    const Float3 dir = Float3( 0.6f, 0.0f, -0.8f );
+
+    // Constant volume and volume ramp. Volumes are multiples of 512, so the integer mixer does not quantize them
+    const int constVol[2] = { 60416, 20480 };
+    const int rampVol[2] = { 10240, 51200 };
+
+    // HRTF path uses the left volume for both channels. Volume is lower, so the filtered voice does not clip
+    const int constVolHRTF[2] = { 20480, 20480 };
+    const int rampVolHRTF[2] = { 4096, 4096 };
+
+    static int16_t output[VOICE_FRAMES * 2];
+    static int16_t reference[VOICE_FRAMES * 2];
+    static int bus[VOICE_FRAMES * 2];
+
+    for ( int channels = 1 ; channels <= 2 ; channels++ ) {
+        TPodVector< int16_t > signal;
+        GenerateSignal( channels, 1234 + channels, signal );
+
+        for ( int sampleBits = 8 ; sampleBits <= 32 ; sampleBits *= 2 ) {
+            STestVoice voice;
+            CreateVoice( sampleBits, channels, signal, voice );
+
+            for ( int mode = MIX_DIRECT ; mode <= MIX_HRTF ; mode++ ) {
+                for ( int ramp = 0 ; ramp < 2 ; ramp++ ) {
+                    const int * curVol = mode == MIX_HRTF ? constVolHRTF : constVol;
+                    const int * newVol = ramp ? ( mode == MIX_HRTF ? rampVolHRTF : rampVol ) : curVol;
+
+                    RenderVoice( device, mixer, voice, curVol, newVol, (EMixMode)mode, dir, output );
+
+                    Core::ZeroMem( bus, sizeof( bus ) );
+                    if ( mode == MIX_HRTF ) {
+                        OldRenderFramesHRTF( hrtf, voice, curVol, newVol, dir, 255, bus );
+                    } else {
+                        OldRenderFrames( voice, curVol, newVol, mode == MIX_SPATIALIZED, bus );
+                    }
+                    OldWriteSamples16( bus, reference );
+
+                    const int rampSize = ramp && mode != MIX_HRTF ? Math::Min( VOICE_FRAMES, Snd_VolumeRampSize.GetInteger() ) : 0;
+
+                    const int maxDiff = MaxDifferenceOld( output, reference, voice, rampSize, mode == MIX_SPATIALIZED );
+                    TEST_CHECK_MSG( maxDiff <= MAX_ERROR, "%d-bit %s %s voice%s: max difference %d",
+                                    sampleBits, channels == 1 ? "mono" : "stereo", MixModeName[mode], ramp ? " with volume ramp" : "", maxDiff );
+                    TEST_CHECK( MaxAmplitude( output ) > 1000 );
+                }
+            }
+
+            voice.pBuffer->RemoveRef();
+        }
+
+        // 8-bit samples on HRTF path: the integer mixer scaled them by 248 instead of 255
+        {
+            STestVoice voice8;
+            CreateVoice( 8, channels, signal, voice8 );
+
+            RenderVoice( device, mixer, voice8, constVolHRTF, constVolHRTF, MIX_HRTF, dir, output );
+
+            Core::ZeroMem( bus, sizeof( bus ) );
+            OldRenderFramesHRTF( hrtf, voice8, constVolHRTF, constVolHRTF, dir, 248, bus );
+            OldWriteSamples16( bus, reference );
+
+            int maxDiff = 0;
+            for ( int i = 0 ; i < VOICE_FRAMES * 2 ; i++ ) {
+                maxDiff = Math::Max( maxDiff, Math::Abs( output[i] - (int)Math::Round( reference[i] * ( 255.0f / 248.0f ) ) ) );
+            }
+            TEST_CHECK_MSG( maxDiff <= MAX_ERROR + 1, "%s 8-bit HRTF voice is not scaled by 255/248: max difference %d",
+                            channels == 1 ? "mono" : "stereo", maxDiff );
+            TEST_CHECK( MaxAmplitude( output ) > MaxAmplitude( reference ) );
+            TEST_CHECK( MaxAmplitude( output ) < 32767 );
+
+            // Same samples in 16-bit format must sound the same now
+            STestVoice voice16;
+            CreateVoice( 16, channels, voice8.Samples, voice16 );
+
+            static int16_t output16[VOICE_FRAMES * 2];
+            RenderVoice( device, mixer, voice16, constVolHRTF, constVolHRTF, MIX_HRTF, dir, output16 );
+
+            maxDiff = MaxDifference( output, output16 );
+            TEST_CHECK_MSG( maxDiff <= MAX_ERROR, "%s 8-bit and 16-bit HRTF voices differ: max difference %d",
+                            channels == 1 ? "mono" : "stereo", maxDiff );
+
+            voice8.pBuffer->RemoveRef();
+            voice16.pBuffer->RemoveRef();
+        }
+    }
+
+    // Quiet channel: the integer mixer truncated volume below 256 to silence
+    {
+        TPodVector< int16_t > signal;
+        GenerateSignal( 1, 4321, signal );
+
+        STestVoice voice;
+        CreateVoice( 16, 1, signal, voice );
+
+        const int quietVol[2] = { QUIET_VOLUME, QUIET_VOLUME };
+
+        RenderVoice( device, mixer, voice, quietVol, quietVol, MIX_DIRECT, dir, output );
+
+        Core::ZeroMem( bus, sizeof( bus ) );
+        OldRenderFrames( voice, quietVol, quietVol, false, bus );
+        OldWriteSamples16( bus, reference );
+
+        TEST_CHECK( MaxAmplitude( reference ) == 0 );
+
+        int maxDiff = 0;
+        for ( int i = 0 ; i < VOICE_FRAMES ; i++ ) {
+            int expected = (int)( (double)signal[i] * QUIET_VOLUME / 65536 );
+            maxDiff = Math::Max( maxDiff, Math::Abs( output[i * 2] - expected ) );
+            maxDiff = Math::Max( maxDiff, Math::Abs( output[i * 2 + 1] - expected ) );
+        }
+        TEST_CHECK_MSG( maxDiff <= MAX_ERROR, "quiet voice: max difference %d", maxDiff );
+        TEST_CHECK( MaxAmplitude( output ) >= 32767 * QUIET_VOLUME / 65536 - MAX_ERROR );
+
+        voice.pBuffer->RemoveRef();
+    }
+
+    Snd_HRTF.ForceBool( true );
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    // HRTF data is loaded from embedded resources without the runtime
+    AArchive resources;
+    if ( !resources.OpenFromMemory( EmbeddedResources_Data, EmbeddedResources_Size ) ) {
+        TEST_CHECK_MSG( false, "failed to open embedded resources" );
+        return env.Finish( "AudioMixerTest" );
+    }
+
+    RunTests( resources );
+
+    return env.Finish( "AudioMixerTest" );
+}
@@ -0,0 +1,341 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Light voxelizer test
+
+Voxelizes a fixed set of box lights into the frustum cluster grid with the generic, SSE and AVX2 code paths.
+Per-cluster light lists are checked from both sides: every point of a light that is inside the frustum must find
+the light in its cluster, and every light listed in a cluster must not be separated from the cluster by the light
+box planes. All code paths must produce the same lists. Then the item capacity is lowered to check that overflowed
+clusters are clamped and accounted in the voxelizer statistics.
+
+*/
+
+#include "TestCommon.h"
+
+#include <World/Public/Render/LightVoxelizer.h>
+#include <Runtime/Public/RuntimeVariable.h>
+
+extern ARuntimeVariable com_ClusterSSE;
+extern ARuntimeVariable com_ClusterAVX2;
+extern ARuntimeVariable com_ClusterItemCapacity;
+
+static constexpr int NUM_RANDOM_LIGHTS = 48;
+static constexpr int NUM_OVERLAPPING_LIGHTS = 12;
+static constexpr int NUM_SAMPLES_PER_LIGHT = 1000;
+static constexpr int DEFAULT_CAPACITY = 256;
+static constexpr int OVERFLOW_CAPACITY = 4;
+
+// Reference separation test tolerance in box space
+static constexpr float BOX_EPSILON = 0.001f;
+
+enum ETestPath
+{
+    PATH_GENERIC,
+    PATH_SSE,
+    PATH_AVX2
+};
+
+static const char * PathName[] = { "generic", "SSE", "AVX2" };
+
+struct STestLight
+{
+    BvAxisAlignedBox Bounds;
+    Float4x4 OBBTransformInverse;
+};
+
+/** Voxelization result */
+struct STestGrid
+{
+    SClusterGrid Grid;
+    SLightVoxelizerStat Stat;
+    TPodVector< SClusterHeader > Headers;
+    TPodVector< SClusterPackedIndex > PackedIndices;
+
+    int GetNumLights( int _ClusterIndex ) const {
+        return Headers[_ClusterIndex].NumLights;
+    }
+
+    int GetLight( int _ClusterIndex, int _Index ) const {
+        return PackedIndices[Headers[_ClusterIndex].FirstPackedIndex + _Index].Indices & 0xfff;
+    }
+
+    bool HasLight( int _ClusterIndex, int _LightIndex ) const {
+        for ( int i = 0 ; i < GetNumLights( _ClusterIndex ) ; i++ ) {
+            if ( GetLight( _ClusterIndex, i ) == _LightIndex ) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static void AddLight( TPodVector< STestLight > & _Lights, Float3 const & _Center, Float3 const & _HalfSize ) {
+    STestLight & light = _Lights.Append();
+    light.Bounds.Mins = _Center - _HalfSize;
+    light.Bounds.Maxs = _Center + _HalfSize;
+    light.OBBTransformInverse = ( Float4x4::Translation( _Center ) * Float4x4::Scale( _HalfSize ) ).Inversed();
+}
+
+static void Voxelize( ALightVoxelizer & _Voxelizer, ETestPath _Path, int _Capacity, TPodVector< STestLight > const & _Lights,
+                      Float4x4 const & _ViewProj, Float4x4 const & _ViewProjInv, STestGrid & _Result ) {
+    com_ClusterAVX2.ForceBool( _Path == PATH_AVX2 );
+    com_ClusterSSE.ForceBool( _Path == PATH_SSE );
+    com_ClusterItemCapacity.ForceInteger( _Capacity );
+
+    _Voxelizer.Reset();
+
+    for ( int i = 0 ; i < _Lights.Size() ; i++ ) {
+        SItemInfo * info = _Voxelizer.AllocItem();
+        info->Type = ITEM_TYPE_LIGHT;
+        info->ListIndex = i;
+        info->Mins = _Lights[i].Bounds.Mins;
+        info->Maxs = _Lights[i].Bounds.Maxs;
+        info->ClipToBoxMat = _Lights[i].OBBTransformInverse * _ViewProjInv;
+        info->ClipToBoxMatSSE = info->ClipToBoxMat;
+    }
+
+    _Result.Grid = _Voxelizer.GetGrid();
+    _Result.Headers.ResizeInvalidate( _Result.Grid.GetNumClusters() );
+    _Result.PackedIndices.ResizeInvalidate( MAX_TOTAL_CLUSTER_ITEMS );
+
+    _Voxelizer.Voxelize( _ViewProj, _ViewProjInv, _Result.Headers.ToPtr(), _Result.PackedIndices.ToPtr() );
+
+    _Result.Stat = _Voxelizer.GetStat();
+}
+
+/** Returns cluster of the point the same way as unpack_cluster.frag or -1 if the point is outside of the cluster frustum */
+static int GetClusterIndex( SClusterGrid const & _Grid, Float4x4 const & _ViewProj, Float3 const & _Point ) {
+    const Float4 clip = _ViewProj * Float4( _Point, 1.0f );
+
+    // Linear depth
+    const float depth = clip.W;
+    if ( depth < FRUSTUM_CLUSTER_ZNEAR || depth > FRUSTUM_CLUSTER_ZFAR ) {
+        return -1;
+    }
+
+    const float x = clip.X / clip.W;
+    const float y = clip.Y / clip.W;
+    if ( x < -1.0f || x > 1.0f || y < -1.0f || y > 1.0f ) {
+        return -1;
+    }
+
+    const int clusterX = Math::Min( (int)floorf( ( x + 1.0f ) * ( 0.5f * _Grid.NumClustersX ) ), _Grid.NumClustersX - 1 );
+    const int clusterY = Math::Min( (int)floorf( ( y + 1.0f ) * ( 0.5f * _Grid.NumClustersY ) ), _Grid.NumClustersY - 1 );
+    const int slice = Math::Clamp( (int)floorf( std::log2( depth ) * _Grid.ViewSliceScale + _Grid.ViewSliceBias ), 0, _Grid.NumClustersZ - 1 );
+
+    return ( slice * _Grid.NumClustersY + clusterY ) * _Grid.NumClustersX + clusterX;
+}
+
+/** Returns false if all cluster corners are outside of one of the light box planes */
+static bool IsClusterTouchedReference( SClusterGrid const & _Grid, int _ClusterIndex, Float4x4 const & _ClipToBox ) {
+    const int clusterX = _ClusterIndex % _Grid.NumClustersX;
+    const int clusterY = ( _ClusterIndex / _Grid.NumClustersX ) % _Grid.NumClustersY;
+    const int slice = _ClusterIndex / ( _Grid.NumClustersX * _Grid.NumClustersY );
+
+    Float3 corners[8];
+    for ( int i = 0 ; i < 8 ; i++ ) {
+        const Float4 clip( ( clusterX + ( i & 1 ) ) * _Grid.ClusterWidth - 1.0f,
+                           ( clusterY + ( ( i >> 1 ) & 1 ) ) * _Grid.ClusterHeight - 1.0f,
+                           _Grid.SliceZClip[slice + ( ( i >> 2 ) & 1 )],
+                           1.0f );
+        const Float4 p = _ClipToBox * clip;
+        corners[i] = Float3( p.X / p.W, p.Y / p.W, p.Z / p.W );
+    }
+
+    for ( int axis = 0 ; axis < 3 ; axis++ ) {
+        int numOutsidePos = 0;
+        int numOutsideNeg = 0;
+        for ( int i = 0 ; i < 8 ; i++ ) {
+            numOutsidePos += corners[i][axis] > 1.0f + BOX_EPSILON;
+            numOutsideNeg += corners[i][axis] < -1.0f - BOX_EPSILON;
+        }
+        if ( numOutsidePos == 8 || numOutsideNeg == 8 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int CountClustersWithLight( STestGrid const & _Result, int _LightIndex ) {
+    int count = 0;
+    for ( int c = 0 ; c < _Result.Grid.GetNumClusters() ; c++ ) {
+        count += _Result.HasLight( c, _LightIndex );
+    }
+    return count;
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    // Camera at the origin looking along -Z
+    const Float4x4 viewProj = Float4x4::PerspectiveRevCC( Math::Radians( 90.0f ), 16.0f, 9.0f, FRUSTUM_CLUSTER_ZNEAR, FRUSTUM_CLUSTER_ZFAR );
+    const Float4x4 viewProjInv = viewProj.Inversed();
+
+    TPodVector< STestLight > lights;
+
+    // Light around the camera covers the whole first slice
+    const int cameraLight = lights.Size();
+    AddLight( lights, Float3( 0.0f ), Float3( 4.0f ) );
+
+    // Lights out of the cluster frustum
+    const int behindLight = lights.Size();
+    AddLight( lights, Float3( 0.0f, 0.0f, 20.0f ), Float3( 2.0f ) );
+    const int farLight = lights.Size();
+    AddLight( lights, Float3( 0.0f, 0.0f, -FRUSTUM_CLUSTER_ZFAR - 200.0f ), Float3( 10.0f ) );
+
+    STestRandom random( 1234 );
+    for ( int i = 0 ; i < NUM_RANDOM_LIGHTS ; i++ ) {
+        const Float3 center( random.Range( -60.0f, 60.0f ), random.Range( -30.0f, 30.0f ), random.Range( -200.0f, -1.0f ) );
+        const Float3 halfSize( random.Range( 0.25f, 6.0f ), random.Range( 0.25f, 6.0f ), random.Range( 0.25f, 6.0f ) );
+        AddLight( lights, center, halfSize );
+    }
+
+    ALightVoxelizer voxelizer;
+    STestGrid result[3];
+
+    for ( int path = PATH_GENERIC ; path <= PATH_AVX2 ; path++ ) {
+        Voxelize( voxelizer, (ETestPath)path, DEFAULT_CAPACITY, lights, viewProj, viewProjInv, result[path] );
+
+        if ( path == PATH_AVX2 && !voxelizer.IsAVX2() ) {
+            printf( "AVX2 is not supported, generic path is used instead\n" );
+        }
+    }
+
+    STestGrid const & reference = result[PATH_GENERIC];
+    SClusterGrid const & grid = reference.Grid;
+    const int numClustersPerSlice = grid.NumClustersX * grid.NumClustersY;
+
+    TEST_CHECK( reference.Stat.OverflowClusters == 0 );
+    TEST_CHECK( reference.Stat.DroppedItems == 0 );
+    TEST_CHECK( reference.Stat.DroppedPackedItems == 0 );
+
+    TEST_CHECK( CountClustersWithLight( reference, behindLight ) == 0 );
+    TEST_CHECK( CountClustersWithLight( reference, farLight ) == 0 );
+    for ( int c = 0 ; c < numClustersPerSlice ; c++ ) {
+        TEST_CHECK_MSG( reference.HasLight( c, cameraLight ), "cluster %d", c );
+    }
+
+    // Every visible point of a light must find the light in its cluster
+    int numSamples = 0;
+    for ( int i = 0 ; i < lights.Size() ; i++ ) {
+        BvAxisAlignedBox const & bounds = lights[i].Bounds;
+
+        for ( int s = 0 ; s < NUM_SAMPLES_PER_LIGHT ; s++ ) {
+            const Float3 point( random.Range( bounds.Mins.X, bounds.Maxs.X ),
+                                random.Range( bounds.Mins.Y, bounds.Maxs.Y ),
+                                random.Range( bounds.Mins.Z, bounds.Maxs.Z ) );
+
+            const int clusterIndex = GetClusterIndex( grid, viewProj, point );
+            if ( clusterIndex < 0 ) {
+                continue;
+            }
+
+            numSamples++;
+
+            TEST_CHECK_MSG( reference.HasLight( clusterIndex, i ), "light %d is missing in cluster %d", i, clusterIndex );
+        }
+    }
+
+    // Lights must not be added to clusters separated from the light box
+    int numClusterLights = 0;
+    for ( int c = 0 ; c < grid.GetNumClusters() ; c++ ) {
+        for ( int i = 0 ; i < reference.GetNumLights( c ) ; i++ ) {
+            const int lightIndex = reference.GetLight( c, i );
+            TEST_CHECK_MSG( IsClusterTouchedReference( grid, c, lights[lightIndex].OBBTransformInverse * viewProjInv ), "light %d is listed in cluster %d", lightIndex, c );
+        }
+        numClusterLights += reference.GetNumLights( c );
+    }
+
+    printf( "Light voxelizer: %d x %d x %d clusters, %d lights, %d cluster lights, %d visible samples\n",
+            grid.NumClustersX, grid.NumClustersY, grid.NumClustersZ, lights.Size(), numClusterLights, numSamples );
+
+    // All code paths must give the same lists
+    for ( int path = PATH_SSE ; path <= PATH_AVX2 ; path++ ) {
+        int numDifferent = 0;
+        for ( int c = 0 ; c < grid.GetNumClusters() ; c++ ) {
+            bool bSame = result[path].GetNumLights( c ) == reference.GetNumLights( c );
+            for ( int i = 0 ; bSame && i < reference.GetNumLights( c ) ; i++ ) {
+                bSame = result[path].HasLight( c, reference.GetLight( c, i ) );
+            }
+            numDifferent += !bSame;
+        }
+        TEST_CHECK_MSG( numDifferent == 0, "%d clusters of %s path differ from generic path", numDifferent, PathName[path] );
+    }
+
+    // Pile up lights in front of the camera and lower the capacity to overflow the clusters
+    for ( int i = 0 ; i < NUM_OVERLAPPING_LIGHTS ; i++ ) {
+        AddLight( lights, Float3( 0.0f, 0.0f, -20.0f ), Float3( 3.0f + i * 0.1f ) );
+    }
+
+    for ( int path = PATH_GENERIC ; path <= PATH_AVX2 ; path++ ) {
+        STestGrid full, clamped;
+
+        Voxelize( voxelizer, (ETestPath)path, DEFAULT_CAPACITY, lights, viewProj, viewProjInv, full );
+        Voxelize( voxelizer, (ETestPath)path, OVERFLOW_CAPACITY, lights, viewProj, viewProjInv, clamped );
+
+        TEST_CHECK( full.Stat.OverflowClusters == 0 );
+
+        int expectedOverflow = 0;
+        int expectedDropped = 0;
+        int expectedMax = 0;
+
+        for ( int c = 0 ; c < grid.GetNumClusters() ; c++ ) {
+            const int numLights = full.GetNumLights( c );
+
+            if ( numLights > OVERFLOW_CAPACITY ) {
+                expectedOverflow++;
+                expectedDropped += numLights - OVERFLOW_CAPACITY;
+            }
+            expectedMax = Math::Max( expectedMax, numLights );
+
+            TEST_CHECK_MSG( clamped.GetNumLights( c ) == Math::Min( numLights, OVERFLOW_CAPACITY ), "%s path, cluster %d", PathName[path], c );
+
+            for ( int i = 0 ; i < clamped.GetNumLights( c ) ; i++ ) {
+                TEST_CHECK( full.HasLight( c, clamped.GetLight( c, i ) ) );
+            }
+        }
+
+        TEST_CHECK( expectedOverflow > 0 );
+        TEST_CHECK( full.Stat.MaxClusterItems == expectedMax );
+        TEST_CHECK_MSG( clamped.Stat.OverflowClusters == expectedOverflow, "%s path: %d overflow clusters, expected %d", PathName[path], clamped.Stat.OverflowClusters, expectedOverflow );
+        TEST_CHECK_MSG( clamped.Stat.DroppedItems == expectedDropped, "%s path: %d dropped items, expected %d", PathName[path], clamped.Stat.DroppedItems, expectedDropped );
+        TEST_CHECK( clamped.Stat.MaxClusterItems == expectedMax );
+        TEST_CHECK( clamped.Stat.DroppedPackedItems == 0 );
+
+        if ( path == PATH_GENERIC ) {
+            printf( "Overflow: %d clusters, %d dropped lights, max %d lights per cluster\n", expectedOverflow, expectedDropped, expectedMax );
+        }
+    }
+
+    return env.Finish( "LightVoxelizerTest" );
+}
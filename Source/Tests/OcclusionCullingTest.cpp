@@ -0,0 +1,390 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Occlusion culling test
+
+Builds a level in the persistent level of a world: a large wall, a small panel, a large but finely
+tessellated surface and many small probe surfaces with random bounds. Occluders are marked by
+ABrushModel::MarkOccluders with the level defaults, then the probes are queried with
+AWorld::QueryVisiblePrimitives. The occlusion query goes through AVSD: occluder selection, binned
+rasterization (in parallel by the render frontend job list) and hierarchical Z tests.
+
+The culler must be conservative: a probe is never culled if any of its sample points is visible past the
+wall. It also has to cull most of the probes that are entirely hidden by the wall. Without occluders
+(vsd_MaxOccluders 0 or vsd_OcclusionCulling 0) hidden probes must be visible.
+
+Also random triangles are rasterized by the bands in parallel and on the calling thread, the depth
+pyramids must be equal.
+
+*/
+
+#include "TestCommon.h"
+
+#include <World/Public/World.h>
+#include <World/Public/Level.h>
+#include <World/Public/Render/OcclusionBuffer.h>
+#include <Core/Public/BV/BvFrustum.h>
+#include <Runtime/Public/Runtime.h>
+
+extern ARuntimeVariable com_OccluderMinArea;
+extern ARuntimeVariable com_OccluderMaxTriangles;
+extern ARuntimeVariable com_MaxOccluders;
+extern ARuntimeVariable vsd_OcclusionCulling;
+extern ARuntimeVariable vsd_MaxOccluders;
+
+// Wall is a quad in plane Z = WALL_Z
+static constexpr float WALL_Z = -10.0f;
+static constexpr float WALL_HALF_WIDTH = 6.0f;
+static constexpr float WALL_HALF_HEIGHT = 4.0f;
+
+// Reference tolerance. Occlusion buffer has low resolution, so the silhouette of the wall
+// is extended (for visible boxes) or shrinked (for hidden boxes) by a couple of texels.
+static constexpr float WALL_MARGIN = 0.25f;
+
+// Finely tessellated surface is too complex to be an occluder. It's placed behind the camera.
+static constexpr int GRID_SIZE = 8;
+
+static constexpr int NUM_PROBES = 4000;
+
+static constexpr int NUM_RANDOM_TRIANGLES = 2000;
+
+static constexpr int NUM_WORKER_THREADS = 4;
+
+static SSurfaceDef & AddSurface( ABrushModel * _Model ) {
+    SSurfaceDef & surf = _Model->Surfaces.Append();
+    Core::ZeroMem( &surf, sizeof( surf ) );
+
+    surf.Model = _Model;
+    surf.FirstVertex = _Model->Vertices.Size();
+    surf.FirstIndex = _Model->Indices.Size();
+    surf.Face = PlaneF( Float3( 0, 0, 1 ), 0.0f );
+    surf.QueryGroup = VSD_QUERY_MASK_VISIBLE;
+    surf.VisGroup = VISIBILITY_GROUP_DEFAULT;
+    surf.Bounds.Clear();
+
+    return surf;
+}
+
+static void AddVertex( ABrushModel * _Model, SSurfaceDef & _Surf, Float3 const & _Position ) {
+    SMeshVertex & v = _Model->Vertices.Append();
+    Core::ZeroMem( &v, sizeof( v ) );
+    v.Position = _Position;
+
+    _Surf.Bounds.AddPoint( _Position );
+    _Surf.NumVertices++;
+}
+
+/** Quad in plane Z = _Center.Z, two triangles */
+static void AddQuad( ABrushModel * _Model, Float3 const & _Center, float _HalfWidth, float _HalfHeight ) {
+    SSurfaceDef & surf = AddSurface( _Model );
+
+    AddVertex( _Model, surf, _Center + Float3( -_HalfWidth, -_HalfHeight, 0 ) );
+    AddVertex( _Model, surf, _Center + Float3(  _HalfWidth, -_HalfHeight, 0 ) );
+    AddVertex( _Model, surf, _Center + Float3(  _HalfWidth,  _HalfHeight, 0 ) );
+    AddVertex( _Model, surf, _Center + Float3( -_HalfWidth,  _HalfHeight, 0 ) );
+
+    const unsigned int indices[6] = { 0, 1, 2, 2, 3, 0 };
+    _Model->Indices.Append( indices, 6 );
+    surf.NumIndices = 6;
+}
+
+/** Quad in plane Z = _Center.Z split to GRID_SIZE x GRID_SIZE cells */
+static void AddGrid( ABrushModel * _Model, Float3 const & _Center, float _HalfSize ) {
+    SSurfaceDef & surf = AddSurface( _Model );
+
+    for ( int y = 0 ; y <= GRID_SIZE ; y++ ) {
+        for ( int x = 0 ; x <= GRID_SIZE ; x++ ) {
+            AddVertex( _Model, surf, _Center + Float3( Math::Lerp( -_HalfSize, _HalfSize, ( float )x / GRID_SIZE ),
+                                                       Math::Lerp( -_HalfSize, _HalfSize, ( float )y / GRID_SIZE ), 0 ) );
+        }
+    }
+
+    for ( int y = 0 ; y < GRID_SIZE ; y++ ) {
+        for ( int x = 0 ; x < GRID_SIZE ; x++ ) {
+            const unsigned int i0 = y * ( GRID_SIZE + 1 ) + x;
+            const unsigned int i1 = i0 + 1;
+            const unsigned int i2 = i0 + GRID_SIZE + 2;
+            const unsigned int i3 = i0 + GRID_SIZE + 1;
+            const unsigned int indices[6] = { i0, i1, i2, i2, i3, i0 };
+            _Model->Indices.Append( indices, 6 );
+            surf.NumIndices += 6;
+        }
+    }
+}
+
+/** Probe is a tiny surface with the bounds of the box */
+static void AddProbe( ABrushModel * _Model, BvAxisAlignedBox const & _Box ) {
+    AddQuad( _Model, _Box.Center(), 0.01f, 0.01f );
+
+    _Model->Surfaces.Last().Bounds = _Box;
+}
+
+/** Is the point hidden behind the wall extended by _Margin (negative margin shrinks the wall) */
+static bool IsPointBehindWall( Float3 const & _Point, float _Margin ) {
+    if ( _Point.Z >= WALL_Z ) {
+        return false;
+    }
+
+    // Intersection of the segment from the camera (at origin) to the point with the wall plane
+    float t = WALL_Z / _Point.Z;
+    float x = _Point.X * t;
+    float y = _Point.Y * t;
+
+    return Math::Abs( x ) <= WALL_HALF_WIDTH + _Margin && Math::Abs( y ) <= WALL_HALF_HEIGHT + _Margin;
+}
+
+static bool IsPointInFrustum( Float4x4 const & _ViewProjection, Float3 const & _Point ) {
+    Float4 v = _ViewProjection * Float4( _Point, 1.0f );
+
+    return v.W > 0 && Math::Abs( v.X ) <= v.W && Math::Abs( v.Y ) <= v.W;
+}
+
+/** Reference: box is visible if any of its surface sample points is inside the frustum and not hidden by the wall */
+static bool IsBoxVisibleReference( Float4x4 const & _ViewProjection, BvAxisAlignedBox const & _Box ) {
+    const int GRID = 6;
+
+    for ( int axis = 0 ; axis < 3 ; axis++ ) {
+        int u = ( axis + 1 ) % 3;
+        int v = ( axis + 2 ) % 3;
+
+        for ( int side = 0 ; side < 2 ; side++ ) {
+            for ( int i = 0 ; i <= GRID ; i++ ) {
+                for ( int j = 0 ; j <= GRID ; j++ ) {
+                    Float3 p;
+                    p[axis] = side ? _Box.Maxs[axis] : _Box.Mins[axis];
+                    p[u] = Math::Lerp( _Box.Mins[u], _Box.Maxs[u], ( float )i / GRID );
+                    p[v] = Math::Lerp( _Box.Mins[v], _Box.Maxs[v], ( float )j / GRID );
+
+                    if ( IsPointInFrustum( _ViewProjection, p ) && !IsPointBehindWall( p, WALL_MARGIN ) ) {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+/** Reference: box is entirely hidden if all corners are hidden (the wall and projection of the box are convex) */
+static bool IsBoxHiddenReference( BvAxisAlignedBox const & _Box ) {
+    for ( int i = 0 ; i < 8 ; i++ ) {
+        Float3 corner( ( i & 4 ) ? _Box.Maxs.X : _Box.Mins.X,
+                       ( i & 2 ) ? _Box.Maxs.Y : _Box.Mins.Y,
+                       ( i & 1 ) ? _Box.Maxs.Z : _Box.Mins.Z );
+
+        if ( !IsPointBehindWall( corner, -WALL_MARGIN ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct SQueryStats
+{
+    int NumVisible;
+    int NumHidden;
+    int NumHiddenCulled;
+    int NumFalseCulled;
+};
+
+static SQueryStats QueryProbes( AWorld * _World, ABrushModel const * _Model, int _FirstProbe, Float4x4 const & _ViewProjection ) {
+    BvFrustum frustum;
+    frustum.FromMatrix( _ViewProjection, true );
+
+    SVisibilityQuery query;
+    for ( int i = 0 ; i < 6 ; i++ ) {
+        query.FrustumPlanes[i] = &frustum[i];
+    }
+    query.ViewPosition = Float3( 0.0f );
+    query.ViewRightVec = Float3( 1, 0, 0 );
+    query.ViewUpVec = Float3( 0, 1, 0 );
+    query.VisibilityMask = VISIBILITY_GROUP_DEFAULT;
+    query.QueryMask = VSD_QUERY_MASK_VISIBLE;
+    query.ViewProjection = &_ViewProjection;
+
+    TPodVector< SPrimitiveDef * > visPrimitives;
+    TPodVector< SSurfaceDef * > visSurfs;
+    int visPass;
+
+    _World->QueryVisiblePrimitives( visPrimitives, visSurfs, &visPass, query );
+
+    SQueryStats stats = {};
+
+    for ( int i = _FirstProbe ; i < _Model->Surfaces.Size() ; i++ ) {
+        SSurfaceDef const & probe = _Model->Surfaces[i];
+        BvAxisAlignedBox const & box = probe.Bounds;
+
+        bool bCulled = probe.VisPass != visPass;
+
+        if ( IsBoxVisibleReference( _ViewProjection, box ) ) {
+            stats.NumVisible++;
+
+            if ( bCulled ) {
+                stats.NumFalseCulled++;
+                TEST_CHECK_MSG( !bCulled, "visible box (%f %f %f) - (%f %f %f) was culled",
+                                box.Mins.X, box.Mins.Y, box.Mins.Z, box.Maxs.X, box.Maxs.Y, box.Maxs.Z );
+            }
+        } else if ( IsBoxHiddenReference( box ) ) {
+            stats.NumHidden++;
+
+            if ( bCulled ) {
+                stats.NumHiddenCulled++;
+            }
+        }
+    }
+
+    return stats;
+}
+
+static void CompareBinnedRasterization( Float4x4 const & _ViewProjection ) {
+    STestRandom random( 4321 );
+
+    TPodVector< Float3 > vertices;
+    TPodVector< unsigned int > indices;
+
+    for ( int i = 0 ; i < NUM_RANDOM_TRIANGLES ; i++ ) {
+        Float3 center( random.Range( -30, 30 ), random.Range( -15, 15 ), random.Range( -40, 1 ) );
+
+        for ( int j = 0 ; j < 3 ; j++ ) {
+            indices.Append( vertices.Size() );
+            vertices.Append( center + Float3( random.Range( -3, 3 ), random.Range( -3, 3 ), random.Range( -3, 3 ) ) );
+        }
+    }
+
+    AOcclusionBuffer serial;
+    AOcclusionBuffer parallel;
+
+    serial.Clear( _ViewProjection );
+    serial.RasterizeTriangles( vertices.ToPtr(), sizeof( Float3 ), indices.ToPtr(), indices.Size() );
+    serial.BuildHiZ();
+
+    parallel.Clear( _ViewProjection );
+    parallel.RasterizeTriangles( vertices.ToPtr(), sizeof( Float3 ), indices.ToPtr(), indices.Size() );
+    parallel.BuildHiZ( GRenderFrontendJobList );
+
+    TEST_CHECK( serial.GetNumRasterizedTriangles() > NUM_RANDOM_TRIANGLES / 2 );
+    TEST_CHECK( serial.GetNumRasterizedTriangles() == parallel.GetNumRasterizedTriangles() );
+
+    for ( int lod = 0 ; lod < AOcclusionBuffer::NUM_LODS ; lod++ ) {
+        const size_t size = sizeof( float ) * serial.GetLodWidth( lod ) * serial.GetLodHeight( lod );
+
+        TEST_CHECK_MSG( !memcmp( serial.GetDepth( lod ), parallel.GetDepth( lod ), size ), "lod %d", lod );
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    GAsyncJobManager.Initialize( NUM_WORKER_THREADS, MAX_RUNTIME_JOB_LISTS );
+    GRenderFrontendJobList = GAsyncJobManager.GetAsyncJobList( RENDER_FRONTEND_JOB_LIST );
+
+    AWorld * world = AWorld::CreateWorld();
+    ALevel * level = world->GetPersistentLevel();
+
+    level->Model = CreateInstanceOf< ABrushModel >();
+
+    ABrushModel * model = level->Model;
+
+    AddQuad( model, Float3( 0, 0, WALL_Z ), WALL_HALF_WIDTH, WALL_HALF_HEIGHT );   // area 96
+    AddQuad( model, Float3( -3, 2, -5 ), 0.25f, 0.25f );                          // area 0.25
+    AddGrid( model, Float3( 0, 0, 5 ), 10.0f );                                    // area 400, 128 triangles
+
+    const int firstProbe = model->Surfaces.Size();
+
+    STestRandom random( 12345 );
+
+    for ( int i = 0 ; i < NUM_PROBES ; i++ ) {
+        Float3 center( random.Range( -20, 20 ), random.Range( -10, 10 ), random.Range( -40, -2 ) );
+        Float3 halfSize( random.Range( 0.1f, 1.5f ), random.Range( 0.1f, 1.5f ), random.Range( 0.1f, 1.5f ) );
+
+        AddProbe( model, BvAxisAlignedBox( center - halfSize, center + halfSize ) );
+    }
+
+    // All surfaces are in the outdoor area
+    for ( int i = 0 ; i < model->Surfaces.Size() ; i++ ) {
+        level->AreaSurfaces.Append( i );
+    }
+    level->OutdoorArea.FirstSurface = 0;
+    level->OutdoorArea.NumSurfaces = model->Surfaces.Size();
+
+    // Same as ALevel::Initialize
+    TEST_CHECK( model->MarkOccluders( com_OccluderMinArea.GetFloat(), com_OccluderMaxTriangles.GetInteger(), com_MaxOccluders.GetInteger() ) == 1 );
+    TEST_CHECK( ( model->Surfaces[0].Flags & SURF_OCCLUDER ) != 0 );
+    TEST_CHECK( ( model->Surfaces[1].Flags & SURF_OCCLUDER ) == 0 );
+    TEST_CHECK( ( model->Surfaces[2].Flags & SURF_OCCLUDER ) == 0 );
+
+    // Only the largest candidates are marked
+    TEST_CHECK( model->MarkOccluders( 4.0f, 1024, 1 ) == 1 );
+    TEST_CHECK( ( model->Surfaces[2].Flags & SURF_OCCLUDER ) != 0 );
+    TEST_CHECK( ( model->Surfaces[0].Flags & SURF_OCCLUDER ) == 0 );
+
+    model->MarkOccluders( com_OccluderMinArea.GetFloat(), com_OccluderMaxTriangles.GetInteger(), com_MaxOccluders.GetInteger() );
+
+    // Camera at origin looks along -Z. Aspect ratio matches the occlusion buffer.
+    const float fovX = Math::Radians( 90.0f );
+    const float fovY = 2.0f * atanf( tanf( fovX * 0.5f ) * AOcclusionBuffer::HEIGHT / AOcclusionBuffer::WIDTH );
+    const Float4x4 viewProjection = Float4x4::PerspectiveRevCC( fovX, fovY, 0.1f, 100.0f );
+
+    CompareBinnedRasterization( viewProjection );
+
+    SQueryStats stats = QueryProbes( world, model, firstProbe, viewProjection );
+
+    printf( "Probes: %d visible, %d hidden by wall, %d of them culled, %d falsely culled\n",
+            stats.NumVisible, stats.NumHidden, stats.NumHiddenCulled, stats.NumFalseCulled );
+
+    // Make sure the random set covers both cases
+    TEST_CHECK( stats.NumVisible > NUM_PROBES / 10 );
+    TEST_CHECK( stats.NumHidden > NUM_PROBES / 20 );
+
+    // Hierarchical Z is conservative near the silhouette, but most of hidden boxes must be culled
+    TEST_CHECK_MSG( stats.NumHiddenCulled * 4 >= stats.NumHidden * 3, "%d of %d hidden boxes culled", stats.NumHiddenCulled, stats.NumHidden );
+
+    // Occluders out of the budget are not rasterized
+    vsd_MaxOccluders.ForceInteger( 0 );
+    stats = QueryProbes( world, model, firstProbe, viewProjection );
+    TEST_CHECK( stats.NumHiddenCulled == 0 );
+    TEST_CHECK( stats.NumFalseCulled == 0 );
+    vsd_MaxOccluders.ForceString( vsd_MaxOccluders.GetDefaultValue() );
+
+    vsd_OcclusionCulling.ForceBool( false );
+    stats = QueryProbes( world, model, firstProbe, viewProjection );
+    TEST_CHECK( stats.NumHiddenCulled == 0 );
+    TEST_CHECK( stats.NumFalseCulled == 0 );
+    vsd_OcclusionCulling.ForceBool( true );
+
+    world->Destroy();
+
+    GAsyncJobManager.Deinitialize();
+
+    return env.Finish( "OcclusionCullingTest" );
+}
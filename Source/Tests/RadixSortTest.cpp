@@ -0,0 +1,134 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Radix sort test
+
+Sorts random key/value pairs with RadixSort and with std::stable_sort by key. Values are the original
+positions of the items, so equal results mean both the order and the stability are right.
+
+Array sizes cover insertion sort (up to RADIX_SORT_SMALL_ARRAY items), a single chunk and the parallel
+chunks on the worker threads. Key sets cover full random 64-bit keys, a few distinct keys (long runs of
+equal keys), keys where only some bytes differ (the passes for the other bytes are skipped, including
+bytes in between and the high bytes), 32-bit sort keys as used by the render frontend and equal keys
+(all passes are skipped).
+
+*/
+
+#include "TestCommon.h"
+
+#include <Runtime/Public/RadixSort.h>
+#include <Runtime/Public/Runtime.h>
+
+#include <algorithm>
+
+static constexpr int NUM_WORKER_THREADS = 4;
+
+enum EKeySet
+{
+    KEYS_RANDOM,
+    KEYS_FEW_DISTINCT,
+    KEYS_SPARSE_BYTES,
+    KEYS_32BIT,
+    KEYS_EQUAL,
+    KEYS_MAX
+};
+
+static const char * KeySetNames[KEYS_MAX] = { "random", "few distinct", "sparse bytes", "32-bit", "equal" };
+
+static uint64_t RandomKey( STestRandom & _Random, EKeySet _KeySet ) {
+    switch ( _KeySet ) {
+        case KEYS_RANDOM:
+            return ( (uint64_t)_Random.Next() << 32 ) | _Random.Next();
+        case KEYS_FEW_DISTINCT:
+            return ( (uint64_t)( _Random.Next() % 5 ) << 56 ) | 0x1234;
+        case KEYS_SPARSE_BYTES:
+            // Only the bytes 1 and 5 differ
+            return 0x0a00000000000003ull | ( (uint64_t)( _Random.Next() & 0xff ) << 8 ) | ( (uint64_t)( _Random.Next() & 0xff ) << 40 );
+        case KEYS_32BIT:
+            return _Random.Next();
+        case KEYS_EQUAL:
+        default:
+            return 0x0123456789abcdefull;
+    }
+}
+
+static void TestSort( STestRandom & _Random, int _Count, EKeySet _KeySet ) {
+    TPodVector< SRadixSortItem > items;
+    TPodVector< SRadixSortItem > temp;
+    TPodVector< SRadixSortItem > reference;
+
+    items.Resize( _Count );
+    temp.Resize( _Count );
+
+    for ( int i = 0 ; i < _Count ; i++ ) {
+        items[i].Key = RandomKey( _Random, _KeySet );
+        items[i].Value = i;
+    }
+
+    reference = items;
+
+    std::stable_sort( reference.Begin(), reference.End(), []( SRadixSortItem const & a, SRadixSortItem const & b ) {
+        return a.Key < b.Key;
+    } );
+
+    RadixSort( items.ToPtr(), temp.ToPtr(), _Count );
+
+    for ( int i = 0 ; i < _Count ; i++ ) {
+        if ( items[i].Key != reference[i].Key || items[i].Value != reference[i].Value ) {
+            TEST_CHECK_MSG( 0, "%d items, %s keys: item %d is (%llx, %llu), expected (%llx, %llu)", _Count, KeySetNames[_KeySet], i,
+                            (unsigned long long)items[i].Key, (unsigned long long)items[i].Value,
+                            (unsigned long long)reference[i].Key, (unsigned long long)reference[i].Value );
+            break;
+        }
+    }
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    GAsyncJobManager.Initialize( NUM_WORKER_THREADS, MAX_RUNTIME_JOB_LISTS );
+
+    STestRandom random( 2468 );
+
+    // Insertion sort, the insertion sort threshold, single chunk, parallel chunks with uneven sizes
+    const int counts[] = { 0, 1, 2, 3, 127, 128, 129, 1000, 8191, 20000, 100003 };
+
+    for ( int count : counts ) {
+        for ( int keySet = 0 ; keySet < KEYS_MAX ; keySet++ ) {
+            TestSort( random, count, (EKeySet)keySet );
+        }
+    }
+
+    GAsyncJobManager.Deinitialize();
+
+    return env.Finish( "RadixSortTest" );
+}
@@ -0,0 +1,412 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Batched raycast test
+
+Builds a level in the persistent level of a world: random surfaces (planar one-sided, planar two-sided
+and non-planar triangles) and random box and sphere primitives, movable and non-movable. Each primitive
+holds a triangle inside its bounds, the triangle is intersected by the primitive raycast callback.
+
+The same random rays are traced one by one with AWorld::RaycastClosest / RaycastClosestBounds and in
+parallel with AWorld::RaycastClosestBatch / RaycastClosestBoundsBatch. The results must be equal: hit or
+miss, hit distance, hit primitive and hit triangle.
+
+*/
+
+#include "TestCommon.h"
+
+#include <World/Public/World.h>
+#include <World/Public/Level.h>
+#include <Core/Public/BV/BvIntersect.h>
+#include <Runtime/Public/Runtime.h>
+
+static constexpr int NUM_SURFACES = 300;
+
+static constexpr int NUM_PRIMITIVES = 200;
+
+static constexpr int NUM_RAYS = 5000;
+
+static constexpr int NUM_WORKER_THREADS = 4;
+
+static constexpr float WORLD_HALF_SIZE = 20.0f;
+
+static constexpr float RAY_LENGTH = 40.0f;
+
+static SPrimitiveDef Primitives[NUM_PRIMITIVES];
+
+static Float3 PrimitiveTriangles[NUM_PRIMITIVES][3];
+
+// Raycast never dereferences the primitive owner, so the owners are just unique addresses
+static uint8_t PrimitiveOwners[NUM_PRIMITIVES];
+
+static ASceneComponent * GetPrimitiveOwner( int _Index ) {
+    return reinterpret_cast< ASceneComponent * >( &PrimitiveOwners[_Index] );
+}
+
+static Float3 RandomPoint( STestRandom & _Random, float _HalfSize ) {
+    return Float3( _Random.Range( -_HalfSize, _HalfSize ), _Random.Range( -_HalfSize, _HalfSize ), _Random.Range( -_HalfSize, _HalfSize ) );
+}
+
+static SSurfaceDef & AddSurface( ABrushModel * _Model ) {
+    SSurfaceDef & surf = _Model->Surfaces.Append();
+    Core::ZeroMem( &surf, sizeof( surf ) );
+
+    surf.Model = _Model;
+    surf.FirstVertex = _Model->Vertices.Size();
+    surf.FirstIndex = _Model->Indices.Size();
+    surf.QueryGroup = VSD_QUERY_MASK_VISIBLE | VSD_QUERY_MASK_VISIBLE_IN_LIGHT_PASS;
+    surf.VisGroup = VISIBILITY_GROUP_DEFAULT;
+    surf.Bounds.Clear();
+
+    return surf;
+}
+
+static void AddVertex( ABrushModel * _Model, SSurfaceDef & _Surf, Float3 const & _Position ) {
+    SMeshVertex & v = _Model->Vertices.Append();
+    Core::ZeroMem( &v, sizeof( v ) );
+    v.Position = _Position;
+
+    _Surf.Bounds.AddPoint( _Position );
+    _Surf.NumVertices++;
+}
+
+/** Random planar quad, two triangles */
+static void AddPlanarQuad( ABrushModel * _Model, STestRandom & _Random, bool _bTwoSided ) {
+    SSurfaceDef & surf = AddSurface( _Model );
+
+    const Float3 center = RandomPoint( _Random, WORLD_HALF_SIZE );
+    const Float3 normal = RandomPoint( _Random, 1.0f ).Normalized();
+    const Float3 xAxis = Math::Cross( normal, Math::Abs( normal.X ) < 0.7f ? Float3( 1, 0, 0 ) : Float3( 0, 1, 0 ) ).Normalized() * _Random.Range( 0.5f, 4.0f );
+    const Float3 yAxis = Math::Cross( normal, xAxis ).Normalized() * _Random.Range( 0.5f, 4.0f );
+
+    // Counter clockwise when looking against the normal
+    AddVertex( _Model, surf, center - xAxis - yAxis );
+    AddVertex( _Model, surf, center + xAxis - yAxis );
+    AddVertex( _Model, surf, center + xAxis + yAxis );
+    AddVertex( _Model, surf, center - xAxis + yAxis );
+
+    const unsigned int indices[6] = { 0, 1, 2, 2, 3, 0 };
+    _Model->Indices.Append( indices, 6 );
+    surf.NumIndices = 6;
+
+    surf.Face = PlaneF( normal, center );
+    surf.Flags = SURF_PLANAR | ( _bTwoSided ? SURF_TWOSIDED : 0 );
+}
+
+/** Random non-planar surface, a fan of random triangles */
+static void AddTriangleFan( ABrushModel * _Model, STestRandom & _Random ) {
+    SSurfaceDef & surf = AddSurface( _Model );
+
+    const Float3 center = RandomPoint( _Random, WORLD_HALF_SIZE );
+    const int numTriangles = 1 + _Random.Next() % 4;
+
+    AddVertex( _Model, surf, center );
+    for ( int i = 0 ; i <= numTriangles ; i++ ) {
+        AddVertex( _Model, surf, center + RandomPoint( _Random, 3.0f ) );
+    }
+
+    for ( int i = 0 ; i < numTriangles ; i++ ) {
+        const unsigned int indices[3] = { 0, (unsigned int)i + 1, (unsigned int)i + 2 };
+        _Model->Indices.Append( indices, 3 );
+        surf.NumIndices += 3;
+    }
+
+    surf.Flags = ( _Random.Next() & 1 ) ? SURF_TWOSIDED : 0;
+}
+
+static bool RaycastPrimitiveClosest( SPrimitiveDef const * Self,
+                                     Float3 const & InRayStart,
+                                     Float3 const & InRayEnd,
+                                     STriangleHitResult & Hit,
+                                     SMeshVertex const ** pVertices ) {
+    Float3 const * triangle = PrimitiveTriangles[Self - Primitives];
+
+    const Float3 rayVec = InRayEnd - InRayStart;
+    const float hitDistanceMax = rayVec.Length();
+    if ( hitDistanceMax < 0.0001f ) {
+        return false;
+    }
+
+    const Float3 rayDir = rayVec / hitDistanceMax;
+
+    float d, u, v;
+    if ( !BvRayIntersectTriangle( InRayStart, rayDir, triangle[0], triangle[1], triangle[2], d, u, v, false ) || d >= hitDistanceMax ) {
+        return false;
+    }
+
+    Hit.Location = InRayStart + rayDir * d;
+    Hit.Normal = Math::Cross( triangle[1] - triangle[0], triangle[2] - triangle[0] ).Normalized();
+    Hit.UV.X = u;
+    Hit.UV.Y = v;
+    Hit.Distance = d;
+    Hit.Indices[0] = 0;
+    Hit.Indices[1] = 1;
+    Hit.Indices[2] = 2;
+    Hit.Material = nullptr;
+
+    *pVertices = nullptr;
+
+    return true;
+}
+
+static void EvaluatePrimitiveRaycastResult( SPrimitiveDef * Self,
+                                            ALevel const * LightingLevel,
+                                            SMeshVertex const * pVertices,
+                                            SMeshVertexUV const * pLightmapVerts,
+                                            int LightmapBlock,
+                                            unsigned int const * pIndices,
+                                            Float3 const & HitLocation,
+                                            Float2 const & HitUV,
+                                            Float3 * Vertices,
+                                            Float2 & TexCoord,
+                                            Float3 & LightmapSample ) {
+    Float3 const * triangle = PrimitiveTriangles[Self - Primitives];
+
+    Vertices[0] = triangle[pIndices[0]];
+    Vertices[1] = triangle[pIndices[1]];
+    Vertices[2] = triangle[pIndices[2]];
+    TexCoord = HitUV;
+    LightmapSample = Float3( 0.0f );
+}
+
+static void AddPrimitive( ALevel * _Level, STestRandom & _Random, int _Index ) {
+    SPrimitiveDef & primitive = Primitives[_Index];
+    Core::ZeroMem( &primitive, sizeof( primitive ) );
+
+    const Float3 center = RandomPoint( _Random, WORLD_HALF_SIZE );
+    const float radius = _Random.Range( 1.0f, 4.0f );
+
+    for ( int i = 0 ; i < 3 ; i++ ) {
+        PrimitiveTriangles[_Index][i] = center + RandomPoint( _Random, radius * 0.5f );
+    }
+
+    primitive.Owner = GetPrimitiveOwner( _Index );
+    primitive.RaycastClosestCallback = RaycastPrimitiveClosest;
+    primitive.EvaluateRaycastResult = EvaluatePrimitiveRaycastResult;
+    primitive.QueryGroup = VSD_QUERY_MASK_VISIBLE | VSD_QUERY_MASK_VISIBLE_IN_LIGHT_PASS;
+    primitive.VisGroup = VISIBILITY_GROUP_DEFAULT;
+    primitive.bIsOutdoor = true;
+    primitive.bNonMovable = ( _Index & 2 ) != 0;
+
+    if ( _Index & 1 ) {
+        primitive.Type = VSD_PRIMITIVE_SPHERE;
+        primitive.Sphere.Center = center;
+        primitive.Sphere.Radius = radius;
+    } else {
+        primitive.Type = VSD_PRIMITIVE_BOX;
+        primitive.Box.Mins = center - radius;
+        primitive.Box.Maxs = center + radius;
+    }
+
+    _Level->AddPrimitive( &primitive );
+}
+
+static void GenerateRays( STestRandom & _Random, SWorldRay * _Rays, int _NumRays ) {
+    for ( int i = 0 ; i < _NumRays ; i++ ) {
+        _Rays[i].Start = RandomPoint( _Random, WORLD_HALF_SIZE );
+        _Rays[i].End = _Rays[i].Start + RandomPoint( _Random, 1.0f ).Normalized() * RAY_LENGTH;
+    }
+}
+
+struct SCompareStats
+{
+    int NumHits;
+    int NumSurfaceHits;
+    int NumPrimitiveHits;
+};
+
+static SCompareStats CompareClosest( AWorld * _World, SWorldRay const * _Rays, int _NumRays ) {
+    TPodVector< SWorldRaycastClosestResult > results;
+    TPodVector< bool > hits;
+    results.Resize( _NumRays );
+    hits.Resize( _NumRays );
+
+    const int numHits = _World->RaycastClosestBatch( results.ToPtr(), hits.ToPtr(), _Rays, _NumRays );
+
+    SCompareStats stats = {};
+
+    for ( int i = 0 ; i < _NumRays ; i++ ) {
+        SWorldRaycastClosestResult reference;
+        const bool bHit = _World->RaycastClosest( reference, _Rays[i].Start, _Rays[i].End );
+
+        TEST_CHECK_MSG( hits[i] == bHit, "ray %d: batch hit %d, single hit %d", i, hits[i], bHit );
+        if ( !bHit || !hits[i] ) {
+            continue;
+        }
+
+        SWorldRaycastClosestResult const & result = results[i];
+
+        TEST_CHECK_MSG( result.TriangleHit.Distance == reference.TriangleHit.Distance,
+                        "ray %d: batch distance %f, single distance %f", i, result.TriangleHit.Distance, reference.TriangleHit.Distance );
+        TEST_CHECK_MSG( result.Object == reference.Object, "ray %d: hit different primitives", i );
+        TEST_CHECK_MSG( result.Vertices[0] == reference.Vertices[0]
+                        && result.Vertices[1] == reference.Vertices[1]
+                        && result.Vertices[2] == reference.Vertices[2], "ray %d: hit different triangles", i );
+
+        stats.NumHits++;
+        if ( reference.Object ) {
+            stats.NumPrimitiveHits++;
+        } else {
+            stats.NumSurfaceHits++;
+        }
+    }
+
+    TEST_CHECK_MSG( numHits == stats.NumHits, "batch returned %d hits, expected %d", numHits, stats.NumHits );
+
+    return stats;
+}
+
+static SCompareStats CompareClosestBounds( AWorld * _World, SWorldRay const * _Rays, int _NumRays ) {
+    TPodVector< SBoxHitResult > results;
+    TPodVector< bool > hits;
+    results.Resize( _NumRays );
+    hits.Resize( _NumRays );
+
+    const int numHits = _World->RaycastClosestBoundsBatch( results.ToPtr(), hits.ToPtr(), _Rays, _NumRays );
+
+    SCompareStats stats = {};
+
+    for ( int i = 0 ; i < _NumRays ; i++ ) {
+        SBoxHitResult reference;
+        const bool bHit = _World->RaycastClosestBounds( reference, _Rays[i].Start, _Rays[i].End );
+
+        TEST_CHECK_MSG( hits[i] == bHit, "ray %d: batch bounds hit %d, single bounds hit %d", i, hits[i], bHit );
+        if ( !bHit || !hits[i] ) {
+            continue;
+        }
+
+        SBoxHitResult const & result = results[i];
+
+        TEST_CHECK_MSG( result.DistanceMin == reference.DistanceMin && result.DistanceMax == reference.DistanceMax,
+                        "ray %d: batch distance %f..%f, single distance %f..%f", i,
+                        result.DistanceMin, result.DistanceMax, reference.DistanceMin, reference.DistanceMax );
+        TEST_CHECK_MSG( result.Object == reference.Object, "ray %d: hit different bounds", i );
+
+        stats.NumHits++;
+        if ( reference.Object ) {
+            stats.NumPrimitiveHits++;
+        } else {
+            stats.NumSurfaceHits++;
+        }
+    }
+
+    TEST_CHECK_MSG( numHits == stats.NumHits, "bounds batch returned %d hits, expected %d", numHits, stats.NumHits );
+
+    return stats;
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    GAsyncJobManager.Initialize( NUM_WORKER_THREADS, MAX_RUNTIME_JOB_LISTS );
+    GRenderFrontendJobList = GAsyncJobManager.GetAsyncJobList( RENDER_FRONTEND_JOB_LIST );
+
+    AWorld * world = AWorld::CreateWorld();
+    ALevel * level = world->GetPersistentLevel();
+
+    level->Model = CreateInstanceOf< ABrushModel >();
+
+    ABrushModel * model = level->Model;
+
+    // All surfaces use material 0
+    model->SurfaceMaterials.resize( 1 );
+
+    STestRandom random( 9876 );
+
+    for ( int i = 0 ; i < NUM_SURFACES ; i++ ) {
+        switch ( i % 3 ) {
+            case 0:
+                AddPlanarQuad( model, random, false );
+                break;
+            case 1:
+                AddPlanarQuad( model, random, true );
+                break;
+            case 2:
+                AddTriangleFan( model, random );
+                break;
+        }
+    }
+
+    // All surfaces are in the outdoor area
+    for ( int i = 0 ; i < model->Surfaces.Size() ; i++ ) {
+        level->AreaSurfaces.Append( i );
+    }
+    level->OutdoorArea.FirstSurface = 0;
+    level->OutdoorArea.NumSurfaces = model->Surfaces.Size();
+
+    for ( int i = 0 ; i < NUM_PRIMITIVES ; i++ ) {
+        AddPrimitive( level, random, i );
+    }
+
+    // Link the primitives to the outdoor area
+    AWorld::UpdateWorlds( 0.0f );
+
+    TPodVector< SWorldRay > rays;
+    rays.Resize( NUM_RAYS );
+    GenerateRays( random, rays.ToPtr(), NUM_RAYS );
+
+    SCompareStats stats = CompareClosest( world, rays.ToPtr(), NUM_RAYS );
+
+    printf( "Closest: %d of %d rays hit, %d surfaces, %d primitives\n", stats.NumHits, NUM_RAYS, stats.NumSurfaceHits, stats.NumPrimitiveHits );
+
+    // Make sure the random set covers misses, surface hits and primitive hits
+    TEST_CHECK( stats.NumHits < NUM_RAYS );
+    TEST_CHECK( stats.NumSurfaceHits > NUM_RAYS / 20 );
+    TEST_CHECK( stats.NumPrimitiveHits > NUM_RAYS / 50 );
+
+    stats = CompareClosestBounds( world, rays.ToPtr(), NUM_RAYS );
+
+    printf( "Closest bounds: %d of %d rays hit, %d surfaces, %d primitives\n", stats.NumHits, NUM_RAYS, stats.NumSurfaceHits, stats.NumPrimitiveHits );
+
+    TEST_CHECK( stats.NumHits < NUM_RAYS );
+    TEST_CHECK( stats.NumSurfaceHits > NUM_RAYS / 20 );
+    TEST_CHECK( stats.NumPrimitiveHits > NUM_RAYS / 50 );
+
+    // Batches smaller than the number of the batch tasks, each task traces a single ray
+    for ( int numRays = 1 ; numRays <= 5 ; numRays++ ) {
+        GenerateRays( random, rays.ToPtr(), numRays );
+
+        CompareClosest( world, rays.ToPtr(), numRays );
+        CompareClosestBounds( world, rays.ToPtr(), numRays );
+    }
+
+    for ( int i = 0 ; i < NUM_PRIMITIVES ; i++ ) {
+        level->RemovePrimitive( &Primitives[i] );
+    }
+    AWorld::UpdateWorlds( 0.0f );
+
+    world->Destroy();
+
+    GAsyncJobManager.Deinitialize();
+
+    return env.Finish( "RaycastBatchTest" );
+}
@@ -0,0 +1,429 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Static draw cache test
+
+Drives AStaticDrawCache through the same calls ARenderFrontend makes for non-movable static meshes
+(BeginFrame per view, Find, GetInstances, Store after the instances were built) for a set of simulated
+components over many frames and two views: one with a camera that moves most of the time, and one with a still camera.
+Components are moved, get new materials, meshes and GPU buffers are changed, components are hidden and shown again.
+Each frame the instances that come through the cache are compared with the instances built without the cache,
+like ARenderFrontend::AddStaticMesh builds them. Any stale entry or stale matrix shows up as a difference.
+
+*/
+
+#include "TestCommon.h"
+
+#include <World/Public/Render/StaticDrawCache.h>
+
+static constexpr int NUM_COMPONENTS = 64;
+static constexpr int MAX_SUBPARTS = 4;
+static constexpr int NUM_FRAMES = 2000;
+static constexpr int NUM_VIEWS = 2;
+
+// Fake engine and GPU objects. The cache never dereferences them.
+#define FAKE_POINTER( _Type, _Value ) reinterpret_cast< _Type * >( size_t( _Value ) * 16 + 0x10000 )
+
+/** Simulated state of the component, mesh and vertex memory */
+struct STestComponent
+{
+    uint64_t Id;
+    uint32_t RenderRevision;
+    uint32_t MeshRevision;
+    Float3x4 WorldTransform;
+    Float3x4 RenderTransform;
+    Float3x3 WorldRotation;
+    int NumSubparts;
+    int MaterialInstances[MAX_SUBPARTS];
+    int FirstIndex[MAX_SUBPARTS];
+    int IndexCount[MAX_SUBPARTS];
+    int VertexHandle;
+    int LightmapBlock;
+    bool bVisible;
+};
+
+struct STestWorld
+{
+    STestComponent Components[NUM_COMPONENTS];
+
+    /** Material of each material instance */
+    int Materials[2000];
+
+    /** AMaterialInstance::GetMaterialRevision */
+    uint32_t MaterialRevision = 0;
+
+    /** AVertexMemoryGPU::GetRevision */
+    uint32_t VertexMemoryRevision = 0;
+
+    /** Vertex memory defragmentation moves all buffers */
+    size_t VertexMemoryBase = 0;
+
+    /** Material frame data changes every frame, like AMaterialInstance::PreRenderUpdate */
+    int FrameNumber = 0;
+};
+
+static uint8_t MaterialPriority( int _Material ) {
+    return ( _Material & 3 ) << 4;
+}
+
+static SMaterialFrameData * MaterialFrameData( STestWorld const & _World, int _MaterialInstance ) {
+    return FAKE_POINTER( SMaterialFrameData, _World.FrameNumber * 4096 + _MaterialInstance );
+}
+
+/** Like GetStaticDrawCacheKey in the render frontend */
+static void GetKey( STestWorld const & _World, STestComponent const & _Component, AStaticDrawCache::SKey & _Key ) {
+    Core::ZeroMem( &_Key, sizeof( _Key ) );
+    _Key.ComponentRevision = _Component.RenderRevision;
+    _Key.MeshRevision = _Component.MeshRevision;
+    _Key.VertexMemoryRevision = _World.VertexMemoryRevision;
+    _Key.MaterialRevision = _World.MaterialRevision;
+    _Key.LightmapBlock = _Component.LightmapBlock;
+    _Key.LightmapOffset = Float4( 0, 0, 1, 1 );
+}
+
+/** Reference: build instances without the cache, like ARenderFrontend::AddStaticMesh does. Updates the render transform. */
+static void BuildInstances( STestWorld const & _World, SRenderView const & _View, STestComponent & _Component, SRenderInstance * _Instances, uint8_t * _Lists ) {
+    Float4x4 instanceMatrix = _View.ViewProjection * _Component.WorldTransform;
+    Float4x4 instanceMatrixP = _View.ViewProjectionP * _Component.RenderTransform;
+
+    _Component.RenderTransform = _Component.WorldTransform;
+
+    for ( int i = 0 ; i < _Component.NumSubparts ; i++ ) {
+        SRenderInstance & instance = _Instances[i];
+
+        const int material = _World.Materials[_Component.MaterialInstances[i]];
+
+        Core::ZeroMem( &instance, sizeof( instance ) );
+
+        instance.Material = FAKE_POINTER( AMaterialGPU, material );
+        instance.MaterialInstance = MaterialFrameData( _World, _Component.MaterialInstances[i] );
+        instance.VertexBuffer = FAKE_POINTER( RenderCore::IBuffer, 1 );
+        instance.VertexBufferOffset = _World.VertexMemoryBase + _Component.VertexHandle * 4096;
+        instance.IndexBuffer = FAKE_POINTER( RenderCore::IBuffer, 2 );
+        instance.IndexBufferOffset = _World.VertexMemoryBase + _Component.VertexHandle * 4096 + 2048;
+        instance.Lightmap = FAKE_POINTER( RenderCore::ITexture, _Component.LightmapBlock );
+        instance.LightmapOffset = Float4( 0, 0, 1, 1 );
+        instance.IndexCount = _Component.IndexCount[i];
+        instance.StartIndexLocation = _Component.FirstIndex[i];
+        instance.InstanceCount = 1;
+        instance.Matrix = instanceMatrix;
+        instance.MatrixP = instanceMatrixP;
+        instance.ModelNormalToViewSpace = _View.NormalToViewMatrix * _Component.WorldRotation;
+        instance.GenerateSortKey( MaterialPriority( material ), _Component.Id );
+
+        _Lists[i] = material & 1;
+    }
+}
+
+/** Take instances from the cache, like ARenderFrontend::AddStaticMesh and AddCachedStaticMesh do. Returns false on cache miss. */
+static bool AddCachedInstances( AStaticDrawCache & _Cache, STestWorld const & _World, STestComponent const & _Component, SRenderInstance * _Instances, uint8_t * _Lists ) {
+    AStaticDrawCache::SKey key;
+    GetKey( _World, _Component, key );
+
+    AStaticDrawCache::SEntry * entry = _Cache.Find( _Component.Id, key );
+    if ( !entry || entry->NumSubparts != _Component.NumSubparts ) {
+        return false;
+    }
+
+    _Cache.GetInstances( entry, _Component.WorldTransform, _Instances, _Lists );
+
+    AStaticDrawCache::SSubpart const * subparts = _Cache.GetSubparts( entry );
+
+    for ( int i = 0 ; i < entry->NumSubparts ; i++ ) {
+        _Instances[i].MaterialInstance = MaterialFrameData( _World, (int)( ( (size_t)subparts[i].MaterialInstance - 0x10000 ) / 16 ) );
+        _Instances[i].GenerateSortKey( subparts[i].Priority, _Component.Id );
+    }
+    return true;
+}
+
+/** Like ARenderFrontend::UpdateStaticDrawCache */
+static void StoreInstances( AStaticDrawCache & _Cache, STestWorld const & _World, STestComponent const & _Component, SRenderInstance const * _Instances, uint8_t const * _Lists ) {
+    AStaticDrawCache::SSubpart subparts[MAX_SUBPARTS];
+
+    for ( int i = 0 ; i < _Component.NumSubparts ; i++ ) {
+        subparts[i].Instance = _Instances[i];
+        subparts[i].MaterialInstance = FAKE_POINTER( AMaterialInstance, _Component.MaterialInstances[i] );
+        subparts[i].Lists = _Lists[i];
+        subparts[i].Priority = MaterialPriority( _World.Materials[_Component.MaterialInstances[i]] );
+    }
+
+    AStaticDrawCache::SKey key;
+    GetKey( _World, _Component, key );
+
+    _Cache.Store( _Component.Id, key, _Component.WorldRotation, subparts, _Component.NumSubparts );
+}
+
+static bool IsSameInstance( SRenderInstance const & _A, SRenderInstance const & _B ) {
+    return _A.Material == _B.Material
+        && _A.MaterialInstance == _B.MaterialInstance
+        && _A.VertexBuffer == _B.VertexBuffer
+        && _A.VertexBufferOffset == _B.VertexBufferOffset
+        && _A.IndexBuffer == _B.IndexBuffer
+        && _A.IndexBufferOffset == _B.IndexBufferOffset
+        && _A.Lightmap == _B.Lightmap
+        && _A.LightmapOffset == _B.LightmapOffset
+        && _A.Matrix == _B.Matrix
+        && _A.MatrixP == _B.MatrixP
+        && _A.ModelNormalToViewSpace == _B.ModelNormalToViewSpace
+        && _A.IndexCount == _B.IndexCount
+        && _A.StartIndexLocation == _B.StartIndexLocation
+        && _A.InstanceCount == _B.InstanceCount
+        && _A.SortKey == _B.SortKey;
+}
+
+static void SetTransform( STestComponent & _Component, STestRandom & _Random ) {
+    Quat rotation = Quat::RotationY( _Random.Range( 0, Math::_2PI ) );
+    _Component.WorldRotation = rotation.ToMatrix();
+    _Component.WorldTransform.Compose( Float3( _Random.Range( -100, 100 ), 0, _Random.Range( -100, 100 ) ), _Component.WorldRotation );
+}
+
+/** Random event on the component. Changes increment revisions like the engine does. */
+static void ChangeComponent( STestWorld & _World, STestComponent & _Component, STestRandom & _Random ) {
+    switch ( _Random.Next() % 5 ) {
+    case 0:
+        // Transform change (ADrawable::OnTransformDirty)
+        SetTransform( _Component, _Random );
+        _Component.RenderRevision++;
+        break;
+    case 1:
+        // Component material change (AMeshComponent::SetMaterialInstance)
+        _Component.MaterialInstances[_Random.Next() % _Component.NumSubparts] = _Random.Next() % 2000;
+        _Component.RenderRevision++;
+        break;
+    case 2:
+        // Material of material instance changed (AMaterialInstance::SetMaterial). It invalidates all entries, so it is rare.
+        if ( _Random.Next() % 16 == 0 ) {
+            _World.Materials[_Component.MaterialInstances[_Random.Next() % _Component.NumSubparts]] = _Random.Next() % 16;
+            _World.MaterialRevision++;
+        }
+        break;
+    case 3:
+        // Mesh reinitialized, subpart ranges or subpart materials changed (AIndexedMesh::GetRevision)
+        _Component.NumSubparts = 1 + _Random.Next() % MAX_SUBPARTS;
+        for ( int i = 0 ; i < _Component.NumSubparts ; i++ ) {
+            _Component.FirstIndex[i] = _Random.Next() % 1000;
+            _Component.IndexCount[i] = 3 + _Random.Next() % 1000;
+            _Component.MaterialInstances[i] = _Random.Next() % 2000;
+        }
+        _Component.MeshRevision++;
+        break;
+    case 4:
+        // Hide for a while
+        _Component.bVisible = false;
+        break;
+    }
+}
+
+static void SetView( SRenderView & _View, SRenderView const & _PrevView, Float3 const & _Position, float _Yaw ) {
+    Float3x3 viewRotation = Quat::RotationY( _Yaw ).ToMatrix();
+
+    _View.ViewProjection = Float4x4::PerspectiveRevCC( Math::Radians( 90.0f ), Math::Radians( 60.0f ), 0.1f, 1000.0f )
+                         * Float4x4( Float3x4( viewRotation ) ) * Float4x4::Translation( -_Position );
+    _View.ViewProjectionP = _PrevView.ViewProjection;
+    _View.NormalToViewMatrix = viewRotation;
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    STestRandom random( 777 );
+
+    STestWorld world;
+
+    for ( int i = 0 ; i < 2000 ; i++ ) {
+        world.Materials[i] = random.Next() % 16;
+    }
+
+    for ( int n = 0 ; n < NUM_COMPONENTS ; n++ ) {
+        STestComponent & component = world.Components[n];
+
+        Core::ZeroMem( &component, sizeof( component ) );
+
+        component.Id = 100 + n;
+        component.NumSubparts = 1 + n % MAX_SUBPARTS;
+        for ( int i = 0 ; i < component.NumSubparts ; i++ ) {
+            component.MaterialInstances[i] = random.Next() % 2000;
+            component.FirstIndex[i] = i * 300;
+            component.IndexCount[i] = 300;
+        }
+        component.VertexHandle = n;
+        component.LightmapBlock = n % 3;
+        component.bVisible = true;
+
+        SetTransform( component, random );
+    }
+
+    // Each view has its own cache, like the rendering parameters of the viewports
+    AStaticDrawCache cache[NUM_VIEWS];
+    SRenderView views[NUM_VIEWS];
+    Core::ZeroMem( views, sizeof( views ) );
+
+    SRenderInstance reference[MAX_SUBPARTS];
+    SRenderInstance cached[MAX_SUBPARTS];
+    uint8_t referenceLists[MAX_SUBPARTS];
+    uint8_t cachedLists[MAX_SUBPARTS];
+
+    int numHits[NUM_VIEWS] = {};
+    int numMisses[NUM_VIEWS] = {};
+    int numMismatches = 0;
+    int numStillFrames = 0;
+    int numStillViewRevisionChanges = 0;
+
+    for ( int frame = 1 ; frame <= NUM_FRAMES ; frame++ ) {
+        world.FrameNumber = frame;
+
+        // Events
+        if ( random.Next() % 200 == 0 ) {
+            // Vertex memory defragmentation (AVertexMemoryGPU::GetRevision)
+            world.VertexMemoryBase += 256;
+            world.VertexMemoryRevision++;
+        }
+
+        for ( int n = 0 ; n < NUM_COMPONENTS ; n++ ) {
+            STestComponent & component = world.Components[n];
+
+            if ( !component.bVisible ) {
+                // Some components stay hidden long enough to be removed from the cache
+                if ( random.Next() % ( n < NUM_COMPONENTS / 2 ? 50 : 2000 ) == 0 ) {
+                    component.bVisible = true;
+                }
+                continue;
+            }
+
+            if ( random.Next() % 20 == 0 ) {
+                ChangeComponent( world, component, random );
+            }
+        }
+
+        for ( int v = 0 ; v < NUM_VIEWS ; v++ ) {
+            SRenderView prevView = views[v];
+
+            if ( v == 0 ) {
+                // The camera moves most of the time and stops now and then
+                float t = ( frame % 300 ) < 250 ? frame : ( frame - frame % 300 + 250 );
+                SetView( views[v], prevView, Float3( 0, 2, -t * 0.1f ), t * 0.01f );
+            } else {
+                // Still camera
+                SetView( views[v], prevView, Float3( 10, 5, 10 ), 1.0f );
+            }
+
+            const bool bStill = views[v].ViewProjection == prevView.ViewProjection && views[v].ViewProjectionP == prevView.ViewProjectionP;
+            const uint32_t viewRevision = cache[v].GetViewRevision();
+
+            cache[v].BeginFrame( frame, &views[v] );
+
+            if ( bStill ) {
+                numStillFrames++;
+                numStillViewRevisionChanges += viewRevision != cache[v].GetViewRevision();
+            }
+
+            for ( int n = 0 ; n < NUM_COMPONENTS ; n++ ) {
+                STestComponent & component = world.Components[n];
+
+                if ( !component.bVisible ) {
+                    continue;
+                }
+
+                // The instances are stored only after the component kept its transform for a frame
+                const bool bStore = component.RenderTransform == component.WorldTransform;
+
+                const bool bHit = AddCachedInstances( cache[v], world, component, cached, cachedLists );
+
+                BuildInstances( world, views[v], component, reference, referenceLists );
+
+                if ( bHit ) {
+                    numHits[v]++;
+
+                    for ( int i = 0 ; i < component.NumSubparts ; i++ ) {
+                        if ( !IsSameInstance( reference[i], cached[i] ) || referenceLists[i] != cachedLists[i] ) {
+                            numMismatches++;
+                            TEST_CHECK_MSG( false, "frame %d view %d: cached instance of component %d subpart %d differs from uncached one", frame, v, n, i );
+                        }
+                    }
+                } else {
+                    numMisses[v]++;
+
+                    if ( bStore ) {
+                        StoreInstances( cache[v], world, component, reference, referenceLists );
+                    }
+                }
+            }
+
+            TEST_CHECK( cache[v].GetEntryCount() <= NUM_COMPONENTS );
+        }
+    }
+
+    printf( "Static draw cache: moving view %d hits %d misses, still view %d hits %d misses, %d mismatches\n",
+            numHits[0], numMisses[0], numHits[1], numMisses[1], numMismatches );
+
+    // The cache must actually be used: the camera moves, but the components rarely change
+    TEST_CHECK( numHits[0] > numMisses[0] * 4 );
+    TEST_CHECK( numHits[1] > numMisses[1] * 4 );
+
+    // Instances of a still view are reused with their matrices
+    TEST_CHECK( numStillFrames > NUM_FRAMES );
+    TEST_CHECK_MSG( numStillViewRevisionChanges == 0, "%d view revision changes without a view change", numStillViewRevisionChanges );
+
+    // Components that were hidden for a long time must be removed
+    int numHidden = 0;
+    for ( int n = 0 ; n < NUM_COMPONENTS ; n++ ) {
+        world.Components[n].bVisible = n >= NUM_COMPONENTS / 2;
+        numHidden += !world.Components[n].bVisible;
+    }
+    for ( int frame = NUM_FRAMES + 1 ; frame <= NUM_FRAMES + AStaticDrawCache::MAX_UNUSED_FRAMES * 3 ; frame++ ) {
+        world.FrameNumber = frame;
+
+        cache[1].BeginFrame( frame, &views[1] );
+
+        for ( int n = 0 ; n < NUM_COMPONENTS ; n++ ) {
+            STestComponent & component = world.Components[n];
+            if ( component.bVisible && !AddCachedInstances( cache[1], world, component, cached, cachedLists ) ) {
+                BuildInstances( world, views[1], component, reference, referenceLists );
+                StoreInstances( cache[1], world, component, reference, referenceLists );
+            }
+        }
+    }
+    TEST_CHECK_MSG( cache[1].GetEntryCount() == NUM_COMPONENTS - numHidden, "%d entries left", cache[1].GetEntryCount() );
+
+    // Sanity check of the test itself: a change without notification must be detected as a difference
+    {
+        STestComponent & component = world.Components[NUM_COMPONENTS - 1];
+
+        component.IndexCount[0] += 3;
+
+        TEST_CHECK( AddCachedInstances( cache[1], world, component, cached, cachedLists ) );
+        BuildInstances( world, views[1], component, reference, referenceLists );
+        TEST_CHECK( !IsSameInstance( reference[0], cached[0] ) );
+    }
+
+    return env.Finish( "StaticDrawCacheTest" );
+}
@@ -0,0 +1,152 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Terrain heightmap residency test
+
+Bakes a heightmap and samples rows of it on several threads while the main thread evicts tiles with
+ATerrainHeightmap::UpdateResidency and zero cache budget. Sampling threads of a frame are joined before
+the next frame starts, as the frame contract of UpdateResidency requires. Every sampled row must match
+the source heights. Tiles evicted under the samplers must stay readable until the next frame, run with
+the address sanitizer to catch use after free.
+
+*/
+
+#include "TestCommon.h"
+
+#include <World/Public/TerrainHeightmap.h>
+#include <Core/Public/Atomic.h>
+
+static constexpr int HEIGHTMAP_RESOLUTION = 513;
+static constexpr int NUM_FRAMES = 100;
+static constexpr int NUM_SAMPLING_THREADS = 4;
+static constexpr int NUM_ROWS_PER_THREAD = 200;
+
+// Rows are sampled with a few clamped samples on each side
+static constexpr int ROW_PADDING = 3;
+
+static const char * HeightmapFileName = "TerrainHeightmapTest.tiles";
+
+static float ProceduralHeight( int X, int Z ) {
+    return ( ( X * 7919 + Z * 104729 ) % 1000 ) * 0.01f;
+}
+
+struct SSamplingThread
+{
+    AThread Thread;
+    ATerrainHeightmap const * Heightmap;
+    int Frame;
+    int Seed;
+    int NumMismatches;
+};
+
+static AAtomicInt NumFinishedThreads;
+
+static void SampleRows( void * _Data ) {
+    SSamplingThread * self = ( SSamplingThread * )_Data;
+
+    float heights[HEIGHTMAP_RESOLUTION + ROW_PADDING * 2];
+
+    for ( int i = 0 ; i < NUM_ROWS_PER_THREAD ; i++ ) {
+        int z = ( i * 37 + self->Seed * 101 + self->Frame ) % HEIGHTMAP_RESOLUTION;
+
+        self->Heightmap->SampleRow( 0, -ROW_PADDING, z, HEIGHTMAP_RESOLUTION + ROW_PADDING * 2, heights );
+
+        for ( int x = 0 ; x < HEIGHTMAP_RESOLUTION ; x++ ) {
+            if ( heights[x + ROW_PADDING] != ProceduralHeight( x, z ) ) {
+                self->NumMismatches++;
+            }
+        }
+    }
+
+    NumFinishedThreads.Increment();
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    TPodVector< float > heights;
+    heights.Resize( HEIGHTMAP_RESOLUTION * HEIGHTMAP_RESOLUTION );
+
+    for ( int z = 0 ; z < HEIGHTMAP_RESOLUTION ; z++ ) {
+        for ( int x = 0 ; x < HEIGHTMAP_RESOLUTION ; x++ ) {
+            heights[z * HEIGHTMAP_RESOLUTION + x] = ProceduralHeight( x, z );
+        }
+    }
+
+    if ( !ATerrainHeightmap::Bake( heights.ToPtr(), HEIGHTMAP_RESOLUTION, HeightmapFileName, false ) ) {
+        TEST_CHECK_MSG( false, "couldn't bake %s", HeightmapFileName );
+        return env.Finish( "TerrainHeightmapTest" );
+    }
+
+    ATerrainHeightmap heightmap;
+
+    TEST_CHECK( heightmap.Open( HeightmapFileName ) );
+
+    SSamplingThread threads[NUM_SAMPLING_THREADS];
+
+    int numMismatches = 0;
+
+    for ( int frame = 1 ; frame <= NUM_FRAMES ; frame++ ) {
+        NumFinishedThreads.Store( 0 );
+
+        for ( int i = 0 ; i < NUM_SAMPLING_THREADS ; i++ ) {
+            threads[i].Heightmap = &heightmap;
+            threads[i].Frame = frame;
+            threads[i].Seed = i;
+            threads[i].NumMismatches = 0;
+            threads[i].Thread.Routine = SampleRows;
+            threads[i].Thread.Data = &threads[i];
+            threads[i].Thread.Start();
+        }
+
+        // Evict the tiles while they are sampled
+        while ( NumFinishedThreads.Load() < NUM_SAMPLING_THREADS ) {
+            heightmap.UpdateResidency( frame, 0 );
+        }
+
+        for ( int i = 0 ; i < NUM_SAMPLING_THREADS ; i++ ) {
+            threads[i].Thread.Join();
+            numMismatches += threads[i].NumMismatches;
+        }
+    }
+
+    TEST_CHECK_MSG( numMismatches == 0, "%d samples don't match the source heights", numMismatches );
+
+    // Nothing is used in the new frame, all tiles are evicted
+    heightmap.UpdateResidency( NUM_FRAMES + 1, 0 );
+    TEST_CHECK( heightmap.GetResidentBytes() == 0 );
+
+    heightmap.Close();
+    remove( HeightmapFileName );
+
+    return env.Finish( "TerrainHeightmapTest" );
+}
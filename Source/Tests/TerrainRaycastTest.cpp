@@ -0,0 +1,380 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/*
+
+Terrain raycast test
+
+Bakes a small procedural heightmap and casts random rays against the terrain with the min/max height
+quadtree (com_TerrainNativeRaycast 1) and with the Bullet heightfield (com_TerrainNativeRaycast 0).
+Ray sets include random, vertical and axis-aligned rays, rays with zero and negative zero direction
+components, and rays running exactly along quad edges and tile boundaries. Closest hits must agree in
+location, normal and distance, all-hits queries must find the same intersections, and the batched
+query must give the same results as single rays.
+
+*/
+
+#include "TestCommon.h"
+
+#include <World/Public/Terrain.h>
+#include <World/Public/HitTest.h>
+#include <Core/Public/BV/BvIntersect.h>
+
+extern ARuntimeVariable com_TerrainNativeRaycast;
+
+static constexpr int HEIGHTMAP_RESOLUTION = 257;
+static constexpr int NUM_RAYS_PER_SET = 1000;
+static constexpr float RAY_DISTANCE = 600.0f;
+static constexpr float PLATEAU_HEIGHT = 5.0f;
+
+static constexpr float DISTANCE_EPSILON = 0.001f;
+static constexpr float LOCATION_EPSILON = 0.001f;
+
+// Hits closer than this to a triangle edge may be reported by either of the two triangles
+static constexpr float EDGE_EPSILON = 0.001f;
+
+static const char * HeightmapFileName = "TerrainRaycastTest.tiles";
+
+enum ERaySet
+{
+    RAY_SET_RANDOM,
+    RAY_SET_VERTICAL,
+    RAY_SET_VERTICAL_ON_EDGES,
+    RAY_SET_AXIAL,
+    RAY_SET_AXIAL_ON_EDGES,
+    RAY_SET_ZERO_COMPONENT,
+    RAY_SET_NEGATIVE_ZERO,
+    RAY_SET_UPWARD,
+    RAY_SET_MAX
+};
+
+static const char * RaySetName[RAY_SET_MAX] = {
+    "random",
+    "vertical",
+    "vertical on edges",
+    "axial",
+    "axial on edges",
+    "zero component",
+    "negative zero",
+    "upward"
+};
+
+static float ProceduralHeight( int X, int Z ) {
+    // Flat plateau, so rays can run exactly along the surface
+    if ( X >= 64 && X < 128 && Z >= 64 && Z < 128 ) {
+        return PLATEAU_HEIGHT;
+    }
+
+    return 8.0f * Math::Sin( X * 0.05f ) * Math::Cos( Z * 0.07f )
+         + 3.0f * Math::Sin( X * 0.23f + Z * 0.11f )
+         + ( ( X * 7 + Z * 13 ) % 17 == 0 ? 2.0f : 0.0f ); // spikes
+}
+
+static bool BakeHeightmap() {
+    TPodVector< float > heights;
+    heights.Resize( HEIGHTMAP_RESOLUTION * HEIGHTMAP_RESOLUTION );
+
+    for ( int z = 0 ; z < HEIGHTMAP_RESOLUTION ; z++ ) {
+        for ( int x = 0 ; x < HEIGHTMAP_RESOLUTION ; x++ ) {
+            heights[z * HEIGHTMAP_RESOLUTION + x] = ProceduralHeight( x, z );
+        }
+    }
+
+    return ATerrainHeightmap::Bake( heights.ToPtr(), HEIGHTMAP_RESOLUTION, HeightmapFileName, false );
+}
+
+static Float3 RandomDirection( STestRandom & _Random ) {
+    Float3 dir;
+    do {
+        dir = Float3( _Random.Range( -1.0f, 1.0f ), _Random.Range( -1.0f, 1.0f ), _Random.Range( -1.0f, 1.0f ) );
+    } while ( dir.LengthSqr() < 0.01f || dir.LengthSqr() > 1.0f );
+    return dir.Normalized();
+}
+
+static STerrainRay MakeRay( ERaySet _Set, STestRandom & _Random, ATerrain const * _Terrain ) {
+    BvAxisAlignedBox const & bounds = _Terrain->GetBoundingBox();
+    const float half = HEIGHTMAP_RESOLUTION >> 1;
+
+    STerrainRay ray;
+    ray.Distance = RAY_DISTANCE;
+
+    switch ( _Set ) {
+    case RAY_SET_RANDOM:
+    default:
+        ray.Start = Float3( _Random.Range( -half - 16, half + 16 ), _Random.Range( bounds.Mins.Y - 4, bounds.Maxs.Y + 20 ), _Random.Range( -half - 16, half + 16 ) );
+        ray.Dir = RandomDirection( _Random );
+        break;
+    case RAY_SET_VERTICAL:
+        ray.Start = Float3( _Random.Range( -half, half ), bounds.Maxs.Y + 10, _Random.Range( -half, half ) );
+        ray.Dir = Float3( 0.0f, -1.0f, 0.0f );
+        break;
+    case RAY_SET_VERTICAL_ON_EDGES: {
+        // Quad corners and edges, tile boundaries and terrain border
+        float x = (int)_Random.Range( -half, half );
+        float z = (int)_Random.Range( -half, half );
+        switch ( _Random.Next() % 4 ) {
+        case 0: x += 0.5f; break;
+        case 1: z += 0.5f; break;
+        case 2: x = (int)( x / TERRAIN_HEIGHTMAP_TILE_SIZE ) * TERRAIN_HEIGHTMAP_TILE_SIZE; break;
+        case 3: x = -half; break; // Bullet heightfield misses rays exactly on the max border
+        }
+        ray.Start = Float3( x, bounds.Maxs.Y + 10, z );
+        ray.Dir = Float3( 0.0f, -1.0f, 0.0f );
+        break;
+    }
+    case RAY_SET_AXIAL:
+    case RAY_SET_AXIAL_ON_EDGES: {
+        const float y = _Random.Range( bounds.Mins.Y, bounds.Maxs.Y );
+        float across = _Random.Range( -half, half );
+        if ( _Set == RAY_SET_AXIAL_ON_EDGES ) {
+            across = (int)across;
+        }
+        const float sign = ( _Random.Next() & 1 ) ? 1.0f : -1.0f;
+        if ( _Random.Next() & 1 ) {
+            ray.Start = Float3( -sign * ( half + 8 ), y, across );
+            ray.Dir = Float3( sign, 0.0f, 0.0f );
+        } else {
+            ray.Start = Float3( across, y, -sign * ( half + 8 ) );
+            ray.Dir = Float3( 0.0f, 0.0f, sign );
+        }
+        // Rays along the plateau surface
+        if ( _Set == RAY_SET_AXIAL_ON_EDGES && ( _Random.Next() & 3 ) == 0 ) {
+            ray.Start.Y = PLATEAU_HEIGHT;
+        }
+        break;
+    }
+    case RAY_SET_ZERO_COMPONENT: {
+        Float3 dir = RandomDirection( _Random );
+        dir[( _Random.Next() & 1 ) ? 0 : 2] = 0.0f;
+        if ( dir.LengthSqr() < 0.01f ) {
+            dir = Float3( 1.0f, -1.0f, 0.0f );
+        }
+        ray.Start = Float3( _Random.Range( -half, half ), _Random.Range( bounds.Mins.Y, bounds.Maxs.Y + 20 ), _Random.Range( -half, half ) );
+        ray.Dir = dir.Normalized();
+        break;
+    }
+    case RAY_SET_NEGATIVE_ZERO:
+        ray.Start = Float3( _Random.Range( -half, half ), bounds.Maxs.Y + 10, _Random.Range( -half, half ) );
+        if ( _Random.Next() & 1 ) {
+            ray.Start.X = (int)ray.Start.X;
+            ray.Start.Z = (int)ray.Start.Z;
+        }
+        ray.Dir = Float3( -0.0f, -1.0f, -0.0f );
+        break;
+    case RAY_SET_UPWARD:
+        ray.Start = Float3( _Random.Range( -half, half ), bounds.Mins.Y - 10, _Random.Range( -half, half ) );
+        ray.Dir = Float3( 0.0f, 1.0f, 0.0f );
+        break;
+    }
+
+    return ray;
+}
+
+/** Returns true if the point is close to an edge of the quad triangles */
+static bool IsOnTriangleEdge( Float3 const & _Point ) {
+    const float fx = _Point.X - Math::Floor( _Point.X );
+    const float fz = _Point.Z - Math::Floor( _Point.Z );
+
+    return fx < EDGE_EPSILON || fx > 1.0f - EDGE_EPSILON
+        || fz < EDGE_EPSILON || fz > 1.0f - EDGE_EPSILON
+        || Math::Abs( fx + fz - 1.0f ) < EDGE_EPSILON;
+}
+
+static bool IsSameHit( STriangleHitResult const & _A, STriangleHitResult const & _B, bool & _bEdge ) {
+    _bEdge = false;
+
+    if ( Math::Abs( _A.Distance - _B.Distance ) > DISTANCE_EPSILON ) {
+        return false;
+    }
+    if ( !_A.Location.CompareEps( _B.Location, LOCATION_EPSILON ) ) {
+        return false;
+    }
+    if ( Math::Dot( _A.Normal, _B.Normal ) < 0.9999f ) {
+        // Triangles sharing the edge have different normals
+        _bEdge = IsOnTriangleEdge( _A.Location );
+        return _bEdge;
+    }
+    return true;
+}
+
+/** Returns true if every hit from _A is also found in _B */
+static bool ContainsHits( TPodVector< STriangleHitResult > const & _A, TPodVector< STriangleHitResult > const & _B ) {
+    for ( STriangleHitResult const & a : _A ) {
+        bool bFound = false;
+        for ( int i = 0 ; !bFound && i < _B.Size() ; i++ ) {
+            bool bEdge;
+            bFound = IsSameHit( a, _B[i], bEdge );
+        }
+        if ( !bFound ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void TestRayBox() {
+    const BvAxisAlignedBox box( Float3( 0.0f ), Float3( 1.0f ) );
+    float boxMin, boxMax;
+
+    auto intersect = [&]( Float3 const & _Start, Float3 const & _Dir ) {
+        const Float3 invDir( 1.0f / _Dir.X, 1.0f / _Dir.Y, 1.0f / _Dir.Z );
+        const bool bHit = BvRayIntersectBox( _Start, invDir, box, boxMin, boxMax );
+        TEST_CHECK( !Math::IsNan( boxMin ) && !Math::IsNan( boxMax ) );
+        return bHit;
+    };
+
+    // Vertical ray through the box
+    TEST_CHECK( intersect( Float3( 0.5f, 2.0f, 0.5f ), Float3( 0.0f, -1.0f, 0.0f ) ) );
+    TEST_CHECK( boxMin == 1.0f && boxMax == 2.0f );
+
+    // Same with negative zero components
+    TEST_CHECK( intersect( Float3( 0.5f, 2.0f, 0.5f ), Float3( -0.0f, -1.0f, -0.0f ) ) );
+    TEST_CHECK( boxMin == 1.0f && boxMax == 2.0f );
+
+    // Ray origin on the box face plane of the zero component
+    TEST_CHECK( intersect( Float3( 1.0f, 2.0f, 0.0f ), Float3( 0.0f, -1.0f, 0.0f ) ) );
+    TEST_CHECK( boxMin == 1.0f && boxMax == 2.0f );
+    TEST_CHECK( intersect( Float3( 0.0f, 2.0f, 1.0f ), Float3( -0.0f, -1.0f, 0.0f ) ) );
+
+    // Parallel ray outside of the box
+    TEST_CHECK( !intersect( Float3( 1.5f, 2.0f, 0.5f ), Float3( 0.0f, -1.0f, 0.0f ) ) );
+    TEST_CHECK( !intersect( Float3( 0.5f, 2.0f, -0.5f ), Float3( 0.0f, -1.0f, -0.0f ) ) );
+
+    // Axial ray along the box edge
+    TEST_CHECK( intersect( Float3( -1.0f, 1.0f, 1.0f ), Float3( 1.0f, 0.0f, 0.0f ) ) );
+    TEST_CHECK( boxMin == 1.0f && boxMax == 2.0f );
+
+    // Box behind the ray
+    TEST_CHECK( !intersect( Float3( 0.5f, -1.0f, 0.5f ), Float3( 0.0f, -1.0f, 0.0f ) ) );
+}
+
+int main( int argc, char * argv[] ) {
+    STestEnvironment env( argc, argv );
+
+    TestRayBox();
+
+    if ( !BakeHeightmap() ) {
+        TEST_CHECK_MSG( false, "couldn't bake %s", HeightmapFileName );
+        return env.Finish( "TerrainRaycastTest" );
+    }
+
+    TRef< ATerrain > terrain( CreateInstanceOf< ATerrain >( HeightmapFileName ) );
+
+    TEST_CHECK( terrain->GetHeightmap().GetResolution() == HEIGHTMAP_RESOLUTION );
+
+    STestRandom random( 4321 );
+
+    TPodVector< STerrainRay > rays;
+    TPodVector< STriangleHitResult > hits, hitsBullet;
+
+    for ( int set = 0 ; set < RAY_SET_MAX ; set++ ) {
+        int numHits = 0;
+        int numEdgeHits = 0;
+        int numMismatches = 0;
+
+        rays.Clear();
+
+        for ( int i = 0 ; i < NUM_RAYS_PER_SET ; i++ ) {
+            STerrainRay const & ray = rays.Append() = MakeRay( (ERaySet)set, random, terrain );
+
+            for ( bool bCullBackFace : { true, false } ) {
+                STriangleHitResult closest, closestBullet;
+
+                com_TerrainNativeRaycast.ForceBool( true );
+                const bool bHit = terrain->RaycastClosest( ray.Start, ray.Dir, ray.Distance, bCullBackFace, closest );
+                hits.Clear();
+                terrain->Raycast( ray.Start, ray.Dir, ray.Distance, bCullBackFace, hits );
+
+                com_TerrainNativeRaycast.ForceBool( false );
+                const bool bHitBullet = terrain->RaycastClosest( ray.Start, ray.Dir, ray.Distance, bCullBackFace, closestBullet );
+                hitsBullet.Clear();
+                terrain->Raycast( ray.Start, ray.Dir, ray.Distance, bCullBackFace, hitsBullet );
+
+                bool bEdge = false;
+                bool bSame = bHit == bHitBullet && ( !bHit || IsSameHit( closest, closestBullet, bEdge ) );
+
+                // All hits, unordered. Hits on a shared edge may be reported once or by both triangles,
+                // so compare the sets of intersections instead of the hit counts.
+                // A ray lying in the plateau plane touches every plateau triangle, only the closest hit is well defined.
+                const bool bCoplanar = ray.Dir.Y == 0.0f && ray.Start.Y == PLATEAU_HEIGHT;
+                bSame = bSame && ( bCoplanar || ( ContainsHits( hits, hitsBullet ) && ContainsHits( hitsBullet, hits ) ) );
+
+                if ( !bSame ) {
+                    if ( numMismatches++ < 8 ) {
+                        printf( "%s ray (%f %f %f) dir (%f %f %f), cull %d: hit %d/%d, distance %f/%f, %d/%d hits\n",
+                                RaySetName[set], ray.Start.X, ray.Start.Y, ray.Start.Z, ray.Dir.X, ray.Dir.Y, ray.Dir.Z, bCullBackFace,
+                                bHit, bHitBullet, closest.Distance, closestBullet.Distance, hits.Size(), hitsBullet.Size() );
+                    }
+                }
+
+                numHits += bHit;
+                numEdgeHits += bEdge;
+            }
+        }
+
+        TEST_CHECK_MSG( numMismatches == 0, "%d mismatches in %s ray set", numMismatches, RaySetName[set] );
+
+        // Batched query
+        com_TerrainNativeRaycast.ForceBool( true );
+
+        TPodVector< STriangleHitResult > batchResults;
+        TPodVector< bool > batchHits;
+        batchResults.Resize( rays.Size() );
+        batchHits.Resize( rays.Size() );
+
+        const int numBatchHits = terrain->RaycastClosestBatch( rays.ToPtr(), rays.Size(), true, batchResults.ToPtr(), batchHits.ToPtr() );
+
+        int numSingleHits = 0;
+        for ( int i = 0 ; i < rays.Size() ; i++ ) {
+            STriangleHitResult closest;
+            const bool bHit = terrain->RaycastClosest( rays[i].Start, rays[i].Dir, rays[i].Distance, true, closest );
+
+            TEST_CHECK( bHit == batchHits[i] );
+            TEST_CHECK( !bHit || ( closest.Distance == batchResults[i].Distance && closest.Location == batchResults[i].Location ) );
+
+            numSingleHits += bHit;
+        }
+        TEST_CHECK( numBatchHits == numSingleHits );
+
+        printf( "%s rays: %d hits, %d hits on triangle edges\n", RaySetName[set], numHits, numEdgeHits );
+
+        if ( set == RAY_SET_VERTICAL || set == RAY_SET_NEGATIVE_ZERO ) {
+            // Every vertical ray above the terrain hits it
+            TEST_CHECK( numHits == NUM_RAYS_PER_SET * 2 );
+        }
+    }
+
+    com_TerrainNativeRaycast.ForceBool( true );
+
+    terrain.Reset();
+    remove( HeightmapFileName );
+
+    return env.Finish( "TerrainRaycastTest" );
+}
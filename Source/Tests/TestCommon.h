@@ -0,0 +1,134 @@
+/*
+
+Angie Engine Source Code
+
+MIT License
+
+Copyright (C) 2017-2021 Alexander Samusev.
+
+This file is part of the Angie Engine Source Code.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#pragma once
+
+#include <Core/Public/Core.h>
+#include <World/Public/Base/BaseObject.h>
+#include <Runtime/Public/RuntimeVariable.h>
+
+#include <stdio.h>
+
+/**
+
+Headless test helpers
+
+Tests are plain executables. Every failed check is printed and counted, the test returns
+non-zero exit code if any check failed.
+
+*/
+
+/** Number of failed checks */
+inline int & TestFailures()
+{
+    static int numFailures = 0;
+    return numFailures;
+}
+
+#define TEST_CHECK( _Expression ) \
+    do { \
+        if ( !( _Expression ) ) { \
+            printf( "%s(%d): check failed: %s\n", __FILE__, __LINE__, #_Expression ); \
+            TestFailures()++; \
+        } \
+    } while ( 0 )
+
+#define TEST_CHECK_MSG( _Expression, ... ) \
+    do { \
+        if ( !( _Expression ) ) { \
+            printf( "%s(%d): check failed: %s: ", __FILE__, __LINE__, #_Expression ); \
+            printf( __VA_ARGS__ ); \
+            printf( "\n" ); \
+            TestFailures()++; \
+        } \
+    } while ( 0 )
+
+/** Initializes core library, runtime variables and garbage collector for the lifetime of the test */
+struct STestEnvironment
+{
+    STestEnvironment( int _Argc, char ** _Argv )
+    {
+        SCoreInitialize init;
+        init.Argc = _Argc;
+        init.Argv = _Argv;
+        init.ZoneSizeInMegabytes = 64;
+        init.HunkSizeInMegabytes = 8;
+        Core::Initialize( init );
+
+        // Set default values of the runtime variables
+        ARuntimeVariable::AllocateVariables();
+
+        AGarbageCollector::Initialize();
+    }
+
+    ~STestEnvironment()
+    {
+        AGarbageCollector::DeallocateObjects();
+        AGarbageCollector::Deinitialize();
+
+        ARuntimeVariable::FreeVariables();
+
+        Core::Deinitialize();
+    }
+
+    /** Returns process exit code */
+    int Finish( const char * _TestName )
+    {
+        if ( TestFailures() ) {
+            printf( "%s: %d check(s) failed\n", _TestName, TestFailures() );
+            return 1;
+        }
+        printf( "%s: passed\n", _TestName );
+        return 0;
+    }
+};
+
+/** Deterministic random numbers, so failures are reproducible */
+struct STestRandom
+{
+    uint32_t State;
+
+    explicit STestRandom( uint32_t _Seed ) : State( _Seed ? _Seed : 1 ) {}
+
+    uint32_t Next()
+    {
+        // xorshift32
+        State ^= State << 13;
+        State ^= State >> 17;
+        State ^= State << 5;
+        return State;
+    }
+
+    /** Random float in [_Min, _Max] */
+    float Range( float _Min, float _Max )
+    {
+        return _Min + ( _Max - _Min ) * ( Next() & 0xffffff ) * ( 1.0f / 0xffffff );
+    }
+};